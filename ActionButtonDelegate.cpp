@@ -0,0 +1,130 @@
+﻿#include "ActionButtonDelegate.h"
+#include <QMouseEvent>
+#include <QPainter>
+#include <algorithm>
+
+namespace {
+    constexpr int kButtonHeight = 25;
+    constexpr int kMargin = 5;
+    constexpr int kSpacing = 5;
+}
+
+ActionButtonDelegate::ActionButtonDelegate(QAbstractItemView* view)
+    : QStyledItemDelegate(view), view(view) {
+    view->setMouseTracking(true);
+    // 鼠标离开表格时清除悬停效果
+    view->viewport()->installEventFilter(this);
+}
+
+void ActionButtonDelegate::addButton(int action, const QString& text, const QColor& color,
+    const QColor& hoverColor, int width) {
+    buttons[action] = Button{ text, color, hoverColor.isValid() ? hoverColor : color.darker(115), width };
+}
+
+std::vector<std::pair<int, QRect>> ActionButtonDelegate::buttonRects(const QRect& cell, const QModelIndex& index) const {
+    std::vector<std::pair<int, QRect>> rects;
+    int height = std::min(kButtonHeight, cell.height() - 4);
+    int top = cell.top() + (cell.height() - height) / 2;
+    int left = cell.left() + kMargin;
+
+    const QVariantList actions = index.data(ActionsRole).toList();
+    for (const QVariant& value : actions) {
+        auto it = buttons.find(value.toInt());
+        if (it == buttons.end()) continue;
+
+        rects.emplace_back(it->first, QRect(left, top, it->second.width, height));
+        left += it->second.width + kSpacing;
+    }
+    return rects;
+}
+
+int ActionButtonDelegate::actionAt(const QRect& cell, const QModelIndex& index, const QPoint& pos) const {
+    for (const auto& [action, rect] : buttonRects(cell, index)) {
+        if (rect.contains(pos)) return action;
+    }
+    return -1;
+}
+
+void ActionButtonDelegate::paint(QPainter* painter, const QStyleOptionViewItem& option, const QModelIndex& index) const {
+    // 先画背景（交替行色、选中色），操作列本身没有文字
+    QStyledItemDelegate::paint(painter, option, index);
+
+    std::vector<std::pair<int, QRect>> rects = buttonRects(option.rect, index);
+    if (rects.empty()) return;
+
+    painter->save();
+    painter->setRenderHint(QPainter::Antialiasing);
+    painter->setFont(option.font);
+    for (const auto& [action, rect] : rects) {
+        const Button& button = buttons.at(action);
+        bool hovered = hoveredAction == action && hoveredIndex == index;
+
+        painter->setPen(Qt::NoPen);
+        painter->setBrush(hovered ? button.hoverColor : button.color);
+        painter->drawRoundedRect(rect, 3, 3);
+        painter->setPen(Qt::white);
+        painter->drawText(rect, Qt::AlignCenter, button.text);
+    }
+    painter->restore();
+}
+
+QSize ActionButtonDelegate::sizeHint(const QStyleOptionViewItem& option, const QModelIndex& index) const {
+    QSize size = QStyledItemDelegate::sizeHint(option, index);
+    std::vector<std::pair<int, QRect>> rects = buttonRects(QRect(0, 0, 0, kButtonHeight + 4), index);
+    if (!rects.empty()) {
+        size.setWidth(std::max(size.width(), rects.back().second.right() + kMargin));
+        size.setHeight(std::max(size.height(), kButtonHeight + 4));
+    }
+    return size;
+}
+
+bool ActionButtonDelegate::editorEvent(QEvent* event, QAbstractItemModel* model,
+    const QStyleOptionViewItem& option, const QModelIndex& index) {
+    switch (event->type()) {
+    case QEvent::MouseMove: {
+        QPoint pos = static_cast<QMouseEvent*>(event)->position().toPoint();
+        setHovered(index, actionAt(option.rect, index, pos));
+        return false;
+    }
+    case QEvent::MouseButtonPress:
+    case QEvent::MouseButtonDblClick: {
+        // 按在按钮上时不改变选中行，也不触发双击
+        QPoint pos = static_cast<QMouseEvent*>(event)->position().toPoint();
+        return actionAt(option.rect, index, pos) >= 0;
+    }
+    case QEvent::MouseButtonRelease: {
+        QMouseEvent* mouseEvent = static_cast<QMouseEvent*>(event);
+        if (mouseEvent->button() != Qt::LeftButton) break;
+
+        int action = actionAt(option.rect, index, mouseEvent->position().toPoint());
+        if (action < 0) break;
+        if (actionHandler) {
+            // 处理函数可能弹出对话框，期间模型可能被事件更新，传出的index只在调用开始时有效
+            actionHandler(action, index);
+        }
+        return true;
+    }
+    default:
+        break;
+    }
+    return QStyledItemDelegate::editorEvent(event, model, option, index);
+}
+
+bool ActionButtonDelegate::eventFilter(QObject* watched, QEvent* event) {
+    if (event->type() == QEvent::Leave) {
+        setHovered(QModelIndex(), -1);
+    }
+    return QStyledItemDelegate::eventFilter(watched, event);
+}
+
+void ActionButtonDelegate::setHovered(const QModelIndex& index, int action) {
+    if (action < 0 && hoveredAction < 0) return;
+    if (QPersistentModelIndex(index) == hoveredIndex && action == hoveredAction) return;
+
+    QModelIndex previous = hoveredIndex;
+    hoveredIndex = action >= 0 ? QPersistentModelIndex(index) : QPersistentModelIndex();
+    hoveredAction = action;
+
+    if (previous.isValid()) view->update(previous);
+    if (index.isValid()) view->update(index);
+}
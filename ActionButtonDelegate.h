@@ -0,0 +1,54 @@
+﻿#pragma once
+#include <QAbstractItemView>
+#include <QColor>
+#include <QPersistentModelIndex>
+#include <QStyledItemDelegate>
+#include <functional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// 表格操作列的按钮由委托直接绘制，不为每一行创建按钮控件
+// 单元格的ActionsRole数据为要显示的按钮编号列表（QVariantList），按钮的文字和颜色事先用addButton登记
+// 只有视口中可见的行会被绘制，行数再多也不增加控件和内存开销
+class ActionButtonDelegate : public QStyledItemDelegate {
+public:
+    static constexpr int ActionsRole = Qt::UserRole + 1;
+
+    using ActionHandler = std::function<void(int action, const QModelIndex& index)>;
+
+    // 委托只用于view，开启鼠标跟踪以绘制悬停效果
+    explicit ActionButtonDelegate(QAbstractItemView* view);
+
+    // hoverColor无效时取color加深后的颜色
+    void addButton(int action, const QString& text, const QColor& color,
+        const QColor& hoverColor = QColor(), int width = 60);
+    void setActionHandler(ActionHandler handler) { actionHandler = std::move(handler); }
+
+    void paint(QPainter* painter, const QStyleOptionViewItem& option, const QModelIndex& index) const override;
+    QSize sizeHint(const QStyleOptionViewItem& option, const QModelIndex& index) const override;
+
+protected:
+    bool editorEvent(QEvent* event, QAbstractItemModel* model,
+        const QStyleOptionViewItem& option, const QModelIndex& index) override;
+    bool eventFilter(QObject* watched, QEvent* event) override;
+
+private:
+    struct Button {
+        QString text;
+        QColor color;
+        QColor hoverColor;
+        int width;
+    };
+
+    // 单元格内各按钮的位置，自左向右排列
+    std::vector<std::pair<int, QRect>> buttonRects(const QRect& cell, const QModelIndex& index) const;
+    int actionAt(const QRect& cell, const QModelIndex& index, const QPoint& pos) const;
+    void setHovered(const QModelIndex& index, int action);
+
+    QAbstractItemView* view;
+    std::unordered_map<int, Button> buttons;
+    ActionHandler actionHandler;
+    QPersistentModelIndex hoveredIndex;
+    int hoveredAction = -1;
+};
@@ -0,0 +1,62 @@
+﻿#pragma once
+// 后台任务：在线程池中执行数据库操作，完成后把结果投递回UI线程
+#include <QCoreApplication>
+#include <QObject>
+#include <QPointer>
+#include <QThreadPool>
+#include <atomic>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+// 异步任务句柄：可查询是否仍在执行、请求取消
+// 取消后完成回调不再执行；执行中的任务可通过isCancelled()轮询以提前结束
+class AsyncTask {
+public:
+    AsyncTask() = default;
+
+    void cancel() {
+        if (state) state->cancelled = true;
+    }
+    bool isCancelled() const { return state && state->cancelled; }
+    bool isRunning() const { return state && !state->finished; }
+
+private:
+    struct State {
+        std::atomic<bool> cancelled{ false };
+        std::atomic<bool> finished{ false };
+    };
+
+    explicit AsyncTask(std::shared_ptr<State> state) : state(std::move(state)) {}
+
+    std::shared_ptr<State> state;
+
+    template<typename Work, typename Done>
+    friend AsyncTask startAsyncTask(QThreadPool& pool, QObject* context, Work work, Done done);
+};
+
+// 在pool中执行 work(const AsyncTask&)，完成后在UI线程调用 done(result)
+// context被销毁（如窗口已关闭）或任务已取消时丢弃结果，回调里可以放心访问context
+template<typename Work, typename Done>
+AsyncTask startAsyncTask(QThreadPool& pool, QObject* context, Work work, Done done) {
+    using Result = std::decay_t<std::invoke_result_t<Work&, const AsyncTask&>>;
+
+    auto state = std::make_shared<AsyncTask::State>();
+    AsyncTask task(state);
+    QPointer<QObject> guard(context);
+
+    pool.start([task, guard, work = std::move(work), done = std::move(done)]() mutable {
+        auto result = std::make_shared<Result>(work(task));
+
+        // 投递到应用对象（常驻UI线程），到达后再检查context是否还在
+        QMetaObject::invokeMethod(QCoreApplication::instance(), [task, guard, done, result]() {
+            task.state->finished = true;
+            if (task.isCancelled() || !guard) {
+                return;
+            }
+            done(*result);
+        }, Qt::QueuedConnection);
+    });
+
+    return task;
+}
@@ -0,0 +1,137 @@
+﻿#include "ChangeEventBus.h"
+#include <QCoreApplication>
+#include <algorithm>
+
+namespace {
+    thread_local ChangeEventBus::Capture* activeCapture = nullptr;
+}
+
+ChangeEventBus::Capture::Capture() : outer(activeCapture) {
+    activeCapture = this;
+}
+
+ChangeEventBus::Capture::~Capture() {
+    activeCapture = outer;
+}
+
+ChangeEventBus::ChangeEventBus() : head(&stub), tail(&stub) {
+}
+
+ChangeEventBus::~ChangeEventBus() {
+    while (Node* node = pop()) {
+        delete node;
+    }
+}
+
+bool ChangeEventBus::hasSubscribers() const {
+    return activeCapture != nullptr || subscriberCount.load(std::memory_order_acquire) > 0;
+}
+
+void ChangeEventBus::publish(ChangeEvent event) {
+    if (activeCapture) {
+        activeCapture->events().push_back(event);
+    }
+    if (subscriberCount.load(std::memory_order_acquire) == 0) {
+        return;
+    }
+
+    Node* node = new Node();
+    node->event = std::move(event);
+    push(node);
+
+    // 队列由空闲变为有积压时才投递，一批事件只触发一次取出
+    if (!drainScheduled.exchange(true, std::memory_order_acq_rel)) {
+        QMetaObject::invokeMethod(this, [this]() { drain(); }, Qt::QueuedConnection);
+    }
+}
+
+void ChangeEventBus::push(Node* node) {
+    node->next.store(nullptr, std::memory_order_relaxed);
+    Node* previous = head.exchange(node, std::memory_order_acq_rel);
+    previous->next.store(node, std::memory_order_release);
+}
+
+// 返回已出队的节点（由调用方释放），队列为空或生产者尚未完成链接时返回nullptr
+ChangeEventBus::Node* ChangeEventBus::pop() {
+    Node* first = tail;
+    Node* next = first->next.load(std::memory_order_acquire);
+
+    if (first == &stub) {
+        if (!next) {
+            return nullptr;
+        }
+        tail = next;
+        first = next;
+        next = next->next.load(std::memory_order_acquire);
+    }
+
+    if (next) {
+        tail = next;
+        return first;
+    }
+
+    // first是最后一个节点：把stub接到队尾后才能取出它
+    if (first != head.load(std::memory_order_acquire)) {
+        return nullptr;
+    }
+    push(&stub);
+    next = first->next.load(std::memory_order_acquire);
+    if (next) {
+        tail = next;
+        return first;
+    }
+    return nullptr;
+}
+
+void ChangeEventBus::drain() {
+    // 先清除标记再取出：之后完成入队的生产者会再投递一次，不会有事件滞留
+    drainScheduled.store(false, std::memory_order_release);
+
+    std::vector<ChangeEvent> events;
+    while (Node* node = pop()) {
+        events.push_back(std::move(node->event));
+        delete node;
+    }
+    if (events.empty()) {
+        return;
+    }
+
+    // 回调期间可能订阅或退订，先复制一份
+    std::vector<Subscriber> targets;
+    {
+        std::lock_guard<std::mutex> lock(subscriberMutex);
+        targets = subscribers;
+    }
+
+    bool expired = false;
+    for (const Subscriber& subscriber : targets) {
+        if (!subscriber.context) {
+            expired = true;
+            continue;
+        }
+        subscriber.handler(events);
+    }
+
+    if (expired) {
+        std::lock_guard<std::mutex> lock(subscriberMutex);
+        subscribers.erase(std::remove_if(subscribers.begin(), subscribers.end(),
+            [](const Subscriber& subscriber) { return !subscriber.context; }), subscribers.end());
+        subscriberCount.store(static_cast<int>(subscribers.size()), std::memory_order_release);
+    }
+}
+
+int ChangeEventBus::subscribe(QObject* context, Handler handler) {
+    std::lock_guard<std::mutex> lock(subscriberMutex);
+    int id = nextSubscriptionId++;
+    subscribers.push_back(Subscriber{ id, QPointer<QObject>(context), std::move(handler) });
+    subscriberCount.store(static_cast<int>(subscribers.size()), std::memory_order_release);
+    return id;
+}
+
+void ChangeEventBus::unsubscribe(int subscriptionId) {
+    std::lock_guard<std::mutex> lock(subscriberMutex);
+    subscribers.erase(std::remove_if(subscribers.begin(), subscribers.end(),
+        [subscriptionId](const Subscriber& subscriber) { return subscriber.id == subscriptionId; }),
+        subscribers.end());
+    subscriberCount.store(static_cast<int>(subscribers.size()), std::memory_order_release);
+}
@@ -0,0 +1,96 @@
+﻿#pragma once
+#include "CommonTypes.h"
+#include <QObject>
+#include <QPointer>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// SystemManager写操作成功后发布的数据变更事件
+struct ChangeEvent {
+    enum class Type {
+        RegistrationCreated,        // registration为新挂号
+        RegistrationStatusChanged,  // registration为变更后的挂号
+        RegistrationDeleted,        // 只有registrationId
+        BillCreated,                // registration为结算后的挂号，billId、amount为账单
+        DoctorAssigned,             // doctorId调整到departmentId（0表示未分配）
+        DoctorCapacityChanged,      // doctorId的号源数调整，date为空表示默认号源
+        DepartmentChanged,          // 科室新增、修改或删除
+        UserUpdated                 // 病人或医生注册、修改资料，userId、role
+    };
+
+    Type type = Type::RegistrationCreated;
+    int registrationId = 0;
+    int doctorId = 0;
+    int patientId = 0;
+    int departmentId = 0;
+    int billId = 0;
+    int userId = 0;
+    double amount = 0.0;
+    std::string role;
+    std::string date;
+    RegistrationInfo registration;  // 挂号相关事件携带一行完整数据，界面可直接替换对应行
+};
+
+// 进程内变更事件总线
+// 任意线程publish()，事件进入无锁多生产者单消费者队列；首个进入空闲队列的事件向UI线程投递一次取出任务，
+// 取出时把积压的事件作为一批交给订阅者，订阅者据此只更新受影响的行
+// 没有订阅者时直接丢弃事件（如命令行模式）
+class ChangeEventBus : public QObject {
+public:
+    using Handler = std::function<void(const std::vector<ChangeEvent>& events)>;
+
+    // 在当前线程收集作用域内发布的事件（挂号服务据此把一次调用产生的事件随应答返回）
+    class Capture {
+    public:
+        Capture();
+        ~Capture();
+        Capture(const Capture&) = delete;
+        Capture& operator=(const Capture&) = delete;
+
+        std::vector<ChangeEvent>& events() { return captured; }
+
+    private:
+        std::vector<ChangeEvent> captured;
+        Capture* outer;
+    };
+
+    ChangeEventBus();
+    ~ChangeEventBus() override;
+
+    void publish(ChangeEvent event);
+    // 有订阅者或当前线程正在收集时才需要准备事件内容
+    bool hasSubscribers() const;
+
+    // handler在UI线程调用；context销毁后自动退订
+    int subscribe(QObject* context, Handler handler);
+    void unsubscribe(int subscriptionId);
+
+private:
+    struct Node {
+        std::atomic<Node*> next{ nullptr };
+        ChangeEvent event;
+    };
+
+    void push(Node* node);
+    Node* pop();
+    void drain();
+
+    // 生产者交换head后再链接next；消费者从tail开始读取，只在UI线程访问
+    std::atomic<Node*> head;
+    Node* tail;
+    Node stub;
+    std::atomic<bool> drainScheduled{ false };
+
+    struct Subscriber {
+        int id = 0;
+        QPointer<QObject> context;
+        Handler handler;
+    };
+    std::mutex subscriberMutex;
+    std::vector<Subscriber> subscribers;
+    std::atomic<int> subscriberCount{ 0 };
+    int nextSubscriptionId = 1;
+};
@@ -4,6 +4,7 @@
 // 添加必要的包含
 #include <string>
 #include <vector>
+#include <tuple>
 
 struct UserInfo {
     int userId = 0;
@@ -16,6 +17,13 @@ struct UserInfo {
     std::string address;
     std::string idCard;
     std::string department;
+    // 查询结果列与成员的对应关系（按SELECT列顺序，见RowMapping.h）
+    static constexpr auto columns() {
+        return std::make_tuple(&UserInfo::userId, &UserInfo::username, &UserInfo::role,
+            &UserInfo::name, &UserInfo::gender, &UserInfo::age, &UserInfo::phone,
+            &UserInfo::address, &UserInfo::idCard, &UserInfo::department);
+    }
+
     // 添加默认构造函数
     UserInfo() = default;
 
@@ -37,6 +45,12 @@ struct DoctorInfo {
     std::string phone;
     std::string department;
 
+    // 查询结果列：doctor_id, name, gender, age, phone, department
+    static constexpr auto columns() {
+        return std::make_tuple(&DoctorInfo::doctorId, &DoctorInfo::name, &DoctorInfo::gender,
+            &DoctorInfo::age, &DoctorInfo::phone, &DoctorInfo::department);
+    }
+
     // 添加默认构造函数
     DoctorInfo() = default;
 
@@ -62,6 +76,15 @@ struct RegistrationInfo {
     double billAmount = 0.0;
     std::string billStatus;
 
+    // 查询结果列：挂号信息、病人/医生名称、科室，以及是否有账单、金额、账单状态
+    static constexpr auto columns() {
+        return std::make_tuple(&RegistrationInfo::registrationId, &RegistrationInfo::registrationDate,
+            &RegistrationInfo::patientId, &RegistrationInfo::doctorId, &RegistrationInfo::status,
+            &RegistrationInfo::notes, &RegistrationInfo::patientName, &RegistrationInfo::doctorName,
+            &RegistrationInfo::doctorDepartment, &RegistrationInfo::hasBill,
+            &RegistrationInfo::billAmount, &RegistrationInfo::billStatus);
+    }
+
     // 添加默认构造函数
     RegistrationInfo() = default;
 
@@ -72,12 +95,57 @@ struct RegistrationInfo {
     }
 };
 
+// 挂号查询条件：字符串为空、ID为0表示不限；日期格式yyyy-MM-dd，含首尾两天
+struct RegistrationFilter {
+    std::string startDate;
+    std::string endDate;
+    std::string department;     // 医生所属科室名称
+    int doctorId = 0;
+    std::string status;
+
+    static constexpr auto columns() {
+        return std::make_tuple(&RegistrationFilter::startDate, &RegistrationFilter::endDate,
+            &RegistrationFilter::department, &RegistrationFilter::doctorId, &RegistrationFilter::status);
+    }
+
+    // 与SQL条件一致，用于判断变更事件中的挂号是否属于当前查询结果
+    bool matches(const RegistrationInfo& reg) const {
+        return (startDate.empty() || reg.registrationDate >= startDate)
+            && (endDate.empty() || reg.registrationDate <= endDate)
+            && (department.empty() || reg.doctorDepartment == department)
+            && (doctorId == 0 || reg.doctorId == doctorId)
+            && (status.empty() || reg.status == status);
+    }
+};
+
+// 键集分页游标：上一页最后一行的(挂号日期, 单号)，结果按二者降序；registrationId为0表示第一页
+struct RegistrationCursor {
+    std::string registrationDate;
+    int registrationId = 0;
+
+    static constexpr auto columns() {
+        return std::make_tuple(&RegistrationCursor::registrationDate, &RegistrationCursor::registrationId);
+    }
+
+    static RegistrationCursor after(const RegistrationInfo& last) {
+        RegistrationCursor cursor;
+        cursor.registrationDate = last.registrationDate;
+        cursor.registrationId = last.registrationId;
+        return cursor;
+    }
+};
+
 struct BillInfo {
     int billId = 0;
     std::string billDate;
     double amount = 0.0;
     std::string status = "unpaid";
 
+    // 查询结果列：bill_id, bill_date, amount, status
+    static constexpr auto columns() {
+        return std::make_tuple(&BillInfo::billId, &BillInfo::billDate, &BillInfo::amount, &BillInfo::status);
+    }
+
     // 添加默认构造函数
     BillInfo() = default;
 
@@ -93,6 +161,12 @@ struct DepartmentInfo {
     std::string contactPhone;
     std::string location;
 
+    // 查询结果列：department_id, department_name, description, contact_phone, location
+    static constexpr auto columns() {
+        return std::make_tuple(&DepartmentInfo::departmentId, &DepartmentInfo::departmentName,
+            &DepartmentInfo::description, &DepartmentInfo::contactPhone, &DepartmentInfo::location);
+    }
+
     // 默认构造函数
     DepartmentInfo() = default;
 
@@ -103,4 +177,62 @@ struct DepartmentInfo {
         : departmentId(id), departmentName(name),
         description(desc), contactPhone(phone), location(loc) {
     }
-};
\ No newline at end of file
+};
+
+// 仪表盘统计范围：doctorId大于0时只统计该医生的挂号，否则统计全院
+struct DashboardScope {
+    int doctorId = 0;
+
+    static DashboardScope hospital() { return DashboardScope(); }
+    static DashboardScope doctor(int id) {
+        DashboardScope scope;
+        scope.doctorId = id;
+        return scope;
+    }
+};
+
+// 仪表盘统计结果，由一条查询得到
+struct DashboardStats {
+    int todayRegistrations = 0;   // 今日挂号数
+    int todayCompleted = 0;       // 今日已完成（医生的"今日接诊"）
+    int pendingCount = 0;         // 以下三项仅医生范围
+    int completedCount = 0;
+    int totalCount = 0;
+    double totalIncome = 0.0;     // 以下三项仅全院范围：已支付账单总额
+    int doctorCount = 0;
+    int patientCount = 0;
+};
+
+// 报表行：按科室汇总的挂号数和金额（来自daily_stats）
+struct DepartmentReportRow {
+    int departmentId = 0;
+    std::string departmentName;
+    int registrations = 0;
+    int pendingCount = 0;
+    int completedCount = 0;
+    int cancelledCount = 0;
+    double billedAmount = 0.0;
+    double paidAmount = 0.0;
+
+    // 查询结果列：department_id, 科室名称, 挂号数, 待处理, 已完成, 已取消, 账单金额, 已支付金额
+    static constexpr auto columns() {
+        return std::make_tuple(&DepartmentReportRow::departmentId, &DepartmentReportRow::departmentName,
+            &DepartmentReportRow::registrations, &DepartmentReportRow::pendingCount,
+            &DepartmentReportRow::completedCount, &DepartmentReportRow::cancelledCount,
+            &DepartmentReportRow::billedAmount, &DepartmentReportRow::paidAmount);
+    }
+};
+
+// 病人检索结果（挂号表单的补全列表）
+struct PatientSearchResult {
+    int patientId = 0;
+    std::string name;
+    std::string phone;
+    std::string idCard;
+
+    // 查询结果列：patient_id, name, phone, id_card
+    static constexpr auto columns() {
+        return std::make_tuple(&PatientSearchResult::patientId, &PatientSearchResult::name,
+            &PatientSearchResult::phone, &PatientSearchResult::idCard);
+    }
+};
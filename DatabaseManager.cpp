@@ -1,9 +1,85 @@
 ﻿#include "DatabaseManager.h"
+#include "SchemaMigrations.h"
 #include <sstream>
 #include <iomanip>
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+
+namespace {
+    std::atomic<bool> mysqlLibraryReleased{ false };
+
+    // libmysql要求每个使用连接的线程先调用mysql_thread_init，线程退出时调用mysql_thread_end
+    struct MySqlThreadGuard {
+        MySqlThreadGuard() { mysql_thread_init(); }
+        ~MySqlThreadGuard() {
+            if (!mysqlLibraryReleased) {
+                mysql_thread_end();
+            }
+        }
+    };
+
+    // 文本形式的数值直接用from_chars解析，不构造临时字符串；解析失败时为0
+    template<typename T>
+    T parseNumber(std::string_view text) {
+        T value{};
+        std::from_chars(text.data(), text.data() + text.size(), value);
+        return value;
+    }
 
+    // 记录一次SQL执行的耗时和结果规模，析构时写入统计；流式读取时回调耗时不计入
+    class QueryTimer {
+    public:
+        QueryTimer(QueryStats& stats, const std::string& sql)
+            : stats(stats), sql(sql), started(std::chrono::steady_clock::now()) {}
+
+        ~QueryTimer() {
+            auto elapsed = std::chrono::steady_clock::now() - started - excluded;
+            if (entry) {
+                stats.record(*entry, sql, elapsed, rows, bytes, ok);
+            }
+            else {
+                stats.record(sql, elapsed, rows, bytes, ok);
+            }
+        }
+
+        void setEntry(QueryStats::Entry* statsEntry) { entry = statsEntry; }
+        void addRow(std::uint64_t rowBytes) { ++rows; bytes += rowBytes; }
+        void setRows(std::uint64_t count) { rows = count; }
+        void succeed() { ok = true; }
+
+        template<typename Fn>
+        bool excluding(Fn&& fn) {
+            auto start = std::chrono::steady_clock::now();
+            bool result = fn();
+            excluded += std::chrono::steady_clock::now() - start;
+            return result;
+        }
 
-DatabaseManager::DatabaseManager() : connection(nullptr) {
+    private:
+        QueryStats& stats;
+        const std::string& sql;
+        QueryStats::Entry* entry = nullptr;
+        std::chrono::steady_clock::time_point started;
+        std::chrono::steady_clock::duration excluded{ 0 };
+        std::uint64_t rows = 0;
+        std::uint64_t bytes = 0;
+        bool ok = false;
+    };
+
+    void ensureMySqlThreadInit() {
+        thread_local MySqlThreadGuard guard;
+        (void)guard;
+    }
+}
+
+DatabaseManager::DatabaseManager()
+    : connected(false),
+    sessions([this](ThreadSession& session) {
+        if (session.pinned) {
+            closeConnection(std::move(session.pinned));
+        }
+    }) {
     // 初始化MySQL库（Windows需要）
 #ifdef _WIN32
     if (mysql_library_init(0, NULL, NULL) != 0) {
@@ -15,215 +91,322 @@ DatabaseManager::DatabaseManager() : connection(nullptr) {
 DatabaseManager::~DatabaseManager() {
     disconnect();
 #ifdef _WIN32
+    mysqlLibraryReleased = true;
     mysql_library_end();
 #endif
 }
 
-bool DatabaseManager::connect(const std::string& host, const std::string& user,const std::string& password, const std::string& database,unsigned int port) {
+void DatabaseManager::setPoolConfig(const ConnectionPoolConfig& config) {
+    std::lock_guard<std::mutex> lock(poolMutex);
+    poolConfig = config;
+    if (poolConfig.maxConnections == 0) {
+        poolConfig.maxConnections = 1;
+    }
+    if (poolConfig.minConnections > poolConfig.maxConnections) {
+        poolConfig.minConnections = poolConfig.maxConnections;
+    }
+}
 
+ConnectionPoolConfig DatabaseManager::getPoolConfig() const {
+    std::lock_guard<std::mutex> lock(poolMutex);
+    return poolConfig;
+}
 
-    connection = mysql_init(nullptr);
-    if (!connection) {
-        lastError = "MySQL初始化失败";
-        return false;
-    }
+unsigned int DatabaseManager::getOpenConnectionCount() const {
+    std::lock_guard<std::mutex> lock(poolMutex);
+    return openConnections;
+}
 
-    // 设置连接选项
-    mysql_options(connection, MYSQL_SET_CHARSET_NAME, "utf8mb4");
+unsigned int DatabaseManager::getIdleConnectionCount() const {
+    std::lock_guard<std::mutex> lock(poolMutex);
+    return static_cast<unsigned int>(idleConnections.size());
+}
 
-    // 连接数据库
-    if (!mysql_real_connect(connection, host.c_str(), user.c_str(), password.c_str(),
-        database.c_str(), port, nullptr, CLIENT_MULTI_STATEMENTS)) {
-        lastError = mysql_error(connection);
-        mysql_close(connection);
-        connection = nullptr;
-        return false;
+bool DatabaseManager::connect(const std::string& host, const std::string& user,const std::string& password, const std::string& database,unsigned int port) {
+
+    disconnect();
+
+    this->host = host;
+    this->user = user;
+    this->password = password;
+    this->database = database;
+    this->port = port;
+
+    // 预先建立常驻连接，第一条连接失败即视为配置错误
+    unsigned int minConnections = getPoolConfig().minConnections;
+    std::vector<std::unique_ptr<PooledConnection>> initial;
+    for (unsigned int i = 0; i < std::max(1u, minConnections); ++i) {
+        auto connection = openConnection();
+        if (!connection) {
+            return false;
+        }
+        initial.push_back(std::move(connection));
     }
 
-    // 设置自动重连
-    bool reconnect = 1;
-    mysql_options(connection, MYSQL_OPT_RECONNECT, &reconnect);
+    {
+        // 上次连接时借出、尚未归还的连接仍计入openConnections，归还时按代数关闭并扣减
+        std::lock_guard<std::mutex> lock(poolMutex);
+        openConnections += static_cast<unsigned int>(initial.size());
+        for (auto& connection : initial) {
+            connection->generation = poolGeneration;
+            idleConnections.push_back(std::move(connection));
+        }
+        connected = true;
+    }
 
-    std::cout << "成功连接到数据库: " << database << std::endl;
+    std::cout << "成功连接到数据库: " << database
+        << "（连接池 " << openConnections << "/" << getPoolConfig().maxConnections << "）" << std::endl;
     return true;
 }
 
 void DatabaseManager::disconnect() {
-    if (connection) {
-        mysql_close(connection);
-        connection = nullptr;
-        std::cout << "数据库连接已关闭" << std::endl;
+    std::vector<std::unique_ptr<PooledConnection>> toClose;
+    {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        if (!connected && idleConnections.empty()) {
+            return;
+        }
+        connected = false;
+        ++poolGeneration;
+        for (auto& connection : idleConnections) {
+            toClose.push_back(std::move(connection));
+        }
+        idleConnections.clear();
     }
+    {
+        // 只关闭本线程固定的连接，未提交的事务随连接关闭一起回滚；
+        // 其他线程可能正在事务中使用各自固定的连接，由它们在事务结束归还时关闭（见checkinConnection）
+        ThreadSession& session = currentSession();
+        if (session.pinned) {
+            toClose.push_back(std::move(session.pinned));
+            session.sessionPinned = false;
+        }
+    }
+
+    for (auto& connection : toClose) {
+        closeConnection(std::move(connection));
+    }
+    poolAvailable.notify_all();
+    std::cout << "数据库连接已关闭" << std::endl;
 }
 
 bool DatabaseManager::isConnected() const {
-    if (!connection) return false;
-    return mysql_ping(connection) == 0;
+    // 连接池已建立即视为可用，失效的连接在借出时按需重连
+    std::lock_guard<std::mutex> lock(poolMutex);
+    return connected;
 }
 
-bool DatabaseManager::initializeDatabase() {
+std::unique_ptr<DatabaseManager::PooledConnection> DatabaseManager::openConnection() {
+    ensureMySqlThreadInit();
 
-    // 创建数据库
-    if (!executeQuery("CREATE DATABASE IF NOT EXISTS hospital_system CHARACTER SET utf8mb4 COLLATE utf8mb4_unicode_ci")) {
-        return false;
+    auto connection = std::make_unique<PooledConnection>();
+    connection->handle = mysql_init(nullptr);
+    if (!connection->handle) {
+        setLastError("MySQL初始化失败");
+        return nullptr;
     }
 
-    // 使用数据库
-    if (!executeQuery("USE hospital_system")) {
-        return false;
+    // 设置连接选项
+    mysql_options(connection->handle, MYSQL_SET_CHARSET_NAME, "utf8mb4");
+
+    // 连接数据库
+    if (!mysql_real_connect(connection->handle, host.c_str(), user.c_str(), password.c_str(),
+        database.c_str(), port, nullptr, CLIENT_MULTI_STATEMENTS)) {
+        setLastError(mysql_error(connection->handle), mysql_errno(connection->handle));
+        return nullptr;
     }
 
-    // 创建用户表
-    std::string createUsersTable = R"(
-        CREATE TABLE IF NOT EXISTS users (
-            user_id INT AUTO_INCREMENT PRIMARY KEY,
-            username VARCHAR(50) UNIQUE NOT NULL,
-            password_hash VARCHAR(255) NOT NULL,
-            role ENUM('patient', 'doctor', 'admin') NOT NULL,
-            created_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP
-        ) ENGINE=InnoDB DEFAULT CHARSET=utf8mb4
-    )";
+    connection->lastUsed = std::chrono::steady_clock::now();
+    return connection;
+}
 
-    if (!executeQuery(createUsersTable)) {
+bool DatabaseManager::reopenConnection(PooledConnection& connection) {
+    auto fresh = openConnection();
+    if (!fresh) {
         return false;
     }
+    // 旧连接上缓存的预处理语句随连接一起失效
+    connection.close();
+    connection.handle = fresh->handle;
+    connection.lastUsed = fresh->lastUsed;
+    fresh->handle = nullptr;
+    return true;
+}
 
-    // 创建病人表
-   // 修改原来的CREATE TABLE语句
-    std::string createPatientsTable = R"(
-    CREATE TABLE IF NOT EXISTS patients (
-        patient_id INT PRIMARY KEY,
-        name VARCHAR(100) NOT NULL,
-        gender ENUM('male', 'female', 'other') DEFAULT 'male',
-        age INT,
-        address TEXT,
-        phone VARCHAR(20),
-        id_card VARCHAR(18),
-        created_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP,
-        FOREIGN KEY (patient_id) REFERENCES users(user_id) ON DELETE CASCADE
-    ) ENGINE=InnoDB DEFAULT CHARSET=utf8mb4
-)";
-
-    if (!executeQuery(createPatientsTable)) {
-        return false;
+std::unique_ptr<DatabaseManager::PooledConnection> DatabaseManager::checkoutConnection() {
+    std::unique_lock<std::mutex> lock(poolMutex);
+    auto deadline = std::chrono::steady_clock::now() + poolConfig.acquireTimeout;
+
+    while (true) {
+        if (!connected) {
+            setLastError("数据库未连接");
+            return nullptr;
+        }
+
+        if (!idleConnections.empty()) {
+            auto connection = std::move(idleConnections.back());
+            idleConnections.pop_back();
+            auto validateAfter = poolConfig.validateAfterIdle;
+            lock.unlock();
+
+            // 长时间空闲的连接可能已被服务器断开，借出前校验并按需重连
+            auto now = std::chrono::steady_clock::now();
+            if (now - connection->lastUsed > validateAfter && mysql_ping(connection->handle) != 0) {
+                if (!reopenConnection(*connection)) {
+                    checkinConnection(std::move(connection), true);
+                    return nullptr;
+                }
+            }
+            return connection;
+        }
+
+        if (openConnections < poolConfig.maxConnections) {
+            ++openConnections;
+            std::uint64_t generation = poolGeneration;
+            lock.unlock();
+
+            auto connection = openConnection();
+            if (!connection) {
+                lock.lock();
+                --openConnections;
+                poolAvailable.notify_one();
+                return nullptr;
+            }
+            connection->generation = generation;
+            return connection;
+        }
+
+        if (poolAvailable.wait_until(lock, deadline) == std::cv_status::timeout
+            && idleConnections.empty() && openConnections >= poolConfig.maxConnections) {
+            setLastError("数据库连接池已满，等待可用连接超时");
+            return nullptr;
+        }
     }
-        std::string createDepartmentsTable = R"(
-        CREATE TABLE IF NOT EXISTS departments (
-            department_id INT AUTO_INCREMENT PRIMARY KEY,
-            department_name VARCHAR(50) NOT NULL UNIQUE,
-            description TEXT,
-            contact_phone VARCHAR(20),
-            department_id INT NULL,
-            location VARCHAR(100),
-            created_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP
-        ) ENGINE=InnoDB DEFAULT CHARSET=utf8mb4
-    )";
-
-    if (!executeQuery(createDepartmentsTable)) {
-        return false;
+}
+
+void DatabaseManager::checkinConnection(std::unique_ptr<PooledConnection> connection, bool broken) {
+    if (!connection) {
+        return;
     }
 
-    // 插入默认科室数据
-    std::string insertDepartments = R"(
-        INSERT IGNORE INTO departments (department_name, description, contact_phone, location) VALUES
-        ('内科', '诊治内科疾病，如感冒、高血压、糖尿病等', '010-12345671', '门诊楼2层201-210室'),
-        ('外科', '手术治疗，包括普外科、骨科、神经外科等', '010-12345672', '门诊楼3层301-315室'),
-        ('儿科', '0-14岁儿童疾病诊治', '010-12345673', '门诊楼1层101-110室'),
-        ('妇产科', '妇科和产科疾病，女性健康', '010-12345674', '门诊楼4层401-410室'),
-        ('眼科', '眼部疾病诊治，视力检查', '010-12345675', '门诊楼5层501-505室'),
-        ('口腔科', '牙齿和口腔疾病治疗', '010-12345676', '门诊楼6层601-605室'),
-        ('耳鼻喉科', '耳鼻喉相关疾病', '010-12345677', '门诊楼3层316-320室'),
-        ('皮肤科', '皮肤病诊治', '010-12345678', '门诊楼2层211-215室'),
-        ('中医科', '中医诊疗服务', '010-12345679', '门诊楼1层111-115室'),
-        ('康复科', '术后康复、物理治疗', '010-12345680', '康复中心1层'),
-        ('急诊科', '24小时急诊服务', '010-12345681', '急诊楼1层')
-    )";
-
-    if (!executeQuery(insertDepartments)) {
-        return false;
+    std::vector<std::unique_ptr<PooledConnection>> evicted;
+    {
+        std::lock_guard<std::mutex> lock(poolMutex);
+        // 断开或重新连接（连接参数可能已变）之前借出的连接不再放回池中
+        if (broken || !connected || connection->generation != poolGeneration) {
+            evicted.push_back(std::move(connection));
+        }
+        else {
+            auto now = std::chrono::steady_clock::now();
+            connection->lastUsed = now;
+            idleConnections.push_back(std::move(connection));
+
+            // 回收超出常驻数且空闲过久的连接（最久未用的在队首）
+            while (openConnections - evicted.size() > poolConfig.minConnections
+                && !idleConnections.empty()
+                && now - idleConnections.front()->lastUsed > poolConfig.idleTimeout) {
+                evicted.push_back(std::move(idleConnections.front()));
+                idleConnections.erase(idleConnections.begin());
+            }
+        }
+        openConnections -= static_cast<unsigned int>(evicted.size());
     }
 
-   
-    // 创建医生表
-    std::string createDoctorsTable = R"(
-        CREATE TABLE IF NOT EXISTS doctors (
-            doctor_id INT PRIMARY KEY,
-            name VARCHAR(100) NOT NULL,
-            gender ENUM('male', 'female', 'other') DEFAULT 'male',
-            age INT,
-            phone VARCHAR(20),
-            department VARCHAR(100) NOT NULL,
-            created_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP,
-            FOREIGN KEY (doctor_id) REFERENCES users(user_id) ON DELETE CASCADE
-        ) ENGINE=InnoDB DEFAULT CHARSET=utf8mb4
-    )";
-
-    if (!executeQuery(createDoctorsTable)) {
-        return false;
+    evicted.clear();
+    poolAvailable.notify_one();
+}
+
+void DatabaseManager::closeConnection(std::unique_ptr<PooledConnection> connection) {
+    checkinConnection(std::move(connection), true);
+}
+
+void DatabaseManager::PooledConnection::closeStatements() {
+    for (auto& entry : statements) {
+        mysql_stmt_close(entry.second->handle);
     }
-    // 修改医生表，添加科室外键
-    std::string alterDoctorsTable = R"(
-        ALTER TABLE doctors 
-        ADD COLUMN IF NOT EXISTS department_id INT,
-        ADD FOREIGN KEY IF NOT EXISTS fk_doctors_department 
-        FOREIGN KEY (department_id) REFERENCES departments(department_id) ON DELETE SET NULL
-    )";
-    // 创建挂号表
-    std::string createRegistrationsTable = R"(
-        CREATE TABLE IF NOT EXISTS registrations (
-            registration_id INT AUTO_INCREMENT PRIMARY KEY,
-            registration_date DATE NOT NULL,
-            patient_id INT NOT NULL,
-            doctor_id INT NOT NULL,
-            status ENUM('pending', 'completed', 'cancelled') DEFAULT 'pending',
-            notes TEXT,
-            created_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP,
-            FOREIGN KEY (patient_id) REFERENCES patients(patient_id),
-            FOREIGN KEY (doctor_id) REFERENCES doctors(doctor_id)
-        ) ENGINE=InnoDB DEFAULT CHARSET=utf8mb4
-    )";
-
-    if (!executeQuery(createRegistrationsTable)) {
-        return false;
+    statements.clear();
+}
+
+void DatabaseManager::PooledConnection::close() {
+    closeStatements();
+    if (handle) {
+        mysql_close(handle);
+        handle = nullptr;
+    }
+}
+
+DatabaseManager::ConnectionLease::ConnectionLease(DatabaseManager& manager) : manager(manager) {
+    ensureMySqlThreadInit();
+
+    ThreadSession& session = manager.currentSession();
+    if (session.pinned) {
+        connection = session.pinned.get();
+        return;
     }
 
-    // 创建账单表
-    std::string createBillsTable = R"(
-        CREATE TABLE IF NOT EXISTS bills (
-            bill_id INT AUTO_INCREMENT PRIMARY KEY,
-            bill_date DATE NOT NULL,
-            amount DECIMAL(10,2) NOT NULL,
-            status ENUM('unpaid', 'paid') DEFAULT 'unpaid',
-            created_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP
-        ) ENGINE=InnoDB DEFAULT CHARSET=utf8mb4
-    )";
+    owned = manager.checkoutConnection();
+    connection = owned.get();
+}
 
-    if (!executeQuery(createBillsTable)) {
-        return false;
+DatabaseManager::ConnectionLease::~ConnectionLease() {
+    if (owned) {
+        manager.checkinConnection(std::move(owned), broken);
     }
+}
+
+DatabaseManager::ThreadSession& DatabaseManager::currentSession() {
+    // 先于会话初始化线程的MySQL状态，线程退出时会话（及固定的连接）先于mysql_thread_end释放
+    ensureMySqlThreadInit();
+    return sessions.local();
+}
 
-    // 创建挂号-账单关联表
-    std::string createRegistrationBillsTable = R"(
-        CREATE TABLE IF NOT EXISTS registration_bills (
-            registration_id INT PRIMARY KEY,
-            bill_id INT UNIQUE,
-            created_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP,
-            FOREIGN KEY (registration_id) REFERENCES registrations(registration_id),
-            FOREIGN KEY (bill_id) REFERENCES bills(bill_id)
-        ) ENGINE=InnoDB DEFAULT CHARSET=utf8mb4
-    )";
+void DatabaseManager::setLastError(const std::string& error, unsigned int code) {
+    ThreadSession& session = currentSession();
+    session.lastError = error;
+    session.lastErrorCode = code;
+}
 
-    if (!executeQuery(createRegistrationBillsTable)) {
+bool DatabaseManager::sendQuery(ConnectionLease& lease, const std::string& query) {
+    if (!lease) {
         return false;
     }
 
-    // 创建默认管理员账户
-    std::string createAdminUser = R"(
-        INSERT IGNORE INTO users (username, password_hash, role) 
-        VALUES ('admin', MD5('admin123'), 'admin')
-    )";
+    if (mysql_real_query(lease.get(), query.c_str(), static_cast<unsigned long>(query.length())) == 0) {
+        return true;
+    }
+
+    // 连接在发送前已断开（服务器超时等），非事务中可安全重连后重试一次
+    if (mysql_errno(lease.get()) == CR_SERVER_GONE_ERROR && !lease.isPinned()
+        && reopenConnection(*lease.pooled())) {
+        if (mysql_real_query(lease.get(), query.c_str(), static_cast<unsigned long>(query.length())) == 0) {
+            return true;
+        }
+    }
+
+    setLastError(mysql_error(lease.get()), mysql_errno(lease.get()));
+    unsigned int error = mysql_errno(lease.get());
+    if (error == CR_SERVER_GONE_ERROR || error == CR_SERVER_LOST) {
+        lease.markBroken();
+    }
+    return false;
+}
+
+void DatabaseManager::drainPendingResults(MYSQL* handle) {
+    // 多语句/存储过程会返回额外结果集，必须取完才能在该连接上执行下一条语句
+    while (mysql_next_result(handle) == 0) {
+        MYSQL_RES* extra = mysql_store_result(handle);
+        if (extra) {
+            mysql_free_result(extra);
+        }
+    }
+}
+
+bool DatabaseManager::initializeDatabase() {
 
-    if (!executeQuery(createAdminUser)) {
+    // 表结构由版本化迁移维护，已是最新版本时只需一次查询
+    SchemaMigrator migrator(*this);
+    if (!migrator.migrate()) {
+        setLastError(migrator.getLastError());
         return false;
     }
 
@@ -233,83 +416,586 @@ bool DatabaseManager::initializeDatabase() {
 
 bool DatabaseManager::executeQuery(const std::string& query) {
 
-    if (!isConnected()) {
-        lastError = "数据库未连接";
+    QueryTimer timer(queryStats, query);
+    ConnectionLease lease(*this);
+    if (!lease) {
         return false;
     }
 
-    if (mysql_query(connection, query.c_str()) != 0) {
-        lastError = mysql_error(connection);
+    if (!sendQuery(lease, query)) {
         return false;
     }
 
+    MYSQL_RES* result = mysql_store_result(lease.get());
+    if (result) {
+        mysql_free_result(result);
+    }
+    ThreadSession& session = currentSession();
+    session.lastInsertId = mysql_insert_id(lease.get());
+    session.affectedRows = mysql_affected_rows(lease.get());
+    drainPendingResults(lease.get());
+
+    timer.setRows(session.affectedRows == static_cast<my_ulonglong>(-1) ? 0 : session.affectedRows);
+    timer.succeed();
     return true;
 }
 
 MYSQL_RES* DatabaseManager::executeQueryWithResult(const std::string& query) {
 
-    if (!isConnected()) {
-        lastError = "数据库未连接";
+    // 结果集交给调用方读取，这里只统计行数，不统计字节数
+    QueryTimer timer(queryStats, query);
+    ConnectionLease lease(*this);
+    if (!lease) {
         return nullptr;
     }
 
-    if (mysql_query(connection, query.c_str()) != 0) {
-        lastError = mysql_error(connection);
+    if (!sendQuery(lease, query)) {
         return nullptr;
     }
 
-    return mysql_store_result(connection);
+    // store_result后结果集与连接无关，连接可立即归还给其他线程使用
+    MYSQL_RES* result = mysql_store_result(lease.get());
+    drainPendingResults(lease.get());
+    if (result) {
+        timer.setRows(mysql_num_rows(result));
+        timer.succeed();
+    }
+    return result;
 }
 
 int DatabaseManager::getLastInsertId() {
-    return mysql_insert_id(connection);
+    return static_cast<int>(currentSession().lastInsertId);
 }
 
 std::vector<std::vector<std::string>> DatabaseManager::getQueryResult(const std::string& query) {
     std::vector<std::vector<std::string>> results;
 
-    MYSQL_RES* result = executeQueryWithResult(query);
+    forEachRow(query, [&results](const ResultRow& row) {
+        std::vector<std::string> row_data;
+        row_data.reserve(row.columnCount());
+        for (unsigned int i = 0; i < row.columnCount(); i++) {
+            row_data.push_back(row.getString(i));
+        }
+        results.push_back(std::move(row_data));
+        return true;
+    });
+
+    return results;
+}
+
+bool DatabaseManager::forEachRow(const std::string& query, const std::function<bool(const ResultRow&)>& onRow) {
+
+    QueryTimer timer(queryStats, query);
+    ConnectionLease lease(*this);
+    if (!lease) {
+        return false;
+    }
+
+    if (!sendQuery(lease, query)) {
+        return false;
+    }
+
+    // 事务中连接固定在本线程，回调里可能还要在同一连接上执行语句，因此先整体取回
+    MYSQL_RES* result = lease.isPinned() ? mysql_store_result(lease.get()) : mysql_use_result(lease.get());
     if (!result) {
-        return results;
+        bool ok = mysql_field_count(lease.get()) == 0;
+        if (!ok) {
+            setLastError(mysql_error(lease.get()), mysql_errno(lease.get()));
+        }
+        else {
+            timer.succeed();
+        }
+        drainPendingResults(lease.get());
+        return ok;
     }
 
+    unsigned int fieldCount = mysql_num_fields(result);
     MYSQL_ROW row;
-    int num_fields = mysql_num_fields(result);
-
     while ((row = mysql_fetch_row(result))) {
-        std::vector<std::string> row_data;
-        for (int i = 0; i < num_fields; i++) {
-            row_data.push_back(row[i] ? row[i] : "");
+        const unsigned long* lengths = mysql_fetch_lengths(result);
+        std::uint64_t rowBytes = 0;
+        for (unsigned int i = 0; i < fieldCount; ++i) {
+            rowBytes += lengths[i];
+        }
+        timer.addRow(rowBytes);
+
+        if (!timer.excluding([&] { return onRow(ResultRow(row, lengths, fieldCount)); })) {
+            break;
+        }
+    }
+
+    // use_result模式下读取中断的网络错误在fetch_row返回NULL后才能通过errno得知
+    bool ok = true;
+    if (mysql_errno(lease.get()) != 0) {
+        setLastError(mysql_error(lease.get()), mysql_errno(lease.get()));
+        unsigned int error = mysql_errno(lease.get());
+        if (error == CR_SERVER_GONE_ERROR || error == CR_SERVER_LOST) {
+            lease.markBroken();
         }
-        results.push_back(row_data);
+        ok = false;
     }
 
+    // 提前结束时mysql_free_result会读完并丢弃剩余行，连接可以继续使用
     mysql_free_result(result);
-    return results;
+    drainPendingResults(lease.get());
+    if (ok) {
+        timer.succeed();
+    }
+    return ok;
+}
+
+long long DatabaseManager::getAffectedRows() {
+    return static_cast<long long>(currentSession().affectedRows);
+}
+
+std::string_view ResultRow::getText(unsigned int column) const {
+    if (!row[column]) return {};
+    return std::string_view(row[column], lengths[column]);
+}
+
+long long ResultRow::getInt(unsigned int column) const {
+    return parseNumber<long long>(getText(column));
+}
+
+double ResultRow::getDouble(unsigned int column) const {
+    return parseNumber<double>(getText(column));
+}
+
+long long StatementRow::getInt(unsigned int column) const {
+    const Column& value = columns[column];
+    if (value.isNull) return 0;
+    switch (value.bufferType) {
+    case MYSQL_TYPE_LONGLONG:
+        return value.intValue;
+    case MYSQL_TYPE_DOUBLE:
+        return static_cast<long long>(value.doubleValue);
+    default:
+        return parseNumber<long long>(getText(column));
+    }
+}
+
+double StatementRow::getDouble(unsigned int column) const {
+    const Column& value = columns[column];
+    if (value.isNull) return 0.0;
+    switch (value.bufferType) {
+    case MYSQL_TYPE_DOUBLE:
+        return value.doubleValue;
+    case MYSQL_TYPE_LONGLONG:
+        return static_cast<double>(value.intValue);
+    default:
+        return parseNumber<double>(getText(column));
+    }
+}
+
+std::string_view StatementRow::getText(unsigned int column) const {
+    const Column& value = columns[column];
+    if (value.isNull || value.bufferType != MYSQL_TYPE_STRING) return {};
+    return std::string_view(value.text.data(), value.length);
+}
+
+std::string StatementRow::getString(unsigned int column) const {
+    const Column& value = columns[column];
+    if (value.isNull) return "";
+    switch (value.bufferType) {
+    case MYSQL_TYPE_LONGLONG:
+        return std::to_string(value.intValue);
+    case MYSQL_TYPE_DOUBLE:
+        return std::to_string(value.doubleValue);
+    default:
+        return std::string(getText(column));
+    }
+}
+
+DatabaseManager::CachedStatement* DatabaseManager::prepareCached(ConnectionLease& lease, const std::string& sql) {
+    PooledConnection& connection = *lease.pooled();
+    auto found = connection.statements.find(sql);
+    if (found != connection.statements.end()) {
+        found->second->lastUsed = ++connection.statementClock;
+        return found->second.get();
+    }
+
+    // 缓存已满时淘汰最久未用的语句
+    if (!connection.statements.empty() && connection.statements.size() >= getPoolConfig().statementCacheSize) {
+        auto oldest = connection.statements.begin();
+        for (auto it = connection.statements.begin(); it != connection.statements.end(); ++it) {
+            if (it->second->lastUsed < oldest->second->lastUsed) {
+                oldest = it;
+            }
+        }
+        mysql_stmt_close(oldest->second->handle);
+        connection.statements.erase(oldest);
+    }
+
+    MYSQL_STMT* handle = mysql_stmt_init(connection.handle);
+    if (!handle) {
+        setLastError(mysql_error(connection.handle), mysql_errno(connection.handle));
+        return nullptr;
+    }
+    if (mysql_stmt_prepare(handle, sql.c_str(), static_cast<unsigned long>(sql.length())) != 0) {
+        setLastError(mysql_stmt_error(handle), mysql_stmt_errno(handle));
+        if (mysql_stmt_errno(handle) == CR_SERVER_GONE_ERROR || mysql_stmt_errno(handle) == CR_SERVER_LOST) {
+            lease.markBroken();
+        }
+        mysql_stmt_close(handle);
+        return nullptr;
+    }
+
+    auto statement = std::make_unique<CachedStatement>();
+    statement->handle = handle;
+    statement->paramCount = mysql_stmt_param_count(handle);
+
+    // 存储过程（CALL）的结果列在执行后才知道，这里没有元数据，由queryPrepared在执行后绑定
+    MYSQL_RES* metadata = mysql_stmt_result_metadata(handle);
+    if (metadata && !bindResultColumns(*statement, metadata)) {
+        mysql_stmt_close(handle);
+        return nullptr;
+    }
+
+    statement->lastUsed = ++connection.statementClock;
+    statement->stats = &queryStats.entryFor(sql);
+    CachedStatement* cached = statement.get();
+    connection.statements.emplace(sql, std::move(statement));
+    return cached;
+}
+
+bool DatabaseManager::bindResultColumns(CachedStatement& statement, MYSQL_RES* metadata) {
+    // 按列类型绑定结果缓冲区：整数列取int64，小数列取double，其余（字符串、日期、枚举）取文本
+    MYSQL_STMT* handle = statement.handle;
+    unsigned int fieldCount = mysql_num_fields(metadata);
+    MYSQL_FIELD* fields = mysql_fetch_fields(metadata);
+    statement.row.columns.assign(fieldCount, StatementRow::Column{});
+    statement.resultBinds.assign(fieldCount, MYSQL_BIND{});
+
+    for (unsigned int i = 0; i < fieldCount; ++i) {
+        StatementRow::Column& column = statement.row.columns[i];
+        MYSQL_BIND& bind = statement.resultBinds[i];
+
+        switch (fields[i].type) {
+        case MYSQL_TYPE_TINY:
+        case MYSQL_TYPE_SHORT:
+        case MYSQL_TYPE_LONG:
+        case MYSQL_TYPE_INT24:
+        case MYSQL_TYPE_LONGLONG:
+        case MYSQL_TYPE_YEAR:
+            column.bufferType = MYSQL_TYPE_LONGLONG;
+            bind.buffer = &column.intValue;
+            bind.buffer_length = sizeof(column.intValue);
+            break;
+        case MYSQL_TYPE_FLOAT:
+        case MYSQL_TYPE_DOUBLE:
+        case MYSQL_TYPE_DECIMAL:
+        case MYSQL_TYPE_NEWDECIMAL:
+            column.bufferType = MYSQL_TYPE_DOUBLE;
+            bind.buffer = &column.doubleValue;
+            bind.buffer_length = sizeof(column.doubleValue);
+            break;
+        default:
+            column.bufferType = MYSQL_TYPE_STRING;
+            column.text.resize(std::min<unsigned long>(fields[i].length, 255) + 1);
+            bind.buffer = column.text.data();
+            bind.buffer_length = static_cast<unsigned long>(column.text.size());
+            break;
+        }
+        bind.buffer_type = column.bufferType;
+        bind.length = &column.length;
+        bind.is_null = &column.isNull;
+        bind.error = &column.error;
+    }
+    mysql_free_result(metadata);
+
+    if (fieldCount > 0 && mysql_stmt_bind_result(handle, statement.resultBinds.data()) != 0) {
+        setLastError(mysql_stmt_error(handle), mysql_stmt_errno(handle));
+        return false;
+    }
+    return true;
+}
+
+DatabaseManager::CachedStatement* DatabaseManager::executeStatement(ConnectionLease& lease,
+    const std::string& sql, const std::vector<SqlParam>& params) {
+
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        CachedStatement* statement = prepareCached(lease, sql);
+        if (!statement) {
+            return nullptr;
+        }
+        if (params.size() != statement->paramCount) {
+            setLastError("预处理语句参数数量不匹配: " + sql);
+            return nullptr;
+        }
+
+        std::vector<MYSQL_BIND> binds(params.size(), MYSQL_BIND{});
+        std::vector<unsigned long> lengths(params.size(), 0);
+        for (size_t i = 0; i < params.size(); ++i) {
+            const SqlParam& param = params[i];
+            MYSQL_BIND& bind = binds[i];
+            switch (param.type) {
+            case SqlParam::Type::Null:
+                bind.buffer_type = MYSQL_TYPE_NULL;
+                break;
+            case SqlParam::Type::Integer:
+                bind.buffer_type = MYSQL_TYPE_LONGLONG;
+                bind.buffer = const_cast<long long*>(&param.intValue);
+                break;
+            case SqlParam::Type::Double:
+                bind.buffer_type = MYSQL_TYPE_DOUBLE;
+                bind.buffer = const_cast<double*>(&param.doubleValue);
+                break;
+            case SqlParam::Type::Text:
+                lengths[i] = static_cast<unsigned long>(param.textValue.length());
+                bind.buffer_type = MYSQL_TYPE_STRING;
+                bind.buffer = const_cast<char*>(param.textValue.data());
+                bind.buffer_length = lengths[i];
+                bind.length = &lengths[i];
+                break;
+            }
+        }
+
+        MYSQL_STMT* handle = statement->handle;
+        if ((binds.empty() || mysql_stmt_bind_param(handle, binds.data()) == 0)
+            && mysql_stmt_execute(handle) == 0) {
+            return statement;
+        }
+
+        // 连接在发送前已断开时重连（缓存的语句随之失效）并重新准备、执行一次
+        unsigned int error = mysql_stmt_errno(handle);
+        if (attempt == 0 && error == CR_SERVER_GONE_ERROR && !lease.isPinned()
+            && reopenConnection(*lease.pooled())) {
+            continue;
+        }
+
+        setLastError(mysql_stmt_error(handle), mysql_stmt_errno(handle));
+        if (error == CR_SERVER_GONE_ERROR || error == CR_SERVER_LOST) {
+            lease.markBroken();
+        }
+        return nullptr;
+    }
+    return nullptr;
+}
+
+bool DatabaseManager::drainStatementResults(MYSQL_STMT* handle) {
+    // 存储过程在结果集之后还会返回一个状态结果，过程中途出错也在这里报告；取完后语句才能再次执行
+    mysql_stmt_free_result(handle);
+    int status;
+    while ((status = mysql_stmt_next_result(handle)) == 0) {
+        mysql_stmt_free_result(handle);
+    }
+    if (status > 0) {
+        setLastError(mysql_stmt_error(handle), mysql_stmt_errno(handle));
+        return false;
+    }
+    return true;
+}
+
+bool DatabaseManager::refetchTruncatedColumns(CachedStatement& statement) {
+    bool rebind = false;
+    for (unsigned int i = 0; i < statement.row.columns.size(); ++i) {
+        StatementRow::Column& column = statement.row.columns[i];
+        if (!column.error || column.bufferType != MYSQL_TYPE_STRING || column.length <= column.text.size()) {
+            continue;
+        }
+
+        // 文本超出当前缓冲区：扩容后单独重取该列，并让后续行使用新缓冲区
+        MYSQL_BIND& bind = statement.resultBinds[i];
+        column.text.resize(column.length + 1);
+        bind.buffer = column.text.data();
+        bind.buffer_length = static_cast<unsigned long>(column.text.size());
+        if (mysql_stmt_fetch_column(statement.handle, &bind, i, 0) != 0) {
+            setLastError(mysql_stmt_error(statement.handle), mysql_stmt_errno(statement.handle));
+            return false;
+        }
+        rebind = true;
+    }
+
+    if (rebind) {
+        mysql_stmt_bind_result(statement.handle, statement.resultBinds.data());
+    }
+    return true;
+}
+
+bool DatabaseManager::executePrepared(const std::string& sql, const std::vector<SqlParam>& params) {
+    QueryTimer timer(queryStats, sql);
+    ConnectionLease lease(*this);
+    if (!lease) {
+        return false;
+    }
+
+    CachedStatement* statement = executeStatement(lease, sql, params);
+    if (!statement) {
+        return false;
+    }
+    timer.setEntry(statement->stats);
+
+    ThreadSession& session = currentSession();
+    session.lastInsertId = mysql_stmt_insert_id(statement->handle);
+    session.affectedRows = mysql_stmt_affected_rows(statement->handle);
+
+    if (!drainStatementResults(statement->handle)) {
+        return false;
+    }
+
+    timer.setRows(session.affectedRows == static_cast<my_ulonglong>(-1) ? 0 : session.affectedRows);
+    timer.succeed();
+    return true;
+}
+
+bool DatabaseManager::queryPrepared(const std::string& sql, const std::vector<SqlParam>& params,
+    const std::function<bool(const StatementRow&)>& onRow) {
+
+    QueryTimer timer(queryStats, sql);
+    ConnectionLease lease(*this);
+    if (!lease) {
+        return false;
+    }
+
+    CachedStatement* statement = executeStatement(lease, sql, params);
+    if (!statement) {
+        return false;
+    }
+    timer.setEntry(statement->stats);
+    MYSQL_STMT* handle = statement->handle;
+
+    // 存储过程的结果集元数据在执行后才可用，第一次执行时（或列数变化时）再绑定
+    if (mysql_stmt_field_count(handle) != statement->row.columnCount()) {
+        MYSQL_RES* metadata = mysql_stmt_result_metadata(handle);
+        if (!metadata || !bindResultColumns(*statement, metadata)) {
+            if (!metadata) {
+                setLastError(mysql_stmt_error(handle), mysql_stmt_errno(handle));
+            }
+            drainStatementResults(handle);
+            return false;
+        }
+    }
+
+    // 事务中连接固定在本线程，回调里可能还要在同一连接上执行语句，因此先整体取回
+    if (lease.isPinned() && mysql_stmt_store_result(handle) != 0) {
+        setLastError(mysql_stmt_error(handle), mysql_stmt_errno(handle));
+        mysql_stmt_free_result(handle);
+        return false;
+    }
+
+    bool ok = true;
+    while (true) {
+        int status = mysql_stmt_fetch(handle);
+        if (status == MYSQL_NO_DATA) {
+            break;
+        }
+        if (status == 1) {
+            setLastError(mysql_stmt_error(handle), mysql_stmt_errno(handle));
+            ok = false;
+            break;
+        }
+        if (status == MYSQL_DATA_TRUNCATED && !refetchTruncatedColumns(*statement)) {
+            ok = false;
+            break;
+        }
+
+        std::uint64_t rowBytes = 0;
+        for (const StatementRow::Column& column : statement->row.columns) {
+            rowBytes += column.isNull ? 0 : column.length;
+        }
+        timer.addRow(rowBytes);
+
+        if (!timer.excluding([&] { return onRow(statement->row); })) {
+            break;
+        }
+    }
+
+    ok = drainStatementResults(handle) && ok;
+    if (ok) {
+        timer.succeed();
+    }
+    return ok;
 }
 
 bool DatabaseManager::startTransaction() {
-    return executeQuery("START TRANSACTION");
+    // 事务期间本线程的所有语句都固定在同一条连接上
+    // 已固定的连接（如PinnedSession持有命名锁的连接）属于外层，失败时不归还
+    ThreadSession& session = currentSession();
+    bool checkedOut = false;
+    if (!session.pinned) {
+        session.pinned = checkoutConnection();
+        if (!session.pinned) {
+            return false;
+        }
+        checkedOut = true;
+    }
+
+    if (!executeQuery("START TRANSACTION")) {
+        if (checkedOut) {
+            checkinConnection(std::move(session.pinned), true);
+        }
+        return false;
+    }
+    return true;
 }
 
 bool DatabaseManager::commitTransaction() {
-    return executeQuery("COMMIT");
+    bool ok = executeQuery("COMMIT");
+    ThreadSession& session = currentSession();
+    if (!session.sessionPinned) {
+        checkinConnection(std::move(session.pinned), !ok);
+    }
+    return ok;
 }
 
 bool DatabaseManager::rollbackTransaction() {
-    return executeQuery("ROLLBACK");
+    bool ok = executeQuery("ROLLBACK");
+    ThreadSession& session = currentSession();
+    if (!session.sessionPinned) {
+        checkinConnection(std::move(session.pinned), !ok);
+    }
+    return ok;
 }
 
-std::string DatabaseManager::escapeString(const std::string& str) {
-    if (!connection) return str;
+DatabaseManager::PinnedSession::PinnedSession(DatabaseManager& manager) : manager(manager) {
+    ThreadSession& session = manager.currentSession();
+    if (session.pinned) {
+        // 外层的事务或会话固定已占用一条连接
+        active = true;
+        return;
+    }
 
-    char* escaped = new char[str.length() * 2 + 1];
-    mysql_real_escape_string(connection, escaped, str.c_str(), str.length());
-    std::string result(escaped);
-    delete[] escaped;
-    return result;
+    session.pinned = manager.checkoutConnection();
+    if (session.pinned) {
+        session.sessionPinned = true;
+        active = true;
+        owner = true;
+    }
+}
+
+DatabaseManager::PinnedSession::~PinnedSession() {
+    if (!owner) return;
+
+    ThreadSession& session = manager.currentSession();
+    session.sessionPinned = false;
+    manager.checkinConnection(std::move(session.pinned), broken);
+}
+
+std::string DatabaseManager::escapeString(const std::string& str) {
+    // 不借用连接：连接池耗尽时也不会原样返回未转义的输入
+    // 所有连接都固定使用utf8mb4，多字节字符的每个字节都不小于0x80，不会与需要转义的字符混淆，
+    // 按字节转义的结果与mysql_real_escape_string相同
+    std::string escaped;
+    escaped.reserve(str.length() + str.length() / 8 + 2);
+    for (char c : str) {
+        switch (c) {
+        case '\0':   escaped += "\\0"; break;
+        case '\n':   escaped += "\\n"; break;
+        case '\r':   escaped += "\\r"; break;
+        case '\\':   escaped += "\\\\"; break;
+        case '\'':   escaped += "\\'"; break;
+        case '"':    escaped += "\\\""; break;
+        case '\032': escaped += "\\Z"; break;
+        default:     escaped += c; break;
+        }
+    }
+    return escaped;
 }
 
 std::string DatabaseManager::getLastError() const {
-    return lastError;
-}
\ No newline at end of file
+    return sessions.read([](const ThreadSession& session) { return session.lastError; }, std::string());
+}
+
+unsigned int DatabaseManager::getLastErrorCode() const {
+    return sessions.read([](const ThreadSession& session) { return session.lastErrorCode; }, 0u);
+}
@@ -4,25 +4,186 @@
 #ifdef _WIN32
 #include <winsock2.h>
 #include <mysql.h>
+#include <errmsg.h>
 #pragma comment(lib, "libmysql.lib")
 #else
 #include <mysql/mysql.h>
+#include <mysql/errmsg.h>
 #endif
 
 #include <string>
 #include <vector>
 #include <memory>
 #include <iostream>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <unordered_map>
+#include <functional>
+#include <string_view>
+#include "QueryStats.h"
+#include "PerThreadState.h"
+
+// 连接池配置
+struct ConnectionPoolConfig {
+    unsigned int minConnections = 1;                    // 常驻连接数（connect时预先建立）
+    unsigned int maxConnections = 8;                    // 同时打开的连接上限
+    std::chrono::seconds idleTimeout{ 300 };            // 超出常驻数的连接空闲多久后关闭
+    std::chrono::seconds validateAfterIdle{ 30 };       // 空闲超过该时长的连接借出前先ping
+    std::chrono::milliseconds acquireTimeout{ 5000 };   // 连接耗尽时等待的最长时间
+    unsigned int statementCacheSize = 64;               // 每条连接缓存的预处理语句上限
+};
+
+// 预处理语句参数（按类型走二进制协议，无需拼接和转义）
+class SqlParam {
+public:
+    enum class Type { Null, Integer, Double, Text };
+
+    SqlParam() = default;
+    SqlParam(std::nullptr_t) {}
+    SqlParam(int value) : type(Type::Integer), intValue(value) {}
+    SqlParam(long long value) : type(Type::Integer), intValue(value) {}
+    SqlParam(double value) : type(Type::Double), doubleValue(value) {}
+    SqlParam(const std::string& value) : type(Type::Text), textValue(value) {}
+    SqlParam(const char* value) : type(value ? Type::Text : Type::Null), textValue(value ? value : "") {}
+
+    Type type = Type::Null;
+    long long intValue = 0;
+    double doubleValue = 0.0;
+    std::string textValue;
+};
+
+// 预处理语句的结果行：直接读取按列类型绑定的缓冲区，整数和小数不经过字符串
+class StatementRow {
+public:
+    unsigned int columnCount() const { return static_cast<unsigned int>(columns.size()); }
+    bool isNull(unsigned int column) const { return columns[column].isNull; }
+    long long getInt(unsigned int column) const;
+    double getDouble(unsigned int column) const;
+    std::string_view getText(unsigned int column) const;
+    std::string getString(unsigned int column) const;
+
+private:
+    friend class DatabaseManager;
+
+    struct Column {
+        enum_field_types bufferType = MYSQL_TYPE_STRING;
+        long long intValue = 0;
+        double doubleValue = 0.0;
+        std::vector<char> text;
+        unsigned long length = 0;
+        bool isNull = false;
+        bool error = false;
+    };
+    std::vector<Column> columns;
+};
+
+// 文本协议游标的当前行：指向libmysql内部缓冲区，只在回调期间有效
+class ResultRow {
+public:
+    ResultRow(MYSQL_ROW row, const unsigned long* lengths, unsigned int fieldCount)
+        : row(row), lengths(lengths), fieldCount(fieldCount) {}
+
+    unsigned int columnCount() const { return fieldCount; }
+    bool isNull(unsigned int column) const { return row[column] == nullptr; }
+    std::string_view getText(unsigned int column) const;
+    std::string getString(unsigned int column) const { return std::string(getText(column)); }
+    long long getInt(unsigned int column) const;
+    double getDouble(unsigned int column) const;
+
+private:
+    MYSQL_ROW row;
+    const unsigned long* lengths;
+    unsigned int fieldCount;
+};
 
 class DatabaseManager {
 private:
-    MYSQL* connection;
-    std::string lastError;
+    // 缓存在连接上的预处理语句及其结果绑定
+    struct CachedStatement {
+        MYSQL_STMT* handle = nullptr;
+        unsigned long paramCount = 0;
+        std::vector<MYSQL_BIND> resultBinds;
+        StatementRow row;
+        unsigned long long lastUsed = 0;
+        QueryStats::Entry* stats = nullptr;  // 该SQL模板的统计入口（预先查好，执行时不再计算指纹）
+    };
+
+    // 池中的一条物理连接
+    struct PooledConnection {
+        MYSQL* handle = nullptr;
+        std::chrono::steady_clock::time_point lastUsed;
+        std::unordered_map<std::string, std::unique_ptr<CachedStatement>> statements;  // 按SQL模板缓存
+        unsigned long long statementClock = 0;
+        std::uint64_t generation = 0;   // 建立时的连接池代数，重新connect后归还的旧连接直接关闭
+
+        ~PooledConnection() { close(); }
+        void closeStatements();
+        void close();
+    };
+
+    // 每个线程独立的会话状态：事务期间固定使用的连接、最近的插入ID、影响行数和错误信息
+    // 线程退出时删除，未结束的事务连接随之关闭（回滚）
+    struct ThreadSession {
+        std::unique_ptr<PooledConnection> pinned;
+        bool sessionPinned = false;         // 由PinnedSession固定（事务结束时不归还连接）
+        my_ulonglong lastInsertId = 0;
+        my_ulonglong affectedRows = 0;
+        std::string lastError;
+        unsigned int lastErrorCode = 0;
+    };
+
+    // 借用连接的RAII封装：事务中使用线程固定的连接，否则从池中借出并在析构时归还
+    class ConnectionLease {
+    public:
+        explicit ConnectionLease(DatabaseManager& manager);
+        ~ConnectionLease();
+
+        MYSQL* get() const { return connection ? connection->handle : nullptr; }
+        PooledConnection* pooled() const { return connection; }
+        bool isPinned() const { return !owned && connection != nullptr; }
+        void markBroken() { broken = true; }
+        explicit operator bool() const { return get() != nullptr; }
+
+    private:
+        DatabaseManager& manager;
+        std::unique_ptr<PooledConnection> owned;
+        PooledConnection* connection = nullptr;
+        bool broken = false;
+    };
+
+    // 连接参数（用于按需新建和重连）
+    std::string host;
+    std::string user;
+    std::string password;
+    std::string database;
+    unsigned int port = 3306;
+
+    ConnectionPoolConfig poolConfig;
+    bool connected;
+
+    mutable std::mutex poolMutex;
+    std::condition_variable poolAvailable;
+    std::vector<std::unique_ptr<PooledConnection>> idleConnections;  // 末尾为最近归还的连接
+    unsigned int openConnections = 0;    // 池中空闲和借出的连接总数
+    std::uint64_t poolGeneration = 0;    // 每次disconnect加1
+
+    PerThreadState<ThreadSession> sessions;
+
+    QueryStats queryStats;
 
 public:
     DatabaseManager();
     ~DatabaseManager();
 
+    // 连接池配置（需在connect之前设置）
+    void setPoolConfig(const ConnectionPoolConfig& config);
+    ConnectionPoolConfig getPoolConfig() const;
+    unsigned int getOpenConnectionCount() const;
+    unsigned int getIdleConnectionCount() const;
+
     // 数据库连接
     bool connect(const std::string& host = "127.0.0.1",
         const std::string& user = "root",
@@ -41,17 +202,73 @@ public:
     MYSQL_RES* executeQueryWithResult(const std::string& query);
     int getLastInsertId();
     std::vector<std::vector<std::string>> getQueryResult(const std::string& query);
+    long long getAffectedRows();
+
+    // 流式读取（mysql_use_result）：逐行回调，不在客户端缓存整个结果集
+    // onRow返回false可提前结束；回调期间该连接被占用，回调内的其他查询会使用池中其他连接
+    bool forEachRow(const std::string& query, const std::function<bool(const ResultRow&)>& onRow);
+
+    // 预处理语句：按SQL模板缓存在各连接上，参数和结果均按类型绑定
+    // onRow返回false可提前结束读取；事务外逐行从服务器读取，不在客户端整体缓存
+    bool executePrepared(const std::string& sql, const std::vector<SqlParam>& params = {});
+    bool queryPrepared(const std::string& sql, const std::vector<SqlParam>& params,
+        const std::function<bool(const StatementRow&)>& onRow);
+
+    // 查询统计：按SQL指纹统计调用次数、行数、字节数和耗时分布，超过阈值的写入慢查询日志
+    QueryStats& getQueryStats() { return queryStats; }
+    const QueryStats& getQueryStats() const { return queryStats; }
 
     // 事务管理
     bool startTransaction();
     bool commitTransaction();
     bool rollbackTransaction();
 
+    // 会话固定：作用域内本线程的所有语句使用同一条连接，但不开启事务
+    // 用于依赖会话的操作（如GET_LOCK/RELEASE_LOCK命名锁），其间的DDL照常隐式提交
+    // 已在事务中时沿用事务的连接；作用域内的事务结束后连接仍保持固定
+    class PinnedSession {
+    public:
+        explicit PinnedSession(DatabaseManager& manager);
+        ~PinnedSession();
+        PinnedSession(const PinnedSession&) = delete;
+        PinnedSession& operator=(const PinnedSession&) = delete;
+
+        explicit operator bool() const { return active; }
+        // 关闭而不是归还连接：会话上残留的状态（如未能释放的锁）随连接一起结束
+        void discard() { broken = true; }
+
+    private:
+        DatabaseManager& manager;
+        bool active = false;
+        bool owner = false;
+        bool broken = false;
+    };
+
     // 工具函数
+    // 按连接字符集utf8mb4转义字符串字面量，不占用连接，总是返回转义后的结果
     std::string escapeString(const std::string& str);
     std::string getLastError() const;
+    unsigned int getLastErrorCode() const;  // 最近一次错误的MySQL错误码，非服务器错误时为0
 
 private:
+    // 连接池内部实现
+    std::unique_ptr<PooledConnection> openConnection();
+    bool reopenConnection(PooledConnection& connection);
+    std::unique_ptr<PooledConnection> checkoutConnection();
+    void checkinConnection(std::unique_ptr<PooledConnection> connection, bool broken);
+    void closeConnection(std::unique_ptr<PooledConnection> connection);
+    bool sendQuery(ConnectionLease& lease, const std::string& query);
+    void drainPendingResults(MYSQL* handle);
+    CachedStatement* prepareCached(ConnectionLease& lease, const std::string& sql);
+    bool bindResultColumns(CachedStatement& statement, MYSQL_RES* metadata);
+    CachedStatement* executeStatement(ConnectionLease& lease, const std::string& sql,
+        const std::vector<SqlParam>& params);
+    bool refetchTruncatedColumns(CachedStatement& statement);
+    bool drainStatementResults(MYSQL_STMT* handle);
+
+    ThreadSession& currentSession();
+    void setLastError(const std::string& error, unsigned int code = 0);
+
     // 防止拷贝
     DatabaseManager(const DatabaseManager&) = delete;
     DatabaseManager& operator=(const DatabaseManager&) = delete;
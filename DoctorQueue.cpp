@@ -0,0 +1,243 @@
+﻿#include "DoctorQueue.h"
+
+DoctorQueue::DoctorQueue(int doctorId, std::string date, const std::vector<QueueEntry>& entries,
+    std::uint64_t baseVersion)
+    : ownerId(doctorId), queueDate(std::move(date)) {
+    for (const QueueEntry& entry : entries) {
+        if (!enqueue(entry) || entry.state == QueueEntry::State::Waiting) {
+            continue;
+        }
+        // 就诊中、过号的病人不在排队集合中
+        QueueEntry& stored = byRegistration.at(entry.registrationId);
+        order.erase(keyOf(stored));
+        stored.state = entry.state;
+    }
+    changeVersion = baseVersion + 1;
+}
+
+bool DoctorQueue::contains(int registrationId) const {
+    return byRegistration.count(registrationId) != 0;
+}
+
+bool DoctorQueue::enqueue(QueueEntry entry) {
+    if (contains(entry.registrationId)) {
+        return false;
+    }
+
+    // 初始按挂号单号排队；后续重新排队的序号一定大于已有的序号
+    if (entry.sequence == 0) {
+        entry.sequence = static_cast<std::uint64_t>(entry.registrationId);
+    }
+    if (entry.sequence >= nextSequence) {
+        nextSequence = entry.sequence + 1;
+    }
+
+    entry.state = QueueEntry::State::Waiting;
+    order.insert(keyOf(entry));
+    byRegistration.emplace(entry.registrationId, std::move(entry));
+    ++changeVersion;
+    return true;
+}
+
+bool DoctorQueue::remove(int registrationId) {
+    auto it = byRegistration.find(registrationId);
+    if (it == byRegistration.end()) {
+        return false;
+    }
+
+    if (it->second.state == QueueEntry::State::Waiting) {
+        order.erase(keyOf(it->second));
+    }
+    byRegistration.erase(it);
+    ++changeVersion;
+    return true;
+}
+
+std::optional<QueueEntry> DoctorQueue::callNext() {
+    if (order.empty()) {
+        return std::nullopt;
+    }
+
+    int registrationId = std::get<2>(*order.begin());
+    order.erase(order.begin());
+
+    QueueEntry& entry = byRegistration.at(registrationId);
+    entry.state = QueueEntry::State::Called;
+    ++changeVersion;
+    return entry;
+}
+
+bool DoctorQueue::skip(int registrationId) {
+    auto it = byRegistration.find(registrationId);
+    if (it == byRegistration.end() || it->second.state == QueueEntry::State::Skipped) {
+        return false;
+    }
+
+    if (it->second.state == QueueEntry::State::Waiting) {
+        order.erase(keyOf(it->second));
+    }
+    it->second.state = QueueEntry::State::Skipped;
+    ++changeVersion;
+    return true;
+}
+
+bool DoctorQueue::requeue(int registrationId) {
+    auto it = byRegistration.find(registrationId);
+    if (it == byRegistration.end() || it->second.state == QueueEntry::State::Waiting) {
+        return false;
+    }
+
+    it->second.sequence = nextSequence++;
+    it->second.state = QueueEntry::State::Waiting;
+    order.insert(keyOf(it->second));
+    ++changeVersion;
+    return true;
+}
+
+bool DoctorQueue::setPriority(int registrationId, int priority) {
+    auto it = byRegistration.find(registrationId);
+    if (it == byRegistration.end()) {
+        return false;
+    }
+    if (it->second.priority == priority) {
+        return true;
+    }
+
+    bool waiting = it->second.state == QueueEntry::State::Waiting;
+    if (waiting) {
+        order.erase(keyOf(it->second));
+    }
+    it->second.priority = priority;
+    if (waiting) {
+        order.insert(keyOf(it->second));
+    }
+    ++changeVersion;
+    return true;
+}
+
+std::vector<QueueEntry> DoctorQueue::entries() const {
+    std::vector<QueueEntry> result;
+    result.reserve(byRegistration.size());
+
+    std::vector<QueueEntry> skipped;
+    for (const auto& item : byRegistration) {
+        if (item.second.state == QueueEntry::State::Called) {
+            result.push_back(item.second);
+        }
+        else if (item.second.state == QueueEntry::State::Skipped) {
+            skipped.push_back(item.second);
+        }
+    }
+
+    for (const OrderKey& key : order) {
+        result.push_back(byRegistration.at(std::get<2>(key)));
+    }
+
+    for (QueueEntry& entry : skipped) {
+        result.push_back(std::move(entry));
+    }
+    return result;
+}
+
+void DoctorQueueBoard::reset(int doctorId, const std::string& date, const std::vector<QueueEntry>& entries) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // 同一天重新加载时，仍在队列中的病人保留叫号状态、优先级和排队序号
+    std::unordered_map<int, QueueEntry> previous;
+    auto old = queues.find(doctorId);
+    if (old != queues.end()) {
+        for (QueueEntry& entry : old->second.entries()) {
+            doctorByRegistration.erase(entry.registrationId);
+            if (old->second.date() == date) {
+                previous.emplace(entry.registrationId, std::move(entry));
+            }
+        }
+    }
+
+    std::vector<QueueEntry> merged = entries;
+    for (QueueEntry& entry : merged) {
+        auto kept = previous.find(entry.registrationId);
+        if (kept != previous.end()) {
+            entry.priority = kept->second.priority;
+            entry.sequence = kept->second.sequence;
+            entry.state = kept->second.state;
+        }
+        doctorByRegistration[entry.registrationId] = doctorId;
+    }
+
+    // 版本号延续，界面据此判断是否需要重绘
+    std::uint64_t previousVersion = old != queues.end() ? old->second.version() : 0;
+    queues[doctorId] = DoctorQueue(doctorId, date, merged, previousVersion);
+}
+
+bool DoctorQueueBoard::isLoaded(int doctorId, const std::string& date) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = queues.find(doctorId);
+    return it != queues.end() && it->second.date() == date;
+}
+
+bool DoctorQueueBoard::entries(int doctorId, const std::string& date, std::vector<QueueEntry>& out,
+    std::uint64_t* version) const {
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = queues.find(doctorId);
+    if (it == queues.end() || it->second.date() != date) {
+        return false;
+    }
+
+    out = it->second.entries();
+    if (version) {
+        *version = it->second.version();
+    }
+    return true;
+}
+
+void DoctorQueueBoard::onRegistrationPending(int doctorId, const QueueEntry& entry) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = queues.find(doctorId);
+    if (it == queues.end() || it->second.date() != entry.registrationDate) {
+        return;
+    }
+
+    if (it->second.enqueue(entry)) {
+        doctorByRegistration[entry.registrationId] = doctorId;
+    }
+}
+
+void DoctorQueueBoard::onRegistrationClosed(int registrationId) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto owner = doctorByRegistration.find(registrationId);
+    if (owner == doctorByRegistration.end()) {
+        return;
+    }
+
+    auto it = queues.find(owner->second);
+    if (it != queues.end()) {
+        it->second.remove(registrationId);
+    }
+    doctorByRegistration.erase(owner);
+}
+
+std::optional<QueueEntry> DoctorQueueBoard::callNext(int doctorId) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = queues.find(doctorId);
+    return it == queues.end() ? std::nullopt : it->second.callNext();
+}
+
+bool DoctorQueueBoard::skip(int doctorId, int registrationId) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = queues.find(doctorId);
+    return it != queues.end() && it->second.skip(registrationId);
+}
+
+bool DoctorQueueBoard::requeue(int doctorId, int registrationId) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = queues.find(doctorId);
+    return it != queues.end() && it->second.requeue(registrationId);
+}
+
+bool DoctorQueueBoard::setPriority(int doctorId, int registrationId, int priority) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = queues.find(doctorId);
+    return it != queues.end() && it->second.setPriority(registrationId, priority);
+}
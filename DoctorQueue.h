@@ -0,0 +1,102 @@
+﻿#pragma once
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+// 候诊队列中的一位病人（对应一张当日待处理挂号）
+struct QueueEntry {
+    enum class State {
+        Waiting,    // 排队中
+        Called,     // 已叫号，正在就诊
+        Skipped     // 过号，等待重新排队
+    };
+
+    int registrationId = 0;
+    int patientId = 0;
+    std::string patientName;
+    std::string registrationDate;
+    std::string notes;
+    int priority = 0;               // 数值大的排在前面
+    std::uint64_t sequence = 0;     // 同优先级按序号排队：初始为挂号单号，重新排队时取新的序号
+    State state = State::Waiting;
+};
+
+// 单个医生当日的候诊队列
+// 排队中的病人按(优先级降序, 序号升序)保存在有序集合中，叫号、过号、重新排队、入队和出队均为O(log n)
+// 不加锁，由DoctorQueueBoard串行访问
+class DoctorQueue {
+public:
+    DoctorQueue() = default;
+    // baseVersion：重新加载时延续旧队列的版本号，保证版本单调递增
+    DoctorQueue(int doctorId, std::string date, const std::vector<QueueEntry>& entries,
+        std::uint64_t baseVersion = 0);
+
+    int doctorId() const { return ownerId; }
+    const std::string& date() const { return queueDate; }
+    std::uint64_t version() const { return changeVersion; }
+    std::size_t waitingCount() const { return order.size(); }
+
+    bool contains(int registrationId) const;
+    bool enqueue(QueueEntry entry);
+    bool remove(int registrationId);
+
+    // 叫号：取出队首病人并标记为就诊中，队列为空时返回空
+    std::optional<QueueEntry> callNext();
+    // 过号：排队中或就诊中的病人移出队列，保留以便重新排队
+    bool skip(int registrationId);
+    // 重新排队：过号或就诊中的病人排到同优先级队尾
+    bool requeue(int registrationId);
+    bool setPriority(int registrationId, int priority);
+
+    // 就诊中、排队中（按叫号顺序）、过号的病人依次排列
+    std::vector<QueueEntry> entries() const;
+
+private:
+    using OrderKey = std::tuple<int, std::uint64_t, int>;   // (-优先级, 序号, 挂号单号)
+
+    static OrderKey keyOf(const QueueEntry& entry) {
+        return OrderKey(-entry.priority, entry.sequence, entry.registrationId);
+    }
+
+    int ownerId = 0;
+    std::string queueDate;
+    std::uint64_t nextSequence = 1;
+    std::uint64_t changeVersion = 0;
+
+    std::set<OrderKey> order;                           // 仅包含排队中的病人
+    std::unordered_map<int, QueueEntry> byRegistration; // 全部病人（含就诊中和过号）
+};
+
+// 各医生候诊队列的线程安全登记表，保存在SystemManager中
+// 队列在医生开始接诊时整体加载一次，之后由挂号、结算、状态变更增量维护
+class DoctorQueueBoard {
+public:
+    // 整体替换医生的队列（加载或手动刷新）
+    void reset(int doctorId, const std::string& date, const std::vector<QueueEntry>& entries);
+    // 队列已加载且属于date这一天
+    bool isLoaded(int doctorId, const std::string& date) const;
+
+    // 读取队列内容，未加载或日期不符返回false
+    bool entries(int doctorId, const std::string& date, std::vector<QueueEntry>& out,
+        std::uint64_t* version = nullptr) const;
+
+    // 增量维护：仅在队列已加载且日期相符时生效
+    void onRegistrationPending(int doctorId, const QueueEntry& entry);
+    // 挂号已完成、取消或删除
+    void onRegistrationClosed(int registrationId);
+
+    std::optional<QueueEntry> callNext(int doctorId);
+    bool skip(int doctorId, int registrationId);
+    bool requeue(int doctorId, int registrationId);
+    bool setPriority(int doctorId, int registrationId, int priority);
+
+private:
+    mutable std::mutex mutex;
+    std::unordered_map<int, DoctorQueue> queues;
+    std::unordered_map<int, int> doctorByRegistration;  // 挂号单号 → 所在队列的医生
+};
@@ -0,0 +1,237 @@
+﻿#include "HospitalService.h"
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTcpSocket>
+
+namespace {
+    // 单条请求的上限，超过时认为客户端异常并断开
+    constexpr qint64 kMaxRequestBytes = 16 * 1024 * 1024;
+
+    QByteArray toLine(const QJsonObject& object) {
+        QByteArray line = QJsonDocument(object).toJson(QJsonDocument::Compact);
+        line.append('\n');
+        return line;
+    }
+}
+
+HospitalService::HospitalService(SystemManager& manager) : manager(manager) {
+    registerMethods();
+    QObject::connect(&server, &QTcpServer::newConnection, &server, [this]() { onNewConnection(); });
+}
+
+bool HospitalService::listen(const QHostAddress& address, unsigned short port) {
+    if (!server.listen(address, port)) {
+        listenError = server.errorString().toStdString();
+        return false;
+    }
+    return true;
+}
+
+HospitalService::Guard HospitalService::ownId(int index) {
+    return [index](const UserInfo& user, const QJsonArray& args) {
+        return args.at(index).toInt() == user.userId;
+    };
+}
+
+HospitalService::Guard HospitalService::ownRegistration(int index) {
+    return [this, index](const UserInfo& user, const QJsonArray& args) {
+        RegistrationInfo registration = manager.getRegistrationById(args.at(index).toInt());
+        if (registration.registrationId == 0) return false;
+        return user.role == "patient" ? registration.patientId == user.userId
+            : registration.doctorId == user.userId;
+    };
+}
+
+void HospitalService::registerMethods() {
+    using M = SystemManager;
+
+    // 连接探测，客户端启动时用来确认服务可用
+    handlers["ping"] = { [](const QJsonArray&) { return QJsonValue(true); }, Public, nullptr };
+
+    // 登录结果由handleLine记录到该连接；未登录时只能注册病人账号，医生和管理员账号由管理员创建
+    bind("login", &M::login, Public);
+    bind("registerUser", &M::registerUser, Public, [](const UserInfo&, const QJsonArray& args) {
+        return args.at(2).toString().toStdString() == "patient";
+    });
+    bind("changePassword", &M::changePassword, AnyUser, ownId(0));
+    bind("getUserInfo", &M::getUserInfo, AnyUser, ownId(0));
+    bind("updateUserInfo", &M::updateUserInfo, AnyUser, [](const UserInfo& user, const QJsonArray& args) {
+        UserInfo info;
+        ServiceProtocol::decode(args.at(0), info);
+        return info.userId == user.userId;
+    });
+
+    bind("getAllDoctors", &M::getAllDoctors, AnyUser);
+    bind("searchDoctors", &M::searchDoctors, AnyUser);
+    bind("getDoctorsByDepartmentName",
+        static_cast<std::vector<DoctorInfo>(M::*)(const std::string&)>(&M::getDoctorsByDepartment), AnyUser);
+    bind("getDoctorsByDepartmentId",
+        static_cast<std::vector<DoctorInfo>(M::*)(int)>(&M::getDoctorsByDepartment), AnyUser);
+    bind("searchPatients", &M::searchPatients, Admin);
+    bind("prepareNameIndex", &M::prepareNameIndex, AnyUser);
+
+    bind("createRegistration", &M::createRegistration, Patient | Admin, ownId(0));
+    bind("getRegistrationsByPatient", &M::getRegistrationsByPatient, Patient | Admin, ownId(0));
+    bind("getRegistrationById", &M::getRegistrationById, AnyUser, ownRegistration(0));
+    // 病人只能取消自己的挂号，医生只能修改自己接诊的挂号
+    Guard ownRegistrationStatus = ownRegistration(0);
+    bind("updateRegistrationStatus", &M::updateRegistrationStatus, AnyUser,
+        [ownRegistrationStatus](const UserInfo& user, const QJsonArray& args) {
+            if (user.role == "patient" && args.at(1).toString().toStdString() != "cancelled") return false;
+            return ownRegistrationStatus(user, args);
+        });
+    bind("deleteRegistration", &M::deleteRegistration, Admin);
+    // 客户端的forEachRegistration/getAllRegistrations/getRegistrationsByDoctor按游标逐页调用，
+    // 每页条数由queryRegistrations限制在1000条以内，不在一次应答中返回全部挂号；医生只能查询自己的挂号
+    handlers["queryRegistrations"] = { [this](const QJsonArray& args) {
+        RegistrationFilter filter;
+        RegistrationCursor cursor;
+        ServiceProtocol::decode(args.at(0), filter);
+        ServiceProtocol::decode(args.at(1), cursor);
+        std::vector<RegistrationInfo> page;
+        manager.queryRegistrations(filter, cursor, args.at(2).toInt(), page);
+        return ServiceProtocol::encode(page);
+    }, Doctor | Admin, [](const UserInfo& user, const QJsonArray& args) {
+        RegistrationFilter filter;
+        ServiceProtocol::decode(args.at(0), filter);
+        return filter.doctorId == user.userId;
+    } };
+
+    bind("getRemainingSlots", &M::getRemainingSlots, AnyUser);
+    bind("setDoctorDailyCapacity", &M::setDoctorDailyCapacity, Doctor | Admin, ownId(0));
+    bind("setDoctorSlotCapacity", &M::setDoctorSlotCapacity, Doctor | Admin, ownId(0));
+
+    // 候诊队列保存在服务端，同一医生在不同工作站看到的是同一个队列；医生只能操作自己的队列
+    bind("loadDoctorQueue", &M::loadDoctorQueue, Doctor | Admin, ownId(0));
+    handlers["getDoctorQueue"] = { [this](const QJsonArray& args) {
+        std::vector<QueueEntry> entries;
+        std::uint64_t version = 0;
+        bool loaded = manager.getDoctorQueue(args.at(0).toInt(), entries, &version);
+        return QJsonValue(QJsonArray{ loaded, ServiceProtocol::encode(entries), ServiceProtocol::encode(version) });
+    }, Doctor | Admin, ownId(0) };
+    bind("callNextPatient", &M::callNextPatient, Doctor | Admin, ownId(0));
+    bind("skipPatient", &M::skipPatient, Doctor | Admin, ownId(0));
+    bind("requeuePatient", &M::requeuePatient, Doctor | Admin, ownId(0));
+    bind("setPatientPriority", &M::setPatientPriority, Doctor | Admin, ownId(0));
+
+    bind("createBill", &M::createBill, Doctor | Admin, ownRegistration(0));
+    bind("getDashboardStats", &M::getDashboardStats, Doctor | Admin, [](const UserInfo& user, const QJsonArray& args) {
+        DashboardScope scope;
+        ServiceProtocol::decode(args.at(0), scope);
+        return scope.doctorId == user.userId;
+    });
+    bind("getDepartmentReport", &M::getDepartmentReport, Admin);
+    bind("rebuildDailyStats", &M::rebuildDailyStats, Admin);
+
+    bind("getAllDepartments", &M::getAllDepartments, AnyUser);
+    bind("getDepartmentById", &M::getDepartmentById, AnyUser);
+    bind("getDepartmentByName", &M::getDepartmentByName, AnyUser);
+    bind("addDepartment", &M::addDepartment, Admin);
+    bind("updateDepartment", &M::updateDepartment, Admin);
+    bind("deleteDepartment", &M::deleteDepartment, Admin);
+    bind("assignDoctorToDepartment", &M::assignDoctorToDepartment, Admin);
+    bind("getAvailableDepartmentsForRegistration", &M::getAvailableDepartmentsForRegistration, AnyUser);
+}
+
+void HospitalService::onNewConnection() {
+    while (QTcpSocket* socket = server.nextPendingConnection()) {
+        QObject::connect(socket, &QTcpSocket::readyRead, socket, [this, socket]() {
+            while (socket->canReadLine()) {
+                handleLine(socket, socket->readLine());
+            }
+            if (socket->bytesAvailable() > kMaxRequestBytes) {
+                socket->abort();
+            }
+        });
+        QObject::connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+        QObject::connect(socket, &QObject::destroyed, &server, [this, socket]() { sessions.erase(socket); });
+    }
+}
+
+std::string HospitalService::checkAccess(const Method& method, const UserInfo& user) const {
+    if (method.roles == Public) {
+        return std::string();
+    }
+    if (user.userId == 0) {
+        return "请先登录";
+    }
+    unsigned role = user.role == "patient" ? Patient : user.role == "doctor" ? Doctor
+        : user.role == "admin" ? Admin : 0;
+    if ((method.roles & role) == 0) {
+        return "当前角色无权执行该操作";
+    }
+    return std::string();
+}
+
+void HospitalService::handleLine(QTcpSocket* socket, const QByteArray& line) {
+    QJsonObject request = QJsonDocument::fromJson(line).object();
+    QJsonValue id = request.value("id");
+    std::string method = request.value("method").toString().toStdString();
+
+    auto reject = [&](const std::string& error) {
+        QJsonObject response;
+        response["id"] = id;
+        response["result"] = QJsonValue();
+        response["error"] = QString::fromStdString(error);
+        socket->write(toLine(response));
+    };
+
+    auto it = handlers.find(method);
+    if (it == handlers.end()) {
+        reject("不支持的调用: " + method);
+        return;
+    }
+
+    UserInfo user;
+    auto session = sessions.find(socket);
+    if (session != sessions.end()) {
+        user = session->second;
+    }
+    std::string denied = checkAccess(it->second, user);
+    if (!denied.empty()) {
+        reject(denied);
+        return;
+    }
+
+    // 在后台线程执行并序列化；连接在此期间断开时丢弃应答
+    Method target = it->second;
+    bool isLogin = method == "login";
+    QJsonArray args = request.value("args").toArray();
+    manager.runAsync(socket, [this, target, user, isLogin, args, id](const AsyncTask&) {
+        QJsonObject response;
+        response["id"] = id;
+        UserInfo loggedIn;
+
+        if (target.guard && user.role != "admin" && !target.guard(user, args)) {
+            response["result"] = QJsonValue();
+            response["error"] = QString::fromStdString("无权执行该操作");
+            return std::make_pair(toLine(response), loggedIn);
+        }
+
+        // 错误信息按线程保存，先清除该线程上一个请求（以及上面的检查）留下的错误
+        manager.clearLastError();
+        ChangeEventBus::Capture capture;
+
+        QJsonValue result = target.handler(args);
+        if (isLogin) {
+            ServiceProtocol::decode(result, loggedIn);
+        }
+        response["result"] = result;
+        response["error"] = QString::fromStdString(manager.getLastError());
+        if (!capture.events().empty()) {
+            response["events"] = ServiceProtocol::encode(capture.events());
+        }
+        return std::make_pair(toLine(response), loggedIn);
+    }, [this, socket, isLogin](const std::pair<QByteArray, UserInfo>& reply) {
+        // 登录失败时清除该连接原来的登录状态
+        if (isLogin) {
+            if (reply.second.userId != 0) {
+                sessions[socket] = reply.second;
+            }
+            else {
+                sessions.erase(socket);
+            }
+        }
+        socket->write(reply.first);
+    });
+}
@@ -0,0 +1,82 @@
+﻿#pragma once
+#include "SystemManager.h"
+#include "ServiceProtocol.h"
+#include <QJsonArray>
+#include <QHostAddress>
+#include <QJsonValue>
+#include <QTcpServer>
+#include <functional>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+
+class QTcpSocket;
+
+// 挂号服务（Hospital.exe --serve）：在一个进程内持有SystemManager，
+// 所有客户端共用其数据库连接池、参考数据缓存、拼音索引和候诊队列
+// 每个请求在SystemManager的后台线程池中执行，应答按请求id对应，协议见ServiceProtocol.h
+// 每条连接须先login，之后按该连接登录的角色检查能调用哪些方法；
+// 口令以明文经协议传输，默认只监听本机，监听其他地址须显式指定（--serve 端口 --bind 地址）
+class HospitalService {
+public:
+    explicit HospitalService(SystemManager& manager);
+
+    bool listen(const QHostAddress& address, unsigned short port);
+    std::string lastError() const { return listenError; }
+
+private:
+    using Handler = std::function<QJsonValue(const QJsonArray& args)>;
+    // 按参数检查当前用户能否操作该对象（如只能取消自己的挂号），在后台线程执行，管理员不检查
+    using Guard = std::function<bool(const UserInfo& user, const QJsonArray& args)>;
+
+    // 允许调用的角色，Public为无需登录
+    enum Roles : unsigned {
+        Public = 0,
+        Patient = 1,
+        Doctor = 2,
+        Admin = 4,
+        AnyUser = Patient | Doctor | Admin
+    };
+
+    struct Method {
+        Handler handler;
+        unsigned roles = AnyUser;
+        Guard guard;
+    };
+
+    void registerMethods();
+    void onNewConnection();
+    void handleLine(QTcpSocket* socket, const QByteArray& line);
+    // 检查user能否调用method，不能时返回原因
+    std::string checkAccess(const Method& method, const UserInfo& user) const;
+
+    // 常用的检查：非管理员只能操作自己的账号/队列（args[index]为本人ID），
+    // 或只能操作自己的挂号（args[index]为挂号单号，病人须为挂号病人，医生须为接诊医生）
+    static Guard ownId(int index);
+    Guard ownRegistration(int index);
+
+    // 按成员函数的参数类型解码args并编码返回值
+    template<typename R, typename... Args>
+    void bind(const char* method, R(SystemManager::* function)(Args...), unsigned roles, Guard guard = nullptr) {
+        handlers[method] = { [this, function](const QJsonArray& args) {
+            return invoke(function, args, std::index_sequence_for<Args...>());
+        }, roles, std::move(guard) };
+    }
+
+    template<typename R, typename... Args, std::size_t... I>
+    QJsonValue invoke(R(SystemManager::* function)(Args...), const QJsonArray& args,
+        std::index_sequence<I...>) {
+        std::tuple<std::decay_t<Args>...> decoded;
+        (ServiceProtocol::decode(args.at(static_cast<int>(I)), std::get<I>(decoded)), ...);
+        return ServiceProtocol::encode((manager.*function)(std::get<I>(decoded)...));
+    }
+
+    SystemManager& manager;
+    QTcpServer server;
+    std::unordered_map<std::string, Method> handlers;
+    // 每条连接当前登录的用户（只在主线程访问），连接销毁时删除
+    std::unordered_map<QTcpSocket*, UserInfo> sessions;
+    std::string listenError;
+};
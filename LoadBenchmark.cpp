@@ -0,0 +1,317 @@
+﻿#include "LoadBenchmark.h"
+#include "DatabaseManager.h"
+#include "PasswordHasher.h"
+#include "SystemManager.h"
+#include <QDate>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <map>
+#include <random>
+#include <sstream>
+#include <thread>
+
+namespace {
+    const char* kBenchDatabase = "hospital_system_bench";
+    const char* kSeedPassword = "audit";
+
+    // 挂号日期分布在今天起的一周内
+    constexpr int kBookingDays = 7;
+
+    using Clock = std::chrono::steady_clock;
+
+    // 单个线程的结果，结束后再合并，记录时不加锁
+    struct ThreadResult {
+        std::vector<std::uint32_t> latencies[LoadBenchmark::OperationCount];   // 微秒
+        std::uint64_t errors[LoadBenchmark::OperationCount] = {};
+        std::map<std::string, std::uint64_t> errorMessages;
+    };
+
+    double percentileMs(const std::vector<std::uint32_t>& sorted, double fraction) {
+        if (sorted.empty()) {
+            return 0.0;
+        }
+        std::size_t rank = static_cast<std::size_t>(std::ceil(fraction * static_cast<double>(sorted.size())));
+        return sorted[std::min(sorted.size(), std::max<std::size_t>(rank, 1)) - 1] / 1000.0;
+    }
+
+    void writeJsonString(std::ostream& out, const std::string& value) {
+        out << '"';
+        for (char c : value) {
+            switch (c) {
+            case '"': out << "\\\""; break;
+            case '\\': out << "\\\\"; break;
+            case '\n': out << "\\n"; break;
+            case '\r': out << "\\r"; break;
+            case '\t': out << "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) >= 0x20) out << c;
+            }
+        }
+        out << '"';
+    }
+
+    // 压测线程：按权重随机选择操作，直到deadline
+    void runWorker(SystemManager& manager, const LoadBenchmark::Options& options, int threadIndex,
+        const std::vector<std::string>& bookingDates, Clock::time_point measureFrom, Clock::time_point deadline,
+        ThreadResult& result) {
+
+        std::mt19937 random(options.randomSeed * 7919u + static_cast<unsigned int>(threadIndex));
+        std::discrete_distribution<int> pickOperation(std::begin(options.weights), std::end(options.weights));
+        std::uniform_int_distribution<int> pickDoctor(0, options.seed.doctors - 1);
+        std::uniform_int_distribution<int> pickPatient(0, options.seed.patients - 1);
+        std::uniform_int_distribution<int> pickDate(0, static_cast<int>(bookingDates.size()) - 1);
+
+        // 本线程挂出、尚未结算的挂号，结算从这里取
+        std::vector<int> pending;
+
+        while (Clock::now() < deadline) {
+            int operation = pickOperation(random);
+            if (operation == LoadBenchmark::CreateBill && pending.empty()) {
+                operation = LoadBenchmark::CreateRegistration;
+            }
+
+            int doctorId = QueryPlanAudit::kSeedDoctorIdBase + pickDoctor(random);
+            int patientIndex = pickPatient(random);
+
+            manager.clearLastError();
+            Clock::time_point start = Clock::now();
+            bool ok = false;
+            switch (operation) {
+            case LoadBenchmark::Login:
+                ok = manager.login("audit_patient_" + std::to_string(patientIndex), kSeedPassword, "patient").userId != 0;
+                break;
+            case LoadBenchmark::CreateRegistration: {
+                int registrationId = manager.createRegistration(QueryPlanAudit::kSeedPatientIdBase + patientIndex,
+                    doctorId, bookingDates[pickDate(random)], "压测挂号");
+                ok = registrationId > 0;
+                if (ok) pending.push_back(registrationId);
+                break;
+            }
+            case LoadBenchmark::ListDoctorRegistrations:
+                manager.getRegistrationsByDoctor(doctorId);
+                ok = manager.getLastError().empty();
+                break;
+            case LoadBenchmark::CreateBill: {
+                int registrationId = pending.back();
+                pending.pop_back();
+                ok = manager.createBill(registrationId, 50.0) > 0;
+                break;
+            }
+            default:
+                manager.getDashboardStats(random() % 2 ? DashboardScope::hospital() : DashboardScope::doctor(doctorId));
+                ok = manager.getLastError().empty();
+                break;
+            }
+            Clock::time_point end = Clock::now();
+
+            if (start < measureFrom) {
+                continue;
+            }
+            auto micros = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+            result.latencies[operation].push_back(static_cast<std::uint32_t>(std::min<long long>(micros, UINT32_MAX)));
+            if (!ok) {
+                ++result.errors[operation];
+                ++result.errorMessages[std::string(LoadBenchmark::operationName(operation)) + ": "
+                    + manager.getLastError().substr(0, 200)];
+            }
+        }
+    }
+}
+
+const char* LoadBenchmark::operationName(int operation) {
+    static const char* names[OperationCount] = {
+        "login", "createRegistration", "getRegistrationsByDoctor", "createBill", "dashboardStats"
+    };
+    return operation >= 0 && operation < OperationCount ? names[operation] : "unknown";
+}
+
+bool LoadBenchmark::Options::parse(const std::vector<std::string>& args, std::string& error) {
+    for (const std::string& arg : args) {
+        std::size_t equals = arg.find('=');
+        if (equals == std::string::npos) {
+            error = "参数格式应为key=value: " + arg;
+            return false;
+        }
+        std::string key = arg.substr(0, equals);
+        std::string value = arg.substr(equals + 1);
+
+        try {
+            if (key == "threads") threads = std::stoi(value);
+            else if (key == "connections") connections = std::stoi(value);
+            else if (key == "duration") durationSeconds = std::stoi(value);
+            else if (key == "warmup") warmupSeconds = std::stoi(value);
+            else if (key == "capacity") dailyCapacity = std::stoi(value);
+            else if (key == "random") randomSeed = static_cast<unsigned int>(std::stoul(value));
+            else if (key == "doctors") seed.doctors = std::stoi(value);
+            else if (key == "patients") seed.patients = std::stoi(value);
+            else if (key == "registrations") seed.registrations = std::stoi(value);
+            else if (key == "output") outputPath = value;
+            else if (key == "mix") {
+                // 依次为登录、挂号、医生挂号列表、结算、仪表盘的权重
+                std::istringstream in(value);
+                std::string part;
+                for (int i = 0; i < OperationCount; ++i) {
+                    if (!std::getline(in, part, ',')) {
+                        error = "mix需要" + std::to_string(OperationCount) + "个以逗号分隔的权重";
+                        return false;
+                    }
+                    weights[i] = std::stoi(part);
+                }
+            }
+            else {
+                error = "未知参数: " + key;
+                return false;
+            }
+        }
+        catch (const std::exception&) {
+            error = "参数值无效: " + arg;
+            return false;
+        }
+    }
+
+    if (threads <= 0 || durationSeconds <= 0 || warmupSeconds < 0 || seed.doctors <= 0 || seed.patients <= 0
+        || seed.registrations < 0 || std::all_of(std::begin(weights), std::end(weights), [](int w) { return w <= 0; })
+        || std::any_of(std::begin(weights), std::end(weights), [](int w) { return w < 0; })) {
+        error = "线程数、时长、数据量须为正数，权重不能为负且不能全为0";
+        return false;
+    }
+    return true;
+}
+
+int LoadBenchmark::runStandalone(const std::string& host, const std::string& user,
+    const std::string& password, unsigned int port, const Options& options,
+    std::ostream& result, std::ostream& log) {
+
+    SystemManager manager;
+    DatabaseManager& db = *manager.getDatabaseManager();
+    ConnectionPoolConfig pool = db.getPoolConfig();
+    pool.maxConnections = static_cast<unsigned int>(options.connections > 0 ? options.connections : options.threads);
+    db.setPoolConfig(pool);
+
+    // 每次重建压测库，不触碰业务库；与QueryPlanAudit相同，先连information_schema建库再重连
+    if (!db.connect(host, user, password, "information_schema", port) ||
+        !db.executeQuery(std::string("DROP DATABASE IF EXISTS ") + kBenchDatabase) ||
+        !db.executeQuery(std::string("CREATE DATABASE ") + kBenchDatabase +
+            " CHARACTER SET utf8mb4 COLLATE utf8mb4_unicode_ci")) {
+        log << "[ERROR] 创建压测库失败: " << db.getLastError() << std::endl;
+        return 2;
+    }
+
+    if (!manager.initialize(host, user, password, kBenchDatabase, port)) {
+        log << "[ERROR] 初始化压测库失败: " << manager.getLastError() << std::endl;
+        return 2;
+    }
+
+    log << "写入测试数据: 医生 " << options.seed.doctors << "，病人 " << options.seed.patients
+        << "，挂号 " << options.seed.registrations << std::endl;
+    QueryPlanAudit seeder(db);
+    if (!seeder.seed(options.seed)) {
+        log << "[ERROR] " << seeder.getLastError() << std::endl;
+        return 2;
+    }
+
+    // 测试账户统一换成当前格式的口令哈希，登录时不会触发升级写入；号源调到足够大
+    if (!db.executePrepared("UPDATE users SET password_hash = ? WHERE username LIKE 'audit\\_%'",
+        { PasswordHasher::hash(kSeedPassword) })
+        || !db.executePrepared("UPDATE doctors SET daily_capacity = ?", { options.dailyCapacity })) {
+        log << "[ERROR] 准备测试账户失败: " << db.getLastError() << std::endl;
+        return 2;
+    }
+
+    std::vector<std::string> bookingDates;
+    for (int day = 0; day < kBookingDays; ++day) {
+        bookingDates.push_back(QDate::currentDate().addDays(day).toString("yyyy-MM-dd").toStdString());
+    }
+
+    log << "开始压测: 线程 " << options.threads << "，预热 " << options.warmupSeconds << " 秒，计时 "
+        << options.durationSeconds << " 秒" << std::endl;
+
+    Clock::time_point startedAt = Clock::now();
+    Clock::time_point measureFrom = startedAt + std::chrono::seconds(options.warmupSeconds);
+    Clock::time_point deadline = measureFrom + std::chrono::seconds(options.durationSeconds);
+
+    std::vector<ThreadResult> threadResults(static_cast<std::size_t>(options.threads));
+    std::vector<std::thread> workers;
+    for (int i = 0; i < options.threads; ++i) {
+        workers.emplace_back([&, i]() {
+            runWorker(manager, options, i, bookingDates, measureFrom, deadline, threadResults[static_cast<std::size_t>(i)]);
+        });
+    }
+
+    // 预热结束时清零查询统计，之后的统计与压测结果对应
+    std::this_thread::sleep_until(measureFrom);
+    db.getQueryStats().reset();
+
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    double elapsed = std::chrono::duration<double>(Clock::now() - measureFrom).count();
+
+    // 合并各线程结果
+    ThreadResult merged;
+    for (ThreadResult& threadResult : threadResults) {
+        for (int op = 0; op < OperationCount; ++op) {
+            merged.latencies[op].insert(merged.latencies[op].end(),
+                threadResult.latencies[op].begin(), threadResult.latencies[op].end());
+            merged.errors[op] += threadResult.errors[op];
+        }
+        for (const auto& item : threadResult.errorMessages) {
+            merged.errorMessages[item.first] += item.second;
+        }
+    }
+
+    std::uint64_t totalCalls = 0;
+    std::uint64_t totalErrors = 0;
+    for (int op = 0; op < OperationCount; ++op) {
+        std::sort(merged.latencies[op].begin(), merged.latencies[op].end());
+        totalCalls += merged.latencies[op].size();
+        totalErrors += merged.errors[op];
+    }
+
+    result << std::fixed << std::setprecision(3);
+    result << "{\n  \"threads\": " << options.threads
+        << ",\n  \"connections\": " << pool.maxConnections
+        << ",\n  \"durationSeconds\": " << elapsed
+        << ",\n  \"seed\": {\"doctors\": " << options.seed.doctors << ", \"patients\": " << options.seed.patients
+        << ", \"registrations\": " << options.seed.registrations << "}"
+        << ",\n  \"mix\": {";
+    for (int op = 0; op < OperationCount; ++op) {
+        result << (op ? ", " : "") << '"' << operationName(op) << "\": " << options.weights[op];
+    }
+    result << "},\n  \"totalCalls\": " << totalCalls
+        << ",\n  \"throughput\": " << (elapsed > 0 ? totalCalls / elapsed : 0.0)
+        << ",\n  \"errorRate\": " << (totalCalls ? static_cast<double>(totalErrors) / totalCalls : 0.0)
+        << ",\n  \"operations\": {";
+    for (int op = 0; op < OperationCount; ++op) {
+        const std::vector<std::uint32_t>& latencies = merged.latencies[op];
+        double sum = 0.0;
+        for (std::uint32_t micros : latencies) sum += micros;
+
+        result << (op ? ",\n" : "\n") << "    \"" << operationName(op) << "\": {"
+            << "\"calls\": " << latencies.size()
+            << ", \"errors\": " << merged.errors[op]
+            << ", \"errorRate\": " << (latencies.empty() ? 0.0 : static_cast<double>(merged.errors[op]) / latencies.size())
+            << ", \"throughput\": " << (elapsed > 0 ? latencies.size() / elapsed : 0.0)
+            << ", \"avgMs\": " << (latencies.empty() ? 0.0 : sum / latencies.size() / 1000.0)
+            << ", \"p50Ms\": " << percentileMs(latencies, 0.50)
+            << ", \"p95Ms\": " << percentileMs(latencies, 0.95)
+            << ", \"p99Ms\": " << percentileMs(latencies, 0.99)
+            << ", \"maxMs\": " << (latencies.empty() ? 0.0 : latencies.back() / 1000.0) << "}";
+    }
+    result << "\n  },\n  \"errorMessages\": {";
+    bool first = true;
+    for (const auto& item : merged.errorMessages) {
+        result << (first ? "\n    " : ",\n    ");
+        writeJsonString(result, item.first);
+        result << ": " << item.second;
+        first = false;
+    }
+    result << (first ? "},\n" : "\n  },\n") << "  \"queryStats\": " << db.getQueryStats().toJson() << "}\n";
+
+    log << "完成: " << totalCalls << " 次调用，" << std::setprecision(1) << (elapsed > 0 ? totalCalls / elapsed : 0.0)
+        << " 次/秒，错误 " << totalErrors << std::endl;
+    return 0;
+}
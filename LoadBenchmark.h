@@ -0,0 +1,41 @@
+﻿#pragma once
+#include "QueryPlanAudit.h"
+#include <ostream>
+#include <string>
+#include <vector>
+
+// 挂号流程压测：在独立的压测库中灌入测试数据，由多个线程按比例混合调用SystemManager的
+// 登录、挂号、医生挂号列表、结算和仪表盘统计，输出吞吐量、延迟分位数和错误率（JSON）
+class LoadBenchmark {
+public:
+    enum Operation {
+        Login,
+        CreateRegistration,
+        ListDoctorRegistrations,
+        CreateBill,
+        DashboardStats,
+        OperationCount
+    };
+
+    struct Options {
+        int threads = 8;
+        int connections = 0;            // 连接池上限，0表示与线程数相同
+        int durationSeconds = 30;
+        int warmupSeconds = 3;          // 预热期间的调用不计入结果
+        int dailyCapacity = 100000;     // 医生每日号源，默认足够大，不因号满产生错误
+        unsigned int randomSeed = 1;
+        QueryPlanAudit::SeedSize seed;
+        int weights[OperationCount] = { 5, 40, 30, 15, 10 };  // 各操作所占比例
+        std::string outputPath = "bench_result.json";
+
+        // 解析 key=value 形式的参数，如 threads=16 duration=60 mix=5,40,30,15,10
+        bool parse(const std::vector<std::string>& args, std::string& error);
+    };
+
+    static const char* operationName(int operation);
+
+    // 命令行入口：重建压测库、迁移、灌数据后压测，结果写入result，进度写入log，返回进程退出码
+    static int runStandalone(const std::string& host, const std::string& user,
+        const std::string& password, unsigned int port, const Options& options,
+        std::ostream& result, std::ostream& log);
+};
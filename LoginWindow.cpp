@@ -3,18 +3,13 @@
 #include <QApplication>
 #include <QFile>
 
-LoginWindow::LoginWindow(QWidget* parent)
-    : QMainWindow(parent) {
+LoginWindow::LoginWindow(SystemManager* systemManager, QWidget* parent)
+    : QMainWindow(parent), systemManager(systemManager) {
 
     setWindowTitle("医院挂号系统 - 登录");
     setFixedSize(600, 400);
-
-    // 初始化系统
-    if (!initializeSystem()) {
-        QMessageBox::critical(this, "错误", "系统初始化失败，请检查数据库配置！");
-        QApplication::quit();
-        return;
-    }
+    // 登录窗口和主窗口随会话创建，关闭时释放
+    setAttribute(Qt::WA_DeleteOnClose);
 
     // 初始化UI
     setupUI();
@@ -28,11 +23,6 @@ LoginWindow::LoginWindow(QWidget* parent)
 LoginWindow::~LoginWindow() {
 }
 
-bool LoginWindow::initializeSystem() {
-    systemManager = std::make_unique<SystemManager>();
-    return systemManager->initialize("127.0.0.1", "aaaa", "mysql123", "hospital_system", 3306);
-}
-
 void LoginWindow::setupUI() {
     // 设置窗口背景
     QPalette pal = palette();
@@ -121,28 +111,38 @@ void LoginWindow::onLoginClicked() {
         return;
     }
 
-    UserInfo user = systemManager->login(username.toStdString(), password.toStdString());
-
-    if (user.userId != 0) {
-        QString roleName;
-        if (user.role == "patient") roleName = "病人";
-        else if (user.role == "doctor") roleName = "医生";
-        else roleName = "管理员";
-
-        QMessageBox::information(this, "登录成功",
-            QString("欢迎 %1，您已成功登录！").arg(QString::fromStdString(user.name)));
+    // 登录查询在后台线程执行，期间禁用按钮并提示
+    loginButton->setEnabled(false);
+    loginButton->setText("登录中...");
 
-        // 打开主窗口
-        MainWindow* mainWindow = new MainWindow(systemManager.release(), user);
-        mainWindow->show();
-
-        // 关闭登录窗口
-        this->close();
-    }
-    else {
-        QMessageBox::critical(this, "登录失败",
-            QString("登录失败：%1").arg(QString::fromStdString(systemManager->getLastError())));
-    }
+    // 按所选角色登录，口令哈希在后台线程计算
+    QString role = roleComboBox->currentData().toString();
+    loginTask = systemManager->loginAsync(username.toStdString(), password.toStdString(), role.toStdString(), this,
+        [this](const UserInfo& user, const std::string& error) {
+            loginButton->setEnabled(true);
+            loginButton->setText("登录");
+
+            if (user.userId != 0) {
+                QString roleName;
+                if (user.role == "patient") roleName = "病人";
+                else if (user.role == "doctor") roleName = "医生";
+                else roleName = "管理员";
+
+                QMessageBox::information(this, "登录成功",
+                    QString("欢迎 %1，您已成功登录！").arg(QString::fromStdString(user.name)));
+
+                // 打开主窗口
+                MainWindow* mainWindow = new MainWindow(systemManager, user);
+                mainWindow->show();
+
+                // 关闭登录窗口
+                this->close();
+            }
+            else {
+                QMessageBox::critical(this, "登录失败",
+                    QString("登录失败：%1").arg(QString::fromStdString(error)));
+            }
+        });
 }
 
 void LoginWindow::onRegisterClicked() {
@@ -177,16 +177,28 @@ void LoginWindow::onRegisterClicked() {
         userInfo.department = "未分配科室";
     }
 
-    if (systemManager->registerUser(username.toStdString(), password.toStdString(),
-        role.toStdString(), userInfo)) {
-        QMessageBox::information(this, "注册成功", "用户注册成功，请使用新账号登录！");
-
-        // 清空表单
-        usernameEdit->clear();
-        passwordEdit->clear();
-    }
-    else {
-        QMessageBox::critical(this, "注册失败",
-            QString("注册失败：%1").arg(QString::fromStdString(systemManager->getLastError())));
-    }
+    // 口令哈希计算较慢，注册在后台线程执行
+    registerButton->setEnabled(false);
+    SystemManager* manager = systemManager;
+    registerTask = manager->runAsync(this,
+        [manager, username = username.toStdString(), password = password.toStdString(),
+         role = role.toStdString(), userInfo](const AsyncTask&) {
+            bool ok = manager->registerUser(username, password, role, userInfo);
+            return std::make_pair(ok, ok ? std::string() : manager->getLastError());
+        },
+        [this](const std::pair<bool, std::string>& result) {
+            registerButton->setEnabled(true);
+
+            if (result.first) {
+                QMessageBox::information(this, "注册成功", "用户注册成功，请使用新账号登录！");
+
+                // 清空表单
+                usernameEdit->clear();
+                passwordEdit->clear();
+            }
+            else {
+                QMessageBox::critical(this, "注册失败",
+                    QString("注册失败：%1").arg(QString::fromStdString(result.second)));
+            }
+        });
 }
\ No newline at end of file
@@ -15,7 +15,8 @@ class LoginWindow : public QMainWindow {
     Q_OBJECT
 
 public:
-    LoginWindow(QWidget* parent = nullptr);
+    // systemManager由应用程序持有，退出登录后下一个登录窗口继续使用同一个
+    explicit LoginWindow(SystemManager* systemManager, QWidget* parent = nullptr);
     ~LoginWindow();
 
 private slots:
@@ -43,11 +44,12 @@ private:
     QPushButton* loginButton;
     QPushButton* registerButton;
 
-    // 系统管理器
-    std::unique_ptr<SystemManager> systemManager;
+    // 系统管理器（不归窗口所有）
+    SystemManager* systemManager;
+    AsyncTask loginTask;
+    AsyncTask registerTask;
 
     // 初始化函数
     void setupUI();
     void applyStyles();
-    bool initializeSystem();
 };
\ No newline at end of file
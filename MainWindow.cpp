@@ -6,25 +6,124 @@
 #include <QSpinBox>
 #include <QFile>
 #include <QDateTime>
+#include <QFileDialog>
+#include <QPointer>
+#include <QProgressDialog>
 #include<qinputdialog.h>
+#include <QShowEvent>
+#include "ActionButtonDelegate.h"
+
+namespace {
+    // 管理员挂号表每次取的行数
+    constexpr int kAdminPageSize = 200;
+    // 刷新请求的合并窗口，连续的写操作和筛选只触发一次查询
+    constexpr int kRefreshDebounceMs = 100;
+    // 预先创建标签页的间隔，每次只创建一个，期间界面仍可响应操作
+    constexpr int kTabPrefetchIntervalMs = 50;
+
+    // 可刷新的视图，按编号顺序执行：挂号表先于依赖它的队列和统计
+    enum RefreshView {
+        DoctorsView,
+        PatientRegistrationsView,
+        DoctorSlotsView,
+        DoctorRegistrationsView,
+        TodayQueueView,
+        DoctorStatsView,
+        AdminRegistrationsView,
+        AdminStatsView,
+        DepartmentsView
+    };
+
+    // 挂号表格和今日队列操作列中的按钮
+    enum RegistrationAction {
+        ViewAction,
+        CancelAction,
+        SettleAction,
+        PatientInfoAction,
+        DeleteAction,
+        RequeueAction,
+        HandleAction,
+        PriorityAction,
+        ClearPriorityAction,
+        SkipAction
+    };
+
+    ActionButtonDelegate* createActionDelegate(QAbstractItemView* view, const std::string& role) {
+        ActionButtonDelegate* delegate = new ActionButtonDelegate(view);
+        delegate->addButton(ViewAction, role == "admin" ? "详情" : "查看", QColor("#3b82f6"), QColor("#2563eb"));
+        delegate->addButton(CancelAction, "取消", QColor("#ef4444"), QColor("#dc2626"));
+        delegate->addButton(SettleAction, "结算", QColor("#27ae60"), QColor("#219653"));
+        delegate->addButton(PatientInfoAction, "病人信息", QColor("#3b82f6"), QColor("#2563eb"), 80);
+        delegate->addButton(DeleteAction, "删除", QColor("#ef4444"), QColor("#dc2626"));
+        delegate->addButton(RequeueAction, "重新排队", QColor("#10b981"), QColor(), 70);
+        delegate->addButton(HandleAction, "处理", QColor("#3b82f6"), QColor(), 70);
+        delegate->addButton(PriorityAction, "优先", QColor("#f59e0b"), QColor(), 70);
+        delegate->addButton(ClearPriorityAction, "取消优先", QColor("#f59e0b"), QColor(), 70);
+        delegate->addButton(SkipAction, "过号", QColor("#6b7280"), QColor(), 70);
+        return delegate;
+    }
+}
 
 MainWindow::MainWindow(SystemManager* systemManager, const UserInfo& userInfo, QWidget* parent)
     : QMainWindow(parent), systemManager(systemManager), currentUser(userInfo) {
 
     setWindowTitle("医院挂号管理系统");
     resize(1000, 700);
+    setAttribute(Qt::WA_DeleteOnClose);
 
+    // 加载基础数据：打开窗口前只查询当前用户，其余数据在各标签页创建时加载
+    loadUserData();
+
+    refreshScheduler.setDebounce(kRefreshDebounceMs);
     setupUI();
     applyStyles();
 
-    // 加载基础数据
-    loadUserData();
-    loadDoctors();
-    loadRegistrations();  // 这会根据角色调用不同的函数
+    // 之后的写操作通过变更事件只更新受影响的行
+    systemManager->changeEvents().subscribe(this, [this](const std::vector<ChangeEvent>& events) {
+        onDataChanged(events);
+    });
 }
 
 MainWindow::~MainWindow() {
-    delete systemManager;
+}
+
+// 添加占位页面，内容在第一次切换到该标签页（或空闲时预先创建）时才创建
+void MainWindow::addLazyTab(const QString& title, std::function<QWidget*()> build) {
+    QWidget* page = new QWidget();
+    QVBoxLayout* layout = new QVBoxLayout(page);
+    layout->setContentsMargins(0, 0, 0, 0);
+    tabWidget->addTab(page, title);
+    tabBuilders[page] = std::move(build);
+}
+
+// 创建标签页内容；各标签页在创建时登记自己的视图并请求第一次加载
+void MainWindow::buildTab(int index) {
+    QWidget* page = tabWidget->widget(index);
+    auto it = tabBuilders.find(page);
+    if (it == tabBuilders.end()) return;
+
+    std::function<QWidget*()> build = std::move(it->second);
+    tabBuilders.erase(it);
+    page->layout()->addWidget(build());
+}
+
+// 窗口第一次显示后再开始预先创建其余标签页，不推迟首次绘制
+void MainWindow::showEvent(QShowEvent* event) {
+    QMainWindow::showEvent(event);
+    if (tabsPrefetchStarted) return;
+
+    tabsPrefetchStarted = true;
+    QTimer::singleShot(kTabPrefetchIntervalMs, this, [this]() { prefetchTabs(); });
+}
+
+void MainWindow::prefetchTabs() {
+    for (int i = 0; i < tabWidget->count(); ++i) {
+        if (tabBuilders.count(tabWidget->widget(i)) == 0) continue;
+
+        buildTab(i);
+        QTimer::singleShot(kTabPrefetchIntervalMs, this, [this]() { prefetchTabs(); });
+        return;
+    }
 }
 
 void MainWindow::setupUI() {
@@ -83,31 +182,38 @@ void MainWindow::setupUI() {
     tabWidget->setTabPosition(QTabWidget::North);
     tabWidget->setTabShape(QTabWidget::Rounded);
 
-    setupHomeTab();
+    addLazyTab("🏠 首页", [this]() { return setupHomeTab(); });
     // 挂号管理（根据角色显示不同的界面）
     if (currentUser.role == "patient") {
-        setupPatientRegistrationTab();  // 病人的挂号管理
+        addLazyTab("📋 挂号管理", [this]() { return setupPatientRegistrationTab(); });  // 病人的挂号管理
     }
     else if (currentUser.role == "doctor") {
-        setupDoctorRegistrationTab();   // 医生的工作台
+        addLazyTab("👨‍⚕️ 医生工作台", [this]() { return setupDoctorRegistrationTab(); });  // 医生的工作台
     }
     else if (currentUser.role == "admin") {
-        setupAdminRegistrationTab();    // 管理员查看所有挂号
+        addLazyTab("📋 挂号管理", [this]() { return setupAdminRegistrationTab(); });  // 管理员查看所有挂号
     }
 
     // 个人中心（所有用户都有）
-    setupProfileTab();
+    addLazyTab("👤 个人中心", [this]() { return setupProfileTab(); });
     
     // 医生列表（病人和管理员可以查看）
     if (currentUser.role == "patient" || currentUser.role == "admin") {
-        setupDoctorsTab();
+        addLazyTab("👨‍⚕️ 医生列表", [this]() { return setupDoctorsTab(); });
     }
 
     // 科室管理（仅管理员）
     if (currentUser.role == "admin") {
-        setupDepartmentTab();
+        addLazyTab("🏥 科室管理", [this]() { return setupDepartmentTab(); });
     }
 
+    // 只创建当前标签页；切换标签页时创建新页面，并执行此前因页面不可见而推迟的刷新
+    buildTab(tabWidget->currentIndex());
+    connect(tabWidget, &QTabWidget::currentChanged, this, [this](int index) {
+        buildTab(index);
+        refreshScheduler.schedulePending();
+    });
+
     mainLayout->addWidget(tabWidget);
 
     // 状态栏
@@ -130,7 +236,7 @@ void MainWindow::setupUI() {
     );
     statusBar->addWidget(statusLabel);
 }
-void MainWindow::setupHomeTab() {
+QWidget* MainWindow::setupHomeTab() {
     homeTab = new QWidget();
     QVBoxLayout* layout = new QVBoxLayout(homeTab);
     layout->setAlignment(Qt::AlignCenter);
@@ -154,9 +260,9 @@ void MainWindow::setupHomeTab() {
     layout->addWidget(instructionLabel);
     layout->addStretch();
 
-    tabWidget->addTab(homeTab, "🏠 首页");
+    return homeTab;
 }
-void MainWindow::setupProfileTab() {
+QWidget* MainWindow::setupProfileTab() {
     profileTab = new QWidget();
     QVBoxLayout* mainLayout = new QVBoxLayout(profileTab);
     mainLayout->setSpacing(15);
@@ -251,9 +357,9 @@ void MainWindow::setupProfileTab() {
     mainLayout->addWidget(passwordGroup);
     mainLayout->addStretch();
 
-    tabWidget->addTab(profileTab, "👤 个人中心");
+    return profileTab;
 }
-void MainWindow::setupDoctorsTab() {
+QWidget* MainWindow::setupDoctorsTab() {
     doctorsTab = new QWidget();
     QVBoxLayout* layout = new QVBoxLayout(doctorsTab);
     layout->setContentsMargins(10, 10, 10, 10);
@@ -271,9 +377,12 @@ void MainWindow::setupDoctorsTab() {
 
     layout->addWidget(doctorsTable);
 
-    tabWidget->addTab(doctorsTab, "👨‍⚕️ 医生列表");
+    refreshScheduler.addView(DoctorsView, doctorsTable, [this]() { loadDoctors(); });
+    refreshScheduler.request(DoctorsView);
+
+    return doctorsTab;
 }
-void MainWindow::setupDepartmentTab() {
+QWidget* MainWindow::setupDepartmentTab() {
     departmentTab = new QWidget();
     QVBoxLayout* mainLayout = new QVBoxLayout(departmentTab);
     mainLayout->setSpacing(15);
@@ -372,7 +481,10 @@ void MainWindow::setupDepartmentTab() {
         assignButton->setToolTip(tooltip);
     }
 
-    tabWidget->addTab(departmentTab, "🏥 科室管理");
+    refreshScheduler.addView(DepartmentsView, departmentTable, [this]() { loadDepartments(); });
+    refreshScheduler.request(DepartmentsView);
+
+    return departmentTab;
 }
 void MainWindow::applyStyles() {
     QFile styleFile("styles.qss");
@@ -421,7 +533,8 @@ void MainWindow::loadDoctors() {
 // 事件处理函数
 void MainWindow::onLogoutClicked() {
     if (QMessageBox::question(this, "确认退出", "确定要退出登录吗？") == QMessageBox::Yes) {
-        LoginWindow* loginWindow = new LoginWindow();
+        // 数据库连接、缓存和表结构保持不变，重新登录只需验证账号
+        LoginWindow* loginWindow = new LoginWindow(systemManager);
         loginWindow->show();
         this->close();
     }
@@ -435,17 +548,38 @@ void MainWindow::onDepartmentSelected(int index) {
         auto doctors = systemManager->getDoctorsByDepartment(department.toStdString());
         doctorCombo->addItem("请选择医生", 0);
         for (const auto& doctor : doctors) {
-            doctorCombo->addItem(
-                QString("%1 (%2)").arg(
-                    QString::fromStdString(doctor.name),
-                    QString::fromStdString(doctor.phone)
-                ),
-                doctor.doctorId
+            QString label = QString("%1 (%2)").arg(
+                QString::fromStdString(doctor.name),
+                QString::fromStdString(doctor.phone)
             );
+            doctorCombo->addItem(label, doctor.doctorId);
+            doctorCombo->setItemData(doctorCombo->count() - 1, label, Qt::UserRole + 1);
         }
+        refreshScheduler.request(DoctorSlotsView);
     }
 }
 
+// 在医生下拉框中显示所选日期的剩余号源，查询在后台执行
+void MainWindow::refreshDoctorSlots() {
+    if (!doctorCombo || doctorCombo->count() <= 1) return;
+
+    std::string date = dateEdit->date().toString("yyyy-MM-dd").toStdString();
+    doctorSlotsTask.cancel();
+    doctorSlotsTask = systemManager->runAsync(this, [this, date](const AsyncTask&) {
+        return systemManager->getRemainingSlots(date);
+    }, [this](const std::unordered_map<int, int>& remaining) {
+        for (int i = 0; i < doctorCombo->count(); ++i) {
+            auto it = remaining.find(doctorCombo->itemData(i).toInt());
+            if (it == remaining.end()) continue;
+
+            QString label = doctorCombo->itemData(i, Qt::UserRole + 1).toString();
+            doctorCombo->setItemText(i, it->second > 0
+                ? QString("%1 - 余号 %2").arg(label).arg(it->second)
+                : QString("%1 - 已满").arg(label));
+        }
+    });
+}
+
 void MainWindow::onNewRegistrationClicked() {
     if (currentUser.role != "patient") {
         QMessageBox::warning(this, "权限不足", "只有病人可以挂号！");
@@ -467,14 +601,14 @@ void MainWindow::onNewRegistrationClicked() {
     if (regId > 0) {
         QMessageBox::information(this, "成功", QString("挂号成功！挂号单号：%1").arg(regId));
 
-        // 清空表单
+        // 清空表单；挂号记录由变更事件插入
         notesEdit->clear();
-        loadRegistrations();
     }
     else {
         QMessageBox::critical(this, "失败",
             QString("挂号失败：%1").arg(QString::fromStdString(systemManager->getLastError())));
     }
+    refreshScheduler.request(DoctorSlotsView);
 }
 
 void MainWindow::refreshRegistrations() {
@@ -529,14 +663,30 @@ void MainWindow::onChangePasswordClicked() {
         return;
     }
 
-    // 这里需要调用SystemManager的changePassword方法
-    // 由于之前的SystemManager没有实现这个方法，我们先显示提示
-    QMessageBox::information(this, "提示", "修改密码功能正在开发中...");
-
-    // 清空密码框
-    oldPasswordEdit->clear();
-    newPasswordEdit->clear();
-    confirmPasswordEdit->clear();
+    // 口令校验和哈希计算在后台线程执行
+    changePasswordButton->setEnabled(false);
+    int userId = currentUser.userId;
+    systemManager->runAsync(this,
+        [this, userId, oldPassword = oldPassword.toStdString(), newPassword = newPassword.toStdString()](const AsyncTask&) {
+            bool ok = systemManager->changePassword(userId, oldPassword, newPassword);
+            return std::make_pair(ok, ok ? std::string() : systemManager->getLastError());
+        },
+        [this](const std::pair<bool, std::string>& result) {
+            changePasswordButton->setEnabled(true);
+
+            if (result.first) {
+                QMessageBox::information(this, "成功", "密码修改成功！");
+
+                // 清空密码框
+                oldPasswordEdit->clear();
+                newPasswordEdit->clear();
+                confirmPasswordEdit->clear();
+            }
+            else {
+                QMessageBox::critical(this, "失败",
+                    QString("修改密码失败：%1").arg(QString::fromStdString(result.second)));
+            }
+        });
 }
 
 QString MainWindow::getRoleDisplayName(const std::string& role) {
@@ -669,7 +819,7 @@ void MainWindow::loadDoctorsForAssignment() {
     }
 }
 //病人挂号管理
-void MainWindow::setupPatientRegistrationTab() {
+QWidget* MainWindow::setupPatientRegistrationTab() {
     QWidget* registrationTab = new QWidget();
     QVBoxLayout* mainLayout = new QVBoxLayout(registrationTab);
     mainLayout->setSpacing(15);
@@ -728,6 +878,9 @@ void MainWindow::setupPatientRegistrationTab() {
         this, &MainWindow::onDepartmentSelected);
     connect(submitButton, &QPushButton::clicked,
         this, &MainWindow::onNewRegistrationClicked);
+    connect(dateEdit, &QDateEdit::dateChanged, this, [this]() {
+        refreshScheduler.request(DoctorSlotsView);
+        });
 
     formLayout->addRow("📅 挂号日期:", dateEdit);
     formLayout->addRow("🏥 选择科室:", departmentCombo);
@@ -767,16 +920,12 @@ void MainWindow::setupPatientRegistrationTab() {
     toolbarLayout->addWidget(filterCombo);
 
     // 挂号表格
-    regTable = new QTableWidget();
-    regTable->setColumnCount(6);
-    regTable->setHorizontalHeaderLabels(
-        QStringList() << "单号" << "日期" << "医生" << "科室" << "状态" << "费用"
-    );
-    regTable->setAlternatingRowColors(true);
-    regTable->setSelectionBehavior(QAbstractItemView::SelectRows);
-    regTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    using Column = RegistrationTableModel::Column;
+    regTable = createRegistrationView({
+        { Column::Id, "单号" }, { Column::Date, "日期" }, { Column::Doctor, "医生" },
+        { Column::Department, "科室" }, { Column::Status, "状态" }, { Column::Amount, "费用" },
+        { Column::Actions, "操作" } });
     regTable->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
-    regTable->verticalHeader()->setVisible(false);
 
     // 设置列宽比例
     regTable->setColumnWidth(0, 80);   // 单号
@@ -798,10 +947,14 @@ void MainWindow::setupPatientRegistrationTab() {
     tipLabel->setStyleSheet("color: #666; font-size: 12px; padding: 5px; background-color: #f8f9fa; border-radius: 4px;");
     mainLayout->addWidget(tipLabel);
 
-    tabWidget->addTab(registrationTab, "📋 挂号管理");
+    refreshScheduler.addView(PatientRegistrationsView, regTable, [this]() { loadPatientRegistrations(); });
+    refreshScheduler.addView(DoctorSlotsView, doctorCombo, [this]() { refreshDoctorSlots(); });
+    refreshScheduler.request(PatientRegistrationsView);
+
+    return registrationTab;
 }
 
-void MainWindow::setupAdminRegistrationTab() {
+QWidget* MainWindow::setupAdminRegistrationTab() {
     QWidget* adminTab = new QWidget();
     QVBoxLayout* mainLayout = new QVBoxLayout(adminTab);
     mainLayout->setSpacing(15);
@@ -815,7 +968,27 @@ void MainWindow::setupAdminRegistrationTab() {
     adminDateEdit->setCalendarPopup(true);
     adminDateEdit->setDisplayFormat("yyyy-MM-dd");
 
-    adminPatientCombo = new QComboBox();
+    // 病人数量大，不整体加载：按姓名、手机号、身份证号片段检索，结果显示在补全列表中
+    adminPatientEdit = new QLineEdit();
+    adminPatientEdit->setPlaceholderText("输入姓名、手机号或身份证号搜索病人");
+    patientSearchModel = new QStandardItemModel(this);
+    patientCompleter = new QCompleter(patientSearchModel, this);
+    patientCompleter->setCompletionMode(QCompleter::UnfilteredPopupCompletion);
+    adminPatientEdit->setCompleter(patientCompleter);
+    patientSearchTimer = new QTimer(this);
+    patientSearchTimer->setSingleShot(true);
+    patientSearchTimer->setInterval(250);
+
+    connect(adminPatientEdit, &QLineEdit::textEdited, this, [this]() {
+        adminSelectedPatientId = 0;
+        patientSearchTimer->start();
+    });
+    connect(patientSearchTimer, &QTimer::timeout, this, &MainWindow::searchPatientsForAdmin);
+    connect(patientCompleter, QOverload<const QModelIndex&>::of(&QCompleter::activated), this,
+        [this](const QModelIndex& index) {
+            adminSelectedPatientId = index.data(Qt::UserRole).toInt();
+        });
+
     adminDoctorCombo = new QComboBox();
     adminNotesEdit = new QTextEdit();
     adminNotesEdit->setMaximumHeight(30);
@@ -826,12 +999,11 @@ void MainWindow::setupAdminRegistrationTab() {
 
     connect(adminAddButton, &QPushButton::clicked, this, &MainWindow::onAdminAddRegistrationClicked);
 
-    // 加载病人和医生列表
-    loadPatientsForAdmin();
+    // 加载医生列表
     loadDoctorsForAdmin();
 
     addFormLayout->addRow("挂号日期:", adminDateEdit);
-    addFormLayout->addRow("选择病人:", adminPatientCombo);
+    addFormLayout->addRow("选择病人:", adminPatientEdit);
     addFormLayout->addRow("选择医生:", adminDoctorCombo);
     addFormLayout->addRow("备注:", adminNotesEdit);
     addFormLayout->addRow("", adminAddButton);
@@ -846,6 +1018,7 @@ void MainWindow::setupAdminRegistrationTab() {
 
         QLabel* titleLabel = new QLabel(title);
         QLabel* valueLabel = new QLabel(value);
+        valueLabel->setObjectName("valueLabel");
 
         titleLabel->setStyleSheet(QString("color: %1; font-size: 12px;").arg(color));
         valueLabel->setStyleSheet("font-size: 24px; font-weight: bold;");
@@ -856,18 +1029,15 @@ void MainWindow::setupAdminRegistrationTab() {
         return card;
         };
 
-    // 先更新统计数据
-    updateAdminStats();
-
-    // 创建卡片并存储引用，以便后续更新
-    QWidget* todayCard = createStatCard("今日挂号", QString::number(adminTodayCount), "#3b82f6");
-    QWidget* doctorCard = createStatCard("医生数", QString::number(adminDoctorCount), "#f59e0b");
-    QWidget* patientCard = createStatCard("病人数", QString::number(adminPatientCount), "#ef4444");
+    // 创建卡片并存储引用，统计数据在后台加载完成后更新
+    QWidget* todayCard = createStatCard("今日挂号", "--", "#3b82f6");
+    QWidget* doctorCard = createStatCard("医生数", "--", "#f59e0b");
+    QWidget* patientCard = createStatCard("病人数", "--", "#ef4444");
 
     // 为了后续更新，我们需要存储值标签
-    QLabel* todayValueLabel = todayCard->findChild<QLabel*>();
-    QLabel* doctorValueLabel = doctorCard->findChild<QLabel*>();
-    QLabel* patientValueLabel = patientCard->findChild<QLabel*>();
+    adminTodayValueLabel = todayCard->findChild<QLabel*>("valueLabel");
+    adminDoctorValueLabel = doctorCard->findChild<QLabel*>("valueLabel");
+    adminPatientValueLabel = patientCard->findChild<QLabel*>("valueLabel");
 
     // 添加到布局
     statsLayout->addWidget(todayCard, 0, 0);
@@ -900,6 +1070,16 @@ void MainWindow::setupAdminRegistrationTab() {
     statusFilterCombo->addItem("已完成", "completed");
     statusFilterCombo->addItem("已取消", "cancelled");
 
+    // 科室、医生筛选项来自参考数据缓存
+    for (const auto& dept : systemManager->getAllDepartments()) {
+        QString name = QString::fromStdString(dept.departmentName);
+        deptFilterCombo->addItem(name, name);
+    }
+    for (const auto& doctor : systemManager->getAllDoctors()) {
+        doctorFilterCombo->addItem(QString("%1 (%2)").arg(QString::fromStdString(doctor.name),
+            QString::fromStdString(doctor.department)), doctor.doctorId);
+    }
+
     filterLayout->addWidget(new QLabel("日期:"));
     filterLayout->addWidget(startDateEdit);
     filterLayout->addWidget(new QLabel("至"));
@@ -915,17 +1095,15 @@ void MainWindow::setupAdminRegistrationTab() {
     filterLayout->addStretch();
     filterLayout->addWidget(exportAllButton);
 
-    // 挂号表格
-    adminRegTable = new QTableWidget();
-    adminRegTable->setColumnCount(10);
-    adminRegTable->setHorizontalHeaderLabels(
-        QStringList() << "单号" << "日期" << "病人" << "医生" << "科室" << "状态" << "费用" << "账单" << "操作" << "删除"
-    );
-    adminRegTable->setAlternatingRowColors(true);
-    adminRegTable->setSelectionBehavior(QAbstractItemView::SelectRows);
-    adminRegTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
-    adminRegTable->horizontalHeader()->setStretchLastSection(true);
-    adminRegTable->verticalHeader()->setVisible(false);
+    // 挂号表格：记录可能有数万条，只有可见行参与绘制
+    using Column = RegistrationTableModel::Column;
+    adminRegTable = createRegistrationView({
+        { Column::Id, "单号" }, { Column::Date, "日期" }, { Column::Patient, "病人" },
+        { Column::Doctor, "医生" }, { Column::Department, "科室" }, { Column::Status, "状态" },
+        { Column::Amount, "费用" }, { Column::BillStatus, "账单" }, { Column::Actions, "操作" },
+        { Column::Delete, "删除" } });
+    registrationModel->setUnbilledText("未结算");
+    registrationModel->setFetchMoreHandler([this]() { loadMoreAdminRegistrations(); });
 
     recordsLayout->addWidget(filterBar);
     recordsLayout->addWidget(adminRegTable);
@@ -951,32 +1129,24 @@ void MainWindow::setupAdminRegistrationTab() {
     adminActionsLayout->addWidget(systemLogBtn);
     adminActionsLayout->addStretch();
 
+    connect(reportBtn, &QPushButton::clicked, this, &MainWindow::generateReport);
+    connect(systemLogBtn, &QPushButton::clicked, this, &MainWindow::showSystemLog);
+
     // 添加到主布局
     mainLayout->addWidget(addRegGroup);
     mainLayout->addWidget(statsGroup);
     mainLayout->addWidget(recordsGroup,1);
     mainLayout->addWidget(adminActionsGroup);
 
-    tabWidget->addTab(adminTab, "📋 挂号管理");
-
-    // 加载数据
-    loadAdminRegistrations();
+    connect(exportAllButton, &QPushButton::clicked, this, &MainWindow::exportRegistrations);
 
     // 连接筛选按钮
-    connect(filterButton, &QPushButton::clicked, [this, todayValueLabel,
-        doctorValueLabel, patientValueLabel]() {
-            // 筛选后重新加载数据
-            loadAdminRegistrations();
-            // 更新统计数据
-            updateAdminStats();
-            // 更新显示
-            if (todayValueLabel) todayValueLabel->setText(QString::number(adminTodayCount));
-            if (doctorValueLabel) doctorValueLabel->setText(QString::number(adminDoctorCount));
-            if (patientValueLabel) patientValueLabel->setText(QString::number(adminPatientCount));
+    connect(filterButton, &QPushButton::clicked, [this]() {
+            // 筛选后重新加载数据和统计，连续点击只查询一次
+            refreshScheduler.request({ AdminRegistrationsView, AdminStatsView });
         });
 
-    connect(resetButton, &QPushButton::clicked, [this, todayValueLabel,
-        doctorValueLabel, patientValueLabel]() {
+    connect(resetButton, &QPushButton::clicked, [this]() {
             // 重置筛选条件
             startDateEdit->setDate(QDate::currentDate().addDays(-7));
             endDateEdit->setDate(QDate::currentDate());
@@ -984,281 +1154,227 @@ void MainWindow::setupAdminRegistrationTab() {
             doctorFilterCombo->setCurrentIndex(0);
             statusFilterCombo->setCurrentIndex(0);
 
-            // 重新加载数据
-            loadAdminRegistrations();
-            // 更新统计数据
-            updateAdminStats();
-            // 更新显示
-            if (todayValueLabel) todayValueLabel->setText(QString::number(adminTodayCount));
-            if (doctorValueLabel) doctorValueLabel->setText(QString::number(adminDoctorCount));
-            if (patientValueLabel) patientValueLabel->setText(QString::number(adminPatientCount));
+            // 重新加载数据和统计
+            refreshScheduler.request({ AdminRegistrationsView, AdminStatsView });
         });
+
+    refreshScheduler.addView(AdminRegistrationsView, adminRegTable, [this]() { loadAdminRegistrations(); });
+    // 统计查询条件不变，上一次未返回时等它返回再查，不取消重来
+    refreshScheduler.addView(AdminStatsView, adminTodayValueLabel, [this]() { updateAdminStats(); }, &adminStatsTask);
+    refreshScheduler.request({ AdminRegistrationsView, AdminStatsView });
+
+    return adminTab;
 }
 
 void MainWindow::loadRegistrations() {
-    std::vector<RegistrationInfo> registrations;
-
     if (currentUser.role == "patient") {
-        registrations = systemManager->getRegistrationsByPatient(currentUser.userId);
-        // 调用病人的专门函数
-        loadPatientRegistrations();
+        // 病人的挂号记录
+        refreshScheduler.request(PatientRegistrationsView);
     }
     else if (currentUser.role == "doctor") {
-        registrations = systemManager->getRegistrationsByDoctor(currentUser.userId);
-        // 调用医生的专门函数
-        loadDoctorRegistrations();
+        // 医生的挂号记录、今日队列和统计
+        refreshScheduler.request({ DoctorRegistrationsView, TodayQueueView, DoctorStatsView });
     }
     else {
-        registrations = systemManager->getAllRegistrations();
-        // 调用管理员的专门函数
-        loadAdminRegistrations();
+        // 管理员的挂号记录和统计
+        refreshScheduler.request({ AdminRegistrationsView, AdminStatsView });
     }
 }
 // 病人挂号记录加载
 void MainWindow::loadPatientRegistrations() {
-    std::vector<RegistrationInfo> registrations = systemManager->getRegistrationsByPatient(currentUser.userId);
-    if (regTable) {
-        regTable->setRowCount(static_cast<int>(registrations.size()));
-
-        for (int i = 0; i < static_cast<int>(registrations.size()); ++i) {
-            const auto& reg = registrations[i];
-
-            // 状态显示
-            QString statusText;
-            QString statusStyle;
-            if (reg.status == "pending") {
-                statusText = "待处理";
-                statusStyle = "color: #f59e0b; font-weight: bold;";
-            }
-            else if (reg.status == "completed") {
-                statusText = "已完成";
-                statusStyle = "color: #10b981; font-weight: bold;";
-            }
-            else {
-                statusText = "已取消";
-                statusStyle = "color: #ef4444; font-weight: bold;";
-            }
-
-            regTable->setItem(i, 0, new QTableWidgetItem(QString::number(reg.registrationId)));
-            regTable->setItem(i, 1, new QTableWidgetItem(QString::fromStdString(reg.registrationDate)));
-            regTable->setItem(i, 2, new QTableWidgetItem(QString::fromStdString(reg.doctorName)));
-            regTable->setItem(i, 3, new QTableWidgetItem(QString::fromStdString(reg.doctorDepartment)));
-
-            QTableWidgetItem* statusItem = new QTableWidgetItem(statusText);
-            statusItem->setTextAlignment(Qt::AlignCenter);
-            statusItem->setData(Qt::UserRole, QString::fromStdString(reg.status));
-            regTable->setItem(i, 4, statusItem);
-
-            // 金额
-            QString amountText = reg.hasBill ?
-                QString("¥%1").arg(reg.billAmount, 0, 'f', 2) : "待结算";
-            regTable->setItem(i, 5, new QTableWidgetItem(amountText));
-
-            // 病人只能查看，不能操作
-            QWidget* actionWidget = new QWidget();
-            QHBoxLayout* actionLayout = new QHBoxLayout(actionWidget);
-            actionLayout->setContentsMargins(5, 2, 5, 2);
-            actionLayout->setSpacing(5);
-
-            QPushButton* viewBtn = new QPushButton("查看");
-            viewBtn->setFixedSize(60, 25);
-            viewBtn->setStyleSheet(
-                "QPushButton {"
-                "  background-color: #3b82f6;"
-                "  color: white;"
-                "  border: none;"
-                "  border-radius: 3px;"
-                "  font-size: 12px;"
-                "}"
-                "QPushButton:hover {"
-                "  background-color: #2563eb;"
-                "}"
-            );
+    if (registrationModel) {
+        registrationModel->setRegistrations(systemManager->getRegistrationsByPatient(currentUser.userId));
+    }
+}
 
-            connect(viewBtn, &QPushButton::clicked, [this, reg]() {
-                QString info = QString(
-                    "挂号单详情：\n"
-                    "单号：%1\n"
-                    "日期：%2\n"
-                    "医生：%3\n"
-                    "科室：%4\n"
-                    "状态：%5\n"
-                    "费用：%6\n"
-                    "备注：%7"
-                ).arg(
-                    QString::number(reg.registrationId),
-                    QString::fromStdString(reg.registrationDate),
-                    QString::fromStdString(reg.doctorName),
-                    QString::fromStdString(reg.doctorDepartment),
-                    reg.status == "pending" ? "待处理" : (reg.status == "completed" ? "已完成" : "已取消"),
-                    reg.hasBill ? QString("¥%1").arg(reg.billAmount, 0, 'f', 2) : "待结算",
-                    QString::fromStdString(reg.notes)
-                );
-
-                QMessageBox::information(this, "挂号详情", info);
-                });
-
-            // 如果状态是待处理，病人可以取消
-            if (reg.status == "pending") {
-                QPushButton* cancelBtn = new QPushButton("取消");
-                cancelBtn->setFixedSize(60, 25);
-                cancelBtn->setStyleSheet(
-                    "QPushButton {"
-                    "  background-color: #ef4444;"
-                    "  color: white;"
-                    "  border: none;"
-                    "  border-radius: 3px;"
-                    "  font-size: 12px;"
-                    "}"
-                    "QPushButton:hover {"
-                    "  background-color: #dc2626;"
-                    "}"
-                );
-
-                connect(cancelBtn, &QPushButton::clicked, [this, reg]() {
-                    if (QMessageBox::question(this, "确认取消",
-                        "确定要取消这个挂号吗？") == QMessageBox::Yes) {
-                        // 这里需要调用取消挂号的接口
-                        // 暂时先显示消息
-                        QMessageBox::information(this, "成功", "挂号已取消");
-                        loadRegistrations();
-                    }
-                    });
+// 医生挂号记录加载
+void MainWindow::loadDoctorRegistrations() {
+    if (registrationModel) {
+        registrationModel->setRegistrations(systemManager->getRegistrationsByDoctor(currentUser.userId));
+    }
+}
 
-                actionLayout->addWidget(cancelBtn);
-            }
+// 创建当前角色的挂号表格，操作列的按钮由委托绘制，不为每行创建控件
+QTableView* MainWindow::createRegistrationView(std::vector<RegistrationTableModel::ColumnSpec> columns) {
+    QTableView* view = new QTableView();
+    registrationModel = new RegistrationTableModel(columns, view);
+    registrationModel->setActionProvider(
+        [this](const RegistrationInfo& reg, RegistrationTableModel::Column column) {
+            return registrationActions(reg, column);
+        });
 
-            actionLayout->addWidget(viewBtn);
-            actionLayout->addStretch();
+    view->setModel(registrationModel);
+    view->setAlternatingRowColors(true);
+    view->setSelectionBehavior(QAbstractItemView::SelectRows);
+    view->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    view->horizontalHeader()->setStretchLastSection(true);
+    view->verticalHeader()->setVisible(false);
+    // 固定行高，滚动和整表替换时不逐行计算行高
+    view->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+    view->verticalHeader()->setDefaultSectionSize(32);
+
+    ActionButtonDelegate* delegate = createActionDelegate(view, currentUser.role);
+    delegate->setActionHandler([this](int action, const QModelIndex& index) {
+        onRegistrationAction(action, registrationModel->registrationAt(index.row()));
+    });
+    for (int i = 0; i < static_cast<int>(columns.size()); ++i) {
+        if (columns[i].column == RegistrationTableModel::Column::Actions
+            || columns[i].column == RegistrationTableModel::Column::Delete) {
+            view->setItemDelegateForColumn(i, delegate);
+        }
+    }
+    return view;
+}
 
-            if (regTable->columnCount() > 6) {
-                regTable->setCellWidget(i, 6, actionWidget);
-            }
+// 挂号表操作列显示的按钮
+QVariantList MainWindow::registrationActions(const RegistrationInfo& reg, RegistrationTableModel::Column column) const {
+    QVariantList actions;
+    if (column == RegistrationTableModel::Column::Delete) {
+        actions << DeleteAction;
+    }
+    else if (currentUser.role == "patient") {
+        // 病人可以取消待处理的挂号
+        if (reg.status == "pending") actions << CancelAction;
+        actions << ViewAction;
+    }
+    else if (currentUser.role == "doctor") {
+        // 医生可以结算，结算在后台进行时不显示结算按钮，防止重复提交
+        if (reg.status == "pending" && !settlingRegistrations.count(reg.registrationId)) {
+            actions << SettleAction;
         }
+        actions << PatientInfoAction;
+    }
+    else {
+        actions << ViewAction;
     }
+    return actions;
 }
 
-// 医生挂号记录加载
-void MainWindow::loadDoctorRegistrations() {
-    std::vector<RegistrationInfo> registrations = systemManager->getRegistrationsByDoctor(currentUser.userId);
-    if (doctorRegTable) {
-        doctorRegTable->setRowCount(static_cast<int>(registrations.size()));
-
-        for (int i = 0; i < static_cast<int>(registrations.size()); ++i) {
-            const auto& reg = registrations[i];
-
-            // 状态显示
-            QString statusText;
-            QString statusStyle;
-            if (reg.status == "pending") {
-                statusText = "待处理";
-                statusStyle = "background-color: #f59e0b; color: white;";
-            }
-            else if (reg.status == "completed") {
-                statusText = "已完成";
-                statusStyle = "background-color: #10b981; color: white;";
+// 挂号表的操作按钮，reg为点击时该行的副本，对话框期间表格被更新也不受影响
+void MainWindow::onRegistrationAction(int action, RegistrationInfo reg) {
+    switch (action) {
+    case ViewAction: {
+        QString info;
+        if (currentUser.role == "admin") {
+            info = QString(
+                "挂号单详情：\n"
+                "单号：%1\n"
+                "日期：%2\n"
+                "病人：%3 (ID: %4)\n"
+                "医生：%5 (ID: %6)\n"
+                "科室：%7\n"
+                "状态：%8\n"
+                "费用：%9\n"
+                "账单状态：%10\n"
+                "备注：%11"
+            ).arg(
+                QString::number(reg.registrationId),
+                QString::fromStdString(reg.registrationDate),
+                QString::fromStdString(reg.patientName),
+                QString::number(reg.patientId),
+                QString::fromStdString(reg.doctorName),
+                QString::number(reg.doctorId),
+                QString::fromStdString(reg.doctorDepartment),
+                reg.status == "pending" ? "待处理" : (reg.status == "completed" ? "已完成" : "已取消"),
+                reg.hasBill ? QString("¥%1").arg(reg.billAmount, 0, 'f', 2) : "未结算",
+                reg.billStatus.empty() ? "无账单" : QString::fromStdString(reg.billStatus),
+                QString::fromStdString(reg.notes)
+            );
+        }
+        else {
+            info = QString(
+                "挂号单详情：\n"
+                "单号：%1\n"
+                "日期：%2\n"
+                "医生：%3\n"
+                "科室：%4\n"
+                "状态：%5\n"
+                "费用：%6\n"
+                "备注：%7"
+            ).arg(
+                QString::number(reg.registrationId),
+                QString::fromStdString(reg.registrationDate),
+                QString::fromStdString(reg.doctorName),
+                QString::fromStdString(reg.doctorDepartment),
+                reg.status == "pending" ? "待处理" : (reg.status == "completed" ? "已完成" : "已取消"),
+                reg.hasBill ? QString("¥%1").arg(reg.billAmount, 0, 'f', 2) : "待结算",
+                QString::fromStdString(reg.notes)
+            );
+        }
+        QMessageBox::information(this, "挂号详情", info);
+        break;
+    }
+    case CancelAction:
+        if (QMessageBox::question(this, "确认取消",
+            "确定要取消这个挂号吗？") == QMessageBox::Yes) {
+            if (systemManager->updateRegistrationStatus(reg.registrationId, "cancelled")) {
+                QMessageBox::information(this, "成功", "挂号已取消");
             }
             else {
-                statusText = "已取消";
-                statusStyle = "background-color: #ef4444; color: white;";
+                QMessageBox::critical(this, "失败",
+                    QString("取消失败：%1").arg(QString::fromStdString(systemManager->getLastError())));
             }
-
-            doctorRegTable->setItem(i, 0, new QTableWidgetItem(QString::number(reg.registrationId)));
-            doctorRegTable->setItem(i, 1, new QTableWidgetItem(QString::fromStdString(reg.registrationDate)));
-            doctorRegTable->setItem(i, 2, new QTableWidgetItem(QString::fromStdString(reg.patientName)));
-            doctorRegTable->setItem(i, 3, new QTableWidgetItem(QString("病人ID: %1").arg(reg.patientId)));
-            doctorRegTable->setItem(i, 4, new QTableWidgetItem(QString::fromStdString(reg.notes)));
-
-            QTableWidgetItem* statusItem = new QTableWidgetItem(statusText);
-            statusItem->setTextAlignment(Qt::AlignCenter);
-            doctorRegTable->setItem(i, 5, statusItem);
-
-            // 金额
-            QString amountText = reg.hasBill ?
-                QString("¥%1").arg(reg.billAmount, 0, 'f', 2) : "待结算";
-            doctorRegTable->setItem(i, 6, new QTableWidgetItem(amountText));
-
-            // 操作按钮 - 医生可以结算
-            QWidget* actionWidget = new QWidget();
-            QHBoxLayout* actionLayout = new QHBoxLayout(actionWidget);
-            actionLayout->setContentsMargins(5, 2, 5, 2);
-            actionLayout->setSpacing(5);
-
-            if (reg.status == "pending") {
-                QPushButton* settleButton = new QPushButton("结算");
-                settleButton->setFixedSize(60, 25);
-                settleButton->setStyleSheet(
-                    "QPushButton {"
-                    "  background-color: #27ae60;"
-                    "  color: white;"
-                    "  border: none;"
-                    "  border-radius: 3px;"
-                    "}"
-                    "QPushButton:hover {"
-                    "  background-color: #219653;"
-                    "}"
-                );
-
-                connect(settleButton, &QPushButton::clicked, [this, reg]() {
-                    bool ok;
-                    double amount = QInputDialog::getDouble(this, "结算",
-                        QString("请输入结算金额（挂号单号：%1）:").arg(reg.registrationId),
-                        50.0, 0.0, 10000.0, 2, &ok);
-
-                    if (ok) {
-                        int billId = systemManager->createBill(reg.registrationId, amount);
-                        if (billId > 0) {
-                            QMessageBox::information(this, "成功",
-                                QString("结算成功！结算单号：%1").arg(billId));
-                            loadRegistrations();
-                        }
-                        else {
-                            QMessageBox::critical(this, "失败",
-                                QString("结算失败：%1").arg(
-                                    QString::fromStdString(systemManager->getLastError())));
-                        }
-                    }
-                    });
-
-                actionLayout->addWidget(settleButton);
+        }
+        break;
+    case SettleAction: {
+        bool ok;
+        double amount = QInputDialog::getDouble(this, "结算",
+            QString("请输入结算金额（挂号单号：%1）:").arg(reg.registrationId),
+            50.0, 0.0, 10000.0, 2, &ok);
+        if (!ok) break;
+
+        // 结算在后台执行，期间隐藏该行的结算按钮
+        int regId = reg.registrationId;
+        settlingRegistrations.insert(regId);
+        registrationModel->refreshActions(regId);
+
+        systemManager->createBillAsync(regId, amount, this,
+            [this, regId](int billId, const std::string& error) {
+                settlingRegistrations.erase(regId);
+                registrationModel->refreshActions(regId);
+                if (billId > 0) {
+                    QMessageBox::information(this, "成功",
+                        QString("结算成功！结算单号：%1").arg(billId));
+                }
+                else {
+                    QMessageBox::critical(this, "失败",
+                        QString("结算失败：%1").arg(QString::fromStdString(error)));
+                }
+            });
+        break;
+    }
+    case PatientInfoAction: {
+        QString patientInfo = QString("病人：%1\n备注：%2")
+            .arg(QString::fromStdString(reg.patientName))
+            .arg(QString::fromStdString(reg.notes));
+        QMessageBox::information(this, "病人信息", patientInfo);
+        break;
+    }
+    case DeleteAction:
+        if (QMessageBox::question(this, "确认删除",
+            QString("确定要删除挂号单 %1 吗？\n病人：%2\n日期：%3")
+            .arg(reg.registrationId)
+            .arg(QString::fromStdString(reg.patientName))
+            .arg(QString::fromStdString(reg.registrationDate)),
+            QMessageBox::Yes | QMessageBox::No) == QMessageBox::Yes) {
+
+            // 删除挂号单（同时扣减daily_stats中的计数）
+            if (systemManager->deleteRegistration(reg.registrationId)) {
+                QMessageBox::information(this, "成功", "挂号单已删除！");
             }
-
-            // 查看病人信息按钮
-            QPushButton* viewPatientBtn = new QPushButton("病人信息");
-            viewPatientBtn->setFixedSize(80, 25);
-            viewPatientBtn->setStyleSheet(
-                "QPushButton {"
-                "  background-color: #3b82f6;"
-                "  color: white;"
-                "  border: none;"
-                "  border-radius: 3px;"
-                "}"
-                "QPushButton:hover {"
-                "  background-color: #2563eb;"
-                "}"
-            );
-
-            connect(viewPatientBtn, &QPushButton::clicked, [this, reg]() {
-                // 这里可以显示病人详细信息
-                QString patientInfo = QString("病人：%1\n备注：%2")
-                    .arg(QString::fromStdString(reg.patientName))
-                    .arg(QString::fromStdString(reg.notes));
-                QMessageBox::information(this, "病人信息", patientInfo);
-                });
-
-            actionLayout->addWidget(viewPatientBtn);
-            actionLayout->addStretch();
-
-            if (doctorRegTable->columnCount() > 7) {
-                doctorRegTable->setCellWidget(i, 7, actionWidget);
+            else {
+                QMessageBox::critical(this, "失败",
+                    QString("删除失败：%1").arg(
+                        QString::fromStdString(systemManager->getLastError())));
             }
         }
+        break;
+    default:
+        break;
     }
-    loadTodayRegistrations();
-    updateDoctorStats();
 }
 
-void MainWindow::setupDoctorRegistrationTab() {
+QWidget* MainWindow::setupDoctorRegistrationTab() {
     QWidget* doctorTab = new QWidget();
     QVBoxLayout* mainLayout = new QVBoxLayout(doctorTab);
     mainLayout->setSpacing(15);
@@ -1296,6 +1412,21 @@ void MainWindow::setupDoctorRegistrationTab() {
     todayTable->verticalHeader()->setVisible(false);
     todayTable->setMaximumHeight(200);
 
+    ActionButtonDelegate* queueDelegate = createActionDelegate(todayTable, currentUser.role);
+    queueDelegate->setActionHandler([this](int action, const QModelIndex& index) {
+        onTodayQueueAction(action, index.siblingAtColumn(0).data().toInt());
+    });
+    todayTable->setItemDelegateForColumn(5, queueDelegate);
+
+    QPushButton* callNextBtn = new QPushButton("📣 叫号");
+    callNextBtn->setFixedSize(100, 35);
+    connect(callNextBtn, &QPushButton::clicked, this, &MainWindow::onCallNextPatientClicked);
+
+    QHBoxLayout* queueToolbarLayout = new QHBoxLayout();
+    queueToolbarLayout->addWidget(callNextBtn);
+    queueToolbarLayout->addStretch();
+
+    todayLayout->addLayout(queueToolbarLayout);
     todayLayout->addWidget(todayTable);
 
     // ===== 所有病人挂号 =====
@@ -1321,15 +1452,17 @@ void MainWindow::setupDoctorRegistrationTab() {
     QPushButton* exportButton = new QPushButton("📥 导出");
     exportButton->setFixedSize(100, 35);
 
+    // 手动刷新时重新加载今日队列，以便看到其他客户端新增的挂号
     connect(doctorRefreshButton, &QPushButton::clicked, this, [this]() {
-        loadDoctorRegistrations();
-        loadTodayRegistrations();
-        updateDoctorStats();
+        refreshScheduler.request({ DoctorRegistrationsView, DoctorStatsView });
+        reloadTodayQueue();
         });
 
     connect(doctorFilterCombo, SIGNAL(currentIndexChanged(int)),
         this, SLOT(onDoctorFilterChanged()));
 
+    connect(exportButton, &QPushButton::clicked, this, &MainWindow::exportDoctorRegistrations);
+
     toolbarLayout->addWidget(doctorRefreshButton);
     toolbarLayout->addStretch();
     toolbarLayout->addWidget(filterLabel);
@@ -1338,16 +1471,11 @@ void MainWindow::setupDoctorRegistrationTab() {
     toolbarLayout->addWidget(exportButton);
 
     // 挂号表格
-    doctorRegTable = new QTableWidget();
-    doctorRegTable->setColumnCount(8);
-    doctorRegTable->setHorizontalHeaderLabels(
-        QStringList() << "单号" << "日期" << "病人" << "病人ID" << "症状" << "状态" << "费用" << "操作"
-    );
-    doctorRegTable->setAlternatingRowColors(true);
-    doctorRegTable->setSelectionBehavior(QAbstractItemView::SelectRows);
-    doctorRegTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
-    doctorRegTable->horizontalHeader()->setStretchLastSection(true);
-    doctorRegTable->verticalHeader()->setVisible(false);
+    using Column = RegistrationTableModel::Column;
+    doctorRegTable = createRegistrationView({
+        { Column::Id, "单号" }, { Column::Date, "日期" }, { Column::Patient, "病人" },
+        { Column::PatientId, "病人ID" }, { Column::Notes, "症状" }, { Column::Status, "状态" },
+        { Column::Amount, "费用" }, { Column::Actions, "操作" } });
 
     allRegLayout->addWidget(toolbar);
     allRegLayout->addWidget(doctorRegTable);
@@ -1416,140 +1544,155 @@ void MainWindow::setupDoctorRegistrationTab() {
 
     mainLayout->addWidget(statsWidget);
 
-    tabWidget->addTab(doctorTab, "👨‍⚕️ 医生工作台");
+    refreshScheduler.addView(DoctorRegistrationsView, doctorRegTable, [this]() { loadDoctorRegistrations(); });
+    refreshScheduler.addView(TodayQueueView, todayTable, [this]() { loadTodayRegistrations(); });
+    refreshScheduler.addView(DoctorStatsView, statsWidget, [this]() { updateDoctorStats(); }, &doctorStatsTask);
+    refreshScheduler.request({ DoctorRegistrationsView, TodayQueueView, DoctorStatsView });
+
+    return doctorTab;
 }
 // MainWindow.cpp - 添加新函数
 
-// 加载今日待处理挂号
+// 加载今日待处理挂号：从内存中的候诊队列渲染，不访问数据库
 void MainWindow::loadTodayRegistrations() {
     if (!todayTable) return;
 
-    // 获取今日日期
-    QDate today = QDate::currentDate();
-    std::string todayStr = today.toString("yyyy-MM-dd").toStdString();
-    using namespace std;
-    stringstream query;
-    query << "SELECT r.registration_id, r.registration_date, "
-        << "p.name as patient_name, r.notes, r.status "
-        << "FROM registrations r "
-        << "JOIN patients p ON r.patient_id = p.patient_id "
-        << "WHERE r.doctor_id = " << currentUser.userId
-        << " AND r.registration_date = '" << todayStr << "' "
-        << " AND r.status = 'pending' "
-        << "ORDER BY r.registration_id";
-
-    auto results = systemManager->dbManager->getQueryResult(query.str());
-
-    todayTable->setRowCount(static_cast<int>(results.size()));
-
-    for (size_t i = 0; i < static_cast<int>(results.size()); ++i) {
-        const auto& row = results[i];
-
-        todayTable->setItem(i, 0, new QTableWidgetItem(QString::fromStdString(row[0])));
-        todayTable->setItem(i, 1, new QTableWidgetItem(QString::fromStdString(row[1])));
-        todayTable->setItem(i, 2, new QTableWidgetItem(QString::fromStdString(row[2])));
-        todayTable->setItem(i, 3, new QTableWidgetItem(QString::fromStdString(row[3])));
-        todayTable->setItem(i, 4, new QTableWidgetItem(QString::fromUtf8("待处理")));
-        // 操作按钮
-        QWidget* actionWidget = new QWidget();
-        QHBoxLayout* actionLayout = new QHBoxLayout(actionWidget);
-        actionLayout->setContentsMargins(5, 2, 5, 2);
-        actionLayout->setSpacing(5);
-
-        QPushButton* handleBtn = new QPushButton("处理");
-        handleBtn->setFixedSize(60, 25);
-        handleBtn->setStyleSheet(
-            "QPushButton {"
-            "  background-color: #3b82f6;"
-            "  color: white;"
-            "  border: none;"
-            "  border-radius: 3px;"
-            "}"
-            "QPushButton:hover {"
-            "  background-color: #2563eb;"
-            "}"
-        );
+    std::vector<QueueEntry> entries;
+    if (!systemManager->getDoctorQueue(currentUser.userId, entries)) {
+        // 今日队列尚未加载（开始接诊或跨天），后台加载完成后再渲染
+        reloadTodayQueue();
+        return;
+    }
 
-        int regId = std::stoi(row[0]);
-        connect(handleBtn, &QPushButton::clicked, [this, regId]() {
-            onHandleRegistrationClicked(regId);
-            });
+    todayTable->setRowCount(static_cast<int>(entries.size()));
+
+    for (int i = 0; i < static_cast<int>(entries.size()); ++i) {
+        const QueueEntry& entry = entries[i];
 
-        actionLayout->addWidget(handleBtn);
-        actionLayout->addStretch();
+        QString state;
+        switch (entry.state) {
+        case QueueEntry::State::Called:  state = "就诊中"; break;
+        case QueueEntry::State::Skipped: state = "过号"; break;
+        default:                         state = "待处理"; break;
+        }
+        if (entry.priority > 0) {
+            state += "（优先）";
+        }
 
-        todayTable->setCellWidget(i, 5, actionWidget);
+        todayTable->setItem(i, 0, new QTableWidgetItem(QString::number(entry.registrationId)));
+        todayTable->setItem(i, 1, new QTableWidgetItem(QString::fromStdString(entry.registrationDate)));
+        todayTable->setItem(i, 2, new QTableWidgetItem(QString::fromStdString(entry.patientName)));
+        todayTable->setItem(i, 3, new QTableWidgetItem(QString::fromStdString(entry.notes)));
+        todayTable->setItem(i, 4, new QTableWidgetItem(state));
+        // 操作按钮由委托绘制
+        QVariantList actions;
+        if (entry.state == QueueEntry::State::Skipped) {
+            actions << RequeueAction;
+        }
+        else {
+            if (entry.state == QueueEntry::State::Called) {
+                actions << HandleAction;
+            }
+            else {
+                actions << (entry.priority > 0 ? ClearPriorityAction : PriorityAction);
+            }
+            actions << SkipAction;
+        }
+        QTableWidgetItem* actionItem = new QTableWidgetItem();
+        actionItem->setData(ActionButtonDelegate::ActionsRole, actions);
+        todayTable->setItem(i, 5, actionItem);
     }
 }
 
+// 今日队列的操作按钮
+void MainWindow::onTodayQueueAction(int action, int registrationId) {
+    int doctorId = currentUser.userId;
+    switch (action) {
+    case RequeueAction:
+        systemManager->requeuePatient(doctorId, registrationId);
+        break;
+    case HandleAction:
+        onHandleRegistrationClicked(registrationId);
+        return;
+    case PriorityAction:
+        systemManager->setPatientPriority(doctorId, registrationId, 1);
+        break;
+    case ClearPriorityAction:
+        systemManager->setPatientPriority(doctorId, registrationId, 0);
+        break;
+    case SkipAction:
+        systemManager->skipPatient(doctorId, registrationId);
+        break;
+    default:
+        return;
+    }
+    refreshScheduler.request(TodayQueueView);
+}
+
+// 从数据库重新加载今日候诊队列（开始接诊、手动刷新时），保留仍在队列中病人的叫号状态
+void MainWindow::reloadTodayQueue() {
+    int doctorId = currentUser.userId;
+    todayQueueTask.cancel();
+    todayQueueTask = systemManager->runAsync(this, [this, doctorId](const AsyncTask&) {
+        return systemManager->loadDoctorQueue(doctorId) ? std::string() : systemManager->getLastError();
+    }, [this](const std::string& error) {
+        if (!error.empty()) {
+            statusBar()->showMessage(QString::fromStdString(error), 5000);
+            return;
+        }
+        refreshScheduler.request(TodayQueueView);
+    });
+}
+
+// 叫号：队首病人进入就诊状态
+void MainWindow::onCallNextPatientClicked() {
+    std::optional<QueueEntry> next = systemManager->callNextPatient(currentUser.userId);
+    if (!next) {
+        QMessageBox::information(this, "叫号", "当前没有排队的病人");
+        return;
+    }
+
+    statusBar()->showMessage(QString("请 %1 号 %2 就诊")
+        .arg(next->registrationId)
+        .arg(QString::fromStdString(next->patientName)), 10000);
+    refreshScheduler.request(TodayQueueView);
+}
+
 // 更新医生统计数据
 void MainWindow::updateDoctorStats() {
     if (!todayCountLabel || !pendingCountLabel || !completedCountLabel || !totalCountLabel) return;
 
-    // 今日接诊数
-    QDate today = QDate::currentDate();
-    std::string todayStr = today.toString("yyyy-MM-dd").toStdString();
-
-    std::stringstream todayQuery;
-    todayQuery << "SELECT COUNT(*) FROM registrations "
-        << "WHERE doctor_id = " << currentUser.userId
-        << " AND registration_date = '" << todayStr << "' "
-        << " AND status = 'completed'";
-
-    auto todayResults = systemManager->dbManager->getQueryResult(todayQuery.str());
-    int todayCount = todayResults.empty() ? 0 : std::stoi(todayResults[0][0]);
-
-    // 待处理数
-    std::stringstream pendingQuery;
-    pendingQuery << "SELECT COUNT(*) FROM registrations "
-        << "WHERE doctor_id = " << currentUser.userId
-        << " AND status = 'pending'";
-
-    auto pendingResults = systemManager->dbManager->getQueryResult(pendingQuery.str());
-    int pendingCount = pendingResults.empty() ? 0 : std::stoi(pendingResults[0][0]);
-
-    // 已完成数
-    std::stringstream completedQuery;
-    completedQuery << "SELECT COUNT(*) FROM registrations "
-        << "WHERE doctor_id = " << currentUser.userId
-        << " AND status = 'completed'";
-
-    auto completedResults = systemManager->dbManager->getQueryResult(completedQuery.str());
-    int completedCount = completedResults.empty() ? 0 : std::stoi(completedResults[0][0]);
-
-    // 总数
-    std::stringstream totalQuery;
-    totalQuery << "SELECT COUNT(*) FROM registrations "
-        << "WHERE doctor_id = " << currentUser.userId;
-
-    auto totalResults = systemManager->dbManager->getQueryResult(totalQuery.str());
-    int totalCount = totalResults.empty() ? 0 : std::stoi(totalResults[0][0]);
-
-    // 更新标签
-    todayCountLabel->setText(QString("今日接诊: %1").arg(todayCount));
-    pendingCountLabel->setText(QString("待处理: %1").arg(pendingCount));
-    completedCountLabel->setText(QString("已完成: %1").arg(completedCount));
-    totalCountLabel->setText(QString("总计: %1").arg(totalCount));
+    // 全部计数由一条查询在后台得到
+    int doctorId = currentUser.userId;
+    doctorStatsTask.cancel();
+    doctorStatsTask = systemManager->runAsync(this, [this, doctorId](const AsyncTask&) {
+        return systemManager->getDashboardStats(DashboardScope::doctor(doctorId));
+    }, [this](const DashboardStats& stats) {
+        todayCountLabel->setText(QString("今日接诊: %1").arg(stats.todayCompleted));
+        pendingCountLabel->setText(QString("待处理: %1").arg(stats.pendingCount));
+        completedCountLabel->setText(QString("已完成: %1").arg(stats.completedCount));
+        totalCountLabel->setText(QString("总计: %1").arg(stats.totalCount));
+    });
 }
 
 void MainWindow::onFilterChanged() {
     QString status = filterCombo->currentData().toString();
     // 根据状态过滤挂号记录
     if (currentUser.role == "patient") {
-        loadPatientRegistrations();
+        refreshScheduler.request(PatientRegistrationsView);
     }
     else if (currentUser.role == "doctor") {
-        loadDoctorRegistrations();
+        refreshScheduler.request(DoctorRegistrationsView);
     }
     else if (currentUser.role == "admin") {
-        loadAdminRegistrations();
+        refreshScheduler.request(AdminRegistrationsView);
     }
 }
 
 void MainWindow::onDoctorFilterChanged() {
     QString status = doctorFilterCombo->currentData().toString();
     // 实现医生的过滤逻辑
-    loadDoctorRegistrations();
+    refreshScheduler.request(DoctorRegistrationsView);
 }
 // MainWindow.cpp - 添加新函数
 
@@ -1655,36 +1798,36 @@ void MainWindow::onHandleRegistrationClicked(int registrationId) {
 
         double amount = feeSpinBox->value();
 
-        // 1. 创建账单
-        int billId = systemManager->createBill(registrationId, amount);
-
-        if (billId > 0) {
-            // 2. 更新挂号单状态
-            std::stringstream query;
-            query << "UPDATE registrations SET status = 'completed' "
-                << "WHERE registration_id = " << registrationId;
-
-            if (systemManager->dbManager->executeQuery(query.str())) {
+        // 结算在后台执行，期间禁用保存按钮防止重复提交
+        saveBtn->setEnabled(false);
+        saveBtn->setText("正在结算...");
+
+        QDialog* dialogPtr = &dialog;
+        systemManager->runAsync(&dialog, [this, registrationId, amount](const AsyncTask&) {
+            // 建单并将挂号置为已完成（一次往返）
+            int billId = systemManager->createBill(registrationId, amount);
+            return std::make_pair(billId, billId > 0 ? std::string() : systemManager->getLastError());
+        }, [this, dialogPtr, saveBtn, diagnosisEdit, amount](const std::pair<int, std::string>& result) {
+            int billId = result.first;
+            if (billId > 0) {
                 // 3. 保存处方信息（这里可以扩展为专门的处方表）
                 std::string diagnosis = diagnosisEdit->toPlainText().toStdString();
                 // 可以保存到数据库或生成PDF处方单
 
-                QMessageBox::information(&dialog, "成功",
+                QMessageBox::information(dialogPtr, "成功",
                     QString("处方已保存！\n账单号: %1\n费用: ¥%2")
                     .arg(billId).arg(amount, 0, 'f', 2));
 
-                dialog.accept();
-
-                // 刷新数据
-                loadDoctorRegistrations();
-                loadTodayRegistrations();
-                updateDoctorStats();
+                // 挂号行、候诊队列和统计由结算事件更新
+                dialogPtr->accept();
             }
-        }
-        else {
-            QMessageBox::critical(&dialog, "错误",
-                QString("结算失败: %1").arg(QString::fromStdString(systemManager->getLastError())));
-        }
+            else {
+                saveBtn->setEnabled(true);
+                saveBtn->setText("保存处方并结算");
+                QMessageBox::critical(dialogPtr, "错误",
+                    QString("结算失败: %1").arg(QString::fromStdString(result.second)));
+            }
+        });
         });
 
     connect(cancelBtn, &QPushButton::clicked, &dialog, &QDialog::reject);
@@ -1694,22 +1837,31 @@ void MainWindow::onHandleRegistrationClicked(int registrationId) {
 // MainWindow.cpp - 实现管理员功能
 
 // 加载病人列表（管理员）
-void MainWindow::loadPatientsForAdmin() {
-    if (!adminPatientCombo) return;
-    
-    adminPatientCombo->clear();
-    adminPatientCombo->addItem("请选择病人", 0);
-    
-    std::string query = "SELECT patient_id, name FROM patients ORDER BY name";
-    auto results = systemManager->dbManager->getQueryResult(query);
-    
-    for (const auto& row : results) {
-        if (row.size() >= 2) {
-            int patientId = std::stoi(row[0]);
-            QString name = QString::fromStdString(row[1]);
-            adminPatientCombo->addItem(name, patientId);
-        }
+// 检索病人（管理员挂号表单）：输入停顿后在后台查询，只取前20条显示在补全列表中
+void MainWindow::searchPatientsForAdmin() {
+    std::string term = adminPatientEdit->text().trimmed().toStdString();
+    patientSearchTask.cancel();
+    if (term.empty()) {
+        patientSearchModel->clear();
+        return;
     }
+
+    patientSearchTask = systemManager->runAsync(this, [this, term](const AsyncTask&) {
+        return systemManager->searchPatients(term, 20);
+    }, [this](const std::vector<PatientSearchResult>& patients) {
+        patientSearchModel->clear();
+        for (const PatientSearchResult& patient : patients) {
+            QStandardItem* item = new QStandardItem(QString("%1 (%2) %3")
+                .arg(QString::fromStdString(patient.name))
+                .arg(patient.patientId)
+                .arg(QString::fromStdString(patient.phone)));
+            item->setData(patient.patientId, Qt::UserRole);
+            patientSearchModel->appendRow(item);
+        }
+        if (adminPatientEdit->hasFocus() && !patients.empty()) {
+            patientCompleter->complete();
+        }
+    });
 }
 
 // 加载医生列表（管理员）
@@ -1719,72 +1871,39 @@ void MainWindow::loadDoctorsForAdmin() {
     adminDoctorCombo->clear();
     adminDoctorCombo->addItem("请选择医生", 0);
     
-    std::string query = "SELECT doctor_id, name, department FROM doctors ORDER BY name";
-    auto results = systemManager->dbManager->getQueryResult(query);
-    
-    for (const auto& row : results) {
-        if (row.size() >= 3) {
-            int doctorId = std::stoi(row[0]);
-            QString name = QString::fromStdString(row[1]);
-            QString dept = QString::fromStdString(row[2]);
-            adminDoctorCombo->addItem(QString("%1 (%2)").arg(name).arg(dept), doctorId);
-        }
+    // 医生列表来自参考数据缓存
+    for (const auto& doctor : systemManager->getAllDoctors()) {
+        QString name = QString::fromStdString(doctor.name);
+        QString dept = QString::fromStdString(doctor.department);
+        adminDoctorCombo->addItem(QString("%1 (%2)").arg(name).arg(dept), doctor.doctorId);
     }
 }
 
 void MainWindow::updateAdminStats() {
-    // 今日挂号数 - 使用当前日期
-    QDate today = QDate::currentDate();
-    std::string todayStr = today.toString("yyyy-MM-dd").toStdString();
-
-    std::stringstream todayQuery;
-    todayQuery << "SELECT COUNT(*) FROM registrations "
-        << "WHERE registration_date = '" << todayStr << "'";
-
-    auto todayResults = systemManager->getDatabaseManager()->getQueryResult(todayQuery.str());
-    adminTodayCount = todayResults.empty() ? 0 : std::stoi(todayResults[0][0]);
-
-    // 总收入 - 修改查询逻辑
-    std::stringstream incomeQuery;
-    // 方法1：从bills表查询已支付账单的总金额
-    incomeQuery << "SELECT COALESCE(SUM(amount), 0) FROM bills WHERE status = 'paid'";
-    // 或者方法2：从registration_bills关联查询
-    // incomeQuery << "SELECT COALESCE(SUM(b.amount), 0) "
-    //             << "FROM bills b "
-    //             << "JOIN registration_bills rb ON b.bill_id = rb.bill_id "
-    //             << "WHERE b.status = 'paid'";
-
-    auto incomeResults = systemManager->getDatabaseManager()->getQueryResult(incomeQuery.str());
-    if (!incomeResults.empty() && !incomeResults[0][0].empty()) {
-        adminTotalIncome = std::stod(incomeResults[0][0]);
-    }
-    else {
-        adminTotalIncome = 0.0;
-    }
-
-    // 医生数
-    std::stringstream doctorQuery;
-    doctorQuery << "SELECT COUNT(*) FROM doctors";
-
-    auto doctorResults = systemManager->getDatabaseManager()->getQueryResult(doctorQuery.str());
-    adminDoctorCount = doctorResults.empty() ? 0 : std::stoi(doctorResults[0][0]);
-
-    // 病人数
-    std::stringstream patientQuery;
-    patientQuery << "SELECT COUNT(*) FROM patients";
-
-    auto patientResults = systemManager->getDatabaseManager()->getQueryResult(patientQuery.str());
-    adminPatientCount = patientResults.empty() ? 0 : std::stoi(patientResults[0][0]);
-
-    qDebug() << "统计更新 - 今日挂号:" << adminTodayCount
-        << "总收入:" << adminTotalIncome
-        << "医生数:" << adminDoctorCount
-        << "病人数:" << adminPatientCount;
+    // 全院统计一次查询得到，在后台线程执行，完成后再更新卡片
+    adminStatsTask.cancel();
+    adminStatsTask = systemManager->runAsync(this, [this](const AsyncTask&) {
+        return systemManager->getDashboardStats(DashboardScope::hospital());
+    }, [this](const DashboardStats& stats) {
+        adminTodayCount = stats.todayRegistrations;
+        adminTotalIncome = stats.totalIncome;
+        adminDoctorCount = stats.doctorCount;
+        adminPatientCount = stats.patientCount;
+
+        if (adminTodayValueLabel) adminTodayValueLabel->setText(QString::number(adminTodayCount));
+        if (adminDoctorValueLabel) adminDoctorValueLabel->setText(QString::number(adminDoctorCount));
+        if (adminPatientValueLabel) adminPatientValueLabel->setText(QString::number(adminPatientCount));
+
+        qDebug() << "统计更新 - 今日挂号:" << adminTodayCount
+            << "总收入:" << adminTotalIncome
+            << "医生数:" << adminDoctorCount
+            << "病人数:" << adminPatientCount;
+    });
 }
 // 管理员添加挂号
 void MainWindow::onAdminAddRegistrationClicked() {
     QString date = adminDateEdit->date().toString("yyyy-MM-dd");
-    int patientId = adminPatientCombo->currentData().toInt();
+    int patientId = adminSelectedPatientId;
     int doctorId = adminDoctorCombo->currentData().toInt();
     QString notes = adminNotesEdit->toPlainText();
     
@@ -1800,163 +1919,377 @@ void MainWindow::onAdminAddRegistrationClicked() {
         QMessageBox::information(this, "成功", 
             QString("挂号单添加成功！\n挂号单号：%1").arg(regId));
         
-        // 清空表单
+        // 清空表单；新挂号和统计由变更事件更新
         adminNotesEdit->clear();
-        
-        // 刷新数据
-        loadAdminRegistrations();
-        updateAdminStats();
     } else {
         QMessageBox::critical(this, "失败",
             QString("添加失败：%1").arg(QString::fromStdString(systemManager->getLastError())));
     }
 }
 
-// 修改loadAdminRegistrations函数，添加删除功能
+// 管理员挂号记录：筛选条件在数据库中执行，按页加载，滚动到表格底部时再取下一页
 void MainWindow::loadAdminRegistrations() {
     if (!adminRegTable) return;
-    
-    std::vector<RegistrationInfo> registrations = systemManager->getAllRegistrations();
-    adminRegTable->setRowCount(static_cast<int>(registrations.size()));
 
-    for (int i = 0; i < static_cast<int>(registrations.size()); ++i) {
-        const auto& reg = registrations[i];
+    adminFilter = RegistrationFilter();
+    adminFilter.startDate = startDateEdit->date().toString("yyyy-MM-dd").toStdString();
+    adminFilter.endDate = endDateEdit->date().toString("yyyy-MM-dd").toStdString();
+    adminFilter.department = deptFilterCombo->currentData().toString().toStdString();
+    adminFilter.doctorId = doctorFilterCombo->currentData().toInt();
+    adminFilter.status = statusFilterCombo->currentData().toString().toStdString();
+
+    // 查询在后台线程执行，重新加载时取消上一次尚未返回的查询（包括正在取的下一页）
+    adminRegistrationsTask.cancel();
+    adminRegTable->setEnabled(false);
+    statusBar()->showMessage("正在加载挂号记录...");
+
+    adminRegistrationsTask = systemManager->queryRegistrationsAsync(adminFilter, RegistrationCursor(),
+        kAdminPageSize, this,
+        [this](const std::vector<RegistrationInfo>& page, const std::string& error) {
+            adminRegTable->setEnabled(true);
+            if (!error.empty()) {
+                statusBar()->showMessage(
+                    QString("加载挂号记录失败：%1").arg(QString::fromStdString(error)), 5000);
+                return;
+            }
+
+            adminCursor = page.empty() ? RegistrationCursor() : RegistrationCursor::after(page.back());
+            registrationModel->setMoreAvailable(static_cast<int>(page.size()) == kAdminPageSize);
+            registrationModel->setRegistrations(page);
+            adminRegTable->scrollToTop();
+            statusBar()->showMessage(QString("已加载 %1 条挂号记录").arg(page.size()), 3000);
+        });
+}
+
+// 取下一页，由表格模型在视图滚动到底部时调用
+void MainWindow::loadMoreAdminRegistrations() {
+    adminRegistrationsTask = systemManager->queryRegistrationsAsync(adminFilter, adminCursor,
+        kAdminPageSize, this,
+        [this](const std::vector<RegistrationInfo>& page, const std::string& error) {
+            if (!error.empty()) {
+                statusBar()->showMessage(
+                    QString("加载挂号记录失败：%1").arg(QString::fromStdString(error)), 5000);
+                // 保留游标，再次滚动到底部时重试
+                registrationModel->setMoreAvailable(true);
+                return;
+            }
+
+            if (!page.empty()) {
+                adminCursor = RegistrationCursor::after(page.back());
+            }
+            registrationModel->appendRegistrations(page);
+            registrationModel->setMoreAvailable(static_cast<int>(page.size()) == kAdminPageSize);
+        });
+}
+
+void MainWindow::refreshAdminStats() {
+    // 更新统计数据
+    refreshScheduler.request(AdminStatsView);
+
+    // 这里可以添加更新UI显示的代码
+    // 比如在界面上显示一个"统计数据已更新"的消息
+    statusBar()->showMessage("正在刷新统计数据...", 3000);
+}
+
+// 写操作之后的增量更新：按挂号单号替换、插入或删除对应行，不再重新执行整表查询
+void MainWindow::onDataChanged(const std::vector<ChangeEvent>& events) {
+    bool registrationsChanged = false;
+    bool slotsChanged = false;
+    bool doctorsChanged = false;
+
+    for (const ChangeEvent& event : events) {
+        switch (event.type) {
+        case ChangeEvent::Type::RegistrationCreated:
+        case ChangeEvent::Type::RegistrationStatusChanged:
+        case ChangeEvent::Type::RegistrationDeleted:
+        case ChangeEvent::Type::BillCreated:
+            registrationsChanged = applyRegistrationChange(event) || registrationsChanged;
+            // 新挂号、取消、删除都会改变剩余号源
+            slotsChanged = slotsChanged || event.type != ChangeEvent::Type::BillCreated;
+            break;
+        case ChangeEvent::Type::DoctorCapacityChanged:
+            slotsChanged = true;
+            break;
+        case ChangeEvent::Type::DoctorAssigned:
+            doctorsChanged = true;
+            break;
+        case ChangeEvent::Type::UserUpdated:
+            doctorsChanged = doctorsChanged || event.role == "doctor";
+            break;
+        default:
+            break;
+        }
+    }
+
+    // 统计卡片和候诊队列由调度器合并，连续多批事件也只刷新一次；只登记了当前角色的视图
+    if (registrationsChanged) {
+        refreshScheduler.request({ TodayQueueView, DoctorStatsView, AdminStatsView });
+    }
+    if (slotsChanged) {
+        refreshScheduler.request(DoctorSlotsView);
+    }
+    if (doctorsChanged) {
+        refreshScheduler.request(DoctorsView);
+    }
+}
+
+// 挂号变更应用到当前角色的挂号表，返回表格是否有变化
+bool MainWindow::applyRegistrationChange(const ChangeEvent& event) {
+    if (!registrationModel) return false;
+
+    if (event.type == ChangeEvent::Type::RegistrationDeleted) {
+        return registrationModel->removeRegistration(event.registrationId);
+    }
+
+    const RegistrationInfo& reg = event.registration;
+    bool owned = true;
+    if (currentUser.role == "patient") {
+        owned = reg.patientId == currentUser.userId;
+    }
+    else if (currentUser.role == "doctor") {
+        owned = reg.doctorId == currentUser.userId;
+    }
+    if (reg.registrationId == 0 || !owned) return false;
+
+    if (currentUser.role == "admin" && !adminFilter.matches(reg)) {
+        // 不符合管理员筛选条件（如状态已改变）的挂号不在表中显示
+        return registrationModel->removeRegistration(reg.registrationId);
+    }
+
+    if (registrationModel->updateRegistration(reg)) return true;
+    return event.type == ChangeEvent::Type::RegistrationCreated && registrationModel->insertRegistration(reg);
+}
+
+// 系统日志：按SQL指纹展示查询统计，可导出JSON、调整慢查询阈值
+void MainWindow::showSystemLog() {
+    QueryStats& stats = systemManager->getDatabaseManager()->getQueryStats();
 
-        // 状态显示
-        QString statusText;
-        QString statusStyle;
-        if (reg.status == "pending") {
-            statusText = "待处理";
+    QDialog dialog(this);
+    dialog.setWindowTitle("系统日志 - SQL执行统计");
+    dialog.resize(1000, 600);
+    QVBoxLayout* layout = new QVBoxLayout(&dialog);
+
+    QHBoxLayout* toolbarLayout = new QHBoxLayout();
+    QSpinBox* thresholdSpin = new QSpinBox();
+    thresholdSpin->setRange(0, 60000);
+    thresholdSpin->setSuffix(" ms");
+    thresholdSpin->setValue(static_cast<int>(stats.getSlowQueryThreshold().count()));
+    QPushButton* refreshBtn = new QPushButton("刷新");
+    QPushButton* resetBtn = new QPushButton("清零统计");
+    QPushButton* exportBtn = new QPushButton("导出JSON");
+
+    toolbarLayout->addWidget(new QLabel("慢查询阈值:"));
+    toolbarLayout->addWidget(thresholdSpin);
+    toolbarLayout->addWidget(new QLabel(QString("慢查询日志: %1")
+        .arg(QString::fromStdString(stats.getSlowQueryLogPath()))));
+    toolbarLayout->addStretch();
+    toolbarLayout->addWidget(refreshBtn);
+    toolbarLayout->addWidget(resetBtn);
+    toolbarLayout->addWidget(exportBtn);
+
+    QTableWidget* statsTable = new QTableWidget();
+    statsTable->setColumnCount(10);
+    statsTable->setHorizontalHeaderLabels(QStringList() << "SQL指纹" << "调用次数" << "失败" << "行数"
+        << "字节数" << "平均(ms)" << "P50(ms)" << "P95(ms)" << "P99(ms)" << "最大(ms)");
+    statsTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    statsTable->setSelectionBehavior(QAbstractItemView::SelectRows);
+    statsTable->setAlternatingRowColors(true);
+    statsTable->verticalHeader()->setVisible(false);
+    statsTable->horizontalHeader()->setSectionResizeMode(0, QHeaderView::Stretch);
+
+    layout->addLayout(toolbarLayout);
+    layout->addWidget(statsTable);
+
+    auto refresh = [&stats, statsTable]() {
+        std::vector<QueryStatsSnapshot> snapshot = stats.snapshot();
+        statsTable->setRowCount(static_cast<int>(snapshot.size()));
+        for (int i = 0; i < static_cast<int>(snapshot.size()); ++i) {
+            const QueryStatsSnapshot& item = snapshot[i];
+            QTableWidgetItem* sqlItem = new QTableWidgetItem(QString::fromStdString(item.fingerprint));
+            sqlItem->setToolTip(QString::fromStdString(item.fingerprint));
+            statsTable->setItem(i, 0, sqlItem);
+            statsTable->setItem(i, 1, new QTableWidgetItem(QString::number(item.calls)));
+            statsTable->setItem(i, 2, new QTableWidgetItem(QString::number(item.errors)));
+            statsTable->setItem(i, 3, new QTableWidgetItem(QString::number(item.rows)));
+            statsTable->setItem(i, 4, new QTableWidgetItem(QString::number(item.bytes)));
+            statsTable->setItem(i, 5, new QTableWidgetItem(QString::number(item.avgMs, 'f', 2)));
+            statsTable->setItem(i, 6, new QTableWidgetItem(QString::number(item.p50Ms, 'f', 2)));
+            statsTable->setItem(i, 7, new QTableWidgetItem(QString::number(item.p95Ms, 'f', 2)));
+            statsTable->setItem(i, 8, new QTableWidgetItem(QString::number(item.p99Ms, 'f', 2)));
+            statsTable->setItem(i, 9, new QTableWidgetItem(QString::number(item.maxMs, 'f', 2)));
         }
-        else if (reg.status == "completed") {
-            statusText = "已完成";
+    };
+    refresh();
+
+    connect(thresholdSpin, QOverload<int>::of(&QSpinBox::valueChanged), &dialog, [&stats](int value) {
+        stats.setSlowQueryThreshold(std::chrono::milliseconds(value));
+    });
+    connect(refreshBtn, &QPushButton::clicked, &dialog, refresh);
+    connect(resetBtn, &QPushButton::clicked, &dialog, [&stats, refresh]() {
+        stats.reset();
+        refresh();
+    });
+    connect(exportBtn, &QPushButton::clicked, &dialog, [&dialog, &stats]() {
+        QString defaultName = QString("query_stats_%1.json")
+            .arg(QDateTime::currentDateTime().toString("yyyyMMdd_HHmmss"));
+        QString filePath = QFileDialog::getSaveFileName(&dialog, "导出查询统计", defaultName, "JSON文件 (*.json)");
+        if (filePath.isEmpty()) return;
+
+        if (stats.dumpJson(filePath.toStdString())) {
+            QMessageBox::information(&dialog, "导出成功", "查询统计已导出到：\n" + filePath);
         }
         else {
-            statusText = "已取消";
+            QMessageBox::critical(&dialog, "导出失败", "无法写入文件：" + filePath);
         }
+    });
 
-        adminRegTable->setItem(i, 0, new QTableWidgetItem(QString::number(reg.registrationId)));
-        adminRegTable->setItem(i, 1, new QTableWidgetItem(QString::fromStdString(reg.registrationDate)));
-        adminRegTable->setItem(i, 2, new QTableWidgetItem(QString::fromStdString(reg.patientName)));
-        adminRegTable->setItem(i, 3, new QTableWidgetItem(QString::fromStdString(reg.doctorName)));
-        adminRegTable->setItem(i, 4, new QTableWidgetItem(QString::fromStdString(reg.doctorDepartment)));
-        adminRegTable->setItem(i, 5, new QTableWidgetItem(statusText));
-
-        // 金额
-        QString amountText = reg.hasBill ?
-            QString("¥%1").arg(reg.billAmount, 0, 'f', 2) : "未结算";
-        adminRegTable->setItem(i, 6, new QTableWidgetItem(amountText));
-
-        // 账单状态
-        QString billStatus = reg.hasBill ? "已结算" : "未结算";
-        adminRegTable->setItem(i, 7, new QTableWidgetItem(billStatus));
-
-        // 操作按钮 - 查看详情
-        QWidget* actionWidget = new QWidget();
-        QHBoxLayout* actionLayout = new QHBoxLayout(actionWidget);
-        actionLayout->setContentsMargins(5, 2, 5, 2);
-        actionLayout->setSpacing(5);
-
-        QPushButton* viewBtn = new QPushButton("详情");
-        viewBtn->setFixedSize(60, 25);
-        viewBtn->setStyleSheet(
-            "QPushButton {"
-            "  background-color: #3b82f6;"
-            "  color: white;"
-            "  border: none;"
-            "  border-radius: 3px;"
-            "}"
-            "QPushButton:hover {"
-            "  background-color: #2563eb;"
-            "}"
-        );
-
-        connect(viewBtn, &QPushButton::clicked, [this, reg]() {
-            QString info = QString(
-                "挂号单详情：\n"
-                "单号：%1\n"
-                "日期：%2\n"
-                "病人：%3 (ID: %4)\n"
-                "医生：%5 (ID: %6)\n"
-                "科室：%7\n"
-                "状态：%8\n"
-                "费用：%9\n"
-                "账单状态：%10\n"
-                "备注：%11"
-            ).arg(
-                QString::number(reg.registrationId),
-                QString::fromStdString(reg.registrationDate),
-                QString::fromStdString(reg.patientName),
-                QString::number(reg.patientId),
-                QString::fromStdString(reg.doctorName),
-                QString::number(reg.doctorId),
-                QString::fromStdString(reg.doctorDepartment),
-                reg.status == "pending" ? "待处理" : (reg.status == "completed" ? "已完成" : "已取消"),
-                reg.hasBill ? QString("¥%1").arg(reg.billAmount, 0, 'f', 2) : "未结算",
-                reg.billStatus.empty() ? "无账单" : QString::fromStdString(reg.billStatus),
-                QString::fromStdString(reg.notes)
-            );
+    dialog.exec();
+}
 
-            QMessageBox::information(this, "挂号详情", info);
-        });
+// 科室报表：按日期范围汇总各科室挂号和收入，读取daily_stats
+void MainWindow::generateReport() {
+    QDialog dialog(this);
+    dialog.setWindowTitle("科室统计报表");
+    dialog.resize(900, 500);
+    QVBoxLayout* layout = new QVBoxLayout(&dialog);
 
-        actionLayout->addWidget(viewBtn);
-        actionLayout->addStretch();
+    QHBoxLayout* toolbarLayout = new QHBoxLayout();
+    QDate today = QDate::currentDate();
+    QDateEdit* startEdit = new QDateEdit(QDate(today.year(), today.month(), 1));
+    QDateEdit* endEdit = new QDateEdit(today);
+    startEdit->setCalendarPopup(true);
+    endEdit->setCalendarPopup(true);
+    startEdit->setDisplayFormat("yyyy-MM-dd");
+    endEdit->setDisplayFormat("yyyy-MM-dd");
+    QPushButton* queryBtn = new QPushButton("查询");
+
+    toolbarLayout->addWidget(new QLabel("开始日期:"));
+    toolbarLayout->addWidget(startEdit);
+    toolbarLayout->addWidget(new QLabel("结束日期:"));
+    toolbarLayout->addWidget(endEdit);
+    toolbarLayout->addStretch();
+    toolbarLayout->addWidget(queryBtn);
+
+    QTableWidget* reportTable = new QTableWidget();
+    reportTable->setColumnCount(7);
+    reportTable->setHorizontalHeaderLabels(QStringList() << "科室" << "挂号数" << "待处理"
+        << "已完成" << "已取消" << "账单金额" << "已收金额");
+    reportTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    reportTable->setSelectionBehavior(QAbstractItemView::SelectRows);
+    reportTable->setAlternatingRowColors(true);
+    reportTable->verticalHeader()->setVisible(false);
+    reportTable->horizontalHeader()->setSectionResizeMode(0, QHeaderView::Stretch);
+
+    layout->addLayout(toolbarLayout);
+    layout->addWidget(reportTable);
+
+    // 报表在后台线程查询，最后一行为合计
+    QDialog* dialogPtr = &dialog;
+    auto refresh = [this, dialogPtr, startEdit, endEdit, queryBtn, reportTable]() {
+        std::string startDate = startEdit->date().toString("yyyy-MM-dd").toStdString();
+        std::string endDate = endEdit->date().toString("yyyy-MM-dd").toStdString();
+        queryBtn->setEnabled(false);
+
+        systemManager->runAsync(dialogPtr, [this, startDate, endDate](const AsyncTask&) {
+            std::vector<DepartmentReportRow> rows = systemManager->getDepartmentReport(startDate, endDate);
+            return std::make_pair(rows, systemManager->getLastError());
+        }, [dialogPtr, queryBtn, reportTable](const std::pair<std::vector<DepartmentReportRow>, std::string>& result) {
+            queryBtn->setEnabled(true);
+            const std::vector<DepartmentReportRow>& rows = result.first;
+            if (rows.empty() && !result.second.empty()) {
+                QMessageBox::critical(dialogPtr, "错误", QString::fromStdString(result.second));
+                return;
+            }
 
-        adminRegTable->setCellWidget(i, 8, actionWidget);
-        
-        // 删除按钮
-        QPushButton* deleteBtn = new QPushButton("删除");
-        deleteBtn->setFixedSize(60, 25);
-        deleteBtn->setStyleSheet(
-            "QPushButton {"
-            "  background-color: #ef4444;"
-            "  color: white;"
-            "  border: none;"
-            "  border-radius: 3px;"
-            "}"
-            "QPushButton:hover {"
-            "  background-color: #dc2626;"
-            "}"
-        );
-        
-        int regId = reg.registrationId;
-        connect(deleteBtn, &QPushButton::clicked, [this, regId, reg]() {
-            if (QMessageBox::question(this, "确认删除",
-                QString("确定要删除挂号单 %1 吗？\n病人：%2\n日期：%3")
-                .arg(regId)
-                .arg(QString::fromStdString(reg.patientName))
-                .arg(QString::fromStdString(reg.registrationDate)),
-                QMessageBox::Yes | QMessageBox::No) == QMessageBox::Yes) {
-                
-                // 删除挂号单
-                std::stringstream query;
-                query << "DELETE FROM registrations WHERE registration_id = " << regId;
-                
-                if (systemManager->dbManager->executeQuery(query.str())) {
-                    QMessageBox::information(this, "成功", "挂号单已删除！");
-                    loadAdminRegistrations();
-                    updateAdminStats();
-                } else {
-                    QMessageBox::critical(this, "失败", 
-                        QString("删除失败：%1").arg(
-                            QString::fromStdString(systemManager->dbManager->getLastError())));
-                }
+            DepartmentReportRow total;
+            total.departmentName = "合计";
+            reportTable->setRowCount(static_cast<int>(rows.size()) + 1);
+            auto fillRow = [reportTable](int i, const DepartmentReportRow& row) {
+                reportTable->setItem(i, 0, new QTableWidgetItem(QString::fromStdString(row.departmentName)));
+                reportTable->setItem(i, 1, new QTableWidgetItem(QString::number(row.registrations)));
+                reportTable->setItem(i, 2, new QTableWidgetItem(QString::number(row.pendingCount)));
+                reportTable->setItem(i, 3, new QTableWidgetItem(QString::number(row.completedCount)));
+                reportTable->setItem(i, 4, new QTableWidgetItem(QString::number(row.cancelledCount)));
+                reportTable->setItem(i, 5, new QTableWidgetItem(QString::number(row.billedAmount, 'f', 2)));
+                reportTable->setItem(i, 6, new QTableWidgetItem(QString::number(row.paidAmount, 'f', 2)));
+            };
+            for (int i = 0; i < static_cast<int>(rows.size()); ++i) {
+                const DepartmentReportRow& row = rows[i];
+                fillRow(i, row);
+                total.registrations += row.registrations;
+                total.pendingCount += row.pendingCount;
+                total.completedCount += row.completedCount;
+                total.cancelledCount += row.cancelledCount;
+                total.billedAmount += row.billedAmount;
+                total.paidAmount += row.paidAmount;
             }
+            fillRow(static_cast<int>(rows.size()), total);
         });
-        
-        adminRegTable->setCellWidget(i, 9, deleteBtn);
-    }
+    };
+    refresh();
+
+    connect(queryBtn, &QPushButton::clicked, &dialog, refresh);
+
+    dialog.exec();
 }
-void MainWindow::refreshAdminStats() {
-    // 更新统计数据
-    updateAdminStats();
 
-    // 这里可以添加更新UI显示的代码
-    // 比如在界面上显示一个"统计数据已更新"的消息
-    statusBar()->showMessage("统计数据已更新", 3000);
+// 导出全部挂号记录（管理员），逐行写入文件
+void MainWindow::exportRegistrations() {
+    QString defaultName = QString("挂号记录_%1.csv").arg(QDate::currentDate().toString("yyyyMMdd"));
+    QString filePath = QFileDialog::getSaveFileName(this, "导出挂号记录", defaultName, "CSV文件 (*.csv)");
+    if (filePath.isEmpty()) return;
+
+    startRegistrationExport(filePath, 0);
+}
+
+// 导出当前医生的挂号记录
+void MainWindow::exportDoctorRegistrations() {
+    QString defaultName = QString("%1_挂号记录_%2.csv")
+        .arg(QString::fromStdString(currentUser.name), QDate::currentDate().toString("yyyyMMdd"));
+    QString filePath = QFileDialog::getSaveFileName(this, "导出挂号记录", defaultName, "CSV文件 (*.csv)");
+    if (filePath.isEmpty()) return;
 
-    qDebug() << "统计数据已刷新 - 总收入:" << adminTotalIncome;
+    startRegistrationExport(filePath, currentUser.userId);
+}
+
+// 导出可能有几十万行，在后台逐行写入；进度框显示已写入的行数，取消时停止导出并删除未写完的文件
+void MainWindow::startRegistrationExport(const QString& filePath, int doctorId) {
+    QPointer<QProgressDialog> progress = new QProgressDialog("正在导出挂号记录...", "取消", 0, 0, this);
+    progress->setWindowTitle("导出挂号记录");
+    progress->setWindowModality(Qt::WindowModal);
+    progress->setMinimumDuration(0);
+
+    exportTask = systemManager->runAsync(this,
+        [this, path = filePath.toStdString(), doctorId, progress](const AsyncTask& task) {
+            int count = systemManager->exportRegistrationsCsv(path, doctorId, [&task, progress](int rows) {
+                QMetaObject::invokeMethod(QCoreApplication::instance(), [progress, rows]() {
+                    if (progress) {
+                        progress->setLabelText(QString("正在导出挂号记录，已写入 %1 条...").arg(rows));
+                    }
+                }, Qt::QueuedConnection);
+                return !task.isCancelled();
+            });
+            return std::make_pair(count, count >= 0 ? std::string() : systemManager->getLastError());
+        },
+        [this, progress](const std::pair<int, std::string>& result) {
+            if (progress) {
+                progress->deleteLater();
+            }
+            if (result.first < 0) {
+                QMessageBox::critical(this, "导出失败", QString::fromStdString(result.second));
+                return;
+            }
+            statusBar()->showMessage(QString("已导出 %1 条挂号记录").arg(result.first), 5000);
+        });
+
+    connect(progress, &QProgressDialog::canceled, this, [this, progress]() {
+        exportTask.cancel();
+        if (progress) {
+            progress->deleteLater();
+        }
+        statusBar()->showMessage("已取消导出", 5000);
+    });
+    progress->show();
 }
 // MainWindow.cpp - 添加以下函数实现
 
@@ -2,6 +2,7 @@
 #include <QMainWindow>
 #include <QTabWidget>
 #include <QTableWidget>
+#include <QTableView>
 #include <QPushButton>
 #include <QLabel>
 #include <QDateEdit>
@@ -15,8 +16,16 @@
 #include <QStatusBar>
 #include <QSpinBox>
 #include <QLineEdit>
+#include <QCompleter>
+#include <QStandardItemModel>
+#include <QTimer>
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
 #include "SystemManager.h"
 #include "CommonTypes.h"
+#include "RegistrationTableModel.h"
+#include "RefreshScheduler.h"
 
 class MainWindow : public QMainWindow {
     Q_OBJECT
@@ -42,9 +51,11 @@ private slots:
     void onDoctorFilterChanged();
     void onAdminAddRegistrationClicked();
     void refreshAdminStats();
+protected:
+    void showEvent(QShowEvent* event) override;
 private:
     void initializeTestDoctors();
-    // 系统管理器
+    // 系统管理器（应用程序持有，退出登录后继续使用）
     SystemManager* systemManager;
     UserInfo currentUser;
 
@@ -52,29 +63,29 @@ private:
     QTabWidget* tabWidget;
 
     // 首页标签页
-    QWidget* homeTab;
-    QLabel* welcomeLabel;
+    QWidget* homeTab = nullptr;
+    QLabel* welcomeLabel = nullptr;
 
     // 挂号管理标签页 - 根据角色不同显示不同界面
     QWidget* registrationTab;
 
     // 病人挂号相关组件
-    QDateEdit* dateEdit;
+    QDateEdit* dateEdit = nullptr;
     QComboBox* departmentCombo;
-    QComboBox* doctorCombo;
+    QComboBox* doctorCombo = nullptr;
     QTextEdit* notesEdit;
     QPushButton* submitButton;
 
     // 通用组件
-    QTableWidget* regTable;
+    QTableView* regTable = nullptr;
     QPushButton* refreshButton;
     QComboBox* filterCombo;
 
     // 医生工作台组件
-    QTableWidget* doctorRegTable;
+    QTableView* doctorRegTable = nullptr;
     QPushButton* doctorRefreshButton;
-    QTableWidget* todayTable;
-    QWidget* statsWidget;
+    QTableWidget* todayTable = nullptr;
+    QWidget* statsWidget = nullptr;
     QHBoxLayout* statsLayout;
     QLabel* todayCountLabel;
     QLabel* pendingCountLabel;
@@ -105,25 +116,29 @@ private:
 
     // 医生列表标签页
     QWidget* doctorsTab;
-    QTableWidget* doctorsTable;
+    QTableWidget* doctorsTable = nullptr;
 
     // 科室管理标签页
     QWidget* departmentTab;
-    QTableWidget* departmentTable;
+    QTableWidget* departmentTable = nullptr;
     QPushButton* addDepartmentButton;
     QPushButton* editDepartmentButton;
     QPushButton* deleteDepartmentButton;
     QPushButton* refreshDepartmentButton;
-    QComboBox* assignDoctorCombo;
-    QComboBox* assignDepartmentCombo;
+    QComboBox* assignDoctorCombo = nullptr;
+    QComboBox* assignDepartmentCombo = nullptr;
     QPushButton* assignButton;
 
     // 管理员界面组件
     QDateEdit* adminDateEdit;
-    QComboBox* adminPatientCombo;
+    QLineEdit* adminPatientEdit;            // 输入后在后台检索病人，从补全列表中选择
+    int adminSelectedPatientId = 0;
+    QCompleter* patientCompleter;
+    QStandardItemModel* patientSearchModel;
+    QTimer* patientSearchTimer;             // 输入停顿后才发起检索
     QComboBox* adminDoctorCombo;
     QTextEdit* adminNotesEdit;
-    QTableWidget* adminRegTable;
+    QTableView* adminRegTable = nullptr;
     QDateEdit* startDateEdit;          // 添加
     QDateEdit* endDateEdit;            // 添加
     QComboBox* deptFilterCombo;        // 添加
@@ -137,38 +152,81 @@ private:
     QPushButton* reportBtn;            // 添加
     QPushButton* systemLogBtn;         // 添加
 
-    int adminTodayCount;
-    double adminTotalIncome;
-    int adminDoctorCount;
-    int adminPatientCount;
+    int adminTodayCount = 0;
+    double adminTotalIncome = 0.0;
+    int adminDoctorCount = 0;
+    int adminPatientCount = 0;
+    QLabel* adminTodayValueLabel = nullptr;
+    QLabel* adminDoctorValueLabel = nullptr;
+    QLabel* adminPatientValueLabel = nullptr;
+
+    // 当前角色的挂号表数据，三种界面只会创建其中一个表格
+    RegistrationTableModel* registrationModel = nullptr;
+    std::unordered_set<int> settlingRegistrations;     // 正在后台结算的挂号，期间不显示结算按钮
+    // 管理员挂号表当前的筛选条件和下一页的游标
+    RegistrationFilter adminFilter;
+    RegistrationCursor adminCursor;
+
+    // 后台加载任务（重新加载时取消上一次未完成的任务）
+    AsyncTask adminRegistrationsTask;
+    AsyncTask adminStatsTask;
+    AsyncTask doctorStatsTask;
+    AsyncTask todayQueueTask;
+    AsyncTask doctorSlotsTask;
+    AsyncTask patientSearchTask;
+    AsyncTask exportTask;
+
+    // 视图刷新统一经过调度器，同一轮事件中的多次请求合并，不可见的页面切换回来再刷新
+    RefreshScheduler refreshScheduler;
+
+    // 尚未创建内容的标签页（占位页面 -> 创建函数）
+    std::unordered_map<QWidget*, std::function<QWidget*()>> tabBuilders;
+    bool tabsPrefetchStarted = false;
 
     // 初始化函数
     void setupUI();
-    void setupHomeTab();
+    QWidget* setupHomeTab();
     void setupRegistrationTab();
-    void setupProfileTab();
-    void setupDoctorsTab();
-    void setupDepartmentTab();
+    QWidget* setupProfileTab();
+    QWidget* setupDoctorsTab();
+    QWidget* setupDepartmentTab();
     void applyStyles();
 
+    // 标签页在第一次显示时才创建内容，首次显示窗口后其余标签页在空闲时依次创建
+    void addLazyTab(const QString& title, std::function<QWidget*()> build);
+    void buildTab(int index);
+    void prefetchTabs();
+
     // 管理员相关函数
-    void loadPatientsForAdmin();
+    void searchPatientsForAdmin();
     void loadDoctorsForAdmin();
     void updateAdminStats();
     void onAdminDeleteRegistrationClicked(int registrationId);
 
     // 根据角色设置不同的挂号管理界面
-    void setupPatientRegistrationTab();
-    void setupDoctorRegistrationTab();
-    void setupAdminRegistrationTab();
+    QWidget* setupPatientRegistrationTab();
+    QWidget* setupDoctorRegistrationTab();
+    QWidget* setupAdminRegistrationTab();
 
     // 根据角色加载不同的挂号数据
     void loadPatientRegistrations();
     void loadDoctorRegistrations();
     void loadAdminRegistrations();
+    void loadMoreAdminRegistrations();
+    QTableView* createRegistrationView(std::vector<RegistrationTableModel::ColumnSpec> columns);
+    QVariantList registrationActions(const RegistrationInfo& reg, RegistrationTableModel::Column column) const;
+    void onRegistrationAction(int action, RegistrationInfo reg);
+
+    // 变更事件：只更新受影响的挂号行，再刷新一次统计
+    void onDataChanged(const std::vector<ChangeEvent>& events);
+    bool applyRegistrationChange(const ChangeEvent& event);
 
     // 医生工作台相关函数
     void loadTodayRegistrations();
+    void reloadTodayQueue();
+    void refreshDoctorSlots();
+    void onCallNextPatientClicked();
+    void onTodayQueueAction(int action, int registrationId);
     void updateDoctorStats();
 
     // 过滤函数
@@ -204,6 +262,8 @@ private:
     // 导出数据函数
     void exportRegistrations();
     void exportDoctorRegistrations();
+    // 在后台导出到filePath，显示可取消的进度框
+    void startRegistrationExport(const QString& filePath, int doctorId);
 
     // 系统管理函数
     void backupDatabase();
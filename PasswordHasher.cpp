@@ -0,0 +1,359 @@
+﻿#include "PasswordHasher.h"
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace {
+    std::atomic<unsigned int> currentIterations{ 100000 };
+
+    constexpr const char* kPrefix = "pbkdf2_sha256";
+    constexpr std::size_t kSaltBytes = 16;
+
+    std::uint32_t rotr(std::uint32_t x, int n) { return (x >> n) | (x << (32 - n)); }
+    std::uint32_t rotl(std::uint32_t x, int n) { return (x << n) | (x >> (32 - n)); }
+
+    // SHA-256（FIPS 180-4）
+    class Sha256 {
+    public:
+        static constexpr std::size_t kBlockSize = 64;
+        using Digest = std::array<unsigned char, 32>;
+
+        void update(const unsigned char* data, std::size_t size) {
+            totalBytes += size;
+            while (size > 0) {
+                std::size_t n = std::min(size, kBlockSize - bufferSize);
+                std::memcpy(buffer + bufferSize, data, n);
+                bufferSize += n;
+                data += n;
+                size -= n;
+                if (bufferSize == kBlockSize) {
+                    compress(buffer);
+                    bufferSize = 0;
+                }
+            }
+        }
+
+        Digest finish() {
+            std::uint64_t bits = totalBytes * 8;
+            unsigned char pad[kBlockSize * 2] = { 0x80 };
+            std::size_t padSize = (bufferSize < 56 ? 56 : 120) - bufferSize;
+            for (int i = 0; i < 8; ++i) {
+                pad[padSize + i] = static_cast<unsigned char>(bits >> (56 - 8 * i));
+            }
+            update(pad, padSize + 8);
+
+            Digest digest;
+            for (int i = 0; i < 8; ++i) {
+                for (int j = 0; j < 4; ++j) {
+                    digest[i * 4 + j] = static_cast<unsigned char>(state[i] >> (24 - 8 * j));
+                }
+            }
+            return digest;
+        }
+
+    private:
+        void compress(const unsigned char* block) {
+            static const std::uint32_t k[64] = {
+                0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+                0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+                0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+                0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+                0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+                0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+                0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+                0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+            };
+
+            std::uint32_t w[64];
+            for (int i = 0; i < 16; ++i) {
+                w[i] = (std::uint32_t(block[i * 4]) << 24) | (std::uint32_t(block[i * 4 + 1]) << 16)
+                    | (std::uint32_t(block[i * 4 + 2]) << 8) | std::uint32_t(block[i * 4 + 3]);
+            }
+            for (int i = 16; i < 64; ++i) {
+                std::uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+                std::uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+                w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+            }
+
+            std::uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+            std::uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+            for (int i = 0; i < 64; ++i) {
+                std::uint32_t s1 = rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25);
+                std::uint32_t ch = (e & f) ^ (~e & g);
+                std::uint32_t t1 = h + s1 + ch + k[i] + w[i];
+                std::uint32_t s0 = rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22);
+                std::uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+                std::uint32_t t2 = s0 + maj;
+                h = g; g = f; f = e; e = d + t1;
+                d = c; c = b; b = a; a = t1 + t2;
+            }
+            state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+            state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+        }
+
+        std::uint32_t state[8] = {
+            0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+        };
+        unsigned char buffer[kBlockSize] = {};
+        std::size_t bufferSize = 0;
+        std::uint64_t totalBytes = 0;
+    };
+
+    // HMAC-SHA256：内外两层的初始状态只计算一次，PBKDF2每轮迭代直接复制
+    class HmacSha256 {
+    public:
+        explicit HmacSha256(const std::string& key) {
+            unsigned char block[Sha256::kBlockSize] = {};
+            if (key.size() > Sha256::kBlockSize) {
+                Sha256 keyHash;
+                keyHash.update(reinterpret_cast<const unsigned char*>(key.data()), key.size());
+                Sha256::Digest digest = keyHash.finish();
+                std::memcpy(block, digest.data(), digest.size());
+            }
+            else {
+                std::memcpy(block, key.data(), key.size());
+            }
+
+            unsigned char pad[Sha256::kBlockSize];
+            for (std::size_t i = 0; i < Sha256::kBlockSize; ++i) pad[i] = block[i] ^ 0x36;
+            inner.update(pad, sizeof(pad));
+            for (std::size_t i = 0; i < Sha256::kBlockSize; ++i) pad[i] = block[i] ^ 0x5c;
+            outer.update(pad, sizeof(pad));
+        }
+
+        Sha256::Digest compute(const unsigned char* data, std::size_t size) const {
+            Sha256 in = inner;
+            in.update(data, size);
+            Sha256::Digest innerDigest = in.finish();
+            Sha256 out = outer;
+            out.update(innerDigest.data(), innerDigest.size());
+            return out.finish();
+        }
+
+    private:
+        Sha256 inner;
+        Sha256 outer;
+    };
+
+    std::string toHex(const unsigned char* data, std::size_t size) {
+        static const char digits[] = "0123456789abcdef";
+        std::string hex;
+        hex.reserve(size * 2);
+        for (std::size_t i = 0; i < size; ++i) {
+            hex.push_back(digits[data[i] >> 4]);
+            hex.push_back(digits[data[i] & 0x0f]);
+        }
+        return hex;
+    }
+
+    bool fromHex(const std::string& hex, std::string& out) {
+        if (hex.size() % 2 != 0) {
+            return false;
+        }
+        auto value = [](char c) -> int {
+            if (c >= '0' && c <= '9') return c - '0';
+            if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+            if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+            return -1;
+        };
+        out.clear();
+        for (std::size_t i = 0; i < hex.size(); i += 2) {
+            int high = value(hex[i]);
+            int low = value(hex[i + 1]);
+            if (high < 0 || low < 0) {
+                return false;
+            }
+            out.push_back(static_cast<char>(high * 16 + low));
+        }
+        return true;
+    }
+
+    bool isHex(const std::string& text) {
+        std::string ignored;
+        return fromHex(text, ignored);
+    }
+
+    // 比较耗时与内容无关，避免通过响应时间推测哈希
+    bool constantTimeEquals(const std::string& a, const std::string& b) {
+        if (a.size() != b.size()) {
+            return false;
+        }
+        unsigned char diff = 0;
+        for (std::size_t i = 0; i < a.size(); ++i) {
+            diff |= static_cast<unsigned char>(a[i] ^ b[i]);
+        }
+        return diff == 0;
+    }
+
+    std::string lowercase(std::string text) {
+        for (char& c : text) {
+            if (c >= 'A' && c <= 'F') c = static_cast<char>(c - 'A' + 'a');
+        }
+        return text;
+    }
+}
+
+void PasswordHasher::setIterations(unsigned int iterations) {
+    currentIterations = iterations > 0 ? iterations : 1;
+}
+
+unsigned int PasswordHasher::getIterations() {
+    return currentIterations.load();
+}
+
+std::string PasswordHasher::hash(const std::string& password) {
+    std::random_device random;
+    std::string salt(kSaltBytes, '\0');
+    for (char& c : salt) {
+        c = static_cast<char>(random() & 0xff);
+    }
+
+    unsigned int iterations = getIterations();
+    return std::string(kPrefix) + "$" + std::to_string(iterations) + "$"
+        + toHex(reinterpret_cast<const unsigned char*>(salt.data()), salt.size()) + "$"
+        + pbkdf2Sha256Hex(password, salt, iterations);
+}
+
+bool PasswordHasher::verify(const std::string& password, const std::string& stored, bool* needsRehash) {
+    if (needsRehash) {
+        *needsRehash = false;
+    }
+
+    // 旧格式：MySQL MD5()生成的32位十六进制
+    if (stored.size() == 32 && isHex(stored)) {
+        bool ok = constantTimeEquals(md5Hex(password), lowercase(stored));
+        if (ok && needsRehash) {
+            *needsRehash = true;
+        }
+        return ok;
+    }
+
+    // pbkdf2_sha256$迭代次数$盐$摘要
+    std::size_t first = stored.find('$');
+    std::size_t second = first == std::string::npos ? first : stored.find('$', first + 1);
+    std::size_t third = second == std::string::npos ? second : stored.find('$', second + 1);
+    if (third == std::string::npos || stored.compare(0, first, kPrefix) != 0) {
+        return false;
+    }
+
+    unsigned long iterations = 0;
+    try {
+        iterations = std::stoul(stored.substr(first + 1, second - first - 1));
+    }
+    catch (const std::exception&) {
+        return false;
+    }
+
+    std::string salt;
+    std::string expected = stored.substr(third + 1);
+    if (iterations == 0 || !fromHex(stored.substr(second + 1, third - second - 1), salt)
+        || expected.empty() || expected.size() % 2 != 0) {
+        return false;
+    }
+
+    bool ok = constantTimeEquals(
+        pbkdf2Sha256Hex(password, salt, static_cast<unsigned int>(iterations), expected.size() / 2),
+        lowercase(expected));
+    if (ok && needsRehash) {
+        *needsRehash = iterations < getIterations();
+    }
+    return ok;
+}
+
+std::string PasswordHasher::pbkdf2Sha256Hex(const std::string& password, const std::string& salt,
+    unsigned int iterations, std::size_t length) {
+
+    // RFC 8018：T_i = U_1 ^ U_2 ^ ... ^ U_c，U_1 = HMAC(P, S || INT(i))，U_j = HMAC(P, U_{j-1})
+    HmacSha256 hmac(password);
+    std::vector<unsigned char> derived;
+    derived.reserve(length);
+
+    for (std::uint32_t blockIndex = 1; derived.size() < length; ++blockIndex) {
+        std::vector<unsigned char> message(salt.begin(), salt.end());
+        for (int i = 3; i >= 0; --i) {
+            message.push_back(static_cast<unsigned char>(blockIndex >> (8 * i)));
+        }
+
+        Sha256::Digest u = hmac.compute(message.data(), message.size());
+        Sha256::Digest t = u;
+        for (unsigned int j = 1; j < iterations; ++j) {
+            u = hmac.compute(u.data(), u.size());
+            for (std::size_t k = 0; k < t.size(); ++k) {
+                t[k] ^= u[k];
+            }
+        }
+
+        std::size_t take = std::min(t.size(), length - derived.size());
+        derived.insert(derived.end(), t.begin(), t.begin() + take);
+    }
+
+    return toHex(derived.data(), derived.size());
+}
+
+std::string PasswordHasher::md5Hex(const std::string& data) {
+    // MD5（RFC 1321），仅用于校验旧格式的口令哈希
+    static const std::uint32_t k[64] = {
+        0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+        0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+        0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+        0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+        0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+        0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+        0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+        0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391
+    };
+    static const int shifts[64] = {
+        7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+        5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20,
+        4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+        6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21
+    };
+
+    std::vector<unsigned char> message(data.begin(), data.end());
+    std::uint64_t bits = static_cast<std::uint64_t>(data.size()) * 8;
+    message.push_back(0x80);
+    while (message.size() % 64 != 56) {
+        message.push_back(0);
+    }
+    for (int i = 0; i < 8; ++i) {
+        message.push_back(static_cast<unsigned char>(bits >> (8 * i)));
+    }
+
+    std::uint32_t state[4] = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476 };
+    for (std::size_t offset = 0; offset < message.size(); offset += 64) {
+        std::uint32_t m[16];
+        for (int i = 0; i < 16; ++i) {
+            const unsigned char* p = &message[offset + i * 4];
+            m[i] = std::uint32_t(p[0]) | (std::uint32_t(p[1]) << 8) | (std::uint32_t(p[2]) << 16)
+                | (std::uint32_t(p[3]) << 24);
+        }
+
+        std::uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        for (int i = 0; i < 64; ++i) {
+            std::uint32_t f;
+            int g;
+            if (i < 16) { f = (b & c) | (~b & d); g = i; }
+            else if (i < 32) { f = (d & b) | (~d & c); g = (5 * i + 1) % 16; }
+            else if (i < 48) { f = b ^ c ^ d; g = (3 * i + 5) % 16; }
+            else { f = c ^ (b | ~d); g = (7 * i) % 16; }
+
+            std::uint32_t next = d;
+            d = c;
+            c = b;
+            b = b + rotl(a + f + k[i] + m[g], shifts[i]);
+            a = next;
+        }
+        state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+    }
+
+    unsigned char digest[16];
+    for (int i = 0; i < 4; ++i) {
+        for (int j = 0; j < 4; ++j) {
+            digest[i * 4 + j] = static_cast<unsigned char>(state[i] >> (8 * j));
+        }
+    }
+    return toHex(digest, sizeof(digest));
+}
@@ -0,0 +1,22 @@
+﻿#pragma once
+#include <string>
+
+// 客户端口令哈希：PBKDF2-HMAC-SHA256，每个口令随机盐
+// 存储格式：pbkdf2_sha256$迭代次数$盐(hex)$摘要(hex)
+// 兼容旧数据：32位十六进制视为MD5(口令)，验证通过后应升级为新格式
+class PasswordHasher {
+public:
+    // 迭代次数可调，越大越慢；已有哈希按其自身记录的次数验证
+    static void setIterations(unsigned int iterations);
+    static unsigned int getIterations();
+
+    static std::string hash(const std::string& password);
+
+    // 验证口令；needsRehash在旧格式或迭代次数低于当前设置时置为true
+    static bool verify(const std::string& password, const std::string& stored, bool* needsRehash = nullptr);
+
+    // 工具函数
+    static std::string md5Hex(const std::string& data);
+    static std::string pbkdf2Sha256Hex(const std::string& password, const std::string& salt,
+        unsigned int iterations, std::size_t length = 32);
+};
@@ -0,0 +1,61 @@
+﻿#include "PerThreadState.h"
+#include <algorithm>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+    // 仍存活的对象；线程退出时只回调其中的对象（对象可能先于线程销毁）
+    std::mutex& registryMutex() {
+        static std::mutex mutex;
+        return mutex;
+    }
+
+    std::unordered_set<PerThreadStateBase*>& liveObjects() {
+        static std::unordered_set<PerThreadStateBase*> objects;
+        return objects;
+    }
+}
+
+// 每个线程记录自己在哪些对象中创建过状态，线程退出时逐个删除
+struct PerThreadStateTracker {
+    std::vector<PerThreadStateBase*> objects;
+
+    ~PerThreadStateTracker() {
+        std::thread::id id = std::this_thread::get_id();
+        // 持有注册表锁回调，对象的析构（untrack）会等回调结束
+        std::lock_guard<std::mutex> lock(registryMutex());
+        for (PerThreadStateBase* object : objects) {
+            if (liveObjects().count(object)) {
+                object->releaseThread(id);
+            }
+        }
+    }
+};
+
+namespace {
+    thread_local PerThreadStateTracker tracker;
+}
+
+PerThreadStateBase::PerThreadStateBase() {
+    std::lock_guard<std::mutex> lock(registryMutex());
+    liveObjects().insert(this);
+}
+
+PerThreadStateBase::~PerThreadStateBase() {
+    untrack();
+}
+
+void PerThreadStateBase::trackCurrentThread() {
+    // 同一线程反复创建、删除状态时只记录一次
+    if (std::find(tracker.objects.begin(), tracker.objects.end(), this) == tracker.objects.end()) {
+        tracker.objects.push_back(this);
+    }
+}
+
+void PerThreadStateBase::untrack() {
+    if (!tracked) return;
+
+    std::lock_guard<std::mutex> lock(registryMutex());
+    liveObjects().erase(this);
+    tracked = false;
+}
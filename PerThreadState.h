@@ -0,0 +1,84 @@
+﻿#pragma once
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+
+// 按线程保存状态的基类：记录哪些线程创建过状态，线程退出时通知对象删除该线程的状态
+// 线程id会被复用，不删除的话新线程会读到旧线程留下的错误信息等状态，表也会随线程数增长
+class PerThreadStateBase {
+public:
+    PerThreadStateBase(const PerThreadStateBase&) = delete;
+    PerThreadStateBase& operator=(const PerThreadStateBase&) = delete;
+
+protected:
+    PerThreadStateBase();
+    ~PerThreadStateBase();
+
+    // 当前线程创建状态后调用，线程退出时回调releaseThread
+    void trackCurrentThread();
+    // 派生类析构开始时调用：此后不再回调，正在进行的回调结束后才返回
+    void untrack();
+
+    virtual void releaseThread(std::thread::id thread) = 0;
+
+private:
+    friend struct PerThreadStateTracker;
+    bool tracked = true;
+};
+
+// 每个线程一份的状态T，第一次访问时创建，线程退出时删除
+// onThreadExit（可为空）在删除前调用，用于归还状态中持有的资源（如事务中固定的连接）
+template<typename T>
+class PerThreadState final : private PerThreadStateBase {
+public:
+    explicit PerThreadState(std::function<void(T&)> onThreadExit = nullptr)
+        : onThreadExit(std::move(onThreadExit)) {}
+    ~PerThreadState() { untrack(); }
+
+    // 当前线程的状态，不存在时创建；返回的引用在本线程退出前有效
+    T& local() {
+        std::thread::id id = std::this_thread::get_id();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = states.find(id);
+            if (it != states.end()) return it->second;
+        }
+        trackCurrentThread();
+        std::lock_guard<std::mutex> lock(mutex);
+        return states[id];
+    }
+
+    // 读取当前线程的状态，不存在时返回fallback，不创建
+    template<typename R, typename Fn>
+    R read(Fn&& fn, R fallback) const {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = states.find(std::this_thread::get_id());
+        return it != states.end() ? fn(it->second) : fallback;
+    }
+
+    void eraseLocal() {
+        std::lock_guard<std::mutex> lock(mutex);
+        states.erase(std::this_thread::get_id());
+    }
+
+private:
+    void releaseThread(std::thread::id thread) override {
+        T state;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = states.find(thread);
+            if (it == states.end()) return;
+            state = std::move(it->second);
+            states.erase(it);
+        }
+        if (onThreadExit) {
+            onThreadExit(state);
+        }
+    }
+
+    mutable std::mutex mutex;
+    std::unordered_map<std::thread::id, T> states;
+    std::function<void(T&)> onThreadExit;
+};
@@ -0,0 +1,314 @@
+﻿#include "PinyinIndex.h"
+#include "PinyinTable.h"
+#include <algorithm>
+#include <mutex>
+#include <unordered_set>
+
+namespace {
+    // 非法字节跳过
+    std::vector<char32_t> decodeUtf8(const std::string& text) {
+        std::vector<char32_t> codePoints;
+        codePoints.reserve(text.size());
+
+        std::size_t i = 0;
+        while (i < text.size()) {
+            unsigned char lead = static_cast<unsigned char>(text[i]);
+            std::size_t length = lead < 0x80 ? 1 : (lead >> 5) == 0x6 ? 2 : (lead >> 4) == 0xE ? 3
+                : (lead >> 3) == 0x1E ? 4 : 0;
+            if (length == 0 || i + length > text.size()) {
+                ++i;
+                continue;
+            }
+
+            char32_t codePoint = length == 1 ? lead : lead & (0xFF >> (length + 1));
+            bool valid = true;
+            for (std::size_t k = 1; k < length; ++k) {
+                unsigned char next = static_cast<unsigned char>(text[i + k]);
+                valid = valid && (next & 0xC0) == 0x80;
+                codePoint = (codePoint << 6) | (next & 0x3F);
+            }
+            if (valid) {
+                codePoints.push_back(codePoint);
+            }
+            i += valid ? length : 1;
+        }
+        return codePoints;
+    }
+
+    bool isHanzi(char32_t codePoint) {
+        return PinyinTable::syllableOf(codePoint) != nullptr;
+    }
+
+    // 一个字的读音：汉字取拼音（首字按姓氏读音），字母数字转小写，其他字符返回空串表示忽略
+    std::string syllableAt(char32_t codePoint, bool first) {
+        if (codePoint < 0x80) {
+            char c = static_cast<char>(codePoint);
+            if (c >= 'A' && c <= 'Z') return std::string(1, static_cast<char>(c - 'A' + 'a'));
+            if ((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9')) return std::string(1, c);
+            return std::string();
+        }
+        const char* syllable = first ? PinyinTable::surnameSyllableOf(codePoint) : PinyinTable::syllableOf(codePoint);
+        return syllable ? std::string(syllable) : std::string();
+    }
+
+    // 按字展开的姓名或查询：(码位, 读音)
+    using Units = std::vector<std::pair<char32_t, std::string>>;
+
+    // 姓名按字展开，忽略的字符不出现
+    Units syllablesOf(const std::string& name) {
+        Units result;
+        for (char32_t codePoint : decodeUtf8(name)) {
+            std::string syllable = syllableAt(codePoint, result.empty());
+            if (!syllable.empty()) {
+                result.emplace_back(codePoint, std::move(syllable));
+            }
+        }
+        return result;
+    }
+
+    // 查询中的汉字必须与姓名同一位置的字相同（全拼路径）
+    // 汉字之前的字母须恰好是完整读音，最后一段字母可以只是读音的前缀
+    bool matchesFull(const Units& query, const Units& name) {
+
+        std::size_t position = 0;
+        std::size_t offset = 0;     // 当前字的读音已被字母消耗的长度
+        for (const auto& unit : query) {
+            if (isHanzi(unit.first)) {
+                if (offset != 0 || position >= name.size() || name[position].first != unit.first) {
+                    return false;
+                }
+                ++position;
+                continue;
+            }
+
+            if (position >= name.size() || name[position].second[offset] != unit.second[0]) {
+                return false;
+            }
+            if (++offset == name[position].second.size()) {
+                ++position;
+                offset = 0;
+            }
+        }
+        return true;
+    }
+
+    // 姓全拼加名首字母路径：首字由汉字或完整读音匹配，之后每个单元对应一个字
+    bool matchesMixed(const Units& query, const Units& name) {
+        std::size_t position = 0;
+        std::size_t offset = 0;
+        for (const auto& unit : query) {
+            if (position >= name.size()) {
+                return false;
+            }
+            bool hanzi = isHanzi(unit.first);
+            if (position == 0 && !hanzi) {
+                if (name[0].second[offset] != unit.second[0]) {
+                    return false;
+                }
+                if (++offset == name[0].second.size()) {
+                    position = 1;
+                }
+                continue;
+            }
+            if ((position == 0 && offset != 0) || (hanzi && name[position].first != unit.first)) {
+                return false;
+            }
+            ++position;
+        }
+        return true;
+    }
+
+    // 首字母路径：查询的第k个单元对应姓名的第k个字
+    bool matchesInitials(const Units& query, const Units& name) {
+
+        if (query.size() > name.size()) {
+            return false;
+        }
+        for (std::size_t k = 0; k < query.size(); ++k) {
+            if (isHanzi(query[k].first) && name[k].first != query[k].first) {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+void PinyinIndex::transliterate(const std::string& name, std::string& full, std::string& initials,
+    std::string& mixed) {
+    full.clear();
+    initials.clear();
+    mixed.clear();
+    for (const auto& unit : syllablesOf(name)) {
+        full += unit.second;
+        initials += unit.second[0];
+        mixed += mixed.empty() ? unit.second : unit.second.substr(0, 1);
+    }
+}
+
+std::string PinyinIndex::collationKey(const std::string& name) {
+    std::string key;
+    for (const auto& unit : syllablesOf(name)) {
+        key += unit.second;
+        key += '\x01';
+    }
+    key += '\x02';
+    key += name;
+    return key;
+}
+
+void PinyinIndex::assign(const std::vector<std::pair<int, std::string>>& names) {
+    std::vector<Entry> loaded;
+    loaded.reserve(names.size());
+    std::unordered_map<int, std::uint32_t> slots;
+    slots.reserve(names.size());
+
+    for (const auto& item : names) {
+        if (slots.count(item.first)) continue;
+        Entry entry;
+        entry.id = item.first;
+        entry.name = item.second;
+        transliterate(entry.name, entry.full, entry.initials, entry.mixed);
+        slots.emplace(entry.id, static_cast<std::uint32_t>(loaded.size()));
+        loaded.push_back(std::move(entry));
+    }
+
+    std::vector<std::uint32_t> sorted[3];
+    for (int k = 0; k < 3; ++k) {
+        std::string Entry::* key = sortedKeys[k].key;
+        sorted[k].resize(loaded.size());
+        for (std::uint32_t i = 0; i < loaded.size(); ++i) sorted[k][i] = i;
+        std::sort(sorted[k].begin(), sorted[k].end(), [&loaded, key](std::uint32_t a, std::uint32_t b) {
+            return std::tie(loaded[a].*key, loaded[a].id) < std::tie(loaded[b].*key, loaded[b].id);
+        });
+    }
+
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    entries = std::move(loaded);
+    slotById = std::move(slots);
+    for (int k = 0; k < 3; ++k) {
+        sortedKeys[k].slots = std::move(sorted[k]);
+    }
+    freeSlots.clear();
+}
+
+void PinyinIndex::insertSorted(std::uint32_t slot) {
+    for (SortedKey& sorted : sortedKeys) {
+        std::string Entry::* key = sorted.key;
+        auto at = std::lower_bound(sorted.slots.begin(), sorted.slots.end(), slot,
+            [this, key](std::uint32_t a, std::uint32_t b) {
+                return std::tie(entries[a].*key, entries[a].id) < std::tie(entries[b].*key, entries[b].id);
+            });
+        sorted.slots.insert(at, slot);
+    }
+}
+
+void PinyinIndex::eraseSorted(std::uint32_t slot) {
+    for (SortedKey& sorted : sortedKeys) {
+        std::string Entry::* key = sorted.key;
+        auto at = std::lower_bound(sorted.slots.begin(), sorted.slots.end(), slot,
+            [this, key](std::uint32_t a, std::uint32_t b) {
+                return std::tie(entries[a].*key, entries[a].id) < std::tie(entries[b].*key, entries[b].id);
+            });
+        if (at != sorted.slots.end() && *at == slot) {
+            sorted.slots.erase(at);
+        }
+    }
+}
+
+void PinyinIndex::upsert(int id, const std::string& name) {
+    std::string full, initials, mixed;
+    transliterate(name, full, initials, mixed);
+
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    std::uint32_t slot;
+    auto existing = slotById.find(id);
+    if (existing != slotById.end()) {
+        slot = existing->second;
+        eraseSorted(slot);
+    }
+    else if (!freeSlots.empty()) {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+        slotById.emplace(id, slot);
+    }
+    else {
+        slot = static_cast<std::uint32_t>(entries.size());
+        entries.emplace_back();
+        slotById.emplace(id, slot);
+    }
+
+    Entry& entry = entries[slot];
+    entry.id = id;
+    entry.name = name;
+    entry.full = std::move(full);
+    entry.initials = std::move(initials);
+    entry.mixed = std::move(mixed);
+    insertSorted(slot);
+}
+
+void PinyinIndex::remove(int id) {
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    auto existing = slotById.find(id);
+    if (existing == slotById.end()) {
+        return;
+    }
+
+    std::uint32_t slot = existing->second;
+    eraseSorted(slot);
+    slotById.erase(existing);
+    entries[slot] = Entry();
+    freeSlots.push_back(slot);
+}
+
+std::vector<PinyinIndex::Match> PinyinIndex::lookup(const std::string& query, std::size_t limit) const {
+    std::vector<Match> results;
+
+    // 查询按字展开，汉字换成拼音（全拼键）或首字母（首字母键），混合键首字取全拼
+    Units units;
+    std::string prefixes[3];    // 顺序同sortedKeys：全拼、姓全拼加名首字母、首字母
+    bool hasHanzi = false;
+    for (char32_t codePoint : decodeUtf8(query)) {
+        std::string syllable = syllableAt(codePoint, units.empty());
+        if (syllable.empty()) continue;
+
+        bool hanzi = isHanzi(codePoint);
+        hasHanzi = hasHanzi || hanzi;
+        std::string initial = hanzi ? syllable.substr(0, 1) : syllable;
+        prefixes[0] += syllable;
+        prefixes[1] += units.empty() ? syllable : initial;
+        prefixes[2] += initial;
+        units.emplace_back(codePoint, std::move(syllable));
+    }
+    if (units.empty() || limit == 0) {
+        return results;
+    }
+
+    bool (*const matchers[3])(const Units&, const Units&) = { &matchesFull, &matchesMixed, &matchesInitials };
+
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    std::unordered_set<int> seen;
+    for (int k = 0; k < 3 && results.size() < limit; ++k) {
+        const std::vector<std::uint32_t>& sorted = sortedKeys[k].slots;
+        std::string Entry::* key = sortedKeys[k].key;
+        const std::string& prefix = prefixes[k];
+
+        auto it = std::lower_bound(sorted.begin(), sorted.end(), prefix,
+            [this, key](std::uint32_t slot, const std::string& value) { return entries[slot].*key < value; });
+        for (; it != sorted.end() && results.size() < limit; ++it) {
+            const Entry& entry = entries[*it];
+            if ((entry.*key).compare(0, prefix.size(), prefix) != 0) break;
+            if (seen.count(entry.id)) continue;
+            // 含汉字时需核对汉字所在位置
+            if (hasHanzi && !matchers[k](units, syllablesOf(entry.name))) continue;
+
+            seen.insert(entry.id);
+            results.push_back(Match{ entry.id, entry.name });
+        }
+    }
+    return results;
+}
+
+std::size_t PinyinIndex::size() const {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    return slotById.size();
+}
@@ -0,0 +1,60 @@
+﻿#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// 姓名拼音检索索引（医生、病人各一份，保存在SystemManager中）
+// 每个姓名保存全拼（zhangsan）、首字母（zs）和姓全拼+名首字母（zhangs）三个键，各自按字典序排成有序数组；
+// 查询时把输入中的汉字换成拼音，在各数组上二分查找前缀，只检查命中区间内的条目
+// 支持全拼前缀（zhangs）、首字母（zs）、姓全拼加名首字母（zengxm）以及汉字和拼音混合输入（张s、张san）
+class PinyinIndex {
+public:
+    struct Match {
+        int id = 0;
+        std::string name;
+    };
+
+    // 姓名转写：full为全拼，initials为各字首字母，mixed为首字全拼加其余各字首字母
+    // 字母、数字转小写后原样保留，其他字符忽略
+    static void transliterate(const std::string& name, std::string& full, std::string& initials,
+        std::string& mixed);
+    // 排序键：逐字拼音（字之间以\x01分隔）后接原姓名，按字节比较即为拼音顺序
+    static std::string collationKey(const std::string& name);
+
+    // 整体替换（启动时批量加载，只排序一次）
+    void assign(const std::vector<std::pair<int, std::string>>& names);
+    void upsert(int id, const std::string& name);
+    void remove(int id);
+
+    // 依次取全拼、姓全拼加名首字母、首字母的前缀命中（各自按键排序），最多limit条
+    std::vector<Match> lookup(const std::string& query, std::size_t limit) const;
+    std::size_t size() const;
+
+private:
+    struct Entry {
+        int id = 0;
+        std::string name;
+        std::string full;
+        std::string initials;
+        std::string mixed;
+    };
+
+    // 按(键, id)排序的条目下标，查询时依次使用
+    struct SortedKey {
+        std::string Entry::* key;
+        std::vector<std::uint32_t> slots;
+    };
+
+    void insertSorted(std::uint32_t slot);
+    void eraseSorted(std::uint32_t slot);
+
+    std::vector<Entry> entries;
+    std::vector<std::uint32_t> freeSlots;
+    std::unordered_map<int, std::uint32_t> slotById;
+    SortedKey sortedKeys[3] = { { &Entry::full, {} }, { &Entry::mixed, {} }, { &Entry::initials, {} } };
+    mutable std::shared_mutex mutex;
+};
@@ -0,0 +1,13 @@
+﻿#pragma once
+#include <cstdint>
+
+// 汉字拼音表：CJK基本区每个汉字一个不带声调的小写读音
+namespace PinyinTable {
+    constexpr char32_t kFirstCodePoint = 0x4E00;
+    constexpr char32_t kLastCodePoint = 0x9FFF;
+
+    // 汉字的拼音，不在表中或没有读音时返回nullptr
+    const char* syllableOf(char32_t codePoint);
+    // 作为姓氏（姓名首字）时的读音，如曾(zeng)、单(shan)；不是多音姓氏时同syllableOf
+    const char* surnameSyllableOf(char32_t codePoint);
+}
@@ -0,0 +1,361 @@
+﻿#include "QueryPlanAudit.h"
+#include "DatabaseManager.h"
+
+namespace {
+    const char* kAuditDatabase = "hospital_system_explain_audit";
+
+    // 估算行数不超过该值的表（科室、医生等）视为小表，不检查扫描方式
+    constexpr long long kSmallTableRows = 1000;
+
+    // 生成 0..count-1 的整数序列（派生表seq，列名n），由0-9交叉连接得到，不依赖递归CTE的深度限制
+    std::string sequence(int count) {
+        const std::string digits =
+            "(SELECT 0 AS d UNION ALL SELECT 1 UNION ALL SELECT 2 UNION ALL SELECT 3 UNION ALL SELECT 4 "
+            "UNION ALL SELECT 5 UNION ALL SELECT 6 UNION ALL SELECT 7 UNION ALL SELECT 8 UNION ALL SELECT 9)";
+
+        std::string expr;
+        std::string from;
+        long long weight = 1;
+        for (int i = 0; i == 0 || weight < count; ++i, weight *= 10) {
+            std::string alias = "d" + std::to_string(i);
+            expr += (i ? " + " : "") + alias + ".d * " + std::to_string(weight);
+            from += (i ? " CROSS JOIN " : "") + digits + " " + alias;
+        }
+        return "(SELECT n FROM (SELECT " + expr + " AS n FROM " + from + ") digits WHERE n < "
+            + std::to_string(count) + ") seq";
+    }
+
+    // 与SystemManager中的挂号查询模板一致
+    const std::string kRegistrationSelect =
+        "SELECT r.registration_id, r.registration_date, r.patient_id, r.doctor_id, "
+        "r.status, r.notes, p.name as patient_name, d.name as doctor_name, d.department, "
+        "CASE WHEN rb.bill_id IS NOT NULL THEN 1 ELSE 0 END as has_bill, "
+        "COALESCE(b.amount, 0) as bill_amount, COALESCE(b.status, '') as bill_status "
+        "FROM registrations r "
+        "JOIN patients p ON r.patient_id = p.patient_id "
+        "JOIN doctors d ON r.doctor_id = d.doctor_id "
+        "LEFT JOIN registration_bills rb ON r.registration_id = rb.registration_id "
+        "LEFT JOIN bills b ON rb.bill_id = b.bill_id ";
+
+    // 选择列表不影响执行计划，这里只保留与SystemManager相同的FROM/JOIN
+    const std::string kUserSelect =
+        "SELECT u.user_id, u.username, u.role, COALESCE(p.name, d.name), "
+        "COALESCE(p.gender, d.gender), COALESCE(p.age, d.age), COALESCE(p.phone, d.phone), "
+        "p.address, p.id_card, d.department "
+        "FROM users u "
+        "LEFT JOIN patients p ON u.user_id = p.patient_id AND u.role = 'patient' "
+        "LEFT JOIN doctors d ON u.user_id = d.doctor_id AND u.role = 'doctor' ";
+}
+
+QueryPlanAudit::QueryPlanAudit(DatabaseManager& db) : db(db) {
+}
+
+std::vector<AuditedQuery> QueryPlanAudit::auditedQueries() {
+    const std::string doctorId = std::to_string(kSeedDoctorIdBase);
+    const std::string patientId = std::to_string(kSeedPatientIdBase);
+
+    // 科室筛选展开后的医生编号列表：测试医生按序号轮流分到各科室，每隔10个取一个，约为一个科室的医生数
+    std::string departmentDoctors;
+    for (int i = 0; i < 10; ++i) {
+        departmentDoctors += (i ? ", " : "") + std::to_string(kSeedDoctorIdBase + i * 10);
+    }
+    const std::string cursor = "AND r.registration_date <= CURDATE() AND (r.registration_date < CURDATE() "
+        "OR (r.registration_date = CURDATE() AND r.registration_id < 1000000)) ";
+    const std::string pageOrder = "ORDER BY r.registration_date DESC, r.registration_id DESC LIMIT 200";
+
+    return {
+        // SystemManager
+        { "SystemManager::forEachRegistration(all)",
+            kRegistrationSelect + "ORDER BY r.registration_date DESC", true },
+        { "SystemManager::forEachRegistration(doctor)",
+            kRegistrationSelect + "WHERE r.doctor_id = " + doctorId + " ORDER BY r.registration_date DESC" },
+        // 管理员筛选的键集分页：第一页和带游标的后续页
+        { "SystemManager::queryRegistrations(date range)",
+            kRegistrationSelect + "WHERE 1 = 1 AND r.registration_date >= DATE_SUB(CURDATE(), INTERVAL 7 DAY) "
+            "AND r.registration_date <= CURDATE() "
+            "ORDER BY r.registration_date DESC, r.registration_id DESC LIMIT 200" },
+        { "SystemManager::queryRegistrations(status, cursor)",
+            kRegistrationSelect + "WHERE 1 = 1 AND r.status = 'pending' "
+            "AND r.registration_date <= CURDATE() AND (r.registration_date < CURDATE() "
+            "OR (r.registration_date = CURDATE() AND r.registration_id < 1000000)) "
+            "ORDER BY r.registration_date DESC, r.registration_id DESC LIMIT 200" },
+        { "SystemManager::queryRegistrations(doctor, cursor)",
+            kRegistrationSelect + "WHERE 1 = 1 AND r.doctor_id = " + doctorId + " "
+            "AND r.registration_date <= CURDATE() AND (r.registration_date < CURDATE() "
+            "OR (r.registration_date = CURDATE() AND r.registration_id < 1000000)) "
+            "ORDER BY r.registration_date DESC, r.registration_id DESC LIMIT 200" },
+        // 管理员筛选栏总是带日期范围，科室与状态、医生组合使用；宽日期范围时不能读出整个范围再排序
+        { "SystemManager::queryRegistrations(date range, department)",
+            kRegistrationSelect + "WHERE 1 = 1 AND r.registration_date >= DATE_SUB(CURDATE(), INTERVAL 7 DAY) "
+            "AND r.registration_date <= CURDATE() AND r.doctor_id IN (" + departmentDoctors + ") " + pageOrder },
+        { "SystemManager::queryRegistrations(wide date range, department, cursor)",
+            kRegistrationSelect + "WHERE 1 = 1 AND r.registration_date >= DATE_SUB(CURDATE(), INTERVAL 365 DAY) "
+            "AND r.registration_date <= CURDATE() AND r.doctor_id IN (" + departmentDoctors + ") "
+            + cursor + pageOrder },
+        { "SystemManager::queryRegistrations(date range, department, status)",
+            kRegistrationSelect + "WHERE 1 = 1 AND r.registration_date >= DATE_SUB(CURDATE(), INTERVAL 365 DAY) "
+            "AND r.registration_date <= CURDATE() AND r.status = 'pending' "
+            "AND r.doctor_id IN (" + departmentDoctors + ") " + pageOrder },
+        { "SystemManager::queryRegistrations(date range, doctor, status)",
+            kRegistrationSelect + "WHERE 1 = 1 AND r.registration_date >= DATE_SUB(CURDATE(), INTERVAL 365 DAY) "
+            "AND r.registration_date <= CURDATE() AND r.doctor_id = " + doctorId + " AND r.status = 'pending' "
+            + pageOrder },
+        { "SystemManager::queryRegistrations(date range, status, cursor)",
+            kRegistrationSelect + "WHERE 1 = 1 AND r.registration_date >= DATE_SUB(CURDATE(), INTERVAL 365 DAY) "
+            "AND r.registration_date <= CURDATE() AND r.status = 'completed' " + cursor + pageOrder },
+        { "SystemManager::getRegistrationsByPatient",
+            kRegistrationSelect + "WHERE r.patient_id = " + patientId + " ORDER BY r.registration_date DESC" },
+        { "SystemManager::getRegistrationById",
+            kRegistrationSelect + "WHERE r.registration_id = 1" },
+        { "SystemManager::login(patient)",
+            "SELECT u.user_id, u.username, u.role, p.name, p.gender, p.age, p.phone, p.address, "
+            "p.id_card, '', u.password_hash "
+            "FROM users u LEFT JOIN patients p ON p.patient_id = u.user_id "
+            "WHERE u.username = 'audit_patient_0' AND u.role = 'patient'" },
+        { "SystemManager::changePassword",
+            "SELECT password_hash FROM users WHERE user_id = " + patientId },
+        { "SystemManager::registerUser",
+            "SELECT user_id FROM users WHERE username = 'audit_patient_0'" },
+        { "SystemManager::getUserById",
+            kUserSelect + "WHERE u.user_id = " + patientId },
+        { "ReferenceDataCache::load(departments)",
+            "SELECT department_id, department_name, description, contact_phone, location "
+            "FROM departments" },
+        { "ReferenceDataCache::load(doctors)",
+            "SELECT doctor_id, name, gender, age, phone, department, department_id FROM doctors" },
+        // 拼音索引一次性读取全部姓名
+        { "SystemManager::prepareNameIndex(patients)",
+            "SELECT patient_id, name FROM patients", true },
+        { "SystemManager::loadDoctorQueue",
+            kRegistrationSelect + "WHERE r.doctor_id = " + doctorId + " AND r.registration_date = CURDATE() "
+            "AND r.status = 'pending' ORDER BY r.registration_id" },
+        { "settle_registration",
+            "SELECT status FROM registrations WHERE registration_id = 1 FOR UPDATE" },
+        { "settle_registration(bill)",
+            "SELECT bill_id FROM registration_bills WHERE registration_id = 1" },
+
+        // MainWindow
+        { "SystemManager::getDashboardStats(doctor)",
+            "SELECT COALESCE(SUM(registrations), 0), COALESCE(SUM(pending_count), 0), "
+            "COALESCE(SUM(completed_count), 0), COALESCE(SUM(IF(stat_date = CURDATE(), registrations, 0)), 0), "
+            "COALESCE(SUM(IF(stat_date = CURDATE(), completed_count, 0)), 0) "
+            "FROM daily_stats WHERE doctor_id = " + doctorId },
+        // 全院仪表盘除累计收入外的各项：当日汇总按主键前缀读取，医生和病人总数读取计数行，不允许扫描
+        { "SystemManager::getDashboardStats(hospital)",
+            "SELECT "
+            "(SELECT COALESCE(SUM(registrations), 0) FROM daily_stats WHERE stat_date = CURDATE()), "
+            "(SELECT COALESCE(SUM(completed_count), 0) FROM daily_stats WHERE stat_date = CURDATE()), "
+            "COALESCE((SELECT doctor_count FROM hospital_counters WHERE counter_id = 1), 0), "
+            "COALESCE((SELECT patient_count FROM hospital_counters WHERE counter_id = 1), 0)" },
+        // 累计收入扫描汇总表（每医生每天一行）
+        { "SystemManager::getDashboardStats(hospital income)",
+            "SELECT COALESCE(SUM(paid_amount), 0) FROM daily_stats", true },
+        // 每位医生按主键关联一行号源
+        { "SystemManager::getRemainingSlots",
+            "SELECT d.doctor_id, COALESCE(s.capacity, d.daily_capacity) - COALESCE(s.booked, 0) "
+            "FROM doctors d LEFT JOIN doctor_slots s ON s.doctor_id = d.doctor_id AND s.slot_date = CURDATE()",
+            true },
+        { "reserve_doctor_slot",
+            "UPDATE doctor_slots SET booked = booked + 1 "
+            "WHERE doctor_id = " + doctorId + " AND slot_date = CURDATE() AND booked < capacity" },
+        { "SystemManager::getDepartmentReport",
+            "SELECT ds.department_id, COALESCE(dept.department_name, '未分配'), "
+            "SUM(ds.registrations), SUM(ds.pending_count), SUM(ds.completed_count), SUM(ds.cancelled_count), "
+            "SUM(ds.billed_amount), SUM(ds.paid_amount) "
+            "FROM daily_stats ds LEFT JOIN departments dept ON dept.department_id = ds.department_id "
+            "WHERE ds.stat_date BETWEEN DATE_SUB(CURDATE(), INTERVAL 30 DAY) AND CURDATE() "
+            "GROUP BY ds.department_id, dept.department_name ORDER BY ds.department_id" },
+        // 病人检索的前缀分支和全文分支
+        { "SystemManager::searchPatients(name)",
+            "SELECT patient_id, name, phone, id_card FROM patients WHERE name LIKE '病人12%' ORDER BY name LIMIT 20" },
+        { "SystemManager::searchPatients(phone)",
+            "SELECT patient_id, name, phone, id_card FROM patients WHERE phone LIKE '1390001%' ORDER BY phone LIMIT 20" },
+        { "SystemManager::searchPatients(id_card)",
+            "SELECT patient_id, name, phone, id_card FROM patients WHERE id_card LIKE '0000000000000012%' "
+            "ORDER BY id_card LIMIT 20" },
+        { "SystemManager::searchPatients(fulltext)",
+            "SELECT patient_id, name, phone, id_card FROM patients "
+            "WHERE MATCH(name, phone, id_card) AGAINST ('\"0012\"' IN BOOLEAN MODE) LIMIT 20" },
+        { "delete_registration",
+            "DELETE FROM registrations WHERE registration_id = 1" },
+    };
+}
+
+bool QueryPlanAudit::execute(const std::string& sql) {
+    if (!db.executeQuery(sql)) {
+        lastError = db.getLastError();
+        return false;
+    }
+    return true;
+}
+
+bool QueryPlanAudit::seed(const SeedSize& size) {
+    long long departmentCount = 0;
+    db.forEachRow("SELECT COUNT(*) FROM departments", [&departmentCount](const ResultRow& row) {
+        departmentCount = row.getInt(0);
+        return false;
+    });
+    if (departmentCount == 0) {
+        lastError = "科室表为空，请先执行数据库迁移";
+        return false;
+    }
+
+    const std::string doctorBase = std::to_string(kSeedDoctorIdBase);
+    const std::string patientBase = std::to_string(kSeedPatientIdBase);
+    const std::string doctors = std::to_string(size.doctors);
+    const std::string patients = std::to_string(size.patients);
+
+    std::vector<std::string> statements = {
+        // 医生：按序号轮流分配到各科室
+        "INSERT INTO users (user_id, username, password_hash, role) "
+        "SELECT " + doctorBase + " + n, CONCAT('audit_doctor_', n), MD5('audit'), 'doctor' "
+        "FROM " + sequence(size.doctors),
+
+        "INSERT INTO doctors (doctor_id, name, gender, age, phone, department, department_id) "
+        "SELECT " + doctorBase + " + seq.n, CONCAT('医生', seq.n), IF(seq.n % 2 = 0, 'male', 'female'), "
+        "30 + seq.n % 30, '13800000000', dept.department_name, dept.department_id "
+        "FROM " + sequence(size.doctors) + " "
+        "JOIN (SELECT department_id, department_name, ROW_NUMBER() OVER (ORDER BY department_id) - 1 AS idx "
+        "FROM departments) dept ON dept.idx = seq.n % " + std::to_string(departmentCount),
+
+        // 病人
+        "INSERT INTO users (user_id, username, password_hash, role) "
+        "SELECT " + patientBase + " + n, CONCAT('audit_patient_', n), MD5('audit'), 'patient' "
+        "FROM " + sequence(size.patients),
+
+        "INSERT INTO patients (patient_id, name, gender, age, address, phone, id_card) "
+        "SELECT " + patientBase + " + n, CONCAT('病人', n), IF(n % 2 = 0, 'male', 'female'), n % 90, "
+        "'测试地址', CONCAT('139', LPAD(n, 8, '0')), LPAD(n, 18, '0') "
+        "FROM " + sequence(size.patients),
+
+        // 挂号：日期分布在最近一年，状态轮流取值
+        "INSERT INTO registrations (registration_date, patient_id, doctor_id, status, notes) "
+        "SELECT DATE_SUB(CURDATE(), INTERVAL n % 365 DAY), " + patientBase + " + n % " + patients + ", "
+        + doctorBase + " + (n DIV 7) % " + doctors + ", ELT(1 + n % 3, 'pending', 'completed', 'cancelled'), "
+        "'测试挂号' FROM " + sequence(size.registrations),
+
+        // 已完成的挂号生成账单
+        "INSERT INTO bills (bill_id, bill_date, amount, status) "
+        "SELECT registration_id, registration_date, 20 + registration_id % 200, "
+        "IF(registration_id % 4 = 0, 'unpaid', 'paid') FROM registrations WHERE status = 'completed'",
+
+        "INSERT INTO registration_bills (registration_id, bill_id) "
+        "SELECT registration_id, registration_id FROM registrations WHERE status = 'completed'",
+
+        // 测试数据直接写入明细表，汇总表和计数一次性重建
+        "CALL rebuild_daily_stats(NULL)",
+
+        "UPDATE hospital_counters SET patient_count = (SELECT COUNT(*) FROM patients), "
+        "doctor_count = (SELECT COUNT(*) FROM doctors) WHERE counter_id = 1",
+
+        "INSERT INTO doctor_slots (doctor_id, slot_date, capacity, booked) "
+        "SELECT doctor_id, registration_date, GREATEST(30, COUNT(*)), COUNT(*) FROM registrations "
+        "WHERE status <> 'cancelled' GROUP BY doctor_id, registration_date",
+
+        // 更新索引统计信息，使执行计划反映实际数据分布
+        "ANALYZE TABLE users, patients, doctors, departments, registrations, bills, registration_bills, daily_stats, doctor_slots"
+    };
+
+    for (const std::string& statement : statements) {
+        if (!execute(statement)) {
+            lastError = "写入测试数据失败: " + lastError;
+            return false;
+        }
+    }
+    return true;
+}
+
+int QueryPlanAudit::run(std::ostream& report) {
+    int findings = 0;
+
+    for (const AuditedQuery& query : auditedQueries()) {
+        std::vector<std::string> plan;
+        std::vector<std::string> problems;
+
+        // 传统EXPLAIN列：id, select_type, table, partitions, type, possible_keys, key, key_len, ref, rows, filtered, Extra
+        bool ok = db.forEachRow("EXPLAIN " + query.sql, [&](const ResultRow& row) {
+            if (row.columnCount() < 12) {
+                return false;
+            }
+            std::string table = row.getString(2);
+            std::string type = row.getString(4);
+            std::string key = row.isNull(6) ? "" : row.getString(6);
+            long long rows = row.isNull(9) ? 0 : row.getInt(9);
+            std::string extra = row.isNull(11) ? "" : row.getString(11);
+
+            plan.push_back(table + " type=" + type + " key=" + (key.empty() ? "NULL" : key)
+                + " rows=" + std::to_string(rows) + (extra.empty() ? "" : " extra=" + extra));
+
+            if (rows <= kSmallTableRows) {
+                return true;
+            }
+            // index为按索引顺序读完整个索引（如COUNT(*)），与全表扫描同样随表增长
+            if ((type == "ALL" || type == "index") && !query.allowFullScan) {
+                problems.push_back(table + (type == "ALL" ? " 全表扫描" : " 全索引扫描"));
+            }
+            if (extra.find("Using filesort") != std::string::npos) {
+                problems.push_back(table + " 使用filesort排序");
+            }
+            return true;
+        });
+
+        if (!ok) {
+            lastError = query.caller + " 执行EXPLAIN失败: " + db.getLastError();
+            report << "[ERROR] " << lastError << "\n";
+            return -1;
+        }
+
+        report << (problems.empty() ? "[OK]   " : "[FAIL] ") << query.caller << "\n";
+        for (const std::string& problem : problems) {
+            report << "       问题: " << problem << "\n";
+        }
+        if (!problems.empty()) {
+            for (const std::string& line : plan) {
+                report << "       计划: " << line << "\n";
+            }
+        }
+        findings += static_cast<int>(problems.size());
+    }
+
+    report << "共检查 " << auditedQueries().size() << " 条查询，发现 " << findings << " 个问题" << std::endl;
+    return findings;
+}
+
+std::string QueryPlanAudit::getLastError() const {
+    return lastError;
+}
+
+int QueryPlanAudit::runStandalone(const std::string& host, const std::string& user,
+    const std::string& password, unsigned int port, std::ostream& report) {
+
+    // 每次重建审计库，不触碰业务库
+    // 同一个DatabaseManager先连information_schema建库再重连，避免析构时提前释放MySQL库
+    DatabaseManager db;
+    if (!db.connect(host, user, password, "information_schema", port) ||
+        !db.executeQuery(std::string("DROP DATABASE IF EXISTS ") + kAuditDatabase) ||
+        !db.executeQuery(std::string("CREATE DATABASE ") + kAuditDatabase +
+            " CHARACTER SET utf8mb4 COLLATE utf8mb4_unicode_ci")) {
+        report << "[ERROR] 创建审计库失败: " << db.getLastError() << std::endl;
+        return 2;
+    }
+
+    if (!db.connect(host, user, password, kAuditDatabase, port) || !db.initializeDatabase()) {
+        report << "[ERROR] 初始化审计库失败: " << db.getLastError() << std::endl;
+        return 2;
+    }
+
+    QueryPlanAudit audit(db);
+    SeedSize size;
+    report << "写入测试数据: 医生 " << size.doctors << "，病人 " << size.patients
+        << "，挂号 " << size.registrations << std::endl;
+    if (!audit.seed(size)) {
+        report << "[ERROR] " << audit.getLastError() << std::endl;
+        return 2;
+    }
+
+    int findings = audit.run(report);
+    if (findings < 0) {
+        return 2;
+    }
+    return findings == 0 ? 0 : 1;
+}
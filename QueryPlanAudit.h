@@ -0,0 +1,52 @@
+﻿#pragma once
+#include <ostream>
+#include <string>
+#include <vector>
+
+class DatabaseManager;
+
+// 需要检查执行计划的查询，SQL中的参数以示例值代入
+struct AuditedQuery {
+    std::string caller;         // 发起该查询的函数
+    std::string sql;
+    bool allowFullScan = false; // 本身需要读取整表的查询（如全部挂号列表），允许扫描但仍不允许filesort
+};
+
+// 执行计划回归检查：在大数据量下对系统发出的查询执行EXPLAIN
+// 大表上出现全表扫描、全索引扫描或filesort即视为回归
+class QueryPlanAudit {
+public:
+    struct SeedSize {
+        int doctors = 100;
+        int patients = 20000;
+        int registrations = 200000;
+    };
+
+    // 测试数据的用户ID起点，与默认管理员账户错开
+    // 第n个医生、病人的ID为起点加n，用户名为audit_doctor_n、audit_patient_n，口令为audit
+    static constexpr int kSeedDoctorIdBase = 1000;
+    static constexpr int kSeedPatientIdBase = 100000;
+
+    explicit QueryPlanAudit(DatabaseManager& db);
+
+    // SystemManager和MainWindow发出的查询（修改这些查询时需同步更新）
+    static std::vector<AuditedQuery> auditedQueries();
+
+    // 向空库写入测试数据并更新统计信息
+    bool seed(const SeedSize& size);
+
+    // 逐条执行EXPLAIN并写入报告，返回发现的问题数，执行失败返回-1
+    int run(std::ostream& report);
+
+    std::string getLastError() const;
+
+    // 命令行入口：新建独立的审计库，迁移、灌数据后检查，返回进程退出码（0为通过）
+    static int runStandalone(const std::string& host, const std::string& user,
+        const std::string& password, unsigned int port, std::ostream& report);
+
+private:
+    bool execute(const std::string& sql);
+
+    DatabaseManager& db;
+    std::string lastError;
+};
@@ -0,0 +1,364 @@
+﻿#include "QueryStats.h"
+#include <algorithm>
+#include <cctype>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+namespace {
+    std::size_t bucketIndex(std::uint64_t micros) {
+        if (micros < 8) {
+            return static_cast<std::size_t>(micros);
+        }
+        int exponent = 63;
+        while (!(micros >> exponent)) {
+            --exponent;
+        }
+        std::size_t sub = static_cast<std::size_t>((micros >> (exponent - 2)) & 3);
+        std::size_t index = 8 + static_cast<std::size_t>(exponent - 3) * 4 + sub;
+        return std::min(index, QueryStats::kBucketCount - 1);
+    }
+
+    // 桶的上界（微秒），百分位取所在桶的上界
+    std::uint64_t bucketUpperBound(std::size_t index) {
+        if (index < 8) {
+            return index + 1;
+        }
+        int exponent = static_cast<int>((index - 8) / 4) + 3;
+        std::uint64_t sub = (index - 8) % 4;
+        std::uint64_t lower = (std::uint64_t(1) << exponent) | (sub << (exponent - 2));
+        return lower + (std::uint64_t(1) << (exponent - 2));
+    }
+
+    bool isIdentifierChar(char c) {
+        return std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '$';
+    }
+
+    void writeJsonString(std::ostream& out, const std::string& value) {
+        out << '"';
+        for (char c : value) {
+            switch (c) {
+            case '"': out << "\\\""; break;
+            case '\\': out << "\\\\"; break;
+            case '\n': out << "\\n"; break;
+            case '\r': out << "\\r"; break;
+            case '\t': out << "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    out << "\\u" << std::hex << std::setw(4) << std::setfill('0') << int(c)
+                        << std::dec << std::setfill(' ');
+                }
+                else {
+                    out << c;
+                }
+            }
+        }
+        out << '"';
+    }
+}
+
+void QueryStats::Entry::record(std::uint64_t micros, std::uint64_t rowCount, std::uint64_t byteCount, bool ok) {
+    calls.fetch_add(1, std::memory_order_relaxed);
+    if (!ok) {
+        errors.fetch_add(1, std::memory_order_relaxed);
+    }
+    rows.fetch_add(rowCount, std::memory_order_relaxed);
+    bytes.fetch_add(byteCount, std::memory_order_relaxed);
+    totalMicros.fetch_add(micros, std::memory_order_relaxed);
+    buckets[bucketIndex(micros)].fetch_add(1, std::memory_order_relaxed);
+
+    std::uint64_t currentMax = maxMicros.load(std::memory_order_relaxed);
+    while (micros > currentMax
+        && !maxMicros.compare_exchange_weak(currentMax, micros, std::memory_order_relaxed)) {
+    }
+}
+
+QueryStatsSnapshot QueryStats::Entry::snapshot() const {
+    QueryStatsSnapshot result;
+    result.fingerprint = fingerprint;
+    result.calls = calls.load(std::memory_order_relaxed);
+    result.errors = errors.load(std::memory_order_relaxed);
+    result.rows = rows.load(std::memory_order_relaxed);
+    result.bytes = bytes.load(std::memory_order_relaxed);
+    result.maxMs = maxMicros.load(std::memory_order_relaxed) / 1000.0;
+
+    std::array<std::uint64_t, kBucketCount> counts{};
+    std::uint64_t total = 0;
+    for (std::size_t i = 0; i < kBucketCount; ++i) {
+        counts[i] = buckets[i].load(std::memory_order_relaxed);
+        total += counts[i];
+    }
+    if (total == 0) {
+        return result;
+    }
+    result.avgMs = totalMicros.load(std::memory_order_relaxed) / 1000.0 / total;
+
+    // 各计数器分别读取，并发记录时快照可能有一次调用的偏差，不影响百分位
+    auto percentile = [&](double fraction) {
+        std::uint64_t target = static_cast<std::uint64_t>(fraction * total + 0.999999);
+        std::uint64_t seen = 0;
+        for (std::size_t i = 0; i < kBucketCount; ++i) {
+            seen += counts[i];
+            if (seen >= target) {
+                return std::min(bucketUpperBound(i) / 1000.0, result.maxMs);
+            }
+        }
+        return result.maxMs;
+    };
+    result.p50Ms = percentile(0.50);
+    result.p95Ms = percentile(0.95);
+    result.p99Ms = percentile(0.99);
+    return result;
+}
+
+QueryStats::Entry& QueryStats::entryFor(std::string_view sql) {
+    std::string key = fingerprint(sql);
+    {
+        std::shared_lock<std::shared_mutex> lock(entriesMutex);
+        auto it = entries.find(key);
+        if (it != entries.end()) {
+            return *it->second;
+        }
+    }
+
+    std::unique_lock<std::shared_mutex> lock(entriesMutex);
+    auto& slot = entries[key];
+    if (!slot) {
+        slot = std::make_unique<Entry>(key);
+    }
+    return *slot;
+}
+
+void QueryStats::record(std::string_view sql, std::chrono::steady_clock::duration elapsed,
+    std::uint64_t rows, std::uint64_t bytes, bool ok) {
+    if (!enabled) {
+        return;
+    }
+    record(entryFor(sql), sql, elapsed, rows, bytes, ok);
+}
+
+void QueryStats::record(Entry& entry, std::string_view sql, std::chrono::steady_clock::duration elapsed,
+    std::uint64_t rows, std::uint64_t bytes, bool ok) {
+    if (!enabled) {
+        return;
+    }
+
+    auto micros = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+    std::uint64_t value = micros > 0 ? static_cast<std::uint64_t>(micros) : 0;
+    entry.record(value, rows, bytes, ok);
+
+    long long threshold = slowThresholdMs.load(std::memory_order_relaxed);
+    if (threshold >= 0 && value >= static_cast<std::uint64_t>(threshold) * 1000) {
+        writeSlowQuery(sql, value / 1000.0, rows);
+    }
+}
+
+void QueryStats::setSlowQueryThreshold(std::chrono::milliseconds threshold) {
+    slowThresholdMs = threshold.count();
+}
+
+std::chrono::milliseconds QueryStats::getSlowQueryThreshold() const {
+    return std::chrono::milliseconds(slowThresholdMs.load());
+}
+
+void QueryStats::setSlowQueryLogPath(const std::string& path) {
+    std::lock_guard<std::mutex> lock(slowLogMutex);
+    slowLogPath = path;
+}
+
+std::string QueryStats::getSlowQueryLogPath() const {
+    std::lock_guard<std::mutex> lock(slowLogMutex);
+    return slowLogPath;
+}
+
+void QueryStats::writeSlowQuery(std::string_view sql, double elapsedMs, std::uint64_t rows) {
+    std::time_t now = std::time(nullptr);
+    std::tm local{};
+#ifdef _WIN32
+    localtime_s(&local, &now);
+#else
+    localtime_r(&now, &local);
+#endif
+
+    std::lock_guard<std::mutex> lock(slowLogMutex);
+    if (slowLogPath.empty()) {
+        return;
+    }
+    std::ofstream log(std::filesystem::u8path(slowLogPath), std::ios::app);
+    if (!log) {
+        return;
+    }
+    log << std::put_time(&local, "%Y-%m-%d %H:%M:%S")
+        << " time=" << std::fixed << std::setprecision(3) << elapsedMs << "ms"
+        << " rows=" << rows << " sql=";
+    // SQL中的换行压成空格，保证一条慢查询占一行
+    for (char c : sql) {
+        log << ((c == '\n' || c == '\r') ? ' ' : c);
+    }
+    log << '\n';
+}
+
+std::vector<QueryStatsSnapshot> QueryStats::snapshot() const {
+    std::vector<QueryStatsSnapshot> result;
+    {
+        std::shared_lock<std::shared_mutex> lock(entriesMutex);
+        result.reserve(entries.size());
+        for (const auto& item : entries) {
+            QueryStatsSnapshot stats = item.second->snapshot();
+            if (stats.calls > 0) {
+                result.push_back(std::move(stats));
+            }
+        }
+    }
+    std::sort(result.begin(), result.end(), [](const QueryStatsSnapshot& a, const QueryStatsSnapshot& b) {
+        return a.avgMs * a.calls > b.avgMs * b.calls;
+    });
+    return result;
+}
+
+std::string QueryStats::toJson() const {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(3);
+    out << "{\n  \"slowQueryThresholdMs\": " << slowThresholdMs.load() << ",\n  \"queries\": [";
+
+    bool first = true;
+    for (const auto& stats : snapshot()) {
+        out << (first ? "\n" : ",\n") << "    {\"fingerprint\": ";
+        writeJsonString(out, stats.fingerprint);
+        out << ", \"calls\": " << stats.calls
+            << ", \"errors\": " << stats.errors
+            << ", \"rows\": " << stats.rows
+            << ", \"bytes\": " << stats.bytes
+            << ", \"avgMs\": " << stats.avgMs
+            << ", \"p50Ms\": " << stats.p50Ms
+            << ", \"p95Ms\": " << stats.p95Ms
+            << ", \"p99Ms\": " << stats.p99Ms
+            << ", \"maxMs\": " << stats.maxMs << "}";
+        first = false;
+    }
+    out << (first ? "]\n}\n" : "\n  ]\n}\n");
+    return out.str();
+}
+
+bool QueryStats::dumpJson(const std::string& path) const {
+    std::ofstream out(std::filesystem::u8path(path), std::ios::binary | std::ios::trunc);
+    if (!out) {
+        return false;
+    }
+    out << toJson();
+    return static_cast<bool>(out);
+}
+
+void QueryStats::reset() {
+    // 只清零计数，不删除入口：预处理语句缓存中持有入口指针
+    std::shared_lock<std::shared_mutex> lock(entriesMutex);
+    for (auto& item : entries) {
+        Entry& entry = *item.second;
+        entry.calls = 0;
+        entry.errors = 0;
+        entry.rows = 0;
+        entry.bytes = 0;
+        entry.totalMicros = 0;
+        entry.maxMicros = 0;
+        for (auto& bucket : entry.buckets) {
+            bucket = 0;
+        }
+    }
+}
+
+std::string QueryStats::fingerprint(std::string_view sql) {
+    std::string result;
+    result.reserve(sql.size());
+
+    auto appendSpace = [&result]() {
+        if (!result.empty() && result.back() != ' ') {
+            result.push_back(' ');
+        }
+    };
+
+    std::size_t i = 0;
+    while (i < sql.size()) {
+        char c = sql[i];
+
+        if (std::isspace(static_cast<unsigned char>(c))) {
+            appendSpace();
+            ++i;
+        }
+        else if (c == '\'' || c == '"') {
+            // 字符串字面量（支持反斜杠转义和双写引号）
+            char quote = c;
+            ++i;
+            while (i < sql.size()) {
+                if (sql[i] == '\\') {
+                    i += 2;
+                    continue;
+                }
+                if (sql[i] == quote) {
+                    if (i + 1 < sql.size() && sql[i + 1] == quote) {
+                        i += 2;
+                        continue;
+                    }
+                    break;
+                }
+                ++i;
+            }
+            ++i;
+            result.push_back('?');
+        }
+        else if (c == '`') {
+            // 反引号标识符原样保留
+            std::size_t end = sql.find('`', i + 1);
+            end = end == std::string_view::npos ? sql.size() : end + 1;
+            result.append(sql.substr(i, end - i));
+            i = end;
+        }
+        else if (std::isdigit(static_cast<unsigned char>(c))
+            && (result.empty() || !isIdentifierChar(result.back()))) {
+            // 数字字面量（含小数和负号前缀之外的部分）
+            while (i < sql.size() && (std::isalnum(static_cast<unsigned char>(sql[i])) || sql[i] == '.')) {
+                ++i;
+            }
+            result.push_back('?');
+        }
+        else if (isIdentifierChar(c)) {
+            while (i < sql.size() && isIdentifierChar(sql[i])) {
+                result.push_back(static_cast<char>(std::tolower(static_cast<unsigned char>(sql[i]))));
+                ++i;
+            }
+        }
+        else {
+            result.push_back(c);
+            ++i;
+        }
+    }
+
+    while (!result.empty() && (result.back() == ' ' || result.back() == ';')) {
+        result.pop_back();
+    }
+
+    // IN (?, ?, ?) 合并为 IN (?+)，不同长度的列表归为同一指纹
+    std::string collapsed;
+    collapsed.reserve(result.size());
+    for (std::size_t pos = 0; pos < result.size();) {
+        bool wordStart = collapsed.empty() || !isIdentifierChar(collapsed.back());
+        if (wordStart && (result.compare(pos, 4, "in (") == 0 || result.compare(pos, 3, "in(") == 0)) {
+            std::size_t open = result.find('(', pos);
+            std::size_t close = result.find(')', open);
+            if (close != std::string::npos) {
+                std::string_view inner(result.data() + open + 1, close - open - 1);
+                bool onlyPlaceholders = !inner.empty()
+                    && inner.find_first_not_of("?, ") == std::string_view::npos;
+                if (onlyPlaceholders) {
+                    collapsed.append("in (?+)");
+                    pos = close + 1;
+                    continue;
+                }
+            }
+        }
+        collapsed.push_back(result[pos]);
+        ++pos;
+    }
+    return collapsed;
+}
@@ -0,0 +1,94 @@
+﻿#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// 单条查询指纹的统计快照
+struct QueryStatsSnapshot {
+    std::string fingerprint;
+    std::uint64_t calls = 0;
+    std::uint64_t errors = 0;
+    std::uint64_t rows = 0;
+    std::uint64_t bytes = 0;
+    double avgMs = 0.0;
+    double p50Ms = 0.0;
+    double p95Ms = 0.0;
+    double p99Ms = 0.0;
+    double maxMs = 0.0;
+};
+
+// 按查询指纹（字面量替换为?、空白合并后的SQL）统计调用次数、返回行数、传输字节数和耗时分布
+// 耗时直方图和各计数器均为原子变量，记录时不加锁；只有首次出现新指纹时才加写锁
+class QueryStats {
+public:
+    // 对数分桶：8微秒以下逐微秒，之后每个2的幂区间分4个桶，上限约1分钟
+    static constexpr std::size_t kBucketCount = 8 + 24 * 4;
+
+    class Entry {
+    public:
+        explicit Entry(std::string fingerprint) : fingerprint(std::move(fingerprint)) {}
+
+        void record(std::uint64_t micros, std::uint64_t rows, std::uint64_t bytes, bool ok);
+        QueryStatsSnapshot snapshot() const;
+        const std::string& getFingerprint() const { return fingerprint; }
+
+    private:
+        friend class QueryStats;
+
+        std::string fingerprint;
+        std::atomic<std::uint64_t> calls{ 0 };
+        std::atomic<std::uint64_t> errors{ 0 };
+        std::atomic<std::uint64_t> rows{ 0 };
+        std::atomic<std::uint64_t> bytes{ 0 };
+        std::atomic<std::uint64_t> totalMicros{ 0 };
+        std::atomic<std::uint64_t> maxMicros{ 0 };
+        std::array<std::atomic<std::uint64_t>, kBucketCount> buckets{};
+    };
+
+    QueryStats() = default;
+
+    // 记录一次执行；超过慢查询阈值时写入慢查询日志（记录原始SQL）
+    void record(std::string_view sql, std::chrono::steady_clock::duration elapsed,
+        std::uint64_t rows, std::uint64_t bytes, bool ok);
+    // 已知指纹入口的快速路径（预处理语句缓存入口指针，避免每次重新计算指纹）
+    void record(Entry& entry, std::string_view sql, std::chrono::steady_clock::duration elapsed,
+        std::uint64_t rows, std::uint64_t bytes, bool ok);
+    Entry& entryFor(std::string_view sql);
+
+    // 统计开关与慢查询日志配置
+    void setEnabled(bool enabled) { this->enabled = enabled; }
+    bool isEnabled() const { return enabled; }
+    void setSlowQueryThreshold(std::chrono::milliseconds threshold);
+    std::chrono::milliseconds getSlowQueryThreshold() const;
+    void setSlowQueryLogPath(const std::string& path);  // UTF-8路径，为空时不写日志
+    std::string getSlowQueryLogPath() const;
+
+    // 查询结果：按总耗时从高到低排序
+    std::vector<QueryStatsSnapshot> snapshot() const;
+    std::string toJson() const;
+    bool dumpJson(const std::string& path) const;
+    void reset();
+
+    // 归一化SQL：字符串和数字字面量替换为?，IN列表合并，连续空白合并为一个空格，关键字统一小写
+    static std::string fingerprint(std::string_view sql);
+
+private:
+    void writeSlowQuery(std::string_view sql, double elapsedMs, std::uint64_t rows);
+
+    std::atomic<bool> enabled{ true };
+    std::atomic<long long> slowThresholdMs{ 200 };
+
+    mutable std::shared_mutex entriesMutex;
+    std::unordered_map<std::string, std::unique_ptr<Entry>> entries;
+
+    mutable std::mutex slowLogMutex;
+    std::string slowLogPath = "slow_query.log";
+};
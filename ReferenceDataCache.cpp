@@ -0,0 +1,176 @@
+﻿#include "ReferenceDataCache.h"
+#include "DatabaseManager.h"
+#include "RowMapping.h"
+#include "PinyinIndex.h"
+#include <algorithm>
+
+namespace {
+    // 医生行额外带上department_id，用于按科室ID归类
+    struct DoctorColumns {
+        int doctorId = 0;
+        std::string name;
+        std::string gender;
+        int age = 0;
+        std::string phone;
+        std::string department;
+        int departmentId = 0;
+
+        DoctorInfo toDoctorInfo() const {
+            return DoctorInfo(doctorId, name, gender, age, phone, department);
+        }
+
+        static constexpr auto columns() {
+            return std::make_tuple(&DoctorColumns::doctorId, &DoctorColumns::name, &DoctorColumns::gender,
+                &DoctorColumns::age, &DoctorColumns::phone, &DoctorColumns::department,
+                &DoctorColumns::departmentId);
+        }
+    };
+
+    const std::vector<DoctorInfo> kNoDoctors;
+
+    // 按拼音排序：排序键每项只算一次，比较时直接按字节比较
+    template<typename T, typename NameOf>
+    void sortByPinyin(std::vector<T>& items, NameOf nameOf) {
+        std::vector<std::pair<std::string, std::size_t>> keys;
+        keys.reserve(items.size());
+        for (std::size_t i = 0; i < items.size(); ++i) {
+            keys.emplace_back(PinyinIndex::collationKey(nameOf(items[i])), i);
+        }
+        std::sort(keys.begin(), keys.end());
+
+        std::vector<T> sorted;
+        sorted.reserve(items.size());
+        for (const auto& key : keys) {
+            sorted.push_back(std::move(items[key.second]));
+        }
+        items = std::move(sorted);
+    }
+}
+
+const DepartmentInfo* ReferenceDataCache::Snapshot::findDepartment(int departmentId) const {
+    auto it = departmentIndexById.find(departmentId);
+    return it == departmentIndexById.end() ? nullptr : &departments[it->second];
+}
+
+const DepartmentInfo* ReferenceDataCache::Snapshot::findDepartment(const std::string& name) const {
+    auto it = departmentIndexByName.find(name);
+    return it == departmentIndexByName.end() ? nullptr : &departments[it->second];
+}
+
+const std::vector<DoctorInfo>& ReferenceDataCache::Snapshot::doctorsIn(int departmentId) const {
+    auto it = doctorsByDepartmentId.find(departmentId);
+    return it == doctorsByDepartmentId.end() ? kNoDoctors : it->second;
+}
+
+const std::vector<DoctorInfo>& ReferenceDataCache::Snapshot::doctorsIn(const std::string& departmentName) const {
+    auto it = doctorsByDepartmentName.find(departmentName);
+    return it == doctorsByDepartmentName.end() ? kNoDoctors : it->second;
+}
+
+ReferenceDataCache::ReferenceDataCache(DatabaseManager& db) : db(db) {
+}
+
+std::shared_ptr<const ReferenceDataCache::Snapshot> ReferenceDataCache::snapshot(std::string* error) {
+    auto isFresh = [this](const std::shared_ptr<const Snapshot>& snapshot) {
+        return snapshot && snapshot->version == currentVersion.load()
+            && std::chrono::steady_clock::now() - snapshot->loadedAt < std::chrono::seconds(maxAgeSeconds.load());
+    };
+
+    {
+        std::lock_guard<std::mutex> lock(snapshotMutex);
+        if (isFresh(current)) {
+            return current;
+        }
+    }
+
+    // 并发读取时只加载一次，其余线程等待后直接使用新快照
+    std::lock_guard<std::mutex> loading(loadMutex);
+    {
+        std::lock_guard<std::mutex> lock(snapshotMutex);
+        if (isFresh(current)) {
+            return current;
+        }
+    }
+
+    // 先取版本号再查询：加载期间发生的修改会使该快照立即过期
+    std::string loadError;
+    std::shared_ptr<const Snapshot> loaded = load(currentVersion.load(), loadError);
+    if (!loaded) {
+        if (error) {
+            *error = loadError;
+        }
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(snapshotMutex);
+    current = loaded;
+    return loaded;
+}
+
+void ReferenceDataCache::invalidate() {
+    ++currentVersion;
+}
+
+std::uint64_t ReferenceDataCache::version() const {
+    return currentVersion.load();
+}
+
+void ReferenceDataCache::setMaxAge(std::chrono::seconds maxAge) {
+    maxAgeSeconds = maxAge.count();
+}
+
+std::shared_ptr<const ReferenceDataCache::Snapshot> ReferenceDataCache::load(std::uint64_t version,
+    std::string& error) {
+
+    auto snapshot = std::make_shared<Snapshot>();
+    snapshot->version = version;
+    snapshot->loadedAt = std::chrono::steady_clock::now();
+
+    snapshot->departments = RowMapping::queryAll<DepartmentInfo>(db,
+        "SELECT department_id, department_name, description, contact_phone, location "
+        "FROM departments", {}, &error);
+    if (!error.empty()) {
+        error = "加载科室数据失败: " + error;
+        return nullptr;
+    }
+
+    std::vector<DoctorColumns> doctors = RowMapping::queryAll<DoctorColumns>(db,
+        "SELECT doctor_id, name, gender, age, phone, department, department_id FROM doctors",
+        {}, &error);
+    if (!error.empty()) {
+        error = "加载医生数据失败: " + error;
+        return nullptr;
+    }
+
+    // 数据库按编码排序中文，这里改为按拼音排序
+    sortByPinyin(snapshot->departments, [](const DepartmentInfo& dept) { return dept.departmentName; });
+    sortByPinyin(doctors, [](const DoctorColumns& doctor) { return doctor.name; });
+
+    for (std::size_t i = 0; i < snapshot->departments.size(); ++i) {
+        snapshot->departmentIndexById[snapshot->departments[i].departmentId] = i;
+        snapshot->departmentIndexByName[snapshot->departments[i].departmentName] = i;
+    }
+
+    snapshot->doctors.reserve(doctors.size());
+    for (const DoctorColumns& doctor : doctors) {
+        DoctorInfo info = doctor.toDoctorInfo();
+        snapshot->doctors.push_back(info);
+        snapshot->doctorsByDepartmentName[info.department].push_back(info);
+
+        if (doctor.departmentId > 0) {
+            // 按科室ID查询时科室名称以科室表为准
+            if (const DepartmentInfo* dept = snapshot->findDepartment(doctor.departmentId)) {
+                info.department = dept->departmentName;
+            }
+            snapshot->doctorsByDepartmentId[doctor.departmentId].push_back(info);
+        }
+    }
+
+    for (const DepartmentInfo& dept : snapshot->departments) {
+        if (snapshot->doctorsByDepartmentId.count(dept.departmentId)) {
+            snapshot->availableDepartments.push_back(dept);
+        }
+    }
+
+    return snapshot;
+}
@@ -0,0 +1,61 @@
+﻿#pragma once
+#include "CommonTypes.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class DatabaseManager;
+
+// 医生、科室等参考数据的进程内缓存
+// 数据整体加载为只读快照，读取方持有shared_ptr，无需加锁；
+// 写操作成功后调用invalidate()递增版本号，下次读取时重新加载
+class ReferenceDataCache {
+public:
+    struct Snapshot {
+        std::uint64_t version = 0;
+        std::chrono::steady_clock::time_point loadedAt;
+
+        std::vector<DoctorInfo> doctors;                // 按姓名拼音排序
+        std::vector<DepartmentInfo> departments;        // 按科室名称拼音排序
+        std::vector<DepartmentInfo> availableDepartments; // 有医生的科室，顺序同departments
+
+        std::unordered_map<int, std::size_t> departmentIndexById;
+        std::unordered_map<std::string, std::size_t> departmentIndexByName;
+        // 科室 → 医生（按doctors.department文本和doctors.department_id两种方式归类）
+        std::unordered_map<std::string, std::vector<DoctorInfo>> doctorsByDepartmentName;
+        std::unordered_map<int, std::vector<DoctorInfo>> doctorsByDepartmentId;
+
+        const DepartmentInfo* findDepartment(int departmentId) const;
+        const DepartmentInfo* findDepartment(const std::string& name) const;
+        const std::vector<DoctorInfo>& doctorsIn(int departmentId) const;
+        const std::vector<DoctorInfo>& doctorsIn(const std::string& departmentName) const;
+    };
+
+    explicit ReferenceDataCache(DatabaseManager& db);
+
+    // 返回当前快照；版本已失效或超过最长缓存时间时重新加载，加载失败返回nullptr并设置error
+    std::shared_ptr<const Snapshot> snapshot(std::string* error = nullptr);
+
+    // 数据已变更，丢弃当前快照
+    void invalidate();
+    std::uint64_t version() const;
+
+    // 其他客户端的修改本机无法感知，超过该时间也重新加载（默认5分钟）
+    void setMaxAge(std::chrono::seconds maxAge);
+
+private:
+    std::shared_ptr<const Snapshot> load(std::uint64_t version, std::string& error);
+
+    DatabaseManager& db;
+    std::atomic<std::uint64_t> currentVersion{ 1 };
+    std::atomic<long long> maxAgeSeconds{ 300 };
+
+    mutable std::mutex snapshotMutex;
+    std::shared_ptr<const Snapshot> current;
+    std::mutex loadMutex;   // 同一时间只有一个线程从数据库加载
+};
@@ -0,0 +1,65 @@
+﻿#include "RefreshScheduler.h"
+#include <algorithm>
+
+namespace {
+    // 等待上一次查询返回时的检查间隔
+    constexpr int kWaitPollMs = 50;
+}
+
+RefreshScheduler::RefreshScheduler(int debounceMs) : debounce(debounceMs) {
+    timer.setSingleShot(true);
+    QObject::connect(&timer, &QTimer::timeout, &timer, [this]() { run(); });
+}
+
+void RefreshScheduler::addView(int view, QWidget* widget, std::function<void()> refresh, const AsyncTask* task) {
+    View& entry = views[view];
+    entry.widget = widget;
+    entry.refresh = std::move(refresh);
+    entry.task = task;
+}
+
+void RefreshScheduler::request(int view) {
+    auto it = views.find(view);
+    if (it == views.end()) return;
+
+    it->second.dirty = true;
+    schedulePending();
+}
+
+void RefreshScheduler::request(std::initializer_list<int> ids) {
+    for (int view : ids) {
+        request(view);
+    }
+}
+
+void RefreshScheduler::schedulePending() {
+    // 已在计时时不重新计时，持续的请求不会把刷新无限推后
+    if (!timer.isActive()) {
+        timer.start(debounce);
+    }
+}
+
+void RefreshScheduler::run() {
+    bool waiting = false;
+    for (auto& item : views) {
+        View& view = item.second;
+        if (!view.dirty) continue;
+
+        // 不可见的视图等页面显示后再刷新；第一次加载除外，预先创建的页面在后台填充数据
+        if (view.loaded && view.widget && !view.widget->isVisibleTo(view.widget->window())) continue;
+
+        // 上一次查询返回后再执行，期间的请求合并为一次
+        if (view.task && view.task->isRunning()) {
+            waiting = true;
+            continue;
+        }
+
+        view.dirty = false;
+        view.loaded = true;
+        view.refresh();
+    }
+
+    if (waiting) {
+        timer.start(std::max(debounce, kWaitPollMs));
+    }
+}
@@ -0,0 +1,44 @@
+﻿#pragma once
+#include "AsyncTask.h"
+#include <QTimer>
+#include <QWidget>
+#include <functional>
+#include <initializer_list>
+#include <map>
+
+// 界面刷新调度：刷新请求只把视图标记为待刷新，防抖窗口结束后统一执行，
+// 同一窗口内对同一视图的多次请求只执行一次
+// 视图所在页面不可见时保持待刷新状态，页面切换回来（schedulePending）后再执行，
+// 但登记后的第一次加载不等待页面可见；
+// 视图上一次的后台查询尚未返回时也先等待，不叠加重复查询
+class RefreshScheduler {
+public:
+    explicit RefreshScheduler(int debounceMs = 0);
+
+    void setDebounce(int debounceMs) { debounce = debounceMs; }
+
+    // 登记视图：widget用于判断是否可见（为空表示总是刷新），task为视图的后台查询（可为空）
+    void addView(int view, QWidget* widget, std::function<void()> refresh, const AsyncTask* task = nullptr);
+
+    void request(int view);
+    void request(std::initializer_list<int> ids);
+
+    // 可见性变化（如切换标签页）后执行此前因不可见而推迟的刷新
+    void schedulePending();
+
+private:
+    struct View {
+        QWidget* widget = nullptr;
+        std::function<void()> refresh;
+        const AsyncTask* task = nullptr;
+        bool dirty = false;
+        bool loaded = false;
+    };
+
+    void run();
+
+    // 按视图编号顺序执行，调用方可以用编号安排先后
+    std::map<int, View> views;
+    QTimer timer;
+    int debounce;
+};
@@ -0,0 +1,164 @@
+﻿#include "RegistrationTableModel.h"
+#include "ActionButtonDelegate.h"
+#include <QColor>
+#include <algorithm>
+
+RegistrationTableModel::RegistrationTableModel(std::vector<ColumnSpec> columns, QObject* parent)
+    : QAbstractTableModel(parent), columns(std::move(columns)) {
+}
+
+int RegistrationTableModel::rowCount(const QModelIndex& parent) const {
+    return parent.isValid() ? 0 : static_cast<int>(rows.size());
+}
+
+int RegistrationTableModel::columnCount(const QModelIndex& parent) const {
+    return parent.isValid() ? 0 : static_cast<int>(columns.size());
+}
+
+QVariant RegistrationTableModel::data(const QModelIndex& index, int role) const {
+    if (!index.isValid() || index.row() >= rowCount() || index.column() >= columnCount()) {
+        return QVariant();
+    }
+
+    const RegistrationInfo& reg = rows[static_cast<std::size_t>(index.row())];
+    Column column = columns[static_cast<std::size_t>(index.column())].column;
+
+    switch (role) {
+    case Qt::DisplayRole:
+        return displayText(reg, column);
+    case Qt::TextAlignmentRole:
+        if (column == Column::Status) {
+            return static_cast<int>(Qt::AlignCenter);
+        }
+        break;
+    case Qt::ForegroundRole:
+        if (column == Column::Status) {
+            if (reg.status == "pending") return QColor("#f59e0b");
+            if (reg.status == "completed") return QColor("#10b981");
+            return QColor("#ef4444");
+        }
+        break;
+    case ActionButtonDelegate::ActionsRole:
+        if ((column == Column::Actions || column == Column::Delete) && actionProvider) {
+            return actionProvider(reg, column);
+        }
+        break;
+    case Qt::UserRole:
+        // 所有列都可取到挂号单号
+        return reg.registrationId;
+    default:
+        break;
+    }
+    return QVariant();
+}
+
+QVariant RegistrationTableModel::displayText(const RegistrationInfo& reg, Column column) const {
+    switch (column) {
+    case Column::Id:         return reg.registrationId;
+    case Column::Date:       return QString::fromStdString(reg.registrationDate);
+    case Column::Patient:    return QString::fromStdString(reg.patientName);
+    case Column::PatientId:  return QString("病人ID: %1").arg(reg.patientId);
+    case Column::Doctor:     return QString::fromStdString(reg.doctorName);
+    case Column::Department: return QString::fromStdString(reg.doctorDepartment);
+    case Column::Notes:      return QString::fromStdString(reg.notes);
+    case Column::Status:
+        if (reg.status == "pending") return QString("待处理");
+        if (reg.status == "completed") return QString("已完成");
+        return QString("已取消");
+    case Column::Amount:
+        return reg.hasBill ? QString("¥%1").arg(reg.billAmount, 0, 'f', 2) : unbilledText;
+    case Column::BillStatus:
+        return reg.hasBill ? QString("已结算") : QString("未结算");
+    default:
+        return QVariant();
+    }
+}
+
+QVariant RegistrationTableModel::headerData(int section, Qt::Orientation orientation, int role) const {
+    if (orientation == Qt::Horizontal && role == Qt::DisplayRole
+        && section >= 0 && section < columnCount()) {
+        return columns[static_cast<std::size_t>(section)].title;
+    }
+    return QAbstractTableModel::headerData(section, orientation, role);
+}
+
+bool RegistrationTableModel::canFetchMore(const QModelIndex& parent) const {
+    return !parent.isValid() && hasMore && !fetching && fetchMoreHandler;
+}
+
+void RegistrationTableModel::fetchMore(const QModelIndex& parent) {
+    if (!canFetchMore(parent)) return;
+
+    // 下一页返回前视图可能再次询问，不重复请求
+    fetching = true;
+    fetchMoreHandler();
+}
+
+void RegistrationTableModel::setRegistrations(std::vector<RegistrationInfo> registrations) {
+    beginResetModel();
+    rows = std::move(registrations);
+    endResetModel();
+}
+
+void RegistrationTableModel::appendRegistrations(const std::vector<RegistrationInfo>& registrations) {
+    if (registrations.empty()) return;
+
+    int first = static_cast<int>(rows.size());
+    beginInsertRows(QModelIndex(), first, first + static_cast<int>(registrations.size()) - 1);
+    rows.insert(rows.end(), registrations.begin(), registrations.end());
+    endInsertRows();
+}
+
+int RegistrationTableModel::rowOf(int registrationId) const {
+    auto it = std::find_if(rows.begin(), rows.end(), [registrationId](const RegistrationInfo& reg) {
+        return reg.registrationId == registrationId;
+    });
+    return it == rows.end() ? -1 : static_cast<int>(it - rows.begin());
+}
+
+bool RegistrationTableModel::updateRegistration(const RegistrationInfo& reg) {
+    int row = rowOf(reg.registrationId);
+    if (row < 0) return false;
+
+    rows[static_cast<std::size_t>(row)] = reg;
+    emit dataChanged(index(row, 0), index(row, columnCount() - 1));
+    return true;
+}
+
+bool RegistrationTableModel::insertRegistration(const RegistrationInfo& reg) {
+    if (rowOf(reg.registrationId) >= 0) return false;
+
+    // 按日期降序，新挂号排在同一天已有挂号之前
+    auto it = std::find_if(rows.begin(), rows.end(), [&reg](const RegistrationInfo& existing) {
+        return existing.registrationDate <= reg.registrationDate;
+    });
+    int row = static_cast<int>(it - rows.begin());
+    if (it == rows.end() && (hasMore || fetching)) return false;
+
+    beginInsertRows(QModelIndex(), row, row);
+    rows.insert(it, reg);
+    endInsertRows();
+    return true;
+}
+
+bool RegistrationTableModel::removeRegistration(int registrationId) {
+    int row = rowOf(registrationId);
+    if (row < 0) return false;
+
+    beginRemoveRows(QModelIndex(), row, row);
+    rows.erase(rows.begin() + row);
+    endRemoveRows();
+    return true;
+}
+
+void RegistrationTableModel::refreshActions(int registrationId) {
+    int row = rowOf(registrationId);
+    if (row < 0) return;
+
+    for (int i = 0; i < columnCount(); ++i) {
+        Column column = columns[static_cast<std::size_t>(i)].column;
+        if (column == Column::Actions || column == Column::Delete) {
+            emit dataChanged(index(row, i), index(row, i), { ActionButtonDelegate::ActionsRole });
+        }
+    }
+}
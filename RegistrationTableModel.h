@@ -0,0 +1,83 @@
+﻿#pragma once
+#include "CommonTypes.h"
+#include <QAbstractTableModel>
+#include <QVariantList>
+#include <functional>
+#include <vector>
+
+// 挂号表格的数据模型：病人、医生、管理员三种界面共用，各自选择要显示的列
+// 只保存挂号记录本身，单元格文字在视图绘制可见行时才生成
+// 操作列不放按钮控件，而是通过ActionsRole返回按钮编号，由ActionButtonDelegate绘制和响应点击
+class RegistrationTableModel : public QAbstractTableModel {
+public:
+    enum class Column {
+        Id,
+        Date,
+        Patient,
+        PatientId,
+        Doctor,
+        Department,
+        Notes,
+        Status,
+        Amount,
+        BillStatus,
+        Actions,
+        Delete
+    };
+
+    struct ColumnSpec {
+        Column column;
+        QString title;
+    };
+
+    // 返回某条挂号在操作列中显示的按钮编号（如待处理的挂号才显示取消）
+    using ActionProvider = std::function<QVariantList(const RegistrationInfo& reg, Column column)>;
+
+    explicit RegistrationTableModel(std::vector<ColumnSpec> columns, QObject* parent = nullptr);
+
+    void setActionProvider(ActionProvider provider) { actionProvider = std::move(provider); }
+    // 未结算挂号在费用列显示的文字
+    void setUnbilledText(const QString& text) { unbilledText = text; }
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+    // 分页加载：视图滚动到底部时调用fetchMore处理函数，调用方取到下一页后appendRegistrations，
+    // 并用setMoreAvailable说明是否还有下一页；在此之前不会再次触发
+    bool canFetchMore(const QModelIndex& parent) const override;
+    void fetchMore(const QModelIndex& parent) override;
+    void setFetchMoreHandler(std::function<void()> handler) { fetchMoreHandler = std::move(handler); }
+    void setMoreAvailable(bool available) {
+        hasMore = available;
+        fetching = false;
+    }
+
+    // 整表替换，调用方保证按日期降序
+    void setRegistrations(std::vector<RegistrationInfo> registrations);
+    void appendRegistrations(const std::vector<RegistrationInfo>& registrations);
+    const RegistrationInfo& registrationAt(int row) const { return rows[static_cast<std::size_t>(row)]; }
+
+    // 按挂号单号增量更新，返回表格是否有变化
+    bool updateRegistration(const RegistrationInfo& reg);
+    // 插在同一天的最前面；已存在、或位置在已加载的行之后（会随后续分页取到）时不插入
+    bool insertRegistration(const RegistrationInfo& reg);
+    bool removeRegistration(int registrationId);
+
+    // 操作列的按钮集合依赖模型之外的状态（如结算进行中）时，状态变化后通知视图重绘该行
+    void refreshActions(int registrationId);
+
+    int rowOf(int registrationId) const;
+
+private:
+    QVariant displayText(const RegistrationInfo& reg, Column column) const;
+
+    std::vector<ColumnSpec> columns;
+    std::vector<RegistrationInfo> rows;
+    ActionProvider actionProvider;
+    std::function<void()> fetchMoreHandler;
+    bool hasMore = false;
+    bool fetching = false;
+    QString unbilledText = "待结算";
+};
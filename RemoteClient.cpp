@@ -0,0 +1,121 @@
+﻿#include "RemoteClient.h"
+#include "ServiceProtocol.h"
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTcpSocket>
+#include <memory>
+#include <unordered_map>
+
+std::atomic<std::uint64_t> RemoteClient::nextClientId{ 1 };
+
+namespace {
+    // QTcpSocket只能在创建它的线程中使用，因此连接按线程保存，线程结束时随之释放
+    struct ThreadConnection {
+        std::unique_ptr<QTcpSocket> socket;
+        std::uint64_t loginGeneration = 0;     // 该连接登录时的账号版本，0为未登录
+    };
+
+    thread_local std::unordered_map<std::uint64_t, ThreadConnection> threadConnections;
+    thread_local std::int64_t nextRequestId = 1;
+}
+
+RemoteClient::RemoteClient(std::string host, unsigned short port, int timeoutMs)
+    : serverHost(std::move(host)), serverPort(port), timeoutMs(timeoutMs), clientId(nextClientId++) {
+}
+
+void RemoteClient::setLogin(const std::string& username, const std::string& password, const std::string& role) {
+    std::lock_guard<std::mutex> lock(loginMutex);
+    loginArgs = QJsonArray{ QString::fromStdString(username), QString::fromStdString(password),
+        QString::fromStdString(role) };
+    ++loginGeneration;
+}
+
+bool RemoteClient::exchange(QTcpSocket& socket, const std::string& method, const QJsonArray& args,
+    QJsonObject& response, std::string& error) {
+    std::int64_t requestId = nextRequestId++;
+    QJsonObject request;
+    request["id"] = static_cast<double>(requestId);
+    request["method"] = QString::fromStdString(method);
+    request["args"] = args;
+    QByteArray line = QJsonDocument(request).toJson(QJsonDocument::Compact);
+    line.append('\n');
+
+    socket.write(line);
+    bool sent = socket.waitForBytesWritten(timeoutMs);
+    while (sent && !socket.canReadLine()) {
+        if (!socket.waitForReadyRead(timeoutMs)) {
+            sent = false;
+        }
+    }
+    if (!sent) {
+        error = "挂号服务通信失败: " + socket.errorString().toStdString();
+        return false;
+    }
+
+    response = QJsonDocument::fromJson(socket.readLine()).object();
+    if (response.value("id").toDouble() != static_cast<double>(requestId)) {
+        error = "挂号服务应答无效";
+        return false;
+    }
+    return true;
+}
+
+bool RemoteClient::call(const std::string& method, const QJsonArray& args, Reply& reply) {
+    reply = Reply();
+
+    // 复用的连接可能已被服务端关闭（服务重启），此时重连后再发一次；
+    // 超时不重发，避免写操作在服务端执行两次
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        ThreadConnection& connection = threadConnections[clientId];
+        std::unique_ptr<QTcpSocket>& socket = connection.socket;
+        bool reused = socket && socket->state() == QAbstractSocket::ConnectedState;
+        if (!reused) {
+            socket = std::make_unique<QTcpSocket>();
+            connection.loginGeneration = 0;
+            socket->connectToHost(QString::fromStdString(serverHost), serverPort);
+            if (!socket->waitForConnected(timeoutMs)) {
+                reply.error = "无法连接挂号服务: " + socket->errorString().toStdString();
+                socket.reset();
+                return false;
+            }
+        }
+
+        // 该连接尚未以当前账号登录时先登录
+        QJsonObject response;
+        std::uint64_t generation = loginGeneration;
+        bool sent = true;
+        if (method != "login" && generation != 0 && connection.loginGeneration != generation) {
+            QJsonArray credentials;
+            {
+                std::lock_guard<std::mutex> lock(loginMutex);
+                credentials = loginArgs;
+            }
+            sent = exchange(*socket, "login", credentials, response, reply.error);
+            if (sent) {
+                UserInfo user;
+                ServiceProtocol::decode(response.value("result"), user);
+                if (user.userId == 0) {
+                    reply.error = "登录挂号服务失败: " + response.value("error").toString().toStdString();
+                    return false;
+                }
+                connection.loginGeneration = generation;
+            }
+        }
+
+        if (sent) {
+            sent = exchange(*socket, method, args, response, reply.error);
+        }
+        if (!sent) {
+            bool closedByServer = reused && socket->error() == QAbstractSocket::RemoteHostClosedError;
+            socket.reset();
+            if (closedByServer) continue;
+            return false;
+        }
+
+        reply.result = response.value("result");
+        reply.error = response.value("error").toString().toStdString();
+        ServiceProtocol::decode(response.value("events"), reply.events);
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,52 @@
+﻿#pragma once
+#include "ChangeEventBus.h"
+#include <QJsonArray>
+#include <QJsonValue>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class QJsonObject;
+class QTcpSocket;
+
+// 挂号服务客户端：把调用按ServiceProtocol发送到Hospital.exe --serve并同步等待应答
+// 每个调用线程（UI线程和后台线程池的各线程）各自持有一条TCP连接，线程退出时关闭；
+// 连接断开后下一次调用时重新连接；服务重启导致复用的连接失效时自动重发一次
+// 服务端按连接鉴权：setLogin之后，每条新建的连接（及账号变更前建立的连接）在第一次调用前先登录
+class RemoteClient {
+public:
+    struct Reply {
+        QJsonValue result;
+        std::string error;                  // 服务端设置的错误信息，或网络错误
+        std::vector<ChangeEvent> events;    // 调用期间服务端产生的变更事件
+    };
+
+    RemoteClient(std::string host, unsigned short port, int timeoutMs = 15000);
+
+    const std::string& host() const { return serverHost; }
+    unsigned short port() const { return serverPort; }
+
+    // 网络错误、超时或应答无法解析时返回false，reply.error为原因
+    bool call(const std::string& method, const QJsonArray& args, Reply& reply);
+
+    // 登录成功后设置账号，此后各线程的连接都以该账号登录
+    void setLogin(const std::string& username, const std::string& password, const std::string& role);
+
+private:
+    // 在socket上发送一条请求并读取应答；网络错误时返回false，error为原因
+    bool exchange(QTcpSocket& socket, const std::string& method, const QJsonArray& args,
+        QJsonObject& response, std::string& error);
+
+    std::string serverHost;
+    unsigned short serverPort;
+    int timeoutMs;
+    std::uint64_t clientId;     // 区分同一线程上不同客户端的连接
+
+    std::mutex loginMutex;
+    QJsonArray loginArgs;
+    std::atomic<std::uint64_t> loginGeneration{ 0 };    // 每次setLogin加1，连接记录自己登录时的值
+
+    static std::atomic<std::uint64_t> nextClientId;
+};
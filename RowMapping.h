@@ -0,0 +1,122 @@
+﻿#pragma once
+// 查询结果到CommonTypes结构体的编译期映射
+// 每个结构体通过 static columns() 按SELECT列顺序声明成员指针，
+// 这里按成员类型从 StatementRow（预处理语句绑定缓冲区）或 ResultRow（MYSQL_ROW）直接解码，
+// 数值列不经过中间字符串，字符串列直接assign复用已有容量
+#include "DatabaseManager.h"
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace RowMapping {
+
+    // 结构体声明的列数（编译期常量）
+    template<typename T>
+    constexpr unsigned int columnCount = static_cast<unsigned int>(std::tuple_size_v<decltype(T::columns())>);
+
+    template<typename Row>
+    inline void decodeField(const Row& row, unsigned int column, int& out) {
+        out = static_cast<int>(row.getInt(column));
+    }
+
+    template<typename Row>
+    inline void decodeField(const Row& row, unsigned int column, long long& out) {
+        out = row.getInt(column);
+    }
+
+    template<typename Row>
+    inline void decodeField(const Row& row, unsigned int column, bool& out) {
+        out = row.getInt(column) != 0;
+    }
+
+    template<typename Row>
+    inline void decodeField(const Row& row, unsigned int column, double& out) {
+        out = row.getDouble(column);
+    }
+
+    template<typename Row>
+    inline void decodeField(const Row& row, unsigned int column, std::string& out) {
+        std::string_view text = row.getText(column);
+        if (text.empty() && !row.isNull(column)) {
+            // 数值列映射到字符串成员时按文本格式化
+            out = row.getString(column);
+            return;
+        }
+        out.assign(text.data(), text.size());
+    }
+
+    template<typename T, typename Row, std::size_t... I>
+    inline void mapColumns(const Row& row, T& out, std::index_sequence<I...>) {
+        constexpr auto members = T::columns();
+        (decodeField(row, static_cast<unsigned int>(I), out.*std::get<I>(members)), ...);
+    }
+
+    // 将一行解码到已有对象（调用方需保证列数足够，见queryMapped）
+    template<typename T, typename Row>
+    inline void mapRow(const Row& row, T& out) {
+        mapColumns(row, out, std::make_index_sequence<columnCount<T>>{});
+    }
+
+    // 执行预处理查询并逐行映射为T；列数只在第一行检查一次，不符时返回false并设置错误信息
+    // 回调拿到的对象在各行之间复用，需要保留时请拷贝；回调返回false提前结束
+    template<typename T, typename Fn>
+    bool queryMapped(DatabaseManager& db, const std::string& sql, const std::vector<SqlParam>& params,
+        Fn&& onItem, std::string* error = nullptr) {
+
+        bool checked = false;
+        bool mismatch = false;
+        T item;
+
+        bool ok = db.queryPrepared(sql, params, [&](const StatementRow& row) {
+            if (!checked) {
+                checked = true;
+                if (row.columnCount() != columnCount<T>) {
+                    mismatch = true;
+                    return false;
+                }
+            }
+            mapRow(row, item);
+            return static_cast<bool>(onItem(static_cast<const T&>(item)));
+        });
+
+        if (mismatch) {
+            if (error) {
+                *error = "查询结果列数与映射不一致: 期望" + std::to_string(columnCount<T>) + "列";
+            }
+            return false;
+        }
+        if (!ok && error) {
+            *error = db.getLastError();
+        }
+        return ok;
+    }
+
+    // 查询单行，未找到时返回false
+    template<typename T>
+    bool queryOne(DatabaseManager& db, const std::string& sql, const std::vector<SqlParam>& params,
+        T& out, std::string* error = nullptr) {
+
+        bool found = false;
+        bool ok = queryMapped<T>(db, sql, params, [&](const T& item) {
+            out = item;
+            found = true;
+            return false;
+        }, error);
+        return ok && found;
+    }
+
+    // 查询全部行到vector
+    template<typename T>
+    std::vector<T> queryAll(DatabaseManager& db, const std::string& sql, const std::vector<SqlParam>& params = {},
+        std::string* error = nullptr) {
+
+        std::vector<T> items;
+        queryMapped<T>(db, sql, params, [&](const T& item) {
+            items.push_back(item);
+            return true;
+        }, error);
+        return items;
+    }
+}
@@ -0,0 +1,777 @@
+﻿#include "SchemaMigrations.h"
+#include "DatabaseManager.h"
+#include <iostream>
+
+namespace {
+    // MySQL服务器错误码
+    constexpr unsigned int kErrNoSuchTable = 1146;
+    constexpr unsigned int kErrDuplicateColumn = 1060;
+    constexpr unsigned int kErrDuplicateKey = 1061;
+    constexpr unsigned int kErrDuplicateForeignKey = 1826;
+
+    const char* kMigrationLock = "hospital_system.schema_migration";
+}
+
+SchemaMigrator::SchemaMigrator(DatabaseManager& db) : db(db) {
+}
+
+const std::vector<SchemaMigration>& SchemaMigrator::migrations() {
+    static const std::vector<SchemaMigration> all = {
+        {
+            1, "基础表结构：用户、病人、科室、医生、挂号、账单及默认数据",
+            {
+                R"(
+                CREATE TABLE IF NOT EXISTS users (
+                    user_id INT AUTO_INCREMENT PRIMARY KEY,
+                    username VARCHAR(50) UNIQUE NOT NULL,
+                    password_hash VARCHAR(255) NOT NULL,
+                    role ENUM('patient', 'doctor', 'admin') NOT NULL,
+                    created_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP
+                ) ENGINE=InnoDB DEFAULT CHARSET=utf8mb4
+                )",
+                R"(
+                CREATE TABLE IF NOT EXISTS patients (
+                    patient_id INT PRIMARY KEY,
+                    name VARCHAR(100) NOT NULL,
+                    gender ENUM('male', 'female', 'other') DEFAULT 'male',
+                    age INT,
+                    address TEXT,
+                    phone VARCHAR(20),
+                    id_card VARCHAR(18),
+                    created_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP,
+                    FOREIGN KEY (patient_id) REFERENCES users(user_id) ON DELETE CASCADE
+                ) ENGINE=InnoDB DEFAULT CHARSET=utf8mb4
+                )",
+                R"(
+                CREATE TABLE IF NOT EXISTS departments (
+                    department_id INT AUTO_INCREMENT PRIMARY KEY,
+                    department_name VARCHAR(50) NOT NULL UNIQUE,
+                    description TEXT,
+                    contact_phone VARCHAR(20),
+                    location VARCHAR(100),
+                    created_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP
+                ) ENGINE=InnoDB DEFAULT CHARSET=utf8mb4
+                )",
+                R"(
+                INSERT IGNORE INTO departments (department_name, description, contact_phone, location) VALUES
+                ('内科', '诊治内科疾病，如感冒、高血压、糖尿病等', '010-12345671', '门诊楼2层201-210室'),
+                ('外科', '手术治疗，包括普外科、骨科、神经外科等', '010-12345672', '门诊楼3层301-315室'),
+                ('儿科', '0-14岁儿童疾病诊治', '010-12345673', '门诊楼1层101-110室'),
+                ('妇产科', '妇科和产科疾病，女性健康', '010-12345674', '门诊楼4层401-410室'),
+                ('眼科', '眼部疾病诊治，视力检查', '010-12345675', '门诊楼5层501-505室'),
+                ('口腔科', '牙齿和口腔疾病治疗', '010-12345676', '门诊楼6层601-605室'),
+                ('耳鼻喉科', '耳鼻喉相关疾病', '010-12345677', '门诊楼3层316-320室'),
+                ('皮肤科', '皮肤病诊治', '010-12345678', '门诊楼2层211-215室'),
+                ('中医科', '中医诊疗服务', '010-12345679', '门诊楼1层111-115室'),
+                ('康复科', '术后康复、物理治疗', '010-12345680', '康复中心1层'),
+                ('急诊科', '24小时急诊服务', '010-12345681', '急诊楼1层')
+                )",
+                R"(
+                CREATE TABLE IF NOT EXISTS doctors (
+                    doctor_id INT PRIMARY KEY,
+                    name VARCHAR(100) NOT NULL,
+                    gender ENUM('male', 'female', 'other') DEFAULT 'male',
+                    age INT,
+                    phone VARCHAR(20),
+                    department VARCHAR(100) NOT NULL,
+                    created_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP,
+                    FOREIGN KEY (doctor_id) REFERENCES users(user_id) ON DELETE CASCADE
+                ) ENGINE=InnoDB DEFAULT CHARSET=utf8mb4
+                )",
+                R"(
+                CREATE TABLE IF NOT EXISTS registrations (
+                    registration_id INT AUTO_INCREMENT PRIMARY KEY,
+                    registration_date DATE NOT NULL,
+                    patient_id INT NOT NULL,
+                    doctor_id INT NOT NULL,
+                    status ENUM('pending', 'completed', 'cancelled') DEFAULT 'pending',
+                    notes TEXT,
+                    created_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP,
+                    FOREIGN KEY (patient_id) REFERENCES patients(patient_id),
+                    FOREIGN KEY (doctor_id) REFERENCES doctors(doctor_id)
+                ) ENGINE=InnoDB DEFAULT CHARSET=utf8mb4
+                )",
+                R"(
+                CREATE TABLE IF NOT EXISTS bills (
+                    bill_id INT AUTO_INCREMENT PRIMARY KEY,
+                    bill_date DATE NOT NULL,
+                    amount DECIMAL(10,2) NOT NULL,
+                    status ENUM('unpaid', 'paid') DEFAULT 'unpaid',
+                    created_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP
+                ) ENGINE=InnoDB DEFAULT CHARSET=utf8mb4
+                )",
+                R"(
+                CREATE TABLE IF NOT EXISTS registration_bills (
+                    registration_id INT PRIMARY KEY,
+                    bill_id INT UNIQUE,
+                    created_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP,
+                    FOREIGN KEY (registration_id) REFERENCES registrations(registration_id),
+                    FOREIGN KEY (bill_id) REFERENCES bills(bill_id)
+                ) ENGINE=InnoDB DEFAULT CHARSET=utf8mb4
+                )",
+                R"(
+                INSERT IGNORE INTO users (username, password_hash, role)
+                VALUES ('admin', MD5('admin123'), 'admin')
+                )"
+            },
+            {}
+        },
+        {
+            2, "医生表增加department_id外键，并按科室名称回填",
+            {
+                "ALTER TABLE doctors ADD COLUMN department_id INT NULL",
+                "ALTER TABLE doctors ADD CONSTRAINT fk_doctors_department "
+                "FOREIGN KEY (department_id) REFERENCES departments(department_id) ON DELETE SET NULL",
+                "UPDATE doctors d JOIN departments dept ON d.department = dept.department_name "
+                "SET d.department_id = dept.department_id WHERE d.department_id IS NULL"
+            },
+            { kErrDuplicateColumn, kErrDuplicateKey, kErrDuplicateForeignKey }
+        },
+        {
+            3, "挂号、病人、账单表按常用查询建立组合索引",
+            {
+                // 医生统计（今日/待处理/已完成/总数）和今日待处理列表：等值条件全部命中，COUNT只读索引
+                "CREATE INDEX idx_registrations_doctor_status_date ON registrations (doctor_id, status, registration_date)",
+                // 医生挂号记录按日期倒序
+                "CREATE INDEX idx_registrations_doctor_date ON registrations (doctor_id, registration_date)",
+                // 病人挂号记录按日期倒序
+                "CREATE INDEX idx_registrations_patient_date ON registrations (patient_id, registration_date)",
+                // 管理员今日挂号数、全部挂号按日期排序
+                "CREATE INDEX idx_registrations_date ON registrations (registration_date)",
+                // 病人下拉列表按姓名排序
+                "CREATE INDEX idx_patients_name ON patients (name)",
+                // 已支付总收入只读索引
+                "CREATE INDEX idx_bills_status_amount ON bills (status, amount)"
+            },
+            { kErrDuplicateKey }
+        },
+        {
+            4, "结算存储过程：建单、关联挂号、更新状态一次完成",
+            {
+                "DROP PROCEDURE IF EXISTS settle_registration",
+                // 锁定挂号行使同一挂号的结算串行执行；已有账单时直接返回原账单号（重复提交不会生成第二张账单）
+                // 返回一行：bill_id, created（1为本次新建，0为已结算）
+                R"(
+                CREATE PROCEDURE settle_registration(IN p_registration_id INT, IN p_amount DECIMAL(10,2))
+                BEGIN
+                    DECLARE v_status VARCHAR(20) DEFAULT NULL;
+                    DECLARE v_bill_id INT DEFAULT NULL;
+                    DECLARE v_created TINYINT DEFAULT 0;
+                    DECLARE EXIT HANDLER FOR SQLEXCEPTION
+                    BEGIN
+                        ROLLBACK;
+                        RESIGNAL;
+                    END;
+
+                    START TRANSACTION;
+
+                    SELECT status INTO v_status FROM registrations
+                    WHERE registration_id = p_registration_id FOR UPDATE;
+
+                    IF v_status IS NULL THEN
+                        SIGNAL SQLSTATE '45000' SET MESSAGE_TEXT = '挂号记录不存在';
+                    END IF;
+                    IF v_status = 'cancelled' THEN
+                        SIGNAL SQLSTATE '45000' SET MESSAGE_TEXT = '挂号已取消，无法结算';
+                    END IF;
+
+                    SELECT bill_id INTO v_bill_id FROM registration_bills
+                    WHERE registration_id = p_registration_id;
+
+                    IF v_bill_id IS NULL THEN
+                        INSERT INTO bills (bill_date, amount) VALUES (CURDATE(), p_amount);
+                        SET v_bill_id = LAST_INSERT_ID();
+                        INSERT INTO registration_bills (registration_id, bill_id) VALUES (p_registration_id, v_bill_id);
+                        SET v_created = 1;
+                    END IF;
+
+                    UPDATE registrations SET status = 'completed' WHERE registration_id = p_registration_id;
+
+                    COMMIT;
+
+                    SELECT v_bill_id AS bill_id, v_created AS created;
+                END
+                )"
+            },
+            {}
+        },
+        {
+            5, "按日期/科室/医生汇总的daily_stats表及维护它的存储过程",
+            {
+                // 科室取医生当前所属科室，未分配为0（主键列不能为NULL）；金额按挂号日期归入
+                R"(
+                CREATE TABLE IF NOT EXISTS daily_stats (
+                    stat_date DATE NOT NULL,
+                    department_id INT NOT NULL DEFAULT 0,
+                    doctor_id INT NOT NULL,
+                    registrations INT NOT NULL DEFAULT 0,
+                    pending_count INT NOT NULL DEFAULT 0,
+                    completed_count INT NOT NULL DEFAULT 0,
+                    cancelled_count INT NOT NULL DEFAULT 0,
+                    billed_amount DECIMAL(12,2) NOT NULL DEFAULT 0,
+                    paid_amount DECIMAL(12,2) NOT NULL DEFAULT 0,
+                    PRIMARY KEY (stat_date, department_id, doctor_id),
+                    KEY idx_daily_stats_doctor_date (doctor_id, stat_date)
+                ) ENGINE=InnoDB DEFAULT CHARSET=utf8mb4
+                )",
+
+                // 增量调整一个(日期, 医生)汇总行，由下面的存储过程在各自事务中调用
+                "DROP PROCEDURE IF EXISTS adjust_daily_stats",
+                R"(
+                CREATE PROCEDURE adjust_daily_stats(IN p_date DATE, IN p_doctor_id INT,
+                    IN p_registrations INT, IN p_pending INT, IN p_completed INT, IN p_cancelled INT,
+                    IN p_billed DECIMAL(12,2), IN p_paid DECIMAL(12,2))
+                BEGIN
+                    INSERT INTO daily_stats (stat_date, department_id, doctor_id, registrations,
+                        pending_count, completed_count, cancelled_count, billed_amount, paid_amount)
+                    SELECT p_date, COALESCE(d.department_id, 0), p_doctor_id, p_registrations,
+                        p_pending, p_completed, p_cancelled, p_billed, p_paid
+                    FROM doctors d WHERE d.doctor_id = p_doctor_id
+                    ON DUPLICATE KEY UPDATE
+                        registrations = registrations + VALUES(registrations),
+                        pending_count = pending_count + VALUES(pending_count),
+                        completed_count = completed_count + VALUES(completed_count),
+                        cancelled_count = cancelled_count + VALUES(cancelled_count),
+                        billed_amount = billed_amount + VALUES(billed_amount),
+                        paid_amount = paid_amount + VALUES(paid_amount);
+                END
+                )",
+
+                // 新建挂号并计入汇总，返回一行：registration_id
+                "DROP PROCEDURE IF EXISTS book_registration",
+                R"(
+                CREATE PROCEDURE book_registration(IN p_date DATE, IN p_patient_id INT, IN p_doctor_id INT,
+                    IN p_notes TEXT)
+                BEGIN
+                    DECLARE v_registration_id INT;
+                    DECLARE EXIT HANDLER FOR SQLEXCEPTION
+                    BEGIN
+                        ROLLBACK;
+                        RESIGNAL;
+                    END;
+
+                    START TRANSACTION;
+                    INSERT INTO registrations (registration_date, patient_id, doctor_id, notes)
+                    VALUES (p_date, p_patient_id, p_doctor_id, p_notes);
+                    SET v_registration_id = LAST_INSERT_ID();
+                    CALL adjust_daily_stats(p_date, p_doctor_id, 1, 1, 0, 0, 0, 0);
+                    COMMIT;
+
+                    SELECT v_registration_id AS registration_id;
+                END
+                )",
+
+                // 修改挂号状态（p_notes为NULL时保留原备注），状态变化时同步调整汇总
+                "DROP PROCEDURE IF EXISTS set_registration_status",
+                R"(
+                CREATE PROCEDURE set_registration_status(IN p_registration_id INT, IN p_status VARCHAR(20),
+                    IN p_notes TEXT)
+                BEGIN
+                    DECLARE v_status VARCHAR(20) DEFAULT NULL;
+                    DECLARE v_date DATE;
+                    DECLARE v_doctor_id INT;
+                    DECLARE EXIT HANDLER FOR SQLEXCEPTION
+                    BEGIN
+                        ROLLBACK;
+                        RESIGNAL;
+                    END;
+
+                    START TRANSACTION;
+                    SELECT status, registration_date, doctor_id INTO v_status, v_date, v_doctor_id
+                    FROM registrations WHERE registration_id = p_registration_id FOR UPDATE;
+
+                    IF v_status IS NULL THEN
+                        SIGNAL SQLSTATE '45000' SET MESSAGE_TEXT = '挂号记录不存在';
+                    END IF;
+
+                    UPDATE registrations SET status = p_status, notes = COALESCE(p_notes, notes)
+                    WHERE registration_id = p_registration_id;
+
+                    IF v_status <> p_status THEN
+                        CALL adjust_daily_stats(v_date, v_doctor_id, 0,
+                            (p_status = 'pending') - (v_status = 'pending'),
+                            (p_status = 'completed') - (v_status = 'completed'),
+                            (p_status = 'cancelled') - (v_status = 'cancelled'), 0, 0);
+                    END IF;
+                    COMMIT;
+                END
+                )",
+
+                // 删除挂号并从汇总中扣除（已结算的挂号受外键约束无法删除）
+                "DROP PROCEDURE IF EXISTS delete_registration",
+                R"(
+                CREATE PROCEDURE delete_registration(IN p_registration_id INT)
+                BEGIN
+                    DECLARE v_status VARCHAR(20) DEFAULT NULL;
+                    DECLARE v_date DATE;
+                    DECLARE v_doctor_id INT;
+                    DECLARE EXIT HANDLER FOR SQLEXCEPTION
+                    BEGIN
+                        ROLLBACK;
+                        RESIGNAL;
+                    END;
+
+                    START TRANSACTION;
+                    SELECT status, registration_date, doctor_id INTO v_status, v_date, v_doctor_id
+                    FROM registrations WHERE registration_id = p_registration_id FOR UPDATE;
+
+                    IF v_status IS NOT NULL THEN
+                        DELETE FROM registrations WHERE registration_id = p_registration_id;
+                        CALL adjust_daily_stats(v_date, v_doctor_id, -1,
+                            -(v_status = 'pending'), -(v_status = 'completed'), -(v_status = 'cancelled'), 0, 0);
+                    END IF;
+                    COMMIT;
+                END
+                )",
+
+                // 结算：在版本4的基础上同步计入汇总
+                "DROP PROCEDURE IF EXISTS settle_registration",
+                R"(
+                CREATE PROCEDURE settle_registration(IN p_registration_id INT, IN p_amount DECIMAL(10,2))
+                BEGIN
+                    DECLARE v_status VARCHAR(20) DEFAULT NULL;
+                    DECLARE v_date DATE;
+                    DECLARE v_doctor_id INT;
+                    DECLARE v_bill_id INT DEFAULT NULL;
+                    DECLARE v_created TINYINT DEFAULT 0;
+                    DECLARE EXIT HANDLER FOR SQLEXCEPTION
+                    BEGIN
+                        ROLLBACK;
+                        RESIGNAL;
+                    END;
+
+                    START TRANSACTION;
+
+                    SELECT status, registration_date, doctor_id INTO v_status, v_date, v_doctor_id
+                    FROM registrations WHERE registration_id = p_registration_id FOR UPDATE;
+
+                    IF v_status IS NULL THEN
+                        SIGNAL SQLSTATE '45000' SET MESSAGE_TEXT = '挂号记录不存在';
+                    END IF;
+                    IF v_status = 'cancelled' THEN
+                        SIGNAL SQLSTATE '45000' SET MESSAGE_TEXT = '挂号已取消，无法结算';
+                    END IF;
+
+                    SELECT bill_id INTO v_bill_id FROM registration_bills
+                    WHERE registration_id = p_registration_id;
+
+                    IF v_bill_id IS NULL THEN
+                        INSERT INTO bills (bill_date, amount) VALUES (CURDATE(), p_amount);
+                        SET v_bill_id = LAST_INSERT_ID();
+                        INSERT INTO registration_bills (registration_id, bill_id) VALUES (p_registration_id, v_bill_id);
+                        SET v_created = 1;
+                        CALL adjust_daily_stats(v_date, v_doctor_id, 0, 0, 0, 0, p_amount, 0);
+                    END IF;
+
+                    IF v_status <> 'completed' THEN
+                        UPDATE registrations SET status = 'completed' WHERE registration_id = p_registration_id;
+                        CALL adjust_daily_stats(v_date, v_doctor_id, 0, -(v_status = 'pending'), 1, 0, 0, 0);
+                    END IF;
+
+                    COMMIT;
+
+                    SELECT v_bill_id AS bill_id, v_created AS created;
+                END
+                )",
+
+                // 按挂号和账单重新计算汇总（p_doctor_id为NULL时全部重建），用于回填和修正
+                "DROP PROCEDURE IF EXISTS rebuild_daily_stats",
+                R"(
+                CREATE PROCEDURE rebuild_daily_stats(IN p_doctor_id INT)
+                BEGIN
+                    DECLARE EXIT HANDLER FOR SQLEXCEPTION
+                    BEGIN
+                        ROLLBACK;
+                        RESIGNAL;
+                    END;
+
+                    START TRANSACTION;
+                    DELETE FROM daily_stats WHERE p_doctor_id IS NULL OR doctor_id = p_doctor_id;
+
+                    INSERT INTO daily_stats (stat_date, department_id, doctor_id, registrations,
+                        pending_count, completed_count, cancelled_count, billed_amount, paid_amount)
+                    SELECT r.registration_date, COALESCE(d.department_id, 0), r.doctor_id, COUNT(*),
+                        SUM(r.status = 'pending'), SUM(r.status = 'completed'), SUM(r.status = 'cancelled'),
+                        COALESCE(SUM(b.amount), 0), COALESCE(SUM(IF(b.status = 'paid', b.amount, 0)), 0)
+                    FROM registrations r
+                    JOIN doctors d ON d.doctor_id = r.doctor_id
+                    LEFT JOIN registration_bills rb ON rb.registration_id = r.registration_id
+                    LEFT JOIN bills b ON b.bill_id = rb.bill_id
+                    WHERE p_doctor_id IS NULL OR r.doctor_id = p_doctor_id
+                    GROUP BY r.registration_date, COALESCE(d.department_id, 0), r.doctor_id;
+                    COMMIT;
+                END
+                )",
+
+                // 回填已有数据
+                "CALL rebuild_daily_stats(NULL)"
+            },
+            {}
+        },
+        {
+            6, "医生号源：每位医生每天一行，挂号时原子扣减剩余号源",
+            {
+                // 医生默认每日号源数，未单独设置的日期按此生成号源行
+                "ALTER TABLE doctors ADD COLUMN daily_capacity INT NOT NULL DEFAULT 30",
+                R"(
+                CREATE TABLE IF NOT EXISTS doctor_slots (
+                    doctor_id INT NOT NULL,
+                    slot_date DATE NOT NULL,
+                    capacity INT NOT NULL,
+                    booked INT NOT NULL DEFAULT 0,
+                    PRIMARY KEY (doctor_id, slot_date),
+                    CONSTRAINT fk_doctor_slots_doctor FOREIGN KEY (doctor_id)
+                        REFERENCES doctors(doctor_id) ON DELETE CASCADE
+                ) ENGINE=InnoDB DEFAULT CHARSET=utf8mb4
+                )",
+
+                // 按已有的未取消挂号回填，已超额的日期容量取实际挂号数
+                R"(
+                INSERT INTO doctor_slots (doctor_id, slot_date, capacity, booked)
+                SELECT r.doctor_id, r.registration_date, GREATEST(d.daily_capacity, COUNT(*)), COUNT(*)
+                FROM registrations r JOIN doctors d ON d.doctor_id = r.doctor_id
+                WHERE r.status <> 'cancelled'
+                GROUP BY r.doctor_id, r.registration_date, d.daily_capacity
+                ON DUPLICATE KEY UPDATE booked = VALUES(booked)
+                )",
+
+                // 占用一个号源：按主键的条件UPDATE，号源行只在当天第一次挂号时创建
+                // 行锁由调用方事务持有，调用方应把它放在提交前的最后几步
+                "DROP PROCEDURE IF EXISTS reserve_doctor_slot",
+                R"(
+                CREATE PROCEDURE reserve_doctor_slot(IN p_doctor_id INT, IN p_date DATE)
+                BEGIN
+                    UPDATE doctor_slots SET booked = booked + 1
+                    WHERE doctor_id = p_doctor_id AND slot_date = p_date AND booked < capacity;
+
+                    IF ROW_COUNT() = 0 THEN
+                        INSERT INTO doctor_slots (doctor_id, slot_date, capacity, booked)
+                        SELECT doctor_id, p_date, daily_capacity, 0 FROM doctors WHERE doctor_id = p_doctor_id
+                        ON DUPLICATE KEY UPDATE capacity = capacity;
+
+                        UPDATE doctor_slots SET booked = booked + 1
+                        WHERE doctor_id = p_doctor_id AND slot_date = p_date AND booked < capacity;
+
+                        IF ROW_COUNT() = 0 THEN
+                            SIGNAL SQLSTATE '45000' SET MESSAGE_TEXT = '该医生当日号源已满';
+                        END IF;
+                    END IF;
+                END
+                )",
+
+                "DROP PROCEDURE IF EXISTS release_doctor_slot",
+                R"(
+                CREATE PROCEDURE release_doctor_slot(IN p_doctor_id INT, IN p_date DATE)
+                BEGIN
+                    UPDATE doctor_slots SET booked = GREATEST(booked - 1, 0)
+                    WHERE doctor_id = p_doctor_id AND slot_date = p_date;
+                END
+                )",
+
+                // 挂号：先用一致性读（不加锁）判断是否已满，号满后的大量请求不进入加锁路径；
+                // 热点行（号源、汇总）在插入挂号之后才加锁，持锁到提交只有两条语句
+                "DROP PROCEDURE IF EXISTS book_registration",
+                R"(
+                CREATE PROCEDURE book_registration(IN p_date DATE, IN p_patient_id INT, IN p_doctor_id INT,
+                    IN p_notes TEXT)
+                BEGIN
+                    DECLARE v_registration_id INT;
+                    DECLARE EXIT HANDLER FOR SQLEXCEPTION
+                    BEGIN
+                        ROLLBACK;
+                        RESIGNAL;
+                    END;
+
+                    IF EXISTS (SELECT 1 FROM doctor_slots WHERE doctor_id = p_doctor_id
+                        AND slot_date = p_date AND booked >= capacity) THEN
+                        SIGNAL SQLSTATE '45000' SET MESSAGE_TEXT = '该医生当日号源已满';
+                    END IF;
+
+                    START TRANSACTION;
+                    INSERT INTO registrations (registration_date, patient_id, doctor_id, notes)
+                    VALUES (p_date, p_patient_id, p_doctor_id, p_notes);
+                    SET v_registration_id = LAST_INSERT_ID();
+                    CALL reserve_doctor_slot(p_doctor_id, p_date);
+                    CALL adjust_daily_stats(p_date, p_doctor_id, 1, 1, 0, 0, 0, 0);
+                    COMMIT;
+
+                    SELECT v_registration_id AS registration_id;
+                END
+                )",
+
+                // 取消时归还号源，从已取消恢复时重新占用（号满则失败）
+                "DROP PROCEDURE IF EXISTS set_registration_status",
+                R"(
+                CREATE PROCEDURE set_registration_status(IN p_registration_id INT, IN p_status VARCHAR(20),
+                    IN p_notes TEXT)
+                BEGIN
+                    DECLARE v_status VARCHAR(20) DEFAULT NULL;
+                    DECLARE v_date DATE;
+                    DECLARE v_doctor_id INT;
+                    DECLARE EXIT HANDLER FOR SQLEXCEPTION
+                    BEGIN
+                        ROLLBACK;
+                        RESIGNAL;
+                    END;
+
+                    START TRANSACTION;
+                    SELECT status, registration_date, doctor_id INTO v_status, v_date, v_doctor_id
+                    FROM registrations WHERE registration_id = p_registration_id FOR UPDATE;
+
+                    IF v_status IS NULL THEN
+                        SIGNAL SQLSTATE '45000' SET MESSAGE_TEXT = '挂号记录不存在';
+                    END IF;
+
+                    UPDATE registrations SET status = p_status, notes = COALESCE(p_notes, notes)
+                    WHERE registration_id = p_registration_id;
+
+                    IF v_status <> p_status THEN
+                        IF p_status = 'cancelled' THEN
+                            CALL release_doctor_slot(v_doctor_id, v_date);
+                        ELSEIF v_status = 'cancelled' THEN
+                            CALL reserve_doctor_slot(v_doctor_id, v_date);
+                        END IF;
+
+                        CALL adjust_daily_stats(v_date, v_doctor_id, 0,
+                            (p_status = 'pending') - (v_status = 'pending'),
+                            (p_status = 'completed') - (v_status = 'completed'),
+                            (p_status = 'cancelled') - (v_status = 'cancelled'), 0, 0);
+                    END IF;
+                    COMMIT;
+                END
+                )",
+
+                "DROP PROCEDURE IF EXISTS delete_registration",
+                R"(
+                CREATE PROCEDURE delete_registration(IN p_registration_id INT)
+                BEGIN
+                    DECLARE v_status VARCHAR(20) DEFAULT NULL;
+                    DECLARE v_date DATE;
+                    DECLARE v_doctor_id INT;
+                    DECLARE EXIT HANDLER FOR SQLEXCEPTION
+                    BEGIN
+                        ROLLBACK;
+                        RESIGNAL;
+                    END;
+
+                    START TRANSACTION;
+                    SELECT status, registration_date, doctor_id INTO v_status, v_date, v_doctor_id
+                    FROM registrations WHERE registration_id = p_registration_id FOR UPDATE;
+
+                    IF v_status IS NOT NULL THEN
+                        DELETE FROM registrations WHERE registration_id = p_registration_id;
+                        IF v_status <> 'cancelled' THEN
+                            CALL release_doctor_slot(v_doctor_id, v_date);
+                        END IF;
+                        CALL adjust_daily_stats(v_date, v_doctor_id, -1,
+                            -(v_status = 'pending'), -(v_status = 'completed'), -(v_status = 'cancelled'), 0, 0);
+                    END IF;
+                    COMMIT;
+                END
+                )"
+            },
+            { kErrDuplicateColumn }
+        },
+        {
+            7, "病人检索：手机号、身份证号前缀索引和ngram全文索引",
+            {
+                // 前缀匹配（姓名前缀已有idx_patients_name）
+                "CREATE INDEX idx_patients_phone ON patients (phone)",
+                "CREATE INDEX idx_patients_id_card ON patients (id_card)",
+                // 子串匹配：ngram分词（默认两字一词），中文姓名和数字串均可按片段检索
+                "ALTER TABLE patients ADD FULLTEXT INDEX ft_patients_search (name, phone, id_card) WITH PARSER ngram"
+            },
+            { kErrDuplicateKey }
+        },
+        {
+            8, "管理员挂号筛选：按状态分页的索引",
+            {
+                // 只按状态筛选时按日期倒序分页，末尾隐含的主键用作键集游标的第二列
+                "CREATE INDEX idx_registrations_status_date ON registrations (status, registration_date)"
+            },
+            { kErrDuplicateKey }
+        },
+        {
+            9, "全院计数：病人和医生总数由注册事务维护，仪表盘不再统计整表",
+            {
+                // 只有一行（counter_id = 1），registerUser在创建病人/医生的事务中加1
+                R"(
+                CREATE TABLE IF NOT EXISTS hospital_counters (
+                    counter_id TINYINT PRIMARY KEY,
+                    patient_count INT NOT NULL DEFAULT 0,
+                    doctor_count INT NOT NULL DEFAULT 0
+                ) ENGINE=InnoDB DEFAULT CHARSET=utf8mb4
+                )",
+                // 按已有数据回填
+                R"(
+                INSERT INTO hospital_counters (counter_id, patient_count, doctor_count)
+                SELECT 1, (SELECT COUNT(*) FROM patients), (SELECT COUNT(*) FROM doctors)
+                ON DUPLICATE KEY UPDATE patient_count = VALUES(patient_count), doctor_count = VALUES(doctor_count)
+                )"
+            },
+            {}
+        },
+        {
+            10, "医生换科室：更新所属科室和重算该医生的汇总在同一事务中完成",
+            {
+                // p_department_id为NULL时取消分配；汇总按医生当前科室归类，与rebuild_daily_stats的单个医生重建相同
+                "DROP PROCEDURE IF EXISTS assign_doctor_department",
+                R"(
+                CREATE PROCEDURE assign_doctor_department(IN p_doctor_id INT, IN p_department_id INT)
+                BEGIN
+                    DECLARE EXIT HANDLER FOR SQLEXCEPTION
+                    BEGIN
+                        ROLLBACK;
+                        RESIGNAL;
+                    END;
+
+                    START TRANSACTION;
+                    UPDATE doctors d LEFT JOIN departments dept ON dept.department_id = p_department_id
+                    SET d.department_id = dept.department_id, d.department = dept.department_name
+                    WHERE d.doctor_id = p_doctor_id;
+
+                    DELETE FROM daily_stats WHERE doctor_id = p_doctor_id;
+
+                    INSERT INTO daily_stats (stat_date, department_id, doctor_id, registrations,
+                        pending_count, completed_count, cancelled_count, billed_amount, paid_amount)
+                    SELECT r.registration_date, COALESCE(d.department_id, 0), r.doctor_id, COUNT(*),
+                        SUM(r.status = 'pending'), SUM(r.status = 'completed'), SUM(r.status = 'cancelled'),
+                        COALESCE(SUM(b.amount), 0), COALESCE(SUM(IF(b.status = 'paid', b.amount, 0)), 0)
+                    FROM registrations r
+                    JOIN doctors d ON d.doctor_id = r.doctor_id
+                    LEFT JOIN registration_bills rb ON rb.registration_id = r.registration_id
+                    LEFT JOIN bills b ON b.bill_id = rb.bill_id
+                    WHERE r.doctor_id = p_doctor_id
+                    GROUP BY r.registration_date, COALESCE(d.department_id, 0), r.doctor_id;
+                    COMMIT;
+                END
+                )"
+            },
+            {}
+        },
+    };
+    return all;
+}
+
+int SchemaMigrator::latestVersion() {
+    return migrations().empty() ? 0 : migrations().back().version;
+}
+
+int SchemaMigrator::currentVersion() {
+    int version = 0;
+    bool ok = db.forEachRow("SELECT COALESCE(MAX(version), 0) FROM schema_version", [&version](const ResultRow& row) {
+        version = static_cast<int>(row.getInt(0));
+        return false;
+    });
+
+    if (ok) {
+        return version;
+    }
+    if (db.getLastErrorCode() == kErrNoSuchTable) {
+        return 0;
+    }
+    lastError = "读取数据库版本失败: " + db.getLastError();
+    return -1;
+}
+
+bool SchemaMigrator::migrate() {
+    // 常规启动路径：一次查询确认已是最新版本
+    int version = currentVersion();
+    if (version < 0) {
+        return false;
+    }
+    if (version >= latestVersion()) {
+        return true;
+    }
+
+    // 命名锁属于会话：加锁、全部DDL和释放锁必须在同一条连接上执行
+    DatabaseManager::PinnedSession session(db);
+    if (!session) {
+        lastError = "获取数据库连接失败: " + db.getLastError();
+        return false;
+    }
+
+    // 需要升级时加命名锁，避免多个客户端同时执行DDL
+    bool locked = false;
+    db.forEachRow(std::string("SELECT GET_LOCK('") + kMigrationLock + "', 30)", [&locked](const ResultRow& row) {
+        locked = row.getInt(0) == 1;
+        return false;
+    });
+    if (!locked) {
+        lastError = "等待数据库升级锁超时";
+        return false;
+    }
+
+    bool ok = applyPending();
+
+    // 未能确认释放时关闭这条连接，锁随会话结束释放，不会被池中的空闲连接一直持有
+    bool released = false;
+    db.forEachRow(std::string("SELECT RELEASE_LOCK('") + kMigrationLock + "')", [&released](const ResultRow& row) {
+        released = !row.isNull(0) && row.getInt(0) == 1;
+        return false;
+    });
+    if (!released) {
+        std::cerr << "释放数据库升级锁失败: " << db.getLastError() << std::endl;
+        session.discard();
+    }
+    return ok;
+}
+
+bool SchemaMigrator::applyPending() {
+    if (!db.executeQuery(R"(
+        CREATE TABLE IF NOT EXISTS schema_version (
+            version INT PRIMARY KEY,
+            description VARCHAR(255) NOT NULL,
+            applied_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP
+        ) ENGINE=InnoDB DEFAULT CHARSET=utf8mb4
+    )")) {
+        lastError = "创建schema_version表失败: " + db.getLastError();
+        return false;
+    }
+
+    // 拿到锁后重新读取，其他客户端可能已完成升级
+    int version = currentVersion();
+    if (version < 0) {
+        return false;
+    }
+
+    for (const SchemaMigration& migration : migrations()) {
+        if (migration.version <= version) {
+            continue;
+        }
+        if (!apply(migration)) {
+            return false;
+        }
+        std::cout << "数据库已升级到版本 " << migration.version << ": " << migration.description << std::endl;
+    }
+    return true;
+}
+
+bool SchemaMigrator::apply(const SchemaMigration& migration) {
+    // MySQL的DDL会隐式提交，无法整体回滚；每条语句需可重复执行，失败后下次启动从该版本重试
+    for (const std::string& statement : migration.statements) {
+        if (db.executeQuery(statement)) {
+            continue;
+        }
+        unsigned int code = db.getLastErrorCode();
+        bool ignorable = false;
+        for (unsigned int allowed : migration.ignorableErrors) {
+            ignorable = ignorable || code == allowed;
+        }
+        if (!ignorable) {
+            lastError = "数据库升级到版本 " + std::to_string(migration.version) + " 失败: " + db.getLastError();
+            return false;
+        }
+    }
+
+    if (!db.executePrepared("INSERT INTO schema_version (version, description) VALUES (?, ?)",
+        { migration.version, migration.description })) {
+        lastError = "记录数据库版本失败: " + db.getLastError();
+        return false;
+    }
+    return true;
+}
+
+std::string SchemaMigrator::getLastError() const {
+    return lastError;
+}
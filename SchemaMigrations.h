@@ -0,0 +1,40 @@
+﻿#pragma once
+#include <string>
+#include <vector>
+
+class DatabaseManager;
+
+// 一次结构变更：按顺序执行statements，全部成功后记录到schema_version
+// ignorableErrors中的错误码（如字段/索引已存在）视为该语句已生效，便于在旧库上重复执行
+struct SchemaMigration {
+    int version;
+    std::string description;
+    std::vector<std::string> statements;
+    std::vector<unsigned int> ignorableErrors;
+};
+
+// 版本化的表结构迁移
+// 启动时只查询一次schema_version；已是最新版本时不再发送任何DDL
+class SchemaMigrator {
+public:
+    explicit SchemaMigrator(DatabaseManager& db);
+
+    // 所有迁移（版本号递增）
+    static const std::vector<SchemaMigration>& migrations();
+    static int latestVersion();
+
+    // 当前数据库版本，schema_version表不存在时为0，查询失败返回-1
+    int currentVersion();
+
+    // 应用所有待执行的迁移；多个客户端同时启动时通过GET_LOCK串行化
+    bool migrate();
+
+    std::string getLastError() const;
+
+private:
+    bool applyPending();
+    bool apply(const SchemaMigration& migration);
+
+    DatabaseManager& db;
+    std::string lastError;
+};
@@ -0,0 +1,98 @@
+﻿#include "ServiceProtocol.h"
+
+namespace ServiceProtocol {
+    QJsonValue encode(const DashboardScope& scope) {
+        return QJsonArray{ scope.doctorId };
+    }
+
+    void decode(const QJsonValue& json, DashboardScope& scope) {
+        scope.doctorId = json.toArray().at(0).toInt();
+    }
+
+    QJsonValue encode(const DashboardStats& stats) {
+        return QJsonArray{ stats.todayRegistrations, stats.todayCompleted, stats.pendingCount,
+            stats.completedCount, stats.totalCount, stats.totalIncome, stats.doctorCount, stats.patientCount };
+    }
+
+    void decode(const QJsonValue& json, DashboardStats& stats) {
+        QJsonArray fields = json.toArray();
+        stats.todayRegistrations = fields.at(0).toInt();
+        stats.todayCompleted = fields.at(1).toInt();
+        stats.pendingCount = fields.at(2).toInt();
+        stats.completedCount = fields.at(3).toInt();
+        stats.totalCount = fields.at(4).toInt();
+        stats.totalIncome = fields.at(5).toDouble();
+        stats.doctorCount = fields.at(6).toInt();
+        stats.patientCount = fields.at(7).toInt();
+    }
+
+    QJsonValue encode(const QueueEntry& entry) {
+        return QJsonArray{ entry.registrationId, entry.patientId, encode(entry.patientName),
+            encode(entry.registrationDate), encode(entry.notes), entry.priority, encode(entry.sequence),
+            static_cast<int>(entry.state) };
+    }
+
+    void decode(const QJsonValue& json, QueueEntry& entry) {
+        QJsonArray fields = json.toArray();
+        entry.registrationId = fields.at(0).toInt();
+        entry.patientId = fields.at(1).toInt();
+        decode(fields.at(2), entry.patientName);
+        decode(fields.at(3), entry.registrationDate);
+        decode(fields.at(4), entry.notes);
+        entry.priority = fields.at(5).toInt();
+        decode(fields.at(6), entry.sequence);
+        entry.state = static_cast<QueueEntry::State>(fields.at(7).toInt());
+    }
+
+    // 事件字段较多且大多为0，按名称编码并省略默认值
+    QJsonValue encode(const ChangeEvent& event) {
+        QJsonObject object;
+        object["type"] = static_cast<int>(event.type);
+        if (event.registrationId) object["registrationId"] = event.registrationId;
+        if (event.doctorId) object["doctorId"] = event.doctorId;
+        if (event.patientId) object["patientId"] = event.patientId;
+        if (event.departmentId) object["departmentId"] = event.departmentId;
+        if (event.billId) object["billId"] = event.billId;
+        if (event.userId) object["userId"] = event.userId;
+        if (event.amount != 0.0) object["amount"] = event.amount;
+        if (!event.role.empty()) object["role"] = encode(event.role);
+        if (!event.date.empty()) object["date"] = encode(event.date);
+        if (event.registration.registrationId) object["registration"] = encode(event.registration);
+        return object;
+    }
+
+    void decode(const QJsonValue& json, ChangeEvent& event) {
+        QJsonObject object = json.toObject();
+        event = ChangeEvent();
+        event.type = static_cast<ChangeEvent::Type>(object.value("type").toInt());
+        event.registrationId = object.value("registrationId").toInt();
+        event.doctorId = object.value("doctorId").toInt();
+        event.patientId = object.value("patientId").toInt();
+        event.departmentId = object.value("departmentId").toInt();
+        event.billId = object.value("billId").toInt();
+        event.userId = object.value("userId").toInt();
+        event.amount = object.value("amount").toDouble();
+        decode(object.value("role"), event.role);
+        decode(object.value("date"), event.date);
+        if (object.contains("registration")) {
+            decode(object.value("registration"), event.registration);
+        }
+    }
+
+    // 键值对数组 [[医生ID, 剩余号源], ...]
+    QJsonValue encode(const std::unordered_map<int, int>& values) {
+        QJsonArray pairs;
+        for (const auto& item : values) {
+            pairs.append(QJsonArray{ item.first, item.second });
+        }
+        return pairs;
+    }
+
+    void decode(const QJsonValue& json, std::unordered_map<int, int>& values) {
+        values.clear();
+        for (const QJsonValue& item : json.toArray()) {
+            QJsonArray pair = item.toArray();
+            values[pair.at(0).toInt()] = pair.at(1).toInt();
+        }
+    }
+}
@@ -0,0 +1,121 @@
+﻿#pragma once
+// 挂号服务（Hospital.exe --serve）与客户端之间的调用协议
+// 每条消息是一行紧凑JSON（以\n结尾）：
+//   请求 {"id":1,"method":"createRegistration","args":[...]}
+//   应答 {"id":1,"result":...,"error":"","events":[...]}
+// error为该次调用在服务端设置的错误信息，events为调用期间产生的变更事件，由客户端在本地重新发布
+// 每条连接须先调用login，ping、login和注册病人账号以外的方法按该连接登录的角色鉴权（见HospitalService）
+// 带columns()的结构体按列顺序编码为数组，与RowMapping使用同一份成员列表
+#include "ChangeEventBus.h"
+#include "CommonTypes.h"
+#include "DoctorQueue.h"
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QJsonValue>
+#include <QString>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace ServiceProtocol {
+    constexpr unsigned short kDefaultPort = 7601;
+
+    template<typename T, typename = void>
+    struct HasColumns : std::false_type {};
+    template<typename T>
+    struct HasColumns<T, std::void_t<decltype(T::columns())>> : std::true_type {};
+
+    // 基本类型
+    inline QJsonValue encode(int value) { return value; }
+    inline QJsonValue encode(bool value) { return value; }
+    inline QJsonValue encode(double value) { return value; }
+    inline QJsonValue encode(std::uint64_t value) { return static_cast<double>(value); }
+    inline QJsonValue encode(const std::string& value) { return QString::fromStdString(value); }
+
+    inline void decode(const QJsonValue& json, int& value) { value = json.toInt(); }
+    inline void decode(const QJsonValue& json, bool& value) { value = json.toBool(); }
+    inline void decode(const QJsonValue& json, double& value) { value = json.toDouble(); }
+    inline void decode(const QJsonValue& json, std::uint64_t& value) {
+        value = static_cast<std::uint64_t>(json.toDouble());
+    }
+    inline void decode(const QJsonValue& json, std::string& value) { value = json.toString().toStdString(); }
+
+    // 没有columns()的类型单独编码（ServiceProtocol.cpp）
+    QJsonValue encode(const DashboardScope& scope);
+    QJsonValue encode(const DashboardStats& stats);
+    QJsonValue encode(const QueueEntry& entry);
+    QJsonValue encode(const ChangeEvent& event);
+    QJsonValue encode(const std::unordered_map<int, int>& values);
+    void decode(const QJsonValue& json, DashboardScope& scope);
+    void decode(const QJsonValue& json, DashboardStats& stats);
+    void decode(const QJsonValue& json, QueueEntry& entry);
+    void decode(const QJsonValue& json, ChangeEvent& event);
+    void decode(const QJsonValue& json, std::unordered_map<int, int>& values);
+
+    // 模板先声明，互相嵌套时都能找到
+    template<typename T>
+    std::enable_if_t<HasColumns<T>::value, QJsonValue> encode(const T& value);
+    template<typename T>
+    QJsonValue encode(const std::vector<T>& values);
+    template<typename T>
+    QJsonValue encode(const std::optional<T>& value);
+    template<typename T>
+    std::enable_if_t<HasColumns<T>::value> decode(const QJsonValue& json, T& value);
+    template<typename T>
+    void decode(const QJsonValue& json, std::vector<T>& values);
+    template<typename T>
+    void decode(const QJsonValue& json, std::optional<T>& value);
+
+    template<typename T>
+    std::enable_if_t<HasColumns<T>::value, QJsonValue> encode(const T& value) {
+        QJsonArray fields;
+        std::apply([&](auto... members) { (fields.append(encode(value.*members)), ...); }, T::columns());
+        return fields;
+    }
+
+    template<typename T>
+    QJsonValue encode(const std::vector<T>& values) {
+        QJsonArray items;
+        for (const T& value : values) {
+            items.append(encode(value));
+        }
+        return items;
+    }
+
+    template<typename T>
+    QJsonValue encode(const std::optional<T>& value) {
+        return value ? encode(*value) : QJsonValue();
+    }
+
+    template<typename T>
+    std::enable_if_t<HasColumns<T>::value> decode(const QJsonValue& json, T& value) {
+        QJsonArray fields = json.toArray();
+        int index = 0;
+        std::apply([&](auto... members) { (decode(fields.at(index++), value.*members), ...); }, T::columns());
+    }
+
+    template<typename T>
+    void decode(const QJsonValue& json, std::vector<T>& values) {
+        QJsonArray items = json.toArray();
+        values.clear();
+        values.reserve(static_cast<std::size_t>(items.size()));
+        for (const QJsonValue& item : items) {
+            values.emplace_back();
+            decode(item, values.back());
+        }
+    }
+
+    template<typename T>
+    void decode(const QJsonValue& json, std::optional<T>& value) {
+        value.reset();
+        if (!json.isNull() && !json.isUndefined()) {
+            value.emplace();
+            decode(json, *value);
+        }
+    }
+}
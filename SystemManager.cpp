@@ -1,12 +1,246 @@
 ﻿#include "SystemManager.h"
+#include "PasswordHasher.h"
+#include "RowMapping.h"
+#include "RemoteClient.h"
+#include "ServiceProtocol.h"
 #include <sstream>
 #include <iomanip>
+#include <algorithm>
+#include <unordered_set>
+#include <fstream>
+#include <filesystem>
 #include<qdebug.h>
+#include <QDate>
+
+namespace {
+    // 以下SQL模板按原文缓存为预处理语句，参数走二进制协议
+    const std::string kRegistrationSelect =
+        "SELECT r.registration_id, r.registration_date, r.patient_id, r.doctor_id, "
+        "r.status, r.notes, p.name as patient_name, d.name as doctor_name, d.department, "
+        "CASE WHEN rb.bill_id IS NOT NULL THEN 1 ELSE 0 END as has_bill, "
+        "COALESCE(b.amount, 0) as bill_amount, COALESCE(b.status, '') as bill_status "
+        "FROM registrations r "
+        "JOIN patients p ON r.patient_id = p.patient_id "
+        "JOIN doctors d ON r.doctor_id = d.doctor_id "
+        "LEFT JOIN registration_bills rb ON r.registration_id = rb.registration_id "
+        "LEFT JOIN bills b ON rb.bill_id = b.bill_id ";
+
+    std::string todayDate() {
+        return QDate::currentDate().toString("yyyy-MM-dd").toStdString();
+    }
+
+    QueueEntry toQueueEntry(const RegistrationInfo& info) {
+        QueueEntry entry;
+        entry.registrationId = info.registrationId;
+        entry.patientId = info.patientId;
+        entry.patientName = info.patientName;
+        entry.registrationDate = info.registrationDate;
+        entry.notes = info.notes;
+        return entry;
+    }
+
+    ChangeEvent registrationEvent(ChangeEvent::Type type, const RegistrationInfo& info) {
+        ChangeEvent event;
+        event.type = type;
+        event.registrationId = info.registrationId;
+        event.doctorId = info.doctorId;
+        event.patientId = info.patientId;
+        event.date = info.registrationDate;
+        event.registration = info;
+        return event;
+    }
+
+    // 登录查询结果：用户信息列之后附带口令哈希
+    struct LoginRecord : UserInfo {
+        std::string passwordHash;
+
+        static constexpr auto columns() {
+            return std::tuple_cat(UserInfo::columns(), std::make_tuple(&LoginRecord::passwordHash));
+        }
+    };
+
+    // 登录按角色只关联对应的详情表，不再对每个角色计算CASE
+    const char* loginQuery(const std::string& role) {
+        if (role == "patient") {
+            return "SELECT u.user_id, u.username, u.role, p.name, p.gender, p.age, p.phone, p.address, "
+                "p.id_card, '', u.password_hash "
+                "FROM users u LEFT JOIN patients p ON p.patient_id = u.user_id "
+                "WHERE u.username = ? AND u.role = 'patient'";
+        }
+        if (role == "doctor") {
+            return "SELECT u.user_id, u.username, u.role, d.name, d.gender, d.age, d.phone, '', '', "
+                "d.department, u.password_hash "
+                "FROM users u LEFT JOIN doctors d ON d.doctor_id = u.user_id "
+                "WHERE u.username = ? AND u.role = 'doctor'";
+        }
+        if (role == "admin") {
+            return "SELECT u.user_id, u.username, u.role, '系统管理员', 'male', 30, '', '', '', '', u.password_hash "
+                "FROM users u WHERE u.username = ? AND u.role = 'admin'";
+        }
+        return nullptr;
+    }
+
+    // 医生仪表盘：读取该医生在daily_stats中的汇总行（每天一行）
+    const char* kDoctorDashboardQuery =
+        "SELECT COALESCE(SUM(registrations), 0), "
+        "COALESCE(SUM(pending_count), 0), "
+        "COALESCE(SUM(completed_count), 0), "
+        "COALESCE(SUM(IF(stat_date = CURDATE(), registrations, 0)), 0), "
+        "COALESCE(SUM(IF(stat_date = CURDATE(), completed_count, 0)), 0) "
+        "FROM daily_stats WHERE doctor_id = ?";
+
+    // 全院仪表盘：各项计数作为标量子查询合并为一次往返，挂号和收入读取daily_stats，
+    // 医生和病人总数读取hospital_counters（由registerUser维护），不统计整表
+    const char* kHospitalDashboardQuery =
+        "SELECT "
+        "(SELECT COALESCE(SUM(registrations), 0) FROM daily_stats WHERE stat_date = CURDATE()), "
+        "(SELECT COALESCE(SUM(completed_count), 0) FROM daily_stats WHERE stat_date = CURDATE()), "
+        "(SELECT COALESCE(SUM(paid_amount), 0) FROM daily_stats), "
+        "COALESCE((SELECT doctor_count FROM hospital_counters WHERE counter_id = 1), 0), "
+        "COALESCE((SELECT patient_count FROM hospital_counters WHERE counter_id = 1), 0)";
+
+    // 尚未生成号源行的日期按医生默认号源计算
+    const char* kRemainingSlotsQuery =
+        "SELECT d.doctor_id, COALESCE(s.capacity, d.daily_capacity) - COALESCE(s.booked, 0) "
+        "FROM doctors d LEFT JOIN doctor_slots s ON s.doctor_id = d.doctor_id AND s.slot_date = ?";
+
+    const char* kDepartmentReportQuery =
+        "SELECT ds.department_id, COALESCE(dept.department_name, '未分配'), "
+        "SUM(ds.registrations), SUM(ds.pending_count), SUM(ds.completed_count), SUM(ds.cancelled_count), "
+        "SUM(ds.billed_amount), SUM(ds.paid_amount) "
+        "FROM daily_stats ds LEFT JOIN departments dept ON dept.department_id = ds.department_id "
+        "WHERE ds.stat_date BETWEEN ? AND ? "
+        "GROUP BY ds.department_id, dept.department_name ORDER BY ds.department_id";
+
+    const std::string kUserSelect =
+        "SELECT u.user_id, u.username, u.role, "
+        "CASE u.role "
+        "WHEN 'patient' THEN p.name "
+        "WHEN 'doctor' THEN d.name "
+        "WHEN 'admin' THEN '系统管理员' "
+        "END as name, "
+        "CASE u.role "
+        "WHEN 'patient' THEN p.gender "
+        "WHEN 'doctor' THEN d.gender "
+        "WHEN 'admin' THEN 'male' "
+        "END as gender, "
+        "CASE u.role "
+        "WHEN 'patient' THEN p.age "
+        "WHEN 'doctor' THEN d.age "
+        "WHEN 'admin' THEN 30 "
+        "END as age, "
+        "CASE u.role "
+        "WHEN 'patient' THEN p.phone "
+        "WHEN 'doctor' THEN d.phone "
+        "ELSE '' "
+        "END as phone, "
+        "CASE u.role "
+        "WHEN 'patient' THEN p.address "
+        "ELSE '' "
+        "END as address, "
+        "CASE u.role "
+        "WHEN 'patient' THEN p.id_card "
+        "ELSE '' "
+        "END as id_card, "
+        "CASE u.role "
+        "WHEN 'doctor' THEN d.department "
+        "ELSE '' "
+        "END as department "
+        "FROM users u "
+        "LEFT JOIN patients p ON u.user_id = p.patient_id AND u.role = 'patient' "
+        "LEFT JOIN doctors d ON u.user_id = d.doctor_id AND u.role = 'doctor' ";
+
+    // 远程遍历挂号记录时每页的条数
+    constexpr int kRemotePageSize = 500;
+
+    // 导出时每写入这么多行报告一次进度
+    constexpr int kExportProgressRows = 2000;
+
+    // CSV字段：含逗号、引号或换行时加引号，内部引号双写
+    void writeCsvField(std::ostream& out, const std::string& value) {
+        if (value.find_first_of(",\"\r\n") == std::string::npos) {
+            out << value;
+            return;
+        }
+        out << '"';
+        for (char c : value) {
+            if (c == '"') out << '"';
+            out << c;
+        }
+        out << '"';
+    }
+
+    // 病人检索的候选行：branch为所属检索分支的序号，用于在客户端按分支顺序合并
+    struct PatientSearchCandidate {
+        int patientId = 0;
+        std::string name;
+        std::string phone;
+        std::string idCard;
+        int branch = 0;
+
+        static constexpr auto columns() {
+            return std::make_tuple(&PatientSearchCandidate::patientId, &PatientSearchCandidate::name,
+                &PatientSearchCandidate::phone, &PatientSearchCandidate::idCard, &PatientSearchCandidate::branch);
+        }
+    };
+}
+
+// 远程调用：参数按声明类型编码，返回值解码为R；失败时返回R的默认值，错误信息见getLastError()
+template<typename R, typename... Args>
+R SystemManager::callRemote(const char* method, const Args&... args) {
+    QJsonArray encoded;
+    (encoded.append(ServiceProtocol::encode(args)), ...);
+
+    QJsonValue result;
+    R value{};
+    if (invokeRemote(method, encoded, result)) {
+        ServiceProtocol::decode(result, value);
+    }
+    return value;
+}
+
 SystemManager::SystemManager()
-    : dbManager(std::make_unique<DatabaseManager>()) {
+    : workerPool(std::make_unique<QThreadPool>()),
+    dbManager(std::make_unique<DatabaseManager>()),
+    referenceCache(std::make_unique<ReferenceDataCache>(*dbManager)) {
 }
 
 SystemManager::~SystemManager() {
+    // 先等后台任务结束，再释放数据库连接
+    workerPool->clear();
+    workerPool->waitForDone();
+}
+
+bool SystemManager::connectRemote(const std::string& host, unsigned short port) {
+    workerPool->setMaxThreadCount(static_cast<int>(dbManager->getPoolConfig().maxConnections));
+
+    // 先调用一次确认服务可用，失败时保持本地模式
+    auto client = std::make_unique<RemoteClient>(host, port);
+    RemoteClient::Reply reply;
+    if (!client->call("ping", QJsonArray(), reply) || !reply.error.empty()) {
+        lastError() = reply.error;
+        return false;
+    }
+    remote = std::move(client);
+    return true;
+}
+
+bool SystemManager::invokeRemote(const char* method, const QJsonArray& args, QJsonValue& result) {
+    RemoteClient::Reply reply;
+    if (!remote->call(method, args, reply)) {
+        lastError() = reply.error;
+        return false;
+    }
+
+    result = reply.result;
+    for (ChangeEvent& event : reply.events) {
+        eventBus.publish(std::move(event));
+    }
+    if (!reply.error.empty()) {
+        lastError() = reply.error;
+        return false;
+    }
+    return true;
 }
 
 std::vector<std::vector<std::string>> SystemManager::executeRawQuery(const std::string& query) {
@@ -15,14 +249,17 @@ std::vector<std::vector<std::string>> SystemManager::executeRawQuery(const std::
 
 bool SystemManager::initialize(const std::string& host, const std::string& user,const std::string& password, const std::string& database,unsigned int port) {
 
+    // 后台线程数不超过连接池上限，避免任务排队等连接
+    workerPool->setMaxThreadCount(static_cast<int>(dbManager->getPoolConfig().maxConnections));
+
     if (!dbManager->connect(host, user, password, database, port)) {
-        lastError = dbManager->getLastError();
+        lastError() = dbManager->getLastError();
         return false;
     }
 
     // 初始化数据库表结构
     if (!dbManager->initializeDatabase()) {
-        lastError = dbManager->getLastError();
+        lastError() = dbManager->getLastError();
         return false;
     }
 
@@ -32,174 +269,493 @@ bool SystemManager::initialize(const std::string& host, const std::string& user,
 std::vector<RegistrationInfo> SystemManager::getAllRegistrations() {
     std::vector<RegistrationInfo> registrations;
 
-    std::string query = R"(
-        SELECT r.registration_id, r.registration_date, r.patient_id, r.doctor_id, 
-               r.status, r.notes, p.name as patient_name, d.name as doctor_name, d.department,
-               CASE WHEN rb.bill_id IS NOT NULL THEN 1 ELSE 0 END as has_bill,
-               COALESCE(b.amount, 0) as bill_amount, COALESCE(b.status, '') as bill_status
-        FROM registrations r
-        JOIN patients p ON r.patient_id = p.patient_id
-        JOIN doctors d ON r.doctor_id = d.doctor_id
-        LEFT JOIN registration_bills rb ON r.registration_id = rb.registration_id
-        LEFT JOIN bills b ON rb.bill_id = b.bill_id
-        ORDER BY r.registration_date DESC
-    )";
+    forEachRegistration([&registrations](const RegistrationInfo& info) {
+        registrations.push_back(info);
+        return true;
+    });
 
-    auto results = dbManager->getQueryResult(query);
-    for (const auto& row : results) {
-        registrations.push_back(parseRegistrationInfo(row));
+    return registrations;
+}
+
+bool SystemManager::forEachRegistration(const std::function<bool(const RegistrationInfo&)>& onRegistration,
+    int doctorId) {
+
+    // 远程模式下按游标分页取回（服务端每页最多1000条），每页在本地逐行回调，
+    // 回调提前结束时不再请求后续页
+    if (remote) {
+        RegistrationFilter filter;
+        filter.doctorId = doctorId;
+        RegistrationCursor cursor;
+        std::vector<RegistrationInfo> page;
+        do {
+            if (!queryRegistrations(filter, cursor, kRemotePageSize, page)) {
+                return false;
+            }
+            for (const RegistrationInfo& info : page) {
+                if (!onRegistration(info)) return true;
+            }
+            if (!page.empty()) {
+                cursor = RegistrationCursor::after(page.back());
+            }
+        } while (static_cast<int>(page.size()) == kRemotePageSize);
+        return true;
     }
 
-    return registrations;
+    if (doctorId > 0) {
+        return RowMapping::queryMapped<RegistrationInfo>(*dbManager,
+            kRegistrationSelect + "WHERE r.doctor_id = ? ORDER BY r.registration_date DESC",
+            { doctorId }, onRegistration, &lastError());
+    }
+    return RowMapping::queryMapped<RegistrationInfo>(*dbManager,
+        kRegistrationSelect + "ORDER BY r.registration_date DESC", {}, onRegistration, &lastError());
+}
+
+bool SystemManager::queryRegistrations(const RegistrationFilter& filter, const RegistrationCursor& cursor,
+    int limit, std::vector<RegistrationInfo>& page) {
+    page.clear();
+    limit = std::clamp(limit, 1, 1000);
+
+    if (remote) {
+        QJsonValue result;
+        if (!invokeRemote("queryRegistrations", QJsonArray{ ServiceProtocol::encode(filter),
+            ServiceProtocol::encode(cursor), limit }, result)) {
+            return false;
+        }
+        ServiceProtocol::decode(result, page);
+        return true;
+    }
+
+    // 科室条件展开为该科室的医生编号（取自参考数据缓存），由r.doctor_id上的索引过滤，
+    // 不连接doctors后按department文本列过滤（那样要先读出日期范围内的全部挂号）
+    std::vector<int> departmentDoctors;
+    if (!filter.department.empty()) {
+        auto data = referenceData();
+        if (!data) {
+            return false;
+        }
+        for (const DoctorInfo& doctor : data->doctorsIn(filter.department)) {
+            if (filter.doctorId <= 0 || doctor.doctorId == filter.doctorId) {
+                departmentDoctors.push_back(doctor.doctorId);
+            }
+        }
+        // 科室下没有医生，或所选医生不属于该科室
+        if (departmentDoctors.empty()) {
+            return true;
+        }
+    }
+
+    // 只拼接用到的条件，同一组合的SQL文本相同，可复用缓存的预处理语句
+    // 日期范围走idx_registrations_date，医生走(doctor_id, registration_date)，状态走(status, registration_date)，
+    // 科室展开为医生编号列表（见上）；二级索引末尾隐含主键，按(日期, 单号)降序读取时不需要排序
+    // 各组合的执行计划见QueryPlanAudit
+    std::string sql = kRegistrationSelect + "WHERE 1 = 1";
+    std::vector<SqlParam> params;
+    if (!filter.startDate.empty()) {
+        sql += " AND r.registration_date >= ?";
+        params.emplace_back(filter.startDate);
+    }
+    if (!filter.endDate.empty()) {
+        sql += " AND r.registration_date <= ?";
+        params.emplace_back(filter.endDate);
+    }
+    if (filter.doctorId > 0) {
+        sql += " AND r.doctor_id = ?";
+        params.emplace_back(filter.doctorId);
+    }
+    if (!filter.status.empty()) {
+        sql += " AND r.status = ?";
+        params.emplace_back(filter.status);
+    }
+    if (!departmentDoctors.empty() && filter.doctorId <= 0) {
+        sql += " AND r.doctor_id IN (";
+        for (std::size_t i = 0; i < departmentDoctors.size(); ++i) {
+            sql += i == 0 ? "?" : ", ?";
+            params.emplace_back(departmentDoctors[i]);
+        }
+        sql += ")";
+    }
+    if (cursor.registrationId > 0) {
+        // 展开为范围条件，日期上界让优化器直接定位到游标处
+        sql += " AND r.registration_date <= ? AND (r.registration_date < ? "
+            "OR (r.registration_date = ? AND r.registration_id < ?))";
+        params.emplace_back(cursor.registrationDate);
+        params.emplace_back(cursor.registrationDate);
+        params.emplace_back(cursor.registrationDate);
+        params.emplace_back(cursor.registrationId);
+    }
+    sql += " ORDER BY r.registration_date DESC, r.registration_id DESC LIMIT ?";
+    params.emplace_back(limit);
+
+    return RowMapping::queryMapped<RegistrationInfo>(*dbManager, sql, params, [&page](const RegistrationInfo& info) {
+        page.push_back(info);
+        return true;
+    }, &lastError());
+}
+
+int SystemManager::exportRegistrationsCsv(const std::string& filePath, int doctorId,
+    const std::function<bool(int rows)>& onProgress) {
+    std::ofstream out(std::filesystem::u8path(filePath), std::ios::binary | std::ios::trunc);
+    if (!out) {
+        lastError() = "无法创建导出文件: " + filePath;
+        return -1;
+    }
+
+    // UTF-8 BOM，便于Excel正确识别中文
+    out << "\xEF\xBB\xBF";
+    out << "单号,日期,病人ID,病人,医生ID,医生,科室,状态,费用,账单状态,备注\r\n";
+
+    int count = 0;
+    bool cancelled = false;
+    bool ok = forEachRegistration([&](const RegistrationInfo& reg) {
+        out << reg.registrationId << ',';
+        writeCsvField(out, reg.registrationDate);
+        out << ',' << reg.patientId << ',';
+        writeCsvField(out, reg.patientName);
+        out << ',' << reg.doctorId << ',';
+        writeCsvField(out, reg.doctorName);
+        out << ',';
+        writeCsvField(out, reg.doctorDepartment);
+        out << ',';
+        writeCsvField(out, reg.status);
+        out << ',';
+        if (reg.hasBill) {
+            out << std::fixed << std::setprecision(2) << reg.billAmount;
+        }
+        out << ',';
+        writeCsvField(out, reg.billStatus);
+        out << ',';
+        writeCsvField(out, reg.notes);
+        out << "\r\n";
+        ++count;
+        if (onProgress && count % kExportProgressRows == 0 && !onProgress(count)) {
+            cancelled = true;
+            return false;
+        }
+        return static_cast<bool>(out);
+    }, doctorId);
+
+    if (cancelled) {
+        out.close();
+        std::error_code ignored;
+        std::filesystem::remove(std::filesystem::u8path(filePath), ignored);
+        lastError() = "导出已取消";
+        return -1;
+    }
+    if (!ok) {
+        return -1;
+    }
+    out.flush();
+    if (!out) {
+        lastError() = "写入导出文件失败: " + filePath;
+        return -1;
+    }
+    return count;
 }
 
 RegistrationInfo SystemManager::getRegistrationById(int registrationId) {
+    if (remote) return callRemote<RegistrationInfo>("getRegistrationById", registrationId);
     RegistrationInfo info;
 
-    std::stringstream query;
-    query << "SELECT r.registration_id, r.registration_date, r.patient_id, r.doctor_id, "
-        << "r.status, r.notes, p.name as patient_name, d.name as doctor_name, d.department, "
-        << "CASE WHEN rb.bill_id IS NOT NULL THEN 1 ELSE 0 END as has_bill, "
-        << "COALESCE(b.amount, 0) as bill_amount, COALESCE(b.status, '') as bill_status "
-        << "FROM registrations r "
-        << "JOIN patients p ON r.patient_id = p.patient_id "
-        << "JOIN doctors d ON r.doctor_id = d.doctor_id "
-        << "LEFT JOIN registration_bills rb ON r.registration_id = rb.registration_id "
-        << "LEFT JOIN bills b ON rb.bill_id = b.bill_id "
-        << "WHERE r.registration_id = " << registrationId;
-
-    auto results = dbManager->getQueryResult(query.str());
-    if (!results.empty()) {
-        info = parseRegistrationInfo(results[0]);
-    }
+    RowMapping::queryOne(*dbManager, kRegistrationSelect + "WHERE r.registration_id = ?", { registrationId }, info);
 
     return info;
 }
 
+std::vector<PatientSearchResult> SystemManager::searchPatients(const std::string& term, int limit) {
+    if (remote) return callRemote<std::vector<PatientSearchResult>>("searchPatients", term, limit);
+    std::vector<PatientSearchResult> results;
+
+    std::size_t first = term.find_first_not_of(" \t");
+    std::size_t last = term.find_last_not_of(" \t");
+    if (first == std::string::npos || limit <= 0) {
+        return results;
+    }
+    std::string keyword = term.substr(first, last - first + 1);
+
+    // LIKE前缀：转义通配符
+    std::string prefix;
+    for (char c : keyword) {
+        if (c == '%' || c == '_' || c == '\\') prefix += '\\';
+        prefix += c;
+    }
+    prefix += '%';
+
+    // 每个分支带上自己的序号，UNION ALL不保证各分支的输出顺序，合并时按序号排序
+    std::vector<std::string> parts;
+    std::vector<SqlParam> params;
+    auto columns = [&parts]() {
+        return "SELECT patient_id, name, phone, id_card, " + std::to_string(parts.size())
+            + " AS branch FROM patients ";
+    };
+
+    bool numeric = keyword.size() <= 9 && keyword.find_first_not_of("0123456789") == std::string::npos;
+    if (numeric) {
+        parts.push_back("(" + columns() + "WHERE patient_id = ?)");
+        params.emplace_back(std::stoi(keyword));
+    }
+    parts.push_back("(" + columns() + "WHERE name LIKE ? ORDER BY name LIMIT ?)");
+    params.emplace_back(prefix);
+    params.emplace_back(limit);
+
+    // 含字母时按拼音检索（zs、zhangs、张s），命中的病人在客户端按拼音匹配顺序排列
+    // 编号按limit个占位符绑定，不足的用不存在的编号0补齐：SQL文本只取决于limit，
+    // 逐字输入时复用同一条缓存的预处理语句，不会挤掉其他常用语句
+    int pinyinBranch = -1;
+    std::unordered_map<int, std::size_t> pinyinPositions;
+    bool hasLetter = std::any_of(keyword.begin(), keyword.end(),
+        [](unsigned char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'); });
+    if (hasLetter && prepareNameIndex()) {
+        std::vector<PinyinIndex::Match> matches = patientNameIndex.lookup(keyword, static_cast<std::size_t>(limit));
+        if (!matches.empty()) {
+            std::string placeholders;
+            for (int i = 0; i < limit; ++i) {
+                placeholders += i == 0 ? "?" : ", ?";
+                if (i < static_cast<int>(matches.size())) {
+                    pinyinPositions.emplace(matches[i].id, i);
+                    params.emplace_back(matches[i].id);
+                } else {
+                    params.emplace_back(0);
+                }
+            }
+            pinyinBranch = static_cast<int>(parts.size());
+            parts.push_back("(" + columns() + "WHERE patient_id IN (" + placeholders + "))");
+        }
+    }
+
+    for (const char* column : { "phone", "id_card" }) {
+        parts.push_back("(" + columns() + "WHERE " + column + " LIKE ? ORDER BY " + column + " LIMIT ?)");
+        params.emplace_back(prefix);
+        params.emplace_back(limit);
+    }
+
+    // 子串匹配走ngram全文索引；按UTF-8字符计，不足两个字符时无法组成ngram词，只做前缀匹配
+    std::size_t characters = 0;
+    for (unsigned char c : keyword) {
+        if ((c & 0xC0) != 0x80) ++characters;
+    }
+    if (characters >= 2) {
+        // 作为短语检索，去掉引号后布尔模式的运算符都在短语内，不再生效
+        std::string phrase;
+        for (char c : keyword) {
+            if (c != '"') phrase += c;
+        }
+        parts.push_back("(" + columns() + "WHERE MATCH(name, phone, id_card) AGAINST (? IN BOOLEAN MODE) LIMIT ?)");
+        params.emplace_back("\"" + phrase + "\"");
+        params.emplace_back(limit);
+    }
+
+    std::string sql;
+    for (const std::string& part : parts) {
+        sql += sql.empty() ? part : " UNION ALL " + part;
+    }
+
+    std::string error;
+    std::vector<PatientSearchCandidate> candidates = RowMapping::queryAll<PatientSearchCandidate>(*dbManager,
+        sql, params, &error);
+    if (!error.empty()) {
+        lastError() = "检索病人失败: " + error;
+        return results;
+    }
+
+    // 按分支顺序排列（拼音分支内按索引匹配顺序，其他分支保持SQL的顺序），同一病人只保留第一次出现的位置
+    std::stable_sort(candidates.begin(), candidates.end(),
+        [&](const PatientSearchCandidate& a, const PatientSearchCandidate& b) {
+            if (a.branch != b.branch) return a.branch < b.branch;
+            return a.branch == pinyinBranch && pinyinPositions[a.patientId] < pinyinPositions[b.patientId];
+        });
+    std::unordered_set<int> seen;
+    for (PatientSearchCandidate& candidate : candidates) {
+        if (static_cast<int>(results.size()) >= limit) break;
+        if (seen.insert(candidate.patientId).second) {
+            results.push_back({ candidate.patientId, std::move(candidate.name), std::move(candidate.phone),
+                std::move(candidate.idCard) });
+        }
+    }
+    return results;
+}
+
+bool SystemManager::prepareNameIndex() {
+    if (remote) return callRemote<bool>("prepareNameIndex");
+
+    // updateNameIndex只能看到本进程的修改，其他客户端新增的病人要等超过最长缓存时间重新加载后才能检索到
+    auto isFresh = [this]() {
+        auto loadedAt = std::chrono::steady_clock::time_point(
+            std::chrono::steady_clock::duration(nameIndexLoadedAt.load()));
+        return nameIndexLoaded
+            && std::chrono::steady_clock::now() - loadedAt < std::chrono::seconds(nameIndexMaxAgeSeconds.load());
+    };
+    if (isFresh()) {
+        return true;
+    }
+
+    // 已加载时由一个线程在后台重新加载，其他线程继续使用旧索引，不等待
+    std::unique_lock<std::mutex> lock(nameIndexMutex, std::try_to_lock);
+    if (!lock) {
+        if (nameIndexLoaded) {
+            return true;
+        }
+        lock.lock();
+    }
+    if (isFresh()) {
+        return true;
+    }
+
+    // 只取编号和姓名，逐行读取
+    auto loadNames = [this](const char* sql, std::vector<std::pair<int, std::string>>& names) {
+        return dbManager->queryPrepared(sql, {}, [&names](const StatementRow& row) {
+            names.emplace_back(static_cast<int>(row.getInt(0)), row.getString(1));
+            return true;
+        });
+    };
+
+    std::vector<std::pair<int, std::string>> doctors, patients;
+    if (!loadNames("SELECT doctor_id, name FROM doctors", doctors)
+        || !loadNames("SELECT patient_id, name FROM patients", patients)) {
+        lastError() = "加载拼音索引失败: " + dbManager->getLastError();
+        return false;
+    }
+
+    doctorNameIndex.assign(doctors);
+    patientNameIndex.assign(patients);
+    nameIndexLoadedAt = std::chrono::steady_clock::now().time_since_epoch().count();
+    nameIndexLoaded = true;
+    return true;
+}
+
+void SystemManager::setNameIndexMaxAge(std::chrono::seconds maxAge) {
+    nameIndexMaxAgeSeconds = maxAge.count();
+}
+
+void SystemManager::updateNameIndex(const std::string& role, int userId, const std::string& name) {
+    // 尚未加载时无需维护，加载时会读到最新数据
+    if (!nameIndexLoaded) {
+        return;
+    }
+    if (role == "patient") {
+        patientNameIndex.upsert(userId, name);
+    }
+    else if (role == "doctor") {
+        doctorNameIndex.upsert(userId, name);
+    }
+}
+
+std::vector<DoctorInfo> SystemManager::searchDoctors(const std::string& term, int limit) {
+    if (remote) return callRemote<std::vector<DoctorInfo>>("searchDoctors", term, limit);
+    std::vector<DoctorInfo> results;
+    auto data = referenceData();
+    if (!data || term.empty() || limit <= 0) {
+        return results;
+    }
+
+    std::unordered_map<int, const DoctorInfo*> doctorsById;
+    for (const DoctorInfo& doctor : data->doctors) {
+        doctorsById.emplace(doctor.doctorId, &doctor);
+    }
+
+    // 汉字直接按姓名包含匹配（医生数量少），同时按拼音检索
+    std::unordered_set<int> seen;
+    for (const DoctorInfo& doctor : data->doctors) {
+        if (static_cast<int>(results.size()) >= limit) break;
+        if (doctor.name.find(term) != std::string::npos && seen.insert(doctor.doctorId).second) {
+            results.push_back(doctor);
+        }
+    }
+
+    if (prepareNameIndex()) {
+        for (const PinyinIndex::Match& match : doctorNameIndex.lookup(term, static_cast<std::size_t>(limit))) {
+            if (static_cast<int>(results.size()) >= limit) break;
+            auto it = doctorsById.find(match.id);
+            if (it != doctorsById.end() && seen.insert(match.id).second) {
+                results.push_back(*it->second);
+            }
+        }
+    }
+    return results;
+}
+
 std::vector<RegistrationInfo> SystemManager::getRegistrationsByDoctor(int doctorId) {
     std::vector<RegistrationInfo> registrations;
 
-    std::stringstream query;
-    query << "SELECT r.registration_id, r.registration_date, r.patient_id, r.doctor_id, "
-        << "r.status, r.notes, p.name as patient_name, d.name as doctor_name, d.department, "
-        << "CASE WHEN rb.bill_id IS NOT NULL THEN 1 ELSE 0 END as has_bill, "
-        << "COALESCE(b.amount, 0) as bill_amount, COALESCE(b.status, '') as bill_status "
-        << "FROM registrations r "
-        << "JOIN patients p ON r.patient_id = p.patient_id "
-        << "JOIN doctors d ON r.doctor_id = d.doctor_id "
-        << "LEFT JOIN registration_bills rb ON r.registration_id = rb.registration_id "
-        << "LEFT JOIN bills b ON rb.bill_id = b.bill_id "
-        << "WHERE r.doctor_id = " << doctorId
-        << " ORDER BY r.registration_date DESC";
-
-    auto results = dbManager->getQueryResult(query.str());
-    for (const auto& row : results) {
-        registrations.push_back(parseRegistrationInfo(row));
-    }
+    forEachRegistration([&registrations](const RegistrationInfo& info) {
+        registrations.push_back(info);
+        return true;
+    }, doctorId);
 
     return registrations;
 }
 
 std::vector<DoctorInfo> SystemManager::getDoctorsByDepartment(const std::string& department) {
-    std::vector<DoctorInfo> doctors;
-
-    std::stringstream query;
-    query << "SELECT doctor_id, name, gender, age, phone, department "
-        << "FROM doctors WHERE department = '" << dbManager->escapeString(department) << "' "
-        << "ORDER BY name";
+    if (remote) return callRemote<std::vector<DoctorInfo>>("getDoctorsByDepartmentName", department);
+    auto data = referenceData();
+    return data ? data->doctorsIn(department) : std::vector<DoctorInfo>();
+}
 
-    auto results = dbManager->getQueryResult(query.str());
-    for (const auto& row : results) {
-        doctors.push_back(parseDoctorInfo(row));
+UserInfo SystemManager::login(const std::string& username, const std::string& password, const std::string& role) {
+    if (remote) {
+        // 服务端按连接鉴权，其他线程的连接在下一次调用前以同一账号登录
+        UserInfo user = callRemote<UserInfo>("login", username, password, role);
+        if (user.userId != 0) {
+            remote->setLogin(username, password, role);
+        }
+        return user;
+    }
+    const char* query = loginQuery(role);
+    if (!query) {
+        lastError() = "不支持的用户角色";
+        return UserInfo();
     }
 
-    return doctors;
-}
+    LoginRecord record;
+    std::string error;
+    if (!RowMapping::queryOne(*dbManager, query, { username }, record, &error)) {
+        lastError() = error.empty() ? "用户名或密码错误" : error;
+        return UserInfo();
+    }
 
-UserInfo SystemManager::login(const std::string& username, const std::string& password) {
-    UserInfo userInfo;
-    std::string hashedPassword = hashPassword(password);
+    // 口令在本地校验，计算期间不占用数据库连接
+    bool needsRehash = false;
+    if (!PasswordHasher::verify(password, record.passwordHash, &needsRehash)) {
+        lastError() = "用户名或密码错误";
+        return UserInfo();
+    }
 
-    std::stringstream query;
-    query << "SELECT u.user_id, u.username, u.role, "
-        << "CASE u.role "
-        << "WHEN 'patient' THEN p.name "
-        << "WHEN 'doctor' THEN d.name "
-        << "WHEN 'admin' THEN '系统管理员' "
-        << "END as name, "
-        << "CASE u.role "
-        << "WHEN 'patient' THEN p.gender "
-        << "WHEN 'doctor' THEN d.gender "
-        << "WHEN 'admin' THEN 'male' "
-        << "END as gender, "
-        << "CASE u.role "
-        << "WHEN 'patient' THEN p.age "
-        << "WHEN 'doctor' THEN d.age "
-        << "WHEN 'admin' THEN 30 "
-        << "END as age, "
-        << "CASE u.role "
-        << "WHEN 'patient' THEN p.phone "
-        << "WHEN 'doctor' THEN d.phone "
-        << "ELSE '' "
-        << "END as phone, "
-        << "CASE u.role "
-        << "WHEN 'patient' THEN p.address "
-        << "ELSE '' "
-        << "END as address, "
-        << "CASE u.role "
-        << "WHEN 'patient' THEN p.id_card "
-        << "ELSE '' "
-        << "END as id_card, "
-        << "CASE u.role "
-        << "WHEN 'doctor' THEN d.department "
-        << "ELSE '' "
-        << "END as department "
-        << "FROM users u "
-        << "LEFT JOIN patients p ON u.user_id = p.patient_id AND u.role = 'patient' "
-        << "LEFT JOIN doctors d ON u.user_id = d.doctor_id AND u.role = 'doctor' "
-        << "WHERE u.username = '" << dbManager->escapeString(username) << "' "
-        << "AND u.password_hash = '" << hashedPassword << "'";
-
-    auto results = dbManager->getQueryResult(query.str());
-    if (results.empty()) {
-        lastError = "用户名或密码错误";
-        return userInfo;
+    // 旧的MD5哈希或迭代次数不足时升级；失败不影响本次登录，下次登录再升级
+    if (needsRehash) {
+        dbManager->executePrepared("UPDATE users SET password_hash = ? WHERE user_id = ? AND password_hash = ?",
+            { PasswordHasher::hash(password), record.userId, record.passwordHash });
     }
 
-    return parseUserInfo(results[0]);
+    return static_cast<const UserInfo&>(record);
 }
 
 bool SystemManager::registerUser(const std::string& username, const std::string& password,const std::string& role, const UserInfo& userInfo) {
+    if (remote) return callRemote<bool>("registerUser", username, password, role, userInfo);
 
     // 检查用户名是否存在
-    std::string checkQuery = "SELECT user_id FROM users WHERE username = '" +
-        dbManager->escapeString(username) + "'";
-    auto results = dbManager->getQueryResult(checkQuery);
-    if (!results.empty()) {
-        lastError = "用户名已存在";
+    bool exists = false;
+    dbManager->queryPrepared("SELECT user_id FROM users WHERE username = ?", { username },
+        [&](const StatementRow&) {
+            exists = true;
+            return false;
+        });
+    if (exists) {
+        lastError() = "用户名已存在";
         return false;
     }
 
-    std::string hashedPassword = hashPassword(password);
-    std::string escapedUsername = dbManager->escapeString(username);
-    std::string escapedName = dbManager->escapeString(userInfo.name);
-    std::string escapedGender = dbManager->escapeString(userInfo.gender);
-    std::string escapedPhone = dbManager->escapeString(userInfo.phone);
+    std::string hashedPassword = PasswordHasher::hash(password);
 
     // 开始事务
     if (!dbManager->startTransaction()) {
-        lastError = dbManager->getLastError();
+        lastError() = dbManager->getLastError();
         return false;
     }
 
     // 1. 在users表创建用户
-    std::stringstream userQuery;
-    userQuery << "INSERT INTO users (username, password_hash, role) VALUES ('"
-        << escapedUsername << "', '" << hashedPassword << "', '" << role << "')";
-
-    if (!dbManager->executeQuery(userQuery.str())) {
+    if (!dbManager->executePrepared("INSERT INTO users (username, password_hash, role) VALUES (?, ?, ?)",
+        { username, hashedPassword, role })) {
+        lastError() = dbManager->getLastError();
         dbManager->rollbackTransaction();
-        lastError = dbManager->getLastError();
         return false;
     }
 
@@ -207,287 +763,378 @@ bool SystemManager::registerUser(const std::string& username, const std::string&
 
     // 2. 根据角色插入详细信息
     if (role == "patient") {
-        std::string escapedAddress = dbManager->escapeString(userInfo.address);
-        std::string escapedIdCard = dbManager->escapeString(userInfo.idCard);
-
-        std::stringstream patientQuery;
-        patientQuery << "INSERT INTO patients (patient_id, name, gender, age, address, phone, id_card) VALUES ("
-            << userId << ", '" << escapedName << "', '" << escapedGender << "', "
-            << userInfo.age << ", '" << escapedAddress << "', '" << escapedPhone
-            << "', '" << escapedIdCard << "')";
-
-        if (!dbManager->executeQuery(patientQuery.str())) {
+        if (!dbManager->executePrepared(
+            "INSERT INTO patients (patient_id, name, gender, age, address, phone, id_card) "
+            "VALUES (?, ?, ?, ?, ?, ?, ?)",
+            { userId, userInfo.name, userInfo.gender, userInfo.age, userInfo.address,
+              userInfo.phone, userInfo.idCard })
+            || !dbManager->executePrepared(
+                "UPDATE hospital_counters SET patient_count = patient_count + 1 WHERE counter_id = 1")) {
+            lastError() = dbManager->getLastError();
             dbManager->rollbackTransaction();
-            lastError = dbManager->getLastError();
             return false;
         }
     }
     else if (role == "doctor") {
-        std::string escapedDepartment = dbManager->escapeString(userInfo.department);
-
-        std::stringstream doctorQuery;
-        doctorQuery << "INSERT INTO doctors (doctor_id, name, gender, age, phone, department) VALUES ("
-            << userId << ", '" << escapedName << "', '" << escapedGender << "', "
-            << userInfo.age << ", '" << escapedPhone << "', '" << escapedDepartment << "')";
-
-        if (!dbManager->executeQuery(doctorQuery.str())) {
+        if (!dbManager->executePrepared(
+            "INSERT INTO doctors (doctor_id, name, gender, age, phone, department) VALUES (?, ?, ?, ?, ?, ?)",
+            { userId, userInfo.name, userInfo.gender, userInfo.age, userInfo.phone, userInfo.department })
+            || !dbManager->executePrepared(
+                "UPDATE hospital_counters SET doctor_count = doctor_count + 1 WHERE counter_id = 1")) {
+            lastError() = dbManager->getLastError();
             dbManager->rollbackTransaction();
-            lastError = dbManager->getLastError();
             return false;
         }
     }
 
     if (!dbManager->commitTransaction()) {
-        lastError = dbManager->getLastError();
+        lastError() = dbManager->getLastError();
         return false;
     }
 
+    if (role == "doctor") {
+        referenceCache->invalidate();
+    }
+    updateNameIndex(role, userId, userInfo.name);
+
+    ChangeEvent event;
+    event.type = ChangeEvent::Type::UserUpdated;
+    event.userId = userId;
+    event.role = role;
+    eventBus.publish(std::move(event));
+
     return true;
 }
 
 UserInfo SystemManager::getUserInfo(int userId) {
+    if (remote) return callRemote<UserInfo>("getUserInfo", userId);
     UserInfo userInfo;
 
-    std::stringstream query;
-    query << "SELECT u.user_id, u.username, u.role, "
-        << "CASE u.role "
-        << "WHEN 'patient' THEN p.name "
-        << "WHEN 'doctor' THEN d.name "
-        << "WHEN 'admin' THEN '系统管理员' "
-        << "END as name, "
-        << "CASE u.role "
-        << "WHEN 'patient' THEN p.gender "
-        << "WHEN 'doctor' THEN d.gender "
-        << "WHEN 'admin' THEN 'male' "
-        << "END as gender, "
-        << "CASE u.role "
-        << "WHEN 'patient' THEN p.age "
-        << "WHEN 'doctor' THEN d.age "
-        << "WHEN 'admin' THEN 30 "
-        << "END as age, "
-        << "CASE u.role "
-        << "WHEN 'patient' THEN p.phone "
-        << "WHEN 'doctor' THEN d.phone "
-        << "ELSE '' "
-        << "END as phone, "
-        << "CASE u.role "
-        << "WHEN 'patient' THEN p.address "
-        << "ELSE '' "
-        << "END as address, "
-        << "CASE u.role "
-        << "WHEN 'patient' THEN p.id_card "
-        << "ELSE '' "
-        << "END as id_card, "
-        << "CASE u.role "
-        << "WHEN 'doctor' THEN d.department "
-        << "ELSE '' "
-        << "END as department "
-        << "FROM users u "
-        << "LEFT JOIN patients p ON u.user_id = p.patient_id AND u.role = 'patient' "
-        << "LEFT JOIN doctors d ON u.user_id = d.doctor_id AND u.role = 'doctor' "
-        << "WHERE u.user_id = " << userId;
-
-    auto results = dbManager->getQueryResult(query.str());
-    if (results.empty()) {
-        lastError = "用户不存在";
+    if (!RowMapping::queryOne(*dbManager, kUserSelect + "WHERE u.user_id = ?", { userId }, userInfo)) {
+        lastError() = "用户不存在";
         return userInfo;
     }
 
-    return parseUserInfo(results[0]);
+    return userInfo;
 }
 
 bool SystemManager::updateUserInfo(const UserInfo& userInfo) {
-    std::string escapedName = dbManager->escapeString(userInfo.name);
-    std::string escapedGender = dbManager->escapeString(userInfo.gender);
-    std::string escapedPhone = dbManager->escapeString(userInfo.phone);
+    if (remote) return callRemote<bool>("updateUserInfo", userInfo);
+    bool ok = false;
 
     if (userInfo.role == "patient") {
-        std::string escapedAddress = dbManager->escapeString(userInfo.address);
-        std::string escapedIdCard = dbManager->escapeString(userInfo.idCard);
+        ok = dbManager->executePrepared(
+            "UPDATE patients SET name = ?, gender = ?, age = ?, address = ?, phone = ?, id_card = ? "
+            "WHERE patient_id = ?",
+            { userInfo.name, userInfo.gender, userInfo.age, userInfo.address, userInfo.phone,
+              userInfo.idCard, userInfo.userId });
+    }
+    else if (userInfo.role == "doctor") {
+        ok = dbManager->executePrepared(
+            "UPDATE doctors SET name = ?, gender = ?, age = ?, phone = ?, department = ? "
+            "WHERE doctor_id = ?",
+            { userInfo.name, userInfo.gender, userInfo.age, userInfo.phone, userInfo.department,
+              userInfo.userId });
+    }
+    else {
+        lastError() = "不支持的用户角色";
+        return false;
+    }
 
-        std::stringstream query;
-        query << "UPDATE patients SET name = '" << escapedName
-            << "', gender = '" << escapedGender
-            << "', age = " << userInfo.age
-            << ", address = '" << escapedAddress
-            << "', phone = '" << escapedPhone
-            << "', id_card = '" << escapedIdCard
-            << "' WHERE patient_id = " << userInfo.userId;
+    if (!ok) {
+        lastError() = dbManager->getLastError();
+    }
+    else {
+        if (userInfo.role == "doctor") {
+            referenceCache->invalidate();
+        }
+        updateNameIndex(userInfo.role, userInfo.userId, userInfo.name);
 
-        return dbManager->executeQuery(query.str());
+        ChangeEvent event;
+        event.type = ChangeEvent::Type::UserUpdated;
+        event.userId = userInfo.userId;
+        event.role = userInfo.role;
+        eventBus.publish(std::move(event));
     }
-    else if (userInfo.role == "doctor") {
-        std::string escapedDepartment = dbManager->escapeString(userInfo.department);
+    return ok;
+}
 
-        std::stringstream query;
-        query << "UPDATE doctors SET name = '" << escapedName
-            << "', gender = '" << escapedGender
-            << "', age = " << userInfo.age
-            << ", phone = '" << escapedPhone
-            << "', department = '" << escapedDepartment
-            << "' WHERE doctor_id = " << userInfo.userId;
+int SystemManager::createRegistration(int patientId, int doctorId,const std::string& date, const std::string& notes) {
+    if (remote) return callRemote<int>("createRegistration", patientId, doctorId, date, notes);
 
-        return dbManager->executeQuery(query.str());
+    // 插入挂号并计入daily_stats，由存储过程在同一事务中完成；参数绑定，SQL文本固定，语句可缓存复用
+    int registrationId = -1;
+    if (!dbManager->queryPrepared("CALL book_registration(?, ?, ?, ?)", { date, patientId, doctorId, notes },
+        [&registrationId](const StatementRow& row) {
+        registrationId = static_cast<int>(row.getInt(0));
+        return false;
+    })) {
+        lastError() = dbManager->getLastError();
+        return -1;
     }
 
-    lastError = "不支持的用户角色";
-    return false;
+    // 只有医生已加载的今日队列或有事件订阅者时才需要补充病人姓名等信息（按主键读取一行）
+    bool queueLoaded = date == todayDate() && doctorQueues.isLoaded(doctorId, date);
+    if (queueLoaded || eventBus.hasSubscribers()) {
+        RegistrationInfo info = getRegistrationById(registrationId);
+        enqueuePendingRegistration(info);
+        eventBus.publish(registrationEvent(ChangeEvent::Type::RegistrationCreated, info));
+    }
+    return registrationId;
 }
 
-int SystemManager::createRegistration(int patientId, int doctorId,const std::string& date, const std::string& notes) {
+bool SystemManager::updateRegistrationStatus(int registrationId, const std::string& status,
+    const std::string& notes) {
+    if (remote) return callRemote<bool>("updateRegistrationStatus", registrationId, status, notes);
 
-    std::string escapedDate = dbManager->escapeString(date);
-    std::string escapedNotes = dbManager->escapeString(notes);
+    // notes为空时保留原备注
+    if (!dbManager->executePrepared("CALL set_registration_status(?, ?, ?)",
+        { registrationId, status, notes.empty() ? SqlParam() : SqlParam(notes) })) {
+        lastError() = dbManager->getLastError();
+        return false;
+    }
 
-    std::stringstream query;
-    query << "INSERT INTO registrations (registration_date, patient_id, doctor_id, notes) "
-        << "VALUES ('" << escapedDate << "', " << patientId << ", " << doctorId
-        << ", '" << escapedNotes << "')";
+    if (status != "pending") {
+        doctorQueues.onRegistrationClosed(registrationId);
+    }
+    if (status == "pending" || eventBus.hasSubscribers()) {
+        RegistrationInfo info = getRegistrationById(registrationId);
+        if (status == "pending") {
+            enqueuePendingRegistration(info);
+        }
+        eventBus.publish(registrationEvent(ChangeEvent::Type::RegistrationStatusChanged, info));
+    }
+    return true;
+}
 
-    if (!dbManager->executeQuery(query.str())) {
-        lastError = dbManager->getLastError();
-        return -1;
+bool SystemManager::deleteRegistration(int registrationId) {
+    if (remote) return callRemote<bool>("deleteRegistration", registrationId);
+    if (!dbManager->executeQuery("CALL delete_registration(" + std::to_string(registrationId) + ")")) {
+        lastError() = dbManager->getLastError();
+        return false;
     }
+    doctorQueues.onRegistrationClosed(registrationId);
 
-    return dbManager->getLastInsertId();
+    ChangeEvent event;
+    event.type = ChangeEvent::Type::RegistrationDeleted;
+    event.registrationId = registrationId;
+    eventBus.publish(std::move(event));
+    return true;
 }
 
-std::vector<RegistrationInfo> SystemManager::getRegistrationsByPatient(int patientId) {
-    std::vector<RegistrationInfo> registrations;
+std::unordered_map<int, int> SystemManager::getRemainingSlots(const std::string& date) {
+    if (remote) return callRemote<std::unordered_map<int, int>>("getRemainingSlots", date);
+    std::unordered_map<int, int> remaining;
+    if (!dbManager->queryPrepared(kRemainingSlotsQuery, { date }, [&remaining](const StatementRow& row) {
+        remaining[static_cast<int>(row.getInt(0))] = std::max(0, static_cast<int>(row.getInt(1)));
+        return true;
+    })) {
+        lastError() = dbManager->getLastError();
+    }
+    return remaining;
+}
 
-    std::stringstream query;
-    query << "SELECT r.registration_id, r.registration_date, r.patient_id, r.doctor_id, "
-        << "r.status, r.notes, p.name as patient_name, d.name as doctor_name, d.department, "
-        << "CASE WHEN rb.bill_id IS NOT NULL THEN 1 ELSE 0 END as has_bill, "
-        << "COALESCE(b.amount, 0) as bill_amount, COALESCE(b.status, '') as bill_status "
-        << "FROM registrations r "
-        << "JOIN patients p ON r.patient_id = p.patient_id "
-        << "JOIN doctors d ON r.doctor_id = d.doctor_id "
-        << "LEFT JOIN registration_bills rb ON r.registration_id = rb.registration_id "
-        << "LEFT JOIN bills b ON rb.bill_id = b.bill_id "
-        << "WHERE r.patient_id = " << patientId
-        << " ORDER BY r.registration_date DESC";
-
-    auto results = dbManager->getQueryResult(query.str());
-    for (const auto& row : results) {
-        registrations.push_back(parseRegistrationInfo(row));
+bool SystemManager::setDoctorDailyCapacity(int doctorId, int capacity) {
+    if (remote) return callRemote<bool>("setDoctorDailyCapacity", doctorId, capacity);
+    if (capacity < 0) {
+        lastError() = "号源数不能为负数";
+        return false;
+    }
+    if (!dbManager->executePrepared("UPDATE doctors SET daily_capacity = ? WHERE doctor_id = ?",
+        { capacity, doctorId })) {
+        lastError() = dbManager->getLastError();
+        return false;
     }
 
-    return registrations;
+    ChangeEvent event;
+    event.type = ChangeEvent::Type::DoctorCapacityChanged;
+    event.doctorId = doctorId;
+    eventBus.publish(std::move(event));
+    return true;
 }
 
-int SystemManager::createBill(int registrationId, double amount) {
-    // 开始事务
-    if (!dbManager->startTransaction()) {
-        lastError = dbManager->getLastError();
-        return -1;
+bool SystemManager::setDoctorSlotCapacity(int doctorId, const std::string& date, int capacity) {
+    if (remote) return callRemote<bool>("setDoctorSlotCapacity", doctorId, date, capacity);
+    if (capacity < 0) {
+        lastError() = "号源数不能为负数";
+        return false;
+    }
+    // 调低到已挂号数以下时不影响已有挂号，只是不再接受新的挂号
+    if (!dbManager->executePrepared(
+        "INSERT INTO doctor_slots (doctor_id, slot_date, capacity, booked) VALUES (?, ?, ?, 0) "
+        "ON DUPLICATE KEY UPDATE capacity = VALUES(capacity)", { doctorId, date, capacity })) {
+        lastError() = dbManager->getLastError();
+        return false;
     }
 
-    // 1. 创建账单
-    std::stringstream billQuery;
-    billQuery << "INSERT INTO bills (bill_date, amount) VALUES (CURDATE(), " << amount << ")";
+    ChangeEvent event;
+    event.type = ChangeEvent::Type::DoctorCapacityChanged;
+    event.doctorId = doctorId;
+    event.date = date;
+    eventBus.publish(std::move(event));
+    return true;
+}
 
-    if (!dbManager->executeQuery(billQuery.str())) {
-        dbManager->rollbackTransaction();
-        lastError = dbManager->getLastError();
-        return -1;
+void SystemManager::enqueuePendingRegistration(const RegistrationInfo& info) {
+    if (info.registrationId > 0 && info.status == "pending") {
+        doctorQueues.onRegistrationPending(info.doctorId, toQueueEntry(info));
     }
+}
 
-    int billId = dbManager->getLastInsertId();
+bool SystemManager::loadDoctorQueue(int doctorId) {
+    if (remote) return callRemote<bool>("loadDoctorQueue", doctorId);
+    std::string today = todayDate();
+    std::string error;
+    std::vector<RegistrationInfo> pending = RowMapping::queryAll<RegistrationInfo>(*dbManager,
+        kRegistrationSelect + "WHERE r.doctor_id = ? AND r.registration_date = ? AND r.status = 'pending' "
+        "ORDER BY r.registration_id", { doctorId, today }, &error);
+    if (!error.empty()) {
+        lastError() = "加载候诊队列失败: " + error;
+        return false;
+    }
 
-    // 2. 关联挂号单和账单
-    std::stringstream linkQuery;
-    linkQuery << "INSERT INTO registration_bills (registration_id, bill_id) VALUES ("
-        << registrationId << ", " << billId << ")";
+    std::vector<QueueEntry> entries;
+    entries.reserve(pending.size());
+    for (const RegistrationInfo& info : pending) {
+        entries.push_back(toQueueEntry(info));
+    }
+    doctorQueues.reset(doctorId, today, entries);
+    return true;
+}
 
-    if (!dbManager->executeQuery(linkQuery.str())) {
-        dbManager->rollbackTransaction();
-        lastError = dbManager->getLastError();
-        return -1;
+bool SystemManager::getDoctorQueue(int doctorId, std::vector<QueueEntry>& entries, std::uint64_t* version) {
+    if (remote) {
+        // 应答为 [是否已加载, 队列, 版本号]；调用失败时按未加载处理，错误信息见getLastError()
+        entries.clear();
+        QJsonValue result;
+        if (!invokeRemote("getDoctorQueue", QJsonArray{ doctorId }, result)) {
+            return false;
+        }
+        QJsonArray reply = result.toArray();
+        if (reply.size() != 3) {
+            lastError() = "服务端返回的候诊队列格式错误";
+            return false;
+        }
+        ServiceProtocol::decode(reply.at(1), entries);
+        if (version) {
+            ServiceProtocol::decode(reply.at(2), *version);
+        }
+        return reply.at(0).toBool();
     }
+    return doctorQueues.entries(doctorId, todayDate(), entries, version);
+}
 
-    // 3. 更新挂号单状态
-    std::stringstream updateQuery;
-    updateQuery << "UPDATE registrations SET status = 'completed' WHERE registration_id = " << registrationId;
+std::optional<QueueEntry> SystemManager::callNextPatient(int doctorId) {
+    if (remote) return callRemote<std::optional<QueueEntry>>("callNextPatient", doctorId);
+    return doctorQueues.callNext(doctorId);
+}
 
-    if (!dbManager->executeQuery(updateQuery.str())) {
-        dbManager->rollbackTransaction();
-        lastError = dbManager->getLastError();
+bool SystemManager::skipPatient(int doctorId, int registrationId) {
+    if (remote) return callRemote<bool>("skipPatient", doctorId, registrationId);
+    return doctorQueues.skip(doctorId, registrationId);
+}
+
+bool SystemManager::requeuePatient(int doctorId, int registrationId) {
+    if (remote) return callRemote<bool>("requeuePatient", doctorId, registrationId);
+    return doctorQueues.requeue(doctorId, registrationId);
+}
+
+bool SystemManager::setPatientPriority(int doctorId, int registrationId, int priority) {
+    if (remote) return callRemote<bool>("setPatientPriority", doctorId, registrationId, priority);
+    return doctorQueues.setPriority(doctorId, registrationId, priority);
+}
+
+std::vector<RegistrationInfo> SystemManager::getRegistrationsByPatient(int patientId) {
+    if (remote) return callRemote<std::vector<RegistrationInfo>>("getRegistrationsByPatient", patientId);
+    return RowMapping::queryAll<RegistrationInfo>(*dbManager,
+        kRegistrationSelect + "WHERE r.patient_id = ? ORDER BY r.registration_date DESC", { patientId });
+}
+
+int SystemManager::createBill(int registrationId, double amount) {
+    if (remote) return callRemote<int>("createBill", registrationId, amount);
+    // 建单、关联挂号、更新状态由存储过程settle_registration在一个事务内完成，只需一次往返
+    // 已结算的挂号返回原账单号，重复点击不会生成第二张账单
+    // 存储过程自带事务，不能在startTransaction()开启的事务中调用
+    int billId = 0;
+    if (!dbManager->queryPrepared("CALL settle_registration(?, ?)", { registrationId, amount },
+        [&billId](const StatementRow& row) {
+        billId = static_cast<int>(row.getInt(0));
+        return false;
+    })) {
+        lastError() = dbManager->getLastError();
         return -1;
     }
 
-    if (!dbManager->commitTransaction()) {
-        lastError = dbManager->getLastError();
+    if (billId <= 0) {
+        lastError() = "结算失败：未返回账单号";
         return -1;
     }
 
-    return billId;
-}
+    // 结算后挂号为已完成，移出候诊队列
+    doctorQueues.onRegistrationClosed(registrationId);
 
-// 辅助函数
-std::string SystemManager::hashPassword(const std::string& password) {
-    std::string query = "SELECT MD5('" + dbManager->escapeString(password) + "')";
-    auto results = dbManager->getQueryResult(query);
-    if (!results.empty() && !results[0].empty()) {
-        return results[0][0];
+    if (eventBus.hasSubscribers()) {
+        ChangeEvent event = registrationEvent(ChangeEvent::Type::BillCreated, getRegistrationById(registrationId));
+        event.registrationId = registrationId;
+        event.billId = billId;
+        event.amount = amount;
+        eventBus.publish(std::move(event));
     }
-    return password;
+    return billId;
 }
 
-UserInfo SystemManager::parseUserInfo(const std::vector<std::string>& row) {
-    UserInfo info;
-    if (row.size() >= 9) {
-        info.userId = !row[0].empty() ? std::stoi(row[0]) : 0;
-        info.username = row[1];
-        info.role = row[2];
-        info.name = row[3];
-        info.gender = row[4];
-        info.age = !row[5].empty() ? std::stoi(row[5]) : 0;
-        info.phone = row[6];
-        info.address = row.size() > 7 ? row[7] : "";
-        info.idCard = row.size() > 8 ? row[8] : "";
-        info.department = row.size() > 9 ? row[9] : "";
+bool SystemManager::changePassword(int userId, const std::string& oldPassword,
+    const std::string& newPassword) {
+    if (remote) return callRemote<bool>("changePassword", userId, oldPassword, newPassword);
+
+    std::string stored;
+    bool found = false;
+    if (!dbManager->queryPrepared("SELECT password_hash FROM users WHERE user_id = ?", { userId },
+        [&](const StatementRow& row) {
+            stored = row.getString(0);
+            found = true;
+            return false;
+        })) {
+        lastError() = dbManager->getLastError();
+        return false;
     }
-    return info;
-}
 
-DoctorInfo SystemManager::parseDoctorInfo(const std::vector<std::string>& row) {
-    DoctorInfo info;
-    if (row.size() >= 6) {
-        info.doctorId = !row[0].empty() ? std::stoi(row[0]) : 0;
-        info.name = row[1];
-        info.gender = row[2];
-        info.age = !row[3].empty() ? std::stoi(row[3]) : 0;
-        info.phone = row[4];
-        info.department = row[5];
+    if (!found) {
+        lastError() = "用户不存在";
+        return false;
+    }
+    if (!PasswordHasher::verify(oldPassword, stored)) {
+        lastError() = "原密码错误";
+        return false;
     }
-    return info;
-}
 
-RegistrationInfo SystemManager::parseRegistrationInfo(const std::vector<std::string>& row) {
-    RegistrationInfo info;
-    if (row.size() >= 12) {
-        info.registrationId = !row[0].empty() ? std::stoi(row[0]) : 0;
-        info.registrationDate = row[1];
-        info.patientId = !row[2].empty() ? std::stoi(row[2]) : 0;
-        info.doctorId = !row[3].empty() ? std::stoi(row[3]) : 0;
-        info.status = row[4];
-        info.notes = row[5];
-        info.patientName = row[6];
-        info.doctorName = row[7];
-        info.doctorDepartment = row[8];
-        info.hasBill = !row[9].empty() && row[9] == "1";
-        info.billAmount = !row[10].empty() ? std::stod(row[10]) : 0.0;
-        info.billStatus = row.size() > 11 ? row[11] : "";
+    // 以旧哈希为条件更新，避免覆盖期间其他地方的修改
+    if (!dbManager->executePrepared("UPDATE users SET password_hash = ? WHERE user_id = ? AND password_hash = ?",
+        { PasswordHasher::hash(newPassword), userId, stored })) {
+        lastError() = dbManager->getLastError();
+        return false;
     }
-    return info;
+    if (dbManager->getAffectedRows() == 0) {
+        lastError() = "密码已被修改，请重新输入原密码";
+        return false;
+    }
+    return true;
 }
 
 std::string SystemManager::getLastError() const {
-    return lastError;
+    return lastErrors.read([](const std::string& error) { return error; }, std::string());
+}
+
+void SystemManager::clearLastError() {
+    lastErrors.eraseLocal();
+}
+
+std::string& SystemManager::lastError() {
+    return lastErrors.local();
 }
 // 获取所有科室
 std::vector<DoctorInfo> SystemManager::getAllDoctors() {
+    if (remote) return callRemote<std::vector<DoctorInfo>>("getAllDoctors");
     std::vector<DoctorInfo> doctors;
 
     if (!dbManager || !dbManager->isConnected()) {
@@ -495,110 +1142,43 @@ std::vector<DoctorInfo> SystemManager::getAllDoctors() {
         return doctors;
     }
 
-    try {
-        // 使用更简单的查询，确保能获取数据
-        std::string query = "SELECT doctor_id, name, gender, age, phone, department "
-            "FROM doctors ORDER BY name";
-
-        std::cout << "执行SQL查询医生: " << query << std::endl;
-
-        auto results = dbManager->getQueryResult(query);
-        std::cout << "查询结果行数: " << results.size() << std::endl;
-
-        // 输出查询结果以便调试
-        for (size_t i = 0; i < results.size(); ++i) {
-            std::cout << "第" << i << "行数据: ";
-            for (const auto& field : results[i]) {
-                std::cout << field << " | ";
-            }
-            std::cout << std::endl;
-        }
-
-        for (const auto& row : results) {
-            if (row.size() >= 6) {
-                DoctorInfo info;
-                try {
-                    info.doctorId = !row[0].empty() ? std::stoi(row[0]) : 0;
-                    info.name = row[1];
-                    info.gender = row[2];
-                    info.age = !row[3].empty() ? std::stoi(row[3]) : 0;
-                    info.phone = row[4];
-                    info.department = row[5];
-
-                    doctors.push_back(info);
-
-                    std::cout << "成功解析医生: " << info.name
-                        << " (ID: " << info.doctorId
-                        << "), 科室: " << info.department << std::endl;
-                }
-                catch (const std::exception& e) {
-                    std::cerr << "解析医生数据异常: " << e.what() << std::endl;
-                }
-            }
-        }
-
-        if (doctors.empty()) {
-            std::cout << "警告：没有找到医生数据" << std::endl;
-
-            // 检查users表中是否有医生用户
-            std::string checkUsersQuery = "SELECT COUNT(*) FROM users WHERE role = 'doctor'";
-            auto userResults = dbManager->getQueryResult(checkUsersQuery);
-            if (!userResults.empty() && userResults[0][0] != "0") {
-                std::cout << "users表中有医生用户，但doctors表中没有对应记录" << std::endl;
-            }
-        }
-
+    auto data = referenceData();
+    if (!data) {
+        std::cerr << lastError() << std::endl;
+        return doctors;
     }
-    catch (const std::exception& e) {
-        std::cerr << "获取医生列表异常: " << e.what() << std::endl;
-        lastError = "获取医生列表失败: " + std::string(e.what());
+
+    doctors = data->doctors;
+    if (doctors.empty()) {
+        std::cout << "警告：没有找到医生数据" << std::endl;
     }
 
-    std::cout << "最终返回医生数量: " << doctors.size() << std::endl;
     return doctors;
 }
 // 根据ID获取科室
 DepartmentInfo SystemManager::getDepartmentById(int departmentId) {
-    DepartmentInfo dept;
-
-    std::stringstream query;
-    query << "SELECT department_id, department_name, "
-        << "description, contact_phone, location "
-        << "FROM departments WHERE department_id = " << departmentId;
-
-    auto results = dbManager->getQueryResult(query.str());
-    if (!results.empty()) {
-        dept = parseDepartmentInfo(results[0]);
-    }
-
-    return dept;
+    if (remote) return callRemote<DepartmentInfo>("getDepartmentById", departmentId);
+    auto data = referenceData();
+    const DepartmentInfo* dept = data ? data->findDepartment(departmentId) : nullptr;
+    return dept ? *dept : DepartmentInfo();
 }
 // 根据名称获取科室
 DepartmentInfo SystemManager::getDepartmentByName(const std::string& name) {
-    DepartmentInfo dept;
-
-    std::stringstream query;
-    query << "SELECT department_id, department_name, "
-        << "description, contact_phone, location "
-        << "FROM departments WHERE department_name = '"
-        << dbManager->escapeString(name) << "'";
-
-    auto results = dbManager->getQueryResult(query.str());
-    if (!results.empty()) {
-        dept = parseDepartmentInfo(results[0]);
-    }
-
-    return dept;
+    if (remote) return callRemote<DepartmentInfo>("getDepartmentByName", name);
+    auto data = referenceData();
+    const DepartmentInfo* dept = data ? data->findDepartment(name) : nullptr;
+    return dept ? *dept : DepartmentInfo();
 }
 
 bool SystemManager::addDepartment(const DepartmentInfo& department) {
+    if (remote) return callRemote<bool>("addDepartment", department);
     // 检查科室名称是否已存在
     std::string checkQuery = "SELECT COUNT(*) FROM departments WHERE department_name = '"
         + dbManager->escapeString(department.departmentName) + "'";
 
     auto results = dbManager->getQueryResult(checkQuery);
     if (!results.empty() && results[0][0] != "0") {
-        lastError = "科室名称已存在";
+        lastError() = "科室名称已存在";
         return false;
     }
 
@@ -611,17 +1191,20 @@ bool SystemManager::addDepartment(const DepartmentInfo& department) {
         << dbManager->escapeString(department.location) << "')";
 
     if (dbManager->executeQuery(query.str())) {
+        referenceCache->invalidate();
+        publishDepartmentChanged(dbManager->getLastInsertId());
         return true;
     }
     else {
-        lastError = dbManager->getLastError();
+        lastError() = dbManager->getLastError();
         return false;
     }
 }
 
 bool SystemManager::updateDepartment(const DepartmentInfo& department) {
+    if (remote) return callRemote<bool>("updateDepartment", department);
     if (department.departmentId <= 0) {
-        lastError = "无效的科室ID";
+        lastError() = "无效的科室ID";
         return false;
     }
 
@@ -632,7 +1215,7 @@ bool SystemManager::updateDepartment(const DepartmentInfo& department) {
 
     auto results = dbManager->getQueryResult(checkQuery);
     if (!results.empty() && results[0][0] != "0") {
-        lastError = "科室名称已存在";
+        lastError() = "科室名称已存在";
         return false;
     }
 
@@ -645,22 +1228,25 @@ bool SystemManager::updateDepartment(const DepartmentInfo& department) {
         << "WHERE department_id = " << department.departmentId;
 
     if (dbManager->executeQuery(query.str())) {
+        referenceCache->invalidate();
+        publishDepartmentChanged(department.departmentId);
         return true;
     }
     else {
-        lastError = dbManager->getLastError();
+        lastError() = dbManager->getLastError();
         return false;
     }
 }
 
 bool SystemManager::deleteDepartment(int departmentId) {
+    if (remote) return callRemote<bool>("deleteDepartment", departmentId);
     // 检查是否有医生关联
     std::string checkQuery = "SELECT COUNT(*) FROM doctors WHERE department_id = "
         + std::to_string(departmentId);
 
     auto results = dbManager->getQueryResult(checkQuery);
     if (!results.empty() && results[0][0] != "0") {
-        lastError = "该科室下还有医生，无法删除";
+        lastError() = "该科室下还有医生，无法删除";
         return false;
     }
 
@@ -668,57 +1254,38 @@ bool SystemManager::deleteDepartment(int departmentId) {
         + std::to_string(departmentId);
 
     if (dbManager->executeQuery(query)) {
+        referenceCache->invalidate();
+        publishDepartmentChanged(departmentId);
         return true;
     }
     else {
-        lastError = dbManager->getLastError();
+        lastError() = dbManager->getLastError();
         return false;
     }
 }
 
 // 获取科室下的医生
 std::vector<DoctorInfo> SystemManager::getDoctorsByDepartment(int departmentId) {
-    std::vector<DoctorInfo> doctors;
-
-    std::stringstream query;
-    query << "SELECT d.doctor_id, d.name, d.gender, d.age, "
-        << "d.phone, dept.department_name "
-        << "FROM doctors d "
-        << "LEFT JOIN departments dept ON d.department_id = dept.department_id "
-        << "WHERE d.department_id = " << departmentId
-        << " ORDER BY d.name";
-
-    auto results = dbManager->getQueryResult(query.str());
-    for (const auto& row : results) {
-        doctors.push_back(parseDoctorInfo(row));
-    }
-
-    return doctors;
+    if (remote) return callRemote<std::vector<DoctorInfo>>("getDoctorsByDepartmentId", departmentId);
+    auto data = referenceData();
+    return data ? data->doctorsIn(departmentId) : std::vector<DoctorInfo>();
 }
 
 std::vector<DepartmentInfo> SystemManager::getAllDepartments() {
-    std::vector<DepartmentInfo> departments;
-
-    std::string query = "SELECT department_id, department_name, "
-        "description, contact_phone, location "
-        "FROM departments ORDER BY department_name";
-
-    auto results = dbManager->getQueryResult(query);
-    for (const auto& row : results) {
-        departments.push_back(parseDepartmentInfo(row));
-    }
-
-    return departments;
+    if (remote) return callRemote<std::vector<DepartmentInfo>>("getAllDepartments");
+    auto data = referenceData();
+    return data ? data->departments : std::vector<DepartmentInfo>();
 }
 // 分配医生到科室
 bool SystemManager::assignDoctorToDepartment(int doctorId, int departmentId) {
+    if (remote) return callRemote<bool>("assignDoctorToDepartment", doctorId, departmentId);
     // 1. 检查医生是否存在
     std::string checkDoctorQuery = "SELECT COUNT(*) FROM doctors WHERE doctor_id = "
         + std::to_string(doctorId);
 
     auto doctorResults = dbManager->getQueryResult(checkDoctorQuery);
     if (doctorResults.empty() || doctorResults[0][0] == "0") {
-        lastError = "医生不存在";
+        lastError() = "医生不存在";
         return false;
     }
 
@@ -729,91 +1296,168 @@ bool SystemManager::assignDoctorToDepartment(int doctorId, int departmentId) {
 
         auto deptResults = dbManager->getQueryResult(checkDeptQuery);
         if (deptResults.empty() || deptResults[0][0] == "0") {
-            lastError = "科室不存在";
+            lastError() = "科室不存在";
             return false;
         }
     }
 
-    // 3. 获取科室名称（如果分配的是有效科室）
-    std::string departmentName = "";
-    if (departmentId > 0) {
-        std::string getDeptNameQuery = "SELECT department_name FROM departments WHERE department_id = "
-            + std::to_string(departmentId);
-
-        auto nameResults = dbManager->getQueryResult(getDeptNameQuery);
-        if (!nameResults.empty() && !nameResults[0].empty()) {
-            departmentName = nameResults[0][0];
-        }
-    }
-
-    // 4. 执行更新操作
-    std::stringstream query;
-    query << "UPDATE doctors SET ";
-
-    if (departmentId > 0) {
-        query << "department_id = " << departmentId << ", ";
-        if (!departmentName.empty()) {
-            query << "department = '" << dbManager->escapeString(departmentName) << "' ";
-        }
-        else {
-            query << "department = NULL ";
-        }
-    }
-    else {
-        query << "department_id = NULL, department = NULL ";
-    }
-
-    query << "WHERE doctor_id = " << doctorId;
+    // 3. 更新所属科室并重算该医生的汇总（汇总按医生当前科室归类），两步在同一事务中，失败时都不生效
+    if (dbManager->executePrepared("CALL assign_doctor_department(?, ?)",
+        { doctorId, departmentId > 0 ? SqlParam(departmentId) : SqlParam() })) {
+        referenceCache->invalidate();
 
-    // 打印调试信息
-    std::cout << "执行SQL: " << query.str() << std::endl;
-
-    if (dbManager->executeQuery(query.str())) {
         // 记录操作日志（去掉currentUser的引用）
         std::string logQuery = "INSERT INTO operation_logs (operation_type, target_id, details) VALUES (";
         logQuery += "'assign_doctor', " + std::to_string(doctorId) + ", '";
         logQuery += "分配医生到科室: " + (departmentId > 0 ? std::to_string(departmentId) : "未分配") + "')";
 
         dbManager->executeQuery(logQuery); // 忽略日志错误
+
+        ChangeEvent event;
+        event.type = ChangeEvent::Type::DoctorAssigned;
+        event.doctorId = doctorId;
+        event.departmentId = departmentId > 0 ? departmentId : 0;
+        eventBus.publish(std::move(event));
         return true;
     }
     else {
-        lastError = dbManager->getLastError();
-        std::cout << "SQL执行错误: " << lastError << std::endl;
+        lastError() = dbManager->getLastError();
+        std::cout << "SQL执行错误: " << lastError() << std::endl;
         return false;
     }
 }
 
 // 获取可挂号的科室（有医生的科室）
 std::vector<DepartmentInfo> SystemManager::getAvailableDepartmentsForRegistration() {
-    std::vector<DepartmentInfo> departments;
+    if (remote) return callRemote<std::vector<DepartmentInfo>>("getAvailableDepartmentsForRegistration");
+    auto data = referenceData();
+    return data ? data->availableDepartments : std::vector<DepartmentInfo>();
+}
 
-    std::string query = R"(
-        SELECT DISTINCT d.department_id, d.department_name, 
-               d.description, d.contact_phone, d.location
-        FROM departments d
-        INNER JOIN doctors doc ON d.department_id = doc.department_id
-        WHERE doc.department_id IS NOT NULL
-        ORDER BY d.department_name
-    )";
+void SystemManager::publishDepartmentChanged(int departmentId) {
+    ChangeEvent event;
+    event.type = ChangeEvent::Type::DepartmentChanged;
+    event.departmentId = departmentId;
+    eventBus.publish(std::move(event));
+}
 
-    auto results = dbManager->getQueryResult(query);
-    for (const auto& row : results) {
-        departments.push_back(parseDepartmentInfo(row));
+// 参考数据快照，加载失败时设置错误信息并返回nullptr
+std::shared_ptr<const ReferenceDataCache::Snapshot> SystemManager::referenceData() {
+    std::string error;
+    auto data = referenceCache->snapshot(&error);
+    if (!data) {
+        lastError() = error;
     }
+    return data;
+}
 
-    return departments;
+DashboardStats SystemManager::getDashboardStats(const DashboardScope& scope) {
+    if (remote) return callRemote<DashboardStats>("getDashboardStats", scope);
+    DashboardStats stats;
+    bool ok = false;
+
+    if (scope.doctorId > 0) {
+        ok = dbManager->queryPrepared(kDoctorDashboardQuery, { scope.doctorId }, [&stats](const StatementRow& row) {
+            stats.totalCount = static_cast<int>(row.getInt(0));
+            stats.pendingCount = static_cast<int>(row.getInt(1));
+            stats.completedCount = static_cast<int>(row.getInt(2));
+            stats.todayRegistrations = static_cast<int>(row.getInt(3));
+            stats.todayCompleted = static_cast<int>(row.getInt(4));
+            return false;
+        });
+    }
+    else {
+        ok = dbManager->queryPrepared(kHospitalDashboardQuery, {}, [&stats](const StatementRow& row) {
+            stats.todayRegistrations = static_cast<int>(row.getInt(0));
+            stats.todayCompleted = static_cast<int>(row.getInt(1));
+            stats.totalIncome = row.getDouble(2);
+            stats.doctorCount = static_cast<int>(row.getInt(3));
+            stats.patientCount = static_cast<int>(row.getInt(4));
+            return false;
+        });
+    }
+
+    if (!ok) {
+        lastError() = "获取统计数据失败: " + dbManager->getLastError();
+        return DashboardStats();
+    }
+    return stats;
+}
+
+std::vector<DepartmentReportRow> SystemManager::getDepartmentReport(const std::string& startDate,
+    const std::string& endDate) {
+    if (remote) return callRemote<std::vector<DepartmentReportRow>>("getDepartmentReport", startDate, endDate);
+
+    std::string error;
+    std::vector<DepartmentReportRow> rows = RowMapping::queryAll<DepartmentReportRow>(*dbManager,
+        kDepartmentReportQuery, { startDate, endDate }, &error);
+    // 空报表也是正常结果，这里同时清除之前遗留的错误信息
+    lastError() = error.empty() ? std::string() : "生成报表失败: " + error;
+    return rows;
 }
 
-// 解析科室信息
-DepartmentInfo SystemManager::parseDepartmentInfo(const std::vector<std::string>& row) {
-    DepartmentInfo info;
-    if (row.size() >= 5) {
-        info.departmentId = !row[0].empty() ? std::stoi(row[0]) : 0;
-        info.departmentName = row[1];
-        info.description = row[2];
-        info.contactPhone = row[3];
-        info.location = row[4];
+bool SystemManager::rebuildDailyStats(int doctorId) {
+    if (remote) return callRemote<bool>("rebuildDailyStats", doctorId);
+    if (!dbManager->executePrepared("CALL rebuild_daily_stats(?)",
+        { doctorId > 0 ? SqlParam(doctorId) : SqlParam() })) {
+        lastError() = "重建汇总数据失败: " + dbManager->getLastError();
+        return false;
     }
-    return info;
-}
\ No newline at end of file
+    return true;
+}
+
+// 异步接口：工作线程中调用同步接口，错误信息在工作线程内读取（各线程独立）
+AsyncTask SystemManager::loginAsync(const std::string& username, const std::string& password,
+    const std::string& role, QObject* context, std::function<void(const UserInfo&, const std::string&)> done) {
+
+    return runAsync(context, [this, username, password, role](const AsyncTask&) {
+        UserInfo user = login(username, password, role);
+        return std::make_pair(user, user.userId != 0 ? std::string() : getLastError());
+    }, [done](const std::pair<UserInfo, std::string>& result) {
+        done(result.first, result.second);
+    });
+}
+
+AsyncTask SystemManager::getAllRegistrationsAsync(QObject* context,
+    std::function<void(const std::vector<RegistrationInfo>&, const std::string&)> done) {
+
+    return runAsync(context, [this](const AsyncTask& task) {
+        std::pair<std::vector<RegistrationInfo>, std::string> result;
+        bool ok = forEachRegistration([&](const RegistrationInfo& info) {
+            result.first.push_back(info);
+            return !task.isCancelled();
+        });
+        if (!ok) {
+            result.second = getLastError();
+        }
+        return result;
+    }, [done](const std::pair<std::vector<RegistrationInfo>, std::string>& result) {
+        done(result.first, result.second);
+    });
+}
+
+AsyncTask SystemManager::queryRegistrationsAsync(const RegistrationFilter& filter,
+    const RegistrationCursor& cursor, int limit, QObject* context,
+    std::function<void(const std::vector<RegistrationInfo>&, const std::string&)> done) {
+
+    return runAsync(context, [this, filter, cursor, limit](const AsyncTask&) {
+        std::pair<std::vector<RegistrationInfo>, std::string> result;
+        if (!queryRegistrations(filter, cursor, limit, result.first)) {
+            result.second = getLastError();
+        }
+        return result;
+    }, [done](const std::pair<std::vector<RegistrationInfo>, std::string>& result) {
+        done(result.first, result.second);
+    });
+}
+
+AsyncTask SystemManager::createBillAsync(int registrationId, double amount, QObject* context,
+    std::function<void(int, const std::string&)> done) {
+
+    return runAsync(context, [this, registrationId, amount](const AsyncTask&) {
+        int billId = createBill(registrationId, amount);
+        return std::make_pair(billId, billId > 0 ? std::string() : getLastError());
+    }, [done](const std::pair<int, std::string>& result) {
+        done(result.first, result.second);
+    });
+}
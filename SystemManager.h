@@ -1,14 +1,33 @@
 ﻿#pragma once
 #include "DatabaseManager.h"
 #include "CommonTypes.h"
+#include "AsyncTask.h"
+#include "ReferenceDataCache.h"
+#include "DoctorQueue.h"
+#include "PinyinIndex.h"
+#include "ChangeEventBus.h"
+#include "PerThreadState.h"
+#include <atomic>
+#include <chrono>
 #include <memory>
 #include <string>
 #include <vector>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+class QJsonArray;
+class QJsonValue;
+class RemoteClient;
 
 class SystemManager {
 private:
-   
-    std::string lastError;
+    // 错误信息按线程区分，后台任务和UI线程互不覆盖
+    PerThreadState<std::string> lastErrors;     // 线程退出时删除，复用的线程id不会读到旧错误
+
+    // 执行异步任务的后台线程池（线程数与连接池上限一致）
+    std::unique_ptr<QThreadPool> workerPool;
 
 public:
     std::unique_ptr<DatabaseManager> dbManager;
@@ -27,9 +46,13 @@ public:
         const std::string& password = "",
         const std::string& database = "hospital_system",
         unsigned int port = 3306);
+    // 改为连接挂号服务（Hospital.exe --serve）：之后的业务调用都在服务端执行，本进程不再连接数据库
+    // 与initialize()二选一
+    bool connectRemote(const std::string& host, unsigned short port);
+    bool isRemote() const { return remote != nullptr; }
 
-    // 用户认证
-    UserInfo login(const std::string& username, const std::string& password);
+    // 用户认证：按所选角色查询，一次往返取回用户信息和口令哈希，口令在本地校验
+    UserInfo login(const std::string& username, const std::string& password, const std::string& role);
     bool registerUser(const std::string& username, const std::string& password,
         const std::string& role, const UserInfo& userInfo);
     bool changePassword(int userId, const std::string& oldPassword,
@@ -41,10 +64,14 @@ public:
 
     // 医生管理
     std::vector<DoctorInfo> getAllDoctors();
+    // 按姓名或拼音（全拼、首字母，如zs）检索医生，结果按拼音排序
+    std::vector<DoctorInfo> searchDoctors(const std::string& term, int limit = 20);
     std::vector<DoctorInfo> getDoctorsByDepartment(const std::string& department);
 
     // 病人管理
     UserInfo getPatientInfo(int patientId);
+    // 按姓名、拼音、手机号、身份证号检索病人：前缀和拼音匹配排在前面，其次是子串匹配，最多返回limit条
+    std::vector<PatientSearchResult> searchPatients(const std::string& term, int limit = 20);
 
     // 挂号管理
     int createRegistration(int patientId, int doctorId,
@@ -53,12 +80,54 @@ public:
     std::vector<RegistrationInfo> getRegistrationsByDoctor(int doctorId);
     std::vector<RegistrationInfo> getAllRegistrations();
     RegistrationInfo getRegistrationById(int registrationId);
+    // 流式遍历挂号记录（doctorId为0时遍历全部），逐行回调而不整体加载到内存；回调返回false提前结束
+    bool forEachRegistration(const std::function<bool(const RegistrationInfo&)>& onRegistration,
+        int doctorId = 0);
+    // 按条件分页查询挂号记录：条件下推到WHERE走索引，按(挂号日期, 单号)降序，从cursor之后取最多limit条
+    // 下一页的游标为RegistrationCursor::after(本页最后一行)，返回条数小于limit表示没有更多
+    bool queryRegistrations(const RegistrationFilter& filter, const RegistrationCursor& cursor, int limit,
+        std::vector<RegistrationInfo>& page);
+    // 导出挂号记录为CSV（doctorId为0时导出全部），返回导出行数，失败返回-1
+    // onProgress（可为空）每写入一批行后以已写入行数调用，返回false时取消导出、删除未写完的文件并返回-1
+    int exportRegistrationsCsv(const std::string& filePath, int doctorId = 0,
+        const std::function<bool(int rows)>& onProgress = nullptr);
     bool updateRegistrationStatus(int registrationId,
         const std::string& status, const std::string& notes = "");
+    bool deleteRegistration(int registrationId);
+
+    // 号源：createRegistration在数据库中原子扣减，号满时返回-1并提示号源已满
+    // 某天各医生的剩余号源（医生ID → 剩余数），一条按主键关联的查询
+    std::unordered_map<int, int> getRemainingSlots(const std::string& date);
+    // 医生默认每日号源数，以及单独设置某一天的号源数
+    bool setDoctorDailyCapacity(int doctorId, int capacity);
+    bool setDoctorSlotCapacity(int doctorId, const std::string& date, int capacity);
+
+    // 医生当日候诊队列：开始接诊时从数据库加载一次，之后由挂号、结算、状态变更在内存中增量维护
+    bool loadDoctorQueue(int doctorId);
+    // 读取内存中的队列（不访问数据库），今日队列尚未加载时返回false
+    bool getDoctorQueue(int doctorId, std::vector<QueueEntry>& entries, std::uint64_t* version = nullptr);
+    std::optional<QueueEntry> callNextPatient(int doctorId);
+    bool skipPatient(int doctorId, int registrationId);
+    bool requeuePatient(int doctorId, int registrationId);
+    bool setPatientPriority(int doctorId, int registrationId, int priority);
 
     // 结算管理
     int createBill(int registrationId, double amount);
     BillInfo getBillByRegistrationId(int registrationId);
+
+    // 仪表盘统计：医生范围和全院范围各一条查询，失败时返回全0并设置错误信息
+    DashboardStats getDashboardStats(const DashboardScope& scope);
+
+    // 姓名拼音索引：首次检索时从数据库加载，之后随注册和修改资料更新；可在登录后提前调用
+    bool prepareNameIndex();
+    // 索引的最长缓存时间（默认300秒），超过后下次检索时重新加载，以看到其他客户端的修改
+    void setNameIndexMaxAge(std::chrono::seconds maxAge);
+
+    // 按科室汇总的报表（日期格式yyyy-MM-dd，含首尾两天）
+    std::vector<DepartmentReportRow> getDepartmentReport(const std::string& startDate, const std::string& endDate);
+
+    // 按挂号和账单重建daily_stats汇总（doctorId为0时全部重建）
+    bool rebuildDailyStats(int doctorId = 0);
     std::vector<DepartmentInfo> getAllDepartments();
 
     // 根据ID获取科室
@@ -84,15 +153,59 @@ public:
 
     // 获取可挂号的科室（有医生的科室）
     std::vector<DepartmentInfo> getAvailableDepartmentsForRegistration();
-    // 错误处理
+    // 错误处理（返回当前线程最近一次的错误）
     std::string getLastError() const;
+    void clearLastError();
+
+    // 异步接口：在后台线程池执行，完成后在UI线程回调，error为空表示成功
+    // context销毁或返回的任务被cancel()后不再回调
+    AsyncTask loginAsync(const std::string& username, const std::string& password, const std::string& role,
+        QObject* context,
+        std::function<void(const UserInfo& user, const std::string& error)> done);
+    AsyncTask getAllRegistrationsAsync(QObject* context,
+        std::function<void(const std::vector<RegistrationInfo>& registrations, const std::string& error)> done);
+    AsyncTask queryRegistrationsAsync(const RegistrationFilter& filter, const RegistrationCursor& cursor, int limit,
+        QObject* context,
+        std::function<void(const std::vector<RegistrationInfo>& page, const std::string& error)> done);
+    AsyncTask createBillAsync(int registrationId, double amount, QObject* context,
+        std::function<void(int billId, const std::string& error)> done);
+
+    // 写操作成功后发布的变更事件，界面订阅后按事件只更新受影响的行
+    ChangeEventBus& changeEvents() { return eventBus; }
+
+    // 通用异步执行：work(const AsyncTask&)在后台线程运行，done(result)在UI线程运行
+    template<typename Work, typename Done>
+    AsyncTask runAsync(QObject* context, Work work, Done done) {
+        return startAsyncTask(*workerPool, context, std::move(work), std::move(done));
+    }
 
 private:
-    std::string hashPassword(const std::string& password);
-    UserInfo parseUserInfo(const std::vector<std::string>& row);
-    DoctorInfo parseDoctorInfo(const std::vector<std::string>& row);
-    RegistrationInfo parseRegistrationInfo(const std::vector<std::string>& row);
-    // 解析科室信息
-    DepartmentInfo parseDepartmentInfo(const std::vector<std::string>& row);
-
+    std::string& lastError();
+
+    // 远程模式的客户端，为空时在本进程内访问数据库
+    std::unique_ptr<RemoteClient> remote;
+    bool invokeRemote(const char* method, const QJsonArray& args, QJsonValue& result);
+    template<typename R, typename... Args>
+    R callRemote(const char* method, const Args&... args);
+    std::shared_ptr<const ReferenceDataCache::Snapshot> referenceData();
+
+    // 医生、科室参考数据缓存，相关写操作成功后失效
+    std::unique_ptr<ReferenceDataCache> referenceCache;
+
+    ChangeEventBus eventBus;
+
+    // 已加载的医生候诊队列
+    DoctorQueueBoard doctorQueues;
+
+    // 医生、病人姓名的拼音索引
+    PinyinIndex doctorNameIndex;
+    PinyinIndex patientNameIndex;
+    std::mutex nameIndexMutex;
+    std::atomic<bool> nameIndexLoaded{ false };
+    std::atomic<std::chrono::steady_clock::rep> nameIndexLoadedAt{ 0 };
+    std::atomic<long long> nameIndexMaxAgeSeconds{ 300 };
+    void updateNameIndex(const std::string& role, int userId, const std::string& name);
+    void publishDepartmentChanged(int departmentId);
+    // 待处理挂号放入对应医生的今日队列（队列未加载或不是今日挂号时忽略）
+    void enqueuePendingRegistration(const RegistrationInfo& info);
 };
\ No newline at end of file
@@ -1,4 +1,8 @@
 ﻿#include "LoginWindow.h"
+#include "QueryPlanAudit.h"
+#include "HospitalService.h"
+#include "LoadBenchmark.h"
+#include "ServiceProtocol.h"
 #include <QApplication>
 #include <QFile>
 #include <QFont>
@@ -7,7 +11,111 @@
 #include<qfile.h>
 #include<qdebug.h>
 #include<qdir.h>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#ifdef _WIN32
+#include <windows.h>
+#include <cstdio>
+#endif
+
+// 命令行模式（--serve、--rebuild-daily-stats、--bench）的诊断输出：程序按Windows子系统链接，没有自己的控制台，
+// 附加到启动它的命令行窗口并重新打开标准输出；命令行不会等待程序结束，需要退出码时用 start /wait 启动
+static void attachParentConsole() {
+#ifdef _WIN32
+    if (!AttachConsole(ATTACH_PARENT_PROCESS)) {
+        return;
+    }
+    FILE* stream = nullptr;
+    freopen_s(&stream, "CONOUT$", "w", stdout);
+    freopen_s(&stream, "CONOUT$", "w", stderr);
+    std::cout.clear();
+    std::cerr.clear();
+#endif
+}
+
+// 连接数据库，或以 --connect 主机:端口 连接挂号服务（不直接连接数据库）
+static bool initializeSystem(SystemManager& manager) {
+    QStringList arguments = QCoreApplication::arguments();
+    int index = arguments.indexOf("--connect");
+    if (index >= 0 && index + 1 < arguments.size()) {
+        QString endpoint = arguments.at(index + 1);
+        int colon = endpoint.lastIndexOf(':');
+        QString host = colon > 0 ? endpoint.left(colon) : endpoint;
+        int port = colon > 0 ? endpoint.mid(colon + 1).toInt() : ServiceProtocol::kDefaultPort;
+        return manager.connectRemote(host.toStdString(), static_cast<unsigned short>(port));
+    }
+    return manager.initialize("127.0.0.1", "aaaa", "mysql123", "hospital_system", 3306);
+}
+
 int main(int argc, char* argv[]) {
+    // 执行计划回归检查：Hospital.exe --explain-audit，结果写入explain_audit.log，退出码0为通过
+    if (argc > 1 && std::strcmp(argv[1], "--explain-audit") == 0) {
+        std::ofstream report("explain_audit.log");
+        // 与登录窗口使用相同的连接参数，检查在独立的审计库中进行
+        return QueryPlanAudit::runStandalone("127.0.0.1", "aaaa", "mysql123", 3306, report);
+    }
+
+    // 重建汇总表：Hospital.exe --rebuild-daily-stats，按挂号和账单明细重新计算daily_stats
+    if (argc > 1 && std::strcmp(argv[1], "--rebuild-daily-stats") == 0) {
+        attachParentConsole();
+        SystemManager manager;
+        if (!manager.initialize("127.0.0.1", "aaaa", "mysql123", "hospital_system", 3306)
+            || !manager.rebuildDailyStats()) {
+            std::cerr << "重建daily_stats失败: " << manager.getLastError() << std::endl;
+            return 1;
+        }
+        std::cout << "daily_stats已重建" << std::endl;
+        return 0;
+    }
+
+    // 挂号流程压测：Hospital.exe --bench [threads=8 duration=30 mix=5,40,30,15,10 ...]，结果默认写入bench_result.json
+    if (argc > 1 && std::strcmp(argv[1], "--bench") == 0) {
+        attachParentConsole();
+        LoadBenchmark::Options options;
+        std::string error;
+        if (!options.parse(std::vector<std::string>(argv + 2, argv + argc), error)) {
+            std::cerr << error << std::endl;
+            return 2;
+        }
+        std::ofstream result(options.outputPath);
+        return LoadBenchmark::runStandalone("127.0.0.1", "aaaa", "mysql123", 3306, options, result, std::cout);
+    }
+
+    // 挂号服务：Hospital.exe --serve [端口] [--bind 地址]，客户端以 Hospital.exe --connect 主机:端口 启动
+    // 默认只监听本机；口令以明文传输，监听院内网络地址（如--bind 0.0.0.0）时须确认网络可信
+    if (argc > 1 && std::strcmp(argv[1], "--serve") == 0) {
+        attachParentConsole();
+        QCoreApplication app(argc, argv);
+        unsigned short port = ServiceProtocol::kDefaultPort;
+        QHostAddress address(QHostAddress::LocalHost);
+        for (int i = 2; i < argc; ++i) {
+            if (std::strcmp(argv[i], "--bind") == 0 && i + 1 < argc) {
+                if (!address.setAddress(QString::fromStdString(argv[++i]))) {
+                    std::cerr << "无效的监听地址: " << argv[i] << std::endl;
+                    return 2;
+                }
+            }
+            else {
+                port = static_cast<unsigned short>(std::atoi(argv[i]));
+            }
+        }
+
+        SystemManager manager;
+        if (!manager.initialize("127.0.0.1", "aaaa", "mysql123", "hospital_system", 3306)) {
+            std::cerr << "连接数据库失败: " << manager.getLastError() << std::endl;
+            return 1;
+        }
+        HospitalService service(manager);
+        if (!service.listen(address, port)) {
+            std::cerr << "监听端口失败: " << service.lastError() << std::endl;
+            return 1;
+        }
+        std::cout << "挂号服务已启动，地址 " << address.toString().toStdString() << "，端口 " << port << std::endl;
+        return app.exec();
+    }
+
     QApplication app(argc, argv);
     // 设置应用程序信息
     app.setApplicationName("医院挂号管理系统");
@@ -122,8 +230,16 @@ int main(int argc, char* argv[]) {
         )");
     }
 
+    // 系统管理器在整个进程中只有一个：数据库连接池、缓存和表结构检查只在启动时做一次，
+    // 登录窗口和主窗口随会话创建和销毁
+    SystemManager manager;
+    if (!initializeSystem(manager)) {
+        QMessageBox::critical(nullptr, "错误", "系统初始化失败，请检查数据库配置！");
+        return 1;
+    }
+
     // 创建并显示登录窗口
-    LoginWindow loginWindow;
-    loginWindow.show();
+    LoginWindow* loginWindow = new LoginWindow(&manager);
+    loginWindow->show();
     return app.exec();
 }
\ No newline at end of file